@@ -0,0 +1,117 @@
+#include "benchmark/benchmark.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/// The single shared queue pool that ThreadPool used to be, as a baseline.
+class SharedQueuePool {
+public:
+  explicit SharedQueuePool(unsigned ThreadCount) {
+    for (unsigned I = 0; I < ThreadCount; ++I)
+      Threads.emplace_back([this] {
+        while (true) {
+          std::packaged_task<void()> Task;
+          {
+            std::unique_lock<std::mutex> LockGuard(QueueLock);
+            QueueCondition.wait(LockGuard,
+                                [&] { return !EnableFlag || !Tasks.empty(); });
+            if (!EnableFlag && Tasks.empty())
+              return;
+            ++ActiveThreads;
+            Task = std::move(Tasks.front());
+            Tasks.pop();
+          }
+          Task();
+          {
+            std::unique_lock<std::mutex> LockGuard(QueueLock);
+            --ActiveThreads;
+          }
+          CompletionCondition.notify_all();
+        }
+      });
+  }
+
+  ~SharedQueuePool() {
+    {
+      std::unique_lock<std::mutex> LockGuard(QueueLock);
+      EnableFlag = false;
+    }
+    QueueCondition.notify_all();
+    for (auto &Worker : Threads)
+      Worker.join();
+  }
+
+  std::shared_future<void> async(std::function<void()> F) {
+    std::packaged_task<void()> Task(std::move(F));
+    auto Future = Task.get_future().share();
+    {
+      std::unique_lock<std::mutex> LockGuard(QueueLock);
+      Tasks.push(std::move(Task));
+    }
+    QueueCondition.notify_one();
+    return Future;
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> LockGuard(QueueLock);
+    CompletionCondition.wait(
+        LockGuard, [&] { return !ActiveThreads && Tasks.empty(); });
+  }
+
+private:
+  std::vector<std::thread> Threads;
+  std::queue<std::packaged_task<void()>> Tasks;
+  std::mutex QueueLock;
+  std::condition_variable QueueCondition;
+  std::condition_variable CompletionCondition;
+  unsigned ActiveThreads = 0;
+  bool EnableFlag = true;
+};
+
+} // end anonymous namespace
+
+/// Many tiny independent tasks submitted from the main thread.
+template <typename PoolTy> static void BM_FlatTasks(benchmark::State &State) {
+  PoolTy Pool(std::thread::hardware_concurrency());
+  std::atomic<unsigned> Counter{0};
+  for (auto _ : State) {
+    for (int I = 0; I < State.range(0); ++I)
+      Pool.async([&Counter] { ++Counter; });
+    Pool.wait();
+  }
+  State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+BENCHMARK_TEMPLATE(BM_FlatTasks, SharedQueuePool)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(BM_FlatTasks, ThreadPool)->Arg(1 << 14);
+
+/// A few tasks that each fan out into many tiny subtasks, as a parallel
+/// pass over the functions of a module would.
+template <typename PoolTy>
+static void BM_NestedTasks(benchmark::State &State) {
+  PoolTy Pool(std::thread::hardware_concurrency());
+  std::atomic<unsigned> Counter{0};
+  for (auto _ : State) {
+    for (int I = 0; I < 64; ++I)
+      Pool.async([&Pool, &Counter, &State] {
+        for (int J = 0; J < State.range(0); ++J)
+          Pool.async([&Counter] { ++Counter; });
+      });
+    Pool.wait();
+  }
+  State.SetItemsProcessed(State.iterations() * 64 * State.range(0));
+}
+BENCHMARK_TEMPLATE(BM_NestedTasks, SharedQueuePool)->Arg(256);
+BENCHMARK_TEMPLATE(BM_NestedTasks, ThreadPool)->Arg(256);
+
+BENCHMARK_MAIN();
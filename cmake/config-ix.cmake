@@ -44,6 +44,7 @@ check_include_file(termios.h HAVE_TERMIOS_H)
 check_include_file(unistd.h HAVE_UNISTD_H)
 check_include_file(valgrind/valgrind.h HAVE_VALGRIND_VALGRIND_H)
 check_include_file(zlib.h HAVE_ZLIB_H)
+check_include_file(zstd.h HAVE_ZSTD_H)
 check_include_file(fenv.h HAVE_FENV_H)
 check_symbol_exists(FE_ALL_EXCEPT "fenv.h" HAVE_DECL_FE_ALL_EXCEPT)
 check_symbol_exists(FE_INEXACT "fenv.h" HAVE_DECL_FE_INEXACT)
@@ -117,6 +118,18 @@ if(NOT LLVM_USE_SANITIZER MATCHES "Memory.*")
       endif()
     endforeach()
   endif()
+  set(HAVE_LIBZSTD 0)
+  if(LLVM_ENABLE_ZSTD)
+    foreach(library zstd zstd_static)
+      string(TOUPPER ${library} library_suffix)
+      check_library_exists(${library} ZSTD_compressStream2 "" HAVE_LIBZSTD_${library_suffix})
+      if(HAVE_LIBZSTD_${library_suffix})
+        set(HAVE_LIBZSTD 1)
+        set(ZSTD_LIBRARIES "${library}")
+        break()
+      endif()
+    endforeach()
+  endif()
 
   # Don't look for these libraries on Windows.
   if (NOT PURE_WINDOWS)
@@ -492,6 +505,13 @@ if (LLVM_ENABLE_ZLIB )
   endif()
 endif()
 
+if (LLVM_ENABLE_ZSTD)
+  # Check if zstd is available in the system.
+  if ( NOT HAVE_ZSTD_H OR NOT HAVE_LIBZSTD )
+    set(LLVM_ENABLE_ZSTD 0)
+  endif()
+endif()
+
 if (LLVM_ENABLE_DOXYGEN)
   message(STATUS "Doxygen enabled.")
   find_package(Doxygen REQUIRED)
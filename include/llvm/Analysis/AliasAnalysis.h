@@ -291,7 +291,7 @@ class AAResults {
 public:
   // Make these results default constructable and movable. We have to spell
   // these out because MSVC won't synthesize them.
-  AAResults(const TargetLibraryInfo &TLI) : TLI(TLI) {}
+  AAResults(const TargetLibraryInfo &TLI);
   AAResults(AAResults &&Arg);
   ~AAResults();
 
@@ -317,6 +317,21 @@ public:
   bool invalidate(Function &F, const PreservedAnalyses &PA,
                   FunctionAnalysisManager::Invalidator &Inv);
 
+  /// With -aa-cache-results, the results of the alias queries made while a
+  /// BatchScope of the aggregation is alive are cached, and shared by all its
+  /// clients. The IR must not change until the scope ends, as a result is
+  /// reused whatever its pointers become: passes rewrite pointers in place
+  /// while still preserving the alias analyses.
+  class BatchScope {
+    AAResults &AAR;
+
+  public:
+    explicit BatchScope(AAResults &AAR);
+    BatchScope(const BatchScope &) = delete;
+    BatchScope &operator=(const BatchScope &) = delete;
+    ~BatchScope();
+  };
+
   //===--------------------------------------------------------------------===//
   /// \name Alias Queries
   /// @{
@@ -723,11 +738,24 @@ private:
 
   template <typename T> friend class AAResultBase;
 
+  class ResultCache;
+
   const TargetLibraryInfo &TLI;
 
   std::vector<std::unique_ptr<Concept>> AAs;
 
   std::vector<AnalysisKey *> AADeps;
+
+  /// The results of the earlier alias queries of the current batch, shared by
+  /// all its clients. Only set with -aa-cache-results.
+  std::unique_ptr<ResultCache> Cache;
+
+  /// The number of alias queries in progress. The implementations query the
+  /// aggregation again with refined locations from within their own queries.
+  unsigned QueryDepth = 0;
+
+  /// The number of live BatchScopes.
+  unsigned NumBatches = 0;
 };
 
 /// Temporary typedef for legacy code that uses a generic \c AliasAnalysis
@@ -108,6 +108,11 @@ public:
   /// the values about which this assumption provides information).
   void updateAffectedValues(CallInst *CI);
 
+  /// Add the values about which the assumption \p CI provides information to
+  /// \p Affected.
+  static void findAffectedValues(CallInst *CI,
+                                 SmallVectorImpl<Value *> &Affected);
+
   /// Clear the cache of \@llvm.assume intrinsics for a function.
   ///
   /// It will be re-scanned the next time it is requested.
@@ -104,7 +104,9 @@
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
+#include <mutex>
 #include <utility>
+#include <vector>
 
 namespace llvm {
 
@@ -300,8 +302,31 @@ struct CGSCCUpdateResult {
   /// for a better technique.
   SmallDenseSet<std::pair<LazyCallGraph::Node *, LazyCallGraph::SCC *>, 4>
       &InlinedInternalEdges;
+
+  /// If non-null, the mutex guarding the call graph, the invalidated sets
+  /// above and the functions of the module, when a
+  /// ParallelModuleToPostOrderCGSCCPassAdaptor runs the passes on several
+  /// threads. It is not held while the passes run: they take it, through
+  /// lockCallGraph(), only around their reads and updates of the call graph
+  /// outside of the nodes of the current SCC.
+  std::mutex *CallGraphMutex;
+
+  /// Locks \c CallGraphMutex, if any, until the returned lock is destroyed.
+  std::unique_lock<std::mutex> lockCallGraph() {
+    if (!CallGraphMutex)
+      return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(*CallGraphMutex);
+  }
 };
 
+/// Run a CGSCC pass, through \p RunPass, over the SCCs of the RefSCCs queued
+/// in the worklist of \p UR, in post-order, following the refinements the
+/// pass makes to the call graph. This is the walk the post-order CGSCC
+/// adaptors do for each RefSCC of the call graph.
+PreservedAnalyses runOnRefSCCWorklist(
+    CGSCCAnalysisManager &AM, CGSCCUpdateResult &UR,
+    function_ref<PreservedAnalyses(LazyCallGraph::SCC &)> RunPass);
+
 /// The core module pass which does a post-order walk of the SCCs and
 /// runs a CGSCC pass over each one.
 ///
@@ -360,9 +385,9 @@ public:
     SmallDenseSet<std::pair<LazyCallGraph::Node *, LazyCallGraph::SCC *>, 4>
         InlinedInternalEdges;
 
-    CGSCCUpdateResult UR = {RCWorklist,          CWorklist, InvalidRefSCCSet,
-                            InvalidSCCSet,       nullptr,   nullptr,
-                            InlinedInternalEdges};
+    CGSCCUpdateResult UR = {RCWorklist,           CWorklist, InvalidRefSCCSet,
+                            InvalidSCCSet,        nullptr,   nullptr,
+                            InlinedInternalEdges, nullptr};
 
     PreservedAnalyses PA = PreservedAnalyses::all();
     CG.buildRefSCCs();
@@ -383,105 +408,9 @@ public:
       // We also eagerly increment the iterator to the next position because
       // the CGSCC passes below may delete the current RefSCC.
       RCWorklist.insert(&*RCI++);
-
-      do {
-        LazyCallGraph::RefSCC *RC = RCWorklist.pop_back_val();
-        if (InvalidRefSCCSet.count(RC)) {
-          LLVM_DEBUG(dbgs() << "Skipping an invalid RefSCC...\n");
-          continue;
-        }
-
-        assert(CWorklist.empty() &&
-               "Should always start with an empty SCC worklist");
-
-        LLVM_DEBUG(dbgs() << "Running an SCC pass across the RefSCC: " << *RC
-                          << "\n");
-
-        // Push the initial SCCs in reverse post-order as we'll pop off the
-        // back and so see this in post-order.
-        for (LazyCallGraph::SCC &C : llvm::reverse(*RC))
-          CWorklist.insert(&C);
-
-        do {
-          LazyCallGraph::SCC *C = CWorklist.pop_back_val();
-          // Due to call graph mutations, we may have invalid SCCs or SCCs from
-          // other RefSCCs in the worklist. The invalid ones are dead and the
-          // other RefSCCs should be queued above, so we just need to skip both
-          // scenarios here.
-          if (InvalidSCCSet.count(C)) {
-            LLVM_DEBUG(dbgs() << "Skipping an invalid SCC...\n");
-            continue;
-          }
-          if (&C->getOuterRefSCC() != RC) {
-            LLVM_DEBUG(dbgs()
-                       << "Skipping an SCC that is now part of some other "
-                          "RefSCC...\n");
-            continue;
-          }
-
-          do {
-            // Check that we didn't miss any update scenario.
-            assert(!InvalidSCCSet.count(C) && "Processing an invalid SCC!");
-            assert(C->begin() != C->end() && "Cannot have an empty SCC!");
-            assert(&C->getOuterRefSCC() == RC &&
-                   "Processing an SCC in a different RefSCC!");
-
-            UR.UpdatedRC = nullptr;
-            UR.UpdatedC = nullptr;
-            PreservedAnalyses PassPA = Pass.run(*C, CGAM, CG, UR);
-
-            // Update the SCC and RefSCC if necessary.
-            C = UR.UpdatedC ? UR.UpdatedC : C;
-            RC = UR.UpdatedRC ? UR.UpdatedRC : RC;
-
-            // If the CGSCC pass wasn't able to provide a valid updated SCC,
-            // the current SCC may simply need to be skipped if invalid.
-            if (UR.InvalidatedSCCs.count(C)) {
-              LLVM_DEBUG(dbgs()
-                         << "Skipping invalidated root or island SCC!\n");
-              break;
-            }
-            // Check that we didn't miss any update scenario.
-            assert(C->begin() != C->end() && "Cannot have an empty SCC!");
-
-            // We handle invalidating the CGSCC analysis manager's information
-            // for the (potentially updated) SCC here. Note that any other SCCs
-            // whose structure has changed should have been invalidated by
-            // whatever was updating the call graph. This SCC gets invalidated
-            // late as it contains the nodes that were actively being
-            // processed.
-            CGAM.invalidate(*C, PassPA);
-
-            // Then intersect the preserved set so that invalidation of module
-            // analyses will eventually occur when the module pass completes.
-            PA.intersect(std::move(PassPA));
-
-            // The pass may have restructured the call graph and refined the
-            // current SCC and/or RefSCC. We need to update our current SCC and
-            // RefSCC pointers to follow these. Also, when the current SCC is
-            // refined, re-run the SCC pass over the newly refined SCC in order
-            // to observe the most precise SCC model available. This inherently
-            // cannot cycle excessively as it only happens when we split SCCs
-            // apart, at most converging on a DAG of single nodes.
-            // FIXME: If we ever start having RefSCC passes, we'll want to
-            // iterate there too.
-            if (UR.UpdatedC)
-              LLVM_DEBUG(dbgs()
-                         << "Re-running SCC passes after a refinement of the "
-                            "current SCC: "
-                         << *UR.UpdatedC << "\n");
-
-            // Note that both `C` and `RC` may at this point refer to deleted,
-            // invalid SCC and RefSCCs respectively. But we will short circuit
-            // the processing when we check them in the loop above.
-          } while (UR.UpdatedC);
-        } while (!CWorklist.empty());
-
-        // We only need to keep internal inlined edge information within
-        // a RefSCC, clear it to save on space and let the next time we visit
-        // any of these functions have a fresh start.
-        InlinedInternalEdges.clear();
-      } while (!RCWorklist.empty());
+      PA.intersect(runOnRefSCCWorklist(CGAM, UR, [&](LazyCallGraph::SCC &C) {
+        return Pass.run(C, CGAM, CG, UR);
+      }));
     }
 
     // By definition we preserve the call garph, all SCC analyses, and the
@@ -505,6 +434,38 @@ createModuleToPostOrderCGSCCPassAdaptor(CGSCCPassT Pass) {
   return ModuleToPostOrderCGSCCPassAdaptor<CGSCCPassT>(std::move(Pass));
 }
 
+/// A module pass which runs a CGSCC pipeline over the RefSCCs of the call
+/// graph on several threads, in waves rising from the leaves of the graph.
+///
+/// A RefSCC is dispatched to a thread once the RefSCCs it calls or refers to
+/// are done, so that the inliner still sees its callees fully optimized, and
+/// once the RefSCCs before it in post-order which call or refer to the same
+/// functions are done, so that its passes see the same uses of these
+/// functions as in a sequential walk. Each thread runs its own copy of the
+/// pipeline over the RefSCC, as ModuleToPostOrderCGSCCPassAdaptor does.
+///
+/// The passes run concurrently, and only lock the call graph, through
+/// CGSCCUpdateResult::lockCallGraph(), while they read or update it outside
+/// of the nodes of their SCC. The function passes nested in a
+/// CGSCCToFunctionPassAdaptor must follow the contract of the
+/// ParallelModuleToFunctionPassAdaptor. Running on several threads enables
+/// the thread-safe mode of the LLVMContext and of the CGSCC and function
+/// analysis managers.
+class ParallelModuleToPostOrderCGSCCPassAdaptor
+    : public PassInfoMixin<ParallelModuleToPostOrderCGSCCPassAdaptor> {
+public:
+  /// Call \p BuildPipeline to build the pipeline of each of \p ThreadCount
+  /// threads, or of one thread per core if it is 0.
+  ParallelModuleToPostOrderCGSCCPassAdaptor(
+      function_ref<CGSCCPassManager()> BuildPipeline, unsigned ThreadCount);
+
+  /// Runs the CGSCC pipeline across every SCC in the module.
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+private:
+  std::vector<CGSCCPassManager> Pipelines;
+};
+
 /// A proxy from a \c FunctionAnalysisManager to an \c SCC.
 ///
 /// When a module pass runs and triggers invalidation, both the CGSCC and
@@ -612,8 +573,11 @@ public:
       // Skip nodes from other SCCs. These may have been split out during
       // processing. We'll eventually visit those SCCs and pick up the nodes
       // there.
-      if (CG.lookupSCC(*N) != CurrentC)
-        continue;
+      {
+        auto CallGraphLock = UR.lockCallGraph();
+        if (CG.lookupSCC(*N) != CurrentC)
+          continue;
+      }
 
       PreservedAnalyses PassPA = Pass.run(N->getFunction(), FAM);
 
@@ -631,6 +595,7 @@ public:
       // a smaller, more refined SCC.
       auto PAC = PA.getChecker<LazyCallGraphAnalysis>();
       if (!PAC.preserved() && !PAC.preservedSet<AllAnalysesOn<Module>>()) {
+        auto CallGraphLock = UR.lockCallGraph();
         CurrentC = &updateCGAndAnalysisManagerForFunctionPass(CG, *CurrentC, *N,
                                                               AM, UR);
         assert(
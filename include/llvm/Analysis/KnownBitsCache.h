@@ -0,0 +1,129 @@
+//===- llvm/Analysis/KnownBitsCache.h - Memoize known bits ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains an analysis that memoizes the results of computeKnownBits
+// and ComputeNumSignBits for the values of a function.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_KNOWNBITSCACHE_H
+#define LLVM_ANALYSIS_KNOWNBITSCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/KnownBits.h"
+
+namespace llvm {
+
+class AssumptionCache;
+class Function;
+class Value;
+
+/// A cache of the known bits and sign bits of the instructions and arguments
+/// of a function.
+///
+/// ValueTracking fills it when it is passed to computeKnownBits() or
+/// ComputeNumSignBits(), and reads the results back instead of walking the
+/// operands again. Only the results that do not depend on the context of the
+/// query are kept, that is, the ones no assumption or dominating condition
+/// contributed to. Each result is kept with the depth it was computed at, and
+/// is only reused by queries at the same depth or deeper, so it is at least as
+/// precise as what they would have computed. In particular, a result computed
+/// close to the root of an earlier query is still available past the depth
+/// limit of the later ones.
+///
+/// Deleted values are dropped automatically. A pass that changes a value in
+/// place, e.g. by setting one of its operands, must call forgetValue() on it,
+/// which also drops the results that may depend on it.
+class KnownBitsCache {
+  /// The assumptions of the function. The cache is only used by the queries
+  /// that see the same ones.
+  AssumptionCache &AC;
+
+  struct CachedBits {
+    static const unsigned NotComputed = ~0U;
+
+    KnownBits Known;
+    unsigned KnownBitsDepth = NotComputed;
+    unsigned NumSignBits = 0;
+    unsigned NumSignBitsDepth = NotComputed;
+  };
+
+  class ValueCallbackVH final : public CallbackVH {
+    KnownBitsCache *KBC;
+
+    void deleted() override;
+
+  public:
+    using DMI = DenseMapInfo<Value *>;
+
+    ValueCallbackVH(Value *V, KnownBitsCache *KBC = nullptr)
+        : CallbackVH(V), KBC(KBC) {}
+  };
+
+  friend ValueCallbackVH;
+
+  DenseMap<ValueCallbackVH, CachedBits, ValueCallbackVH::DMI> Cache;
+
+  CachedBits &getOrInsert(const Value *V);
+
+public:
+  KnownBitsCache(AssumptionCache &AC) : AC(AC) {}
+
+  /// The cache is only moved by the analysis manager, before any result is
+  /// added to it, as the value handles point back to it.
+  KnownBitsCache(KnownBitsCache &&Arg) : AC(Arg.AC) {
+    assert(Arg.Cache.empty() && "Moving a non-empty known bits cache!");
+  }
+
+  AssumptionCache &getAssumptionCache() const { return AC; }
+
+  /// Set \p Known to the known bits of \p V, if they were computed at
+  /// \p Depth or less. Return false if they were not.
+  bool lookupKnownBits(const Value *V, unsigned Depth, KnownBits &Known);
+
+  /// Record the known bits of \p V, computed at \p Depth.
+  void insertKnownBits(const Value *V, unsigned Depth, const KnownBits &Known);
+
+  /// Return the number of sign bits of \p V, if they were computed at
+  /// \p Depth or less, and 0 if they were not.
+  unsigned lookupNumSignBits(const Value *V, unsigned Depth);
+
+  /// Record the number of sign bits of \p V, computed at \p Depth.
+  void insertNumSignBits(const Value *V, unsigned Depth, unsigned NumSignBits);
+
+  /// Drop the results for \p V, which was changed in place, and for the values
+  /// whose results may have been computed from it.
+  void forgetValue(const Value *V);
+
+  /// Drop all the results.
+  void clear() { Cache.clear(); }
+};
+
+/// A function analysis which provides a \c KnownBitsCache.
+///
+/// The cache is empty when it is created, and is only valid as long as the
+/// passes that change the function keep it up to date, so it is invalidated
+/// unless it is explicitly preserved.
+class KnownBitsAnalysis : public AnalysisInfoMixin<KnownBitsAnalysis> {
+  friend AnalysisInfoMixin<KnownBitsAnalysis>;
+
+  static AnalysisKey Key;
+
+public:
+  using Result = KnownBitsCache;
+
+  KnownBitsCache run(Function &F, FunctionAnalysisManager &AM);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_ANALYSIS_KNOWNBITSCACHE_H
@@ -0,0 +1,164 @@
+//===- TransactionalFootprint.h - Transaction footprint ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+/// This analysis estimates the memory footprint of a region of code executed
+/// as a hardware memory transaction: the number of distinct cache lines it
+/// reads and writes, and the instructions in it that always abort a
+/// transaction (system calls, I/O, explicit aborts, ...). Hardware tracks the
+/// read and write sets of a transaction in the data caches, so regions whose
+/// footprint exceeds the cache capacity are certain to abort.
+///
+/// Regions are given by the instruction starting them and the instructions
+/// ending them: either a lock and its unlocks, or an llvm.htm.begin and the
+/// matching llvm.htm.commit calls (or their X86 RTM counterparts).
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_TRANSACTIONALFOOTPRINT_H
+#define LLVM_ANALYSIS_TRANSACTIONALFOOTPRINT_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Pass.h"
+#include <memory>
+
+namespace llvm {
+
+class DominatorTree;
+class Function;
+class Instruction;
+class LoopInfo;
+class MemorySSA;
+class raw_ostream;
+class ScalarEvolution;
+class TargetLibraryInfo;
+class TargetTransformInfo;
+
+/// Return true if \p I starts a hardware transaction: a call to
+/// llvm.htm.begin or llvm.x86.xbegin.
+bool isTransactionBegin(const Instruction &I);
+
+/// Return true if \p I commits a hardware transaction: a call to
+/// llvm.htm.commit or llvm.x86.xend.
+bool isTransactionCommit(const Instruction &I);
+
+/// Return true if \p I explicitly aborts a hardware transaction: a call to
+/// llvm.htm.abort or llvm.x86.xabort.
+bool isTransactionAbort(const Instruction &I);
+
+/// The estimated footprint of a transactional region.
+struct TransactionalFootprint {
+  /// Number of distinct cache lines read and written by the region.
+  unsigned ReadLines = 0;
+  unsigned WrittenLines = 0;
+
+  /// True if some accesses could not be bounded (unknown trip counts or
+  /// callees), in which case the line counts are lower bounds.
+  bool Unbounded = false;
+
+  /// Instructions that abort the transaction whenever they are executed.
+  SmallVector<const Instruction *, 2> AbortingInsts;
+
+  /// True if one of AbortingInsts is executed on every path through the
+  /// region.
+  bool AlwaysAborts = false;
+};
+
+/// Computes the footprint of transactional regions of a function.
+class TransactionalFootprintInfo {
+public:
+  TransactionalFootprintInfo(Function &F, ScalarEvolution &SE, MemorySSA &MSSA,
+                             LoopInfo &LI, DominatorTree &DT,
+                             const TargetTransformInfo &TTI,
+                             const TargetLibraryInfo &TLI);
+
+  /// Compute the footprint of the region starting right after \p Begin and
+  /// ending at any of \p Ends. If \p Begin starts a transaction, only the
+  /// paths where the transaction started are considered.
+  TransactionalFootprint getFootprint(const Instruction *Begin,
+                                      ArrayRef<const Instruction *> Ends) const;
+
+  /// Return true if a region with footprint \p FP cannot commit: it always
+  /// executes an aborting instruction, or it touches more cache lines than the
+  /// hardware can track.
+  bool isCertainToAbort(const TransactionalFootprint &FP) const;
+
+  /// Return true if \p I aborts a transaction whenever it is executed.
+  bool isAbortingInstruction(const Instruction &I) const;
+
+  unsigned getCacheLineSize() const { return CacheLineSize; }
+  unsigned getMaxReadLines() const { return MaxReadLines; }
+  unsigned getMaxWrittenLines() const { return MaxWrittenLines; }
+
+  /// Print the footprint of every transaction of the function.
+  void print(raw_ostream &OS) const;
+
+  /// Handle invalidation events in the new pass manager.
+  bool invalidate(Function &F, const PreservedAnalyses &PA,
+                  FunctionAnalysisManager::Invalidator &Inv);
+
+private:
+  Function &F;
+  ScalarEvolution &SE;
+  MemorySSA &MSSA;
+  LoopInfo &LI;
+  DominatorTree &DT;
+  const TargetLibraryInfo &TLI;
+
+  unsigned CacheLineSize;
+  unsigned MaxReadLines;
+  unsigned MaxWrittenLines;
+};
+
+/// Analysis pass providing \c TransactionalFootprintInfo.
+class TransactionalFootprintAnalysis
+    : public AnalysisInfoMixin<TransactionalFootprintAnalysis> {
+  friend AnalysisInfoMixin<TransactionalFootprintAnalysis>;
+
+  static AnalysisKey Key;
+
+public:
+  using Result = TransactionalFootprintInfo;
+
+  TransactionalFootprintInfo run(Function &F, FunctionAnalysisManager &AM);
+};
+
+/// Printer pass for \c TransactionalFootprintInfo.
+class TransactionalFootprintPrinterPass
+    : public PassInfoMixin<TransactionalFootprintPrinterPass> {
+  raw_ostream &OS;
+
+public:
+  explicit TransactionalFootprintPrinterPass(raw_ostream &OS) : OS(OS) {}
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+};
+
+/// Legacy wrapper pass providing \c TransactionalFootprintInfo.
+class TransactionalFootprintWrapperPass : public FunctionPass {
+  std::unique_ptr<TransactionalFootprintInfo> TFI;
+
+public:
+  static char ID;
+
+  TransactionalFootprintWrapperPass();
+
+  TransactionalFootprintInfo &getFootprintInfo() { return *TFI; }
+  const TransactionalFootprintInfo &getFootprintInfo() const { return *TFI; }
+
+  bool runOnFunction(Function &F) override;
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+  void releaseMemory() override;
+  void print(raw_ostream &OS, const Module *M = nullptr) const override;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_ANALYSIS_TRANSACTIONALFOOTPRINT_H
@@ -34,6 +34,7 @@ class DominatorTree;
 class GEPOperator;
 class IntrinsicInst;
 struct KnownBits;
+class KnownBitsCache;
 class Loop;
 class LoopInfo;
 class MDNode;
@@ -50,13 +51,18 @@ class Value;
   /// where V is a vector, the known zero and known one values are the
   /// same width as the vector element, and the bit is set only if it is true
   /// for all of the elements in the vector.
+  ///
+  /// If \p KBC is given, the known bits of the values reached are memoized in
+  /// it, and read back from it when they were computed before. It must use the
+  /// same assumptions as \p AC.
   void computeKnownBits(const Value *V, KnownBits &Known,
                         const DataLayout &DL, unsigned Depth = 0,
                         AssumptionCache *AC = nullptr,
                         const Instruction *CxtI = nullptr,
                         const DominatorTree *DT = nullptr,
                         OptimizationRemarkEmitter *ORE = nullptr,
-                        bool UseInstrInfo = true);
+                        bool UseInstrInfo = true,
+                        KnownBitsCache *KBC = nullptr);
 
   /// Returns the known bits rather than passing by reference.
   KnownBits computeKnownBits(const Value *V, const DataLayout &DL,
@@ -64,7 +70,8 @@ class Value;
                              const Instruction *CxtI = nullptr,
                              const DominatorTree *DT = nullptr,
                              OptimizationRemarkEmitter *ORE = nullptr,
-                             bool UseInstrInfo = true);
+                             bool UseInstrInfo = true,
+                             KnownBitsCache *KBC = nullptr);
 
   /// Compute known bits from the range metadata.
   /// \p KnownZero the set of bits that are known to be zero
@@ -158,7 +165,8 @@ class Value;
                          unsigned Depth = 0, AssumptionCache *AC = nullptr,
                          const Instruction *CxtI = nullptr,
                          const DominatorTree *DT = nullptr,
-                         bool UseInstrInfo = true);
+                         bool UseInstrInfo = true,
+                         KnownBitsCache *KBC = nullptr);
 
   /// Return the number of times the sign bit of the register is replicated into
   /// the other bits. We know that at least 1 bit is always equal to the sign
@@ -166,12 +174,13 @@ class Value;
   /// immediately after an "ashr X, 2", we know that the top 3 bits are all
   /// equal to each other, so we return 3. For vectors, return the number of
   /// sign bits for the vector element with the mininum number of known sign
-  /// bits.
+  /// bits. \p KBC memoizes the results as for computeKnownBits.
   unsigned ComputeNumSignBits(const Value *Op, const DataLayout &DL,
                               unsigned Depth = 0, AssumptionCache *AC = nullptr,
                               const Instruction *CxtI = nullptr,
                               const DominatorTree *DT = nullptr,
-                              bool UseInstrInfo = true);
+                              bool UseInstrInfo = true,
+                              KnownBitsCache *KBC = nullptr);
 
   /// This function computes the integer multiple of Base that equals V. If
   /// successful, it returns true and returns the multiple in Multiple. If
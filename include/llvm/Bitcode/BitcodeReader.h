@@ -15,6 +15,7 @@
 #define LLVM_BITCODE_BITCODEREADER_H
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Bitcode/BitCodes.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
@@ -92,9 +93,10 @@ class Module;
     StringRef getModuleIdentifier() const { return ModuleIdentifier; }
 
     /// Read the bitcode module and prepare for lazy deserialization of function
-    /// bodies. If ShouldLazyLoadMetadata is true, lazily load metadata as well.
-    /// If IsImporting is true, this module is being parsed for ThinLTO
-    /// importing into another module.
+    /// bodies. If ShouldLazyLoadMetadata is true, lazily load metadata as well:
+    /// the metadata used by a function is only loaded when the function is
+    /// materialized. If IsImporting is true, this module is being parsed for
+    /// ThinLTO importing into another module.
     Expected<std::unique_ptr<Module>> getLazyModule(LLVMContext &Context,
                                                     bool ShouldLazyLoadMetadata,
                                                     bool IsImporting);
@@ -106,6 +108,10 @@ class Module;
     /// compile with ThinLTO, and whether it has a summary.
     Expected<BitcodeLTOInfo> getLTOInfo();
 
+    /// Returns the structural hashes of the functions of the module, by name,
+    /// if it was written with them. See StructuralHash().
+    Expected<StringMap<uint64_t>> getFunctionHashes();
+
     /// Parse the specified bitcode buffer, returning the module summary index.
     Expected<std::unique_ptr<ModuleSummaryIndex>> getSummary();
 
@@ -133,8 +139,9 @@ class Module;
 
   /// Read the header of the specified bitcode buffer and prepare for lazy
   /// deserialization of function bodies. If ShouldLazyLoadMetadata is true,
-  /// lazily load metadata as well. If IsImporting is true, this module is
-  /// being parsed for ThinLTO importing into another module.
+  /// lazily load metadata as well: the metadata used by a function is only
+  /// loaded when the function is materialized. If IsImporting is true, this
+  /// module is being parsed for ThinLTO importing into another module.
   Expected<std::unique_ptr<Module>>
   getLazyBitcodeModule(MemoryBufferRef Buffer, LLVMContext &Context,
                        bool ShouldLazyLoadMetadata = false,
@@ -169,6 +176,11 @@ class Module;
   /// Returns LTO information for the specified bitcode file.
   Expected<BitcodeLTOInfo> getBitcodeLTOInfo(MemoryBufferRef Buffer);
 
+  /// Returns the structural hashes of the functions of the specified bitcode
+  /// file, by name.
+  Expected<StringMap<uint64_t>>
+  getBitcodeFunctionHashes(MemoryBufferRef Buffer);
+
   /// Parse the specified bitcode buffer, returning the module summary index.
   Expected<std::unique_ptr<ModuleSummaryIndex>>
   getModuleSummaryIndex(MemoryBufferRef Buffer);
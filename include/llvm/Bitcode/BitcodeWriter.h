@@ -14,6 +14,8 @@
 #ifndef LLVM_BITCODE_BITCODEWRITER_H
 #define LLVM_BITCODE_BITCODEWRITER_H
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/MC/StringTableBuilder.h"
@@ -26,9 +28,16 @@
 namespace llvm {
 
 class BitstreamWriter;
+class Function;
 class Module;
+class StreamingBitcodeWriter;
+class ValueEnumerator;
 class raw_ostream;
 
+/// The bit ranges of the function blocks encoded by a StreamingBitcodeWriter.
+using StreamedFunctionMap =
+    DenseMap<const Function *, std::pair<uint64_t, uint64_t>>;
+
   class BitcodeWriter {
     SmallVectorImpl<char> &Buffer;
     std::unique_ptr<BitstreamWriter> Stream;
@@ -45,6 +54,14 @@ class raw_ostream;
 
     std::vector<Module *> Mods;
 
+    friend class StreamingBitcodeWriter;
+
+    /// Write a module whose IDs were reserved by a StreamingBitcodeWriter,
+    /// copying the function blocks it encoded.
+    void writeStreamedModule(Module &M, ValueEnumerator &VE,
+                             const SmallVectorImpl<char> &FunctionBuffer,
+                             const StreamedFunctionMap &FunctionBlocks);
+
   public:
     /// Create a BitcodeWriter that writes to Buffer.
     BitcodeWriter(SmallVectorImpl<char> &Buffer);
@@ -86,9 +103,14 @@ class raw_ostream;
     /// Can be used to produce the same module hash for a minimized bitcode
     /// used just for the thin link as in the regular full bitcode that will
     /// be used in the backend.
+    ///
+    /// \p GenerateFunctionHashes enables including the StructuralHash() of
+    /// each function definition in the bitcode (currently for use in the
+    /// incremental cache of opt).
     void writeModule(const Module &M, bool ShouldPreserveUseListOrder = false,
                      const ModuleSummaryIndex *Index = nullptr,
-                     bool GenerateHash = false, ModuleHash *ModHash = nullptr);
+                     bool GenerateHash = false, ModuleHash *ModHash = nullptr,
+                     bool GenerateFunctionHashes = false);
 
     /// Write the specified thin link bitcode file (i.e., the minimized bitcode
     /// file) to the buffer specified at construction time. The thin link
@@ -105,6 +127,48 @@ class raw_ostream;
         const std::map<std::string, GVSummaryMapTy> *ModuleToSummariesForIndex);
   };
 
+  /// Writes a module to bitcode while a pipeline is still optimizing it, one
+  /// function at a time: the block of a function is encoded as soon as its
+  /// body is final, and the body is deleted.
+  ///
+  /// The module-level values and metadata that exist when the writer is
+  /// created keep their IDs, and the ones created afterwards, like the
+  /// declarations added by the passes, get IDs from a reserved pool. The
+  /// module-level values must not be deleted until finish() is called.
+  class StreamingBitcodeWriter {
+    Module &M;
+    std::unique_ptr<ValueEnumerator> VE;
+
+    /// The function blocks, encoded in a module block of their own.
+    SmallVector<char, 0> FunctionBuffer;
+    std::unique_ptr<BitstreamWriter> FunctionStream;
+    StreamedFunctionMap FunctionBlocks;
+
+    /// Unused: the names are written by finish().
+    StringTableBuilder StrtabBuilder{StringTableBuilder::RAW};
+
+    bool Finished = false;
+
+  public:
+    /// Create a writer for \p M, reserving \p NumReservedIDs IDs for the
+    /// values and for the metadata created afterwards. Running out of them
+    /// is a fatal error.
+    explicit StreamingBitcodeWriter(Module &M,
+                                    unsigned NumReservedIDs = 4096);
+    ~StreamingBitcodeWriter();
+
+    /// Encode the block of \p F and delete its body, which must not change
+    /// anymore. \p F is left materializable, like a lazily loaded function.
+    ///
+    /// Return false, leaving \p F unchanged, if it cannot be written before
+    /// the rest of the module, like when the address of a block is taken.
+    bool writeFunction(Function &F);
+
+    /// Write the whole module to \p Out, including the function blocks
+    /// encoded so far and the bodies left.
+    void finish(raw_ostream &Out);
+  };
+
   /// Write the specified module to the specified raw output stream.
   ///
   /// For streams where it matters, the given stream should be in "binary"
@@ -126,11 +190,16 @@ class raw_ostream;
   /// Can be used to produce the same module hash for a minimized bitcode
   /// used just for the thin link as in the regular full bitcode that will
   /// be used in the backend.
+  ///
+  /// \p GenerateFunctionHashes enables including the StructuralHash() of each
+  /// function definition in the bitcode (currently for use in the incremental
+  /// cache of opt).
   void WriteBitcodeToFile(const Module &M, raw_ostream &Out,
                           bool ShouldPreserveUseListOrder = false,
                           const ModuleSummaryIndex *Index = nullptr,
                           bool GenerateHash = false,
-                          ModuleHash *ModHash = nullptr);
+                          ModuleHash *ModHash = nullptr,
+                          bool GenerateFunctionHashes = false);
 
   /// Write the specified thin link bitcode file (i.e., the minimized bitcode
   /// file) to the given raw output stream, where it will be written in a new
@@ -118,6 +118,9 @@ enum ModuleCodes {
 
   // IFUNC: [ifunc value type, addrspace, resolver val#, linkage, visibility]
   MODULE_CODE_IFUNC = 18,
+
+  // FUNCTION_HASH: [strtab offset, strtab size, hash]
+  MODULE_CODE_FUNCTION_HASH = 19,
 };
 
 /// PARAMATTR blocks have code for defining a parameter attribute set.
@@ -429,6 +429,10 @@ namespace llvm {
   /// shuffles.
   FunctionPass *createExpandReductionsPass();
 
+  /// This pass expands the llvm.htm.* intrinsics into the hardware
+  /// transactional memory instructions of the target.
+  FunctionPass *createExpandHTMIntrinsicsPass();
+
   // This pass expands memcmp() to load/stores.
   FunctionPass *createExpandMemCmpPass();
 
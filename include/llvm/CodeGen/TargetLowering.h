@@ -1562,6 +1562,31 @@ public:
     llvm_unreachable("Store conditional unimplemented on this target");
   }
 
+  /// Return true if the target supports hardware transactional memory, in
+  /// which case ExpandHTMIntrinsics lowers the llvm.htm.* intrinsics with the
+  /// emitTransaction* hooks below. Otherwise transactions never start.
+  virtual bool hasHardwareTransactionalMemory() const { return false; }
+
+  /// Start a hardware transaction. Return an i32 status as defined for
+  /// llvm.htm.begin: ~0 if the transaction started, or a combination of the
+  /// Intrinsic::HTMAbort* bits when control returns here after an abort. The
+  /// hook may split the block to decode the status on the abort path only,
+  /// but must leave \p Builder before the same instruction.
+  virtual Value *emitTransactionBegin(IRBuilder<> &Builder) const {
+    llvm_unreachable("Transaction begin unimplemented on this target");
+  }
+
+  /// Commit the innermost hardware transaction.
+  virtual void emitTransactionCommit(IRBuilder<> &Builder) const {
+    llvm_unreachable("Transaction commit unimplemented on this target");
+  }
+
+  /// Abort the current hardware transaction with the i8 \p Code, which must
+  /// be reported back in the abort status.
+  virtual void emitTransactionAbort(IRBuilder<> &Builder, Value *Code) const {
+    llvm_unreachable("Transaction abort unimplemented on this target");
+  }
+
   /// Inserts in the IR a target-specific intrinsic specifying a fence.
   /// It is called by AtomicExpandPass before expanding an
   ///   AtomicRMW/AtomicCmpXchg/AtomicStore/AtomicLoad
@@ -30,8 +30,11 @@ namespace llvm {
 class Argument final : public Value {
   Function *Parent;
   unsigned ArgNo;
+  /// The number of uses of the argument, see Value::hasUseCount().
+  unsigned NumUses = 0;
 
   friend class Function;
+  friend class Value;
   void setParent(Function *parent);
 
 public:
@@ -84,6 +84,11 @@ public:
   BasicBlock &operator=(const BasicBlock &) = delete;
   ~BasicBlock();
 
+  /// Allocate a BasicBlock from the current ValueArena of the thread if there
+  /// is one, and from the heap otherwise.
+  void *operator new(size_t Size);
+  void operator delete(void *Ptr);
+
   /// Get the context in which this basic block lives.
   LLVMContext &getContext() const;
 
@@ -40,6 +40,13 @@ class APInt;
 /// don't have to worry about the lifetime of the objects.
 /// LLVM Constant Representation
 class Constant : public User {
+  friend class Value;
+
+  /// The number of uses of the constant, maintained by Value::addUse() and
+  /// Value::removeUse() so that the use counts of the constants, which often
+  /// have very long use lists, are known without walking them.
+  unsigned NumUses = 0;
+
 protected:
   Constant(Type *ty, ValueTy vty, Use *Ops, unsigned NumOps)
     : User(ty, vty, Ops, NumOps) {}
@@ -56,6 +56,7 @@ template <typename T> class Optional;
 class raw_ostream;
 class Type;
 class User;
+class ValueArena;
 
 class Function : public GlobalObject, public ilist_node<Function> {
 public:
@@ -76,6 +77,7 @@ private:
   std::unique_ptr<ValueSymbolTable>
       SymTab;                             ///< Symbol table of args/instructions
   AttributeList AttributeSets;            ///< Parameter attributes
+  ValueArena *Arena = nullptr;            ///< Allocator of the body, if any
 
   /*
    * Value::SubclassData
@@ -630,6 +632,12 @@ public:
   /// Get the underlying elements of the Function... the basic block list is
   /// empty for external functions.
   ///
+  /// Return the arena owned by the function, if the context was set to use
+  /// function arenas when it was created. Its instructions and basic blocks
+  /// are allocated from it under a ValueArenaScope, and released in bulk when
+  /// the body of the function is deleted.
+  ValueArena *getArena() const { return Arena; }
+
   const BasicBlockListType &getBasicBlockList() const { return BasicBlocks; }
         BasicBlockListType &getBasicBlockList()       { return BasicBlocks; }
 
@@ -92,7 +92,7 @@ protected:
 public:
   // allocate space for exactly one operand
   void *operator new(size_t s) {
-    return User::operator new(s, 1);
+    return Instruction::operator new(s, 1);
   }
 
   /// Transparently provide more efficient getOperand methods.
@@ -139,7 +139,7 @@ protected:
 public:
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   /// Transparently provide more efficient getOperand methods.
@@ -730,7 +730,7 @@ protected:
 public:
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   /// Construct a compare instruction, given the opcode, the predicate and
@@ -55,6 +55,12 @@ class Instruction : public User,
 protected:
   ~Instruction(); // Use deleteValue() to delete a generic Instruction.
 
+  /// Allocate an Instruction like the operators new of User, from the current
+  /// ValueArena of the thread if there is one.
+  void *operator new(size_t Size);
+  void *operator new(size_t Size, unsigned Us);
+  void *operator new(size_t Size, unsigned Us, unsigned DescBytes);
+
 public:
   Instruction(const Instruction &) = delete;
   Instruction &operator=(const Instruction &) = delete;
@@ -336,7 +336,7 @@ public:
 
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   /// Return true if this is a store to a volatile memory location.
@@ -461,7 +461,7 @@ public:
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s, 0);
+    return Instruction::operator new(s, 0);
   }
 
   /// Returns the ordering constraint of this fence instruction.
@@ -538,7 +538,7 @@ public:
 
   // allocate space for exactly three operands
   void *operator new(size_t s) {
-    return User::operator new(s, 3);
+    return Instruction::operator new(s, 3);
   }
 
   /// Return true if this is a cmpxchg from a volatile memory
@@ -728,7 +728,7 @@ public:
 
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   BinOp getOperation() const {
@@ -2407,7 +2407,7 @@ public:
 
   // allocate space for exactly three operands
   void *operator new(size_t s) {
-    return User::operator new(s, 3);
+    return Instruction::operator new(s, 3);
   }
 
   /// Return true if a shufflevector instruction can be
@@ -2816,7 +2816,7 @@ protected:
 public:
   // allocate space for exactly two operands
   void *operator new(size_t s) {
-    return User::operator new(s, 2);
+    return Instruction::operator new(s, 2);
   }
 
   static InsertValueInst *Create(Value *Agg, Value *Val,
@@ -3164,7 +3164,7 @@ private:
 
   // Allocate space for exactly zero operands.
   void *operator new(size_t s) {
-    return User::operator new(s);
+    return Instruction::operator new(s);
   }
 
   void growOperands(unsigned Size);
@@ -3501,7 +3501,7 @@ class SwitchInst : public TerminatorInst {
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s);
+    return Instruction::operator new(s);
   }
 
   void init(Value *Value, BasicBlock *Default, unsigned NumReserved);
@@ -3854,7 +3854,7 @@ class IndirectBrInst : public TerminatorInst {
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s);
+    return Instruction::operator new(s);
   }
 
   void init(Value *Address, unsigned NumDests);
@@ -4295,7 +4295,7 @@ class CatchSwitchInst : public TerminatorInst {
                   BasicBlock *InsertAtEnd);
 
   // allocate space for exactly zero operands
-  void *operator new(size_t s) { return User::operator new(s); }
+  void *operator new(size_t s) { return Instruction::operator new(s); }
 
   void init(Value *ParentPad, BasicBlock *UnwindDest, unsigned NumReserved);
   void growOperands(unsigned Size);
@@ -4737,7 +4737,7 @@ public:
 
   // allocate space for exactly zero operands
   void *operator new(size_t s) {
-    return User::operator new(s, 0);
+    return Instruction::operator new(s, 0);
   }
 
   unsigned getNumSuccessors() const { return 0; }
@@ -44,6 +44,27 @@ namespace Intrinsic {
     , num_intrinsics
   };
 
+  /// Values of the status returned by llvm.htm.begin.
+  enum HTMStatus : unsigned {
+    /// The transaction started.
+    HTMStarted = ~0U,
+
+    /// When the transaction aborted, a combination of the following bits.
+    /// The transaction was aborted by llvm.htm.abort, whose code is in the
+    /// bits starting at HTMAbortCodeShift.
+    HTMAbortExplicit = 1 << 0,
+    /// The transaction may succeed if retried.
+    HTMAbortRetry = 1 << 1,
+    /// Another thread accessed the memory of the transaction.
+    HTMAbortConflict = 1 << 2,
+    /// The transaction accessed more memory than the hardware can track.
+    HTMAbortCapacity = 1 << 3,
+
+    HTMAbortCodeShift = 24,
+    /// The codes given to llvm.htm.abort that all targets report back.
+    HTMAbortCodeMask = 0x7f
+  };
+
   /// Return the LLVM name for an intrinsic, such as "llvm.ppc.altivec.lvx".
   /// Note, this version is for intrinsics with no overloads.  Use the other
   /// version of getName if overloads are required.
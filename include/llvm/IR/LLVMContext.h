@@ -161,12 +161,55 @@ public:
   /// especially in release mode.
   void setDiscardValueNames(bool Discard);
 
+  /// Return true if the functions created in the context own a ValueArena,
+  /// which their instructions and basic blocks are allocated from while they
+  /// are parsed or optimized.
+  bool shouldUseFunctionArenas() const;
+
+  /// Set whether the functions created from now on own a ValueArena. Clients
+  /// building or deleting large modules can use this to save the time spent
+  /// allocating and freeing every value.
+  void setUseFunctionArenas(bool Enable);
+
+  /// Return true if the names of the global values read from bitcode are
+  /// references into the string table of the bitcode buffer rather than
+  /// copies.
+  bool shouldBorrowBitcodeNames() const;
+
+  /// Set whether the names of the global values read from bitcode from now on
+  /// are borrowed from the string table of the bitcode buffer, which saves a
+  /// copy of every name in modules with many globals. The names are copied
+  /// when they are changed. The buffers the modules are read from must then
+  /// outlive the values read from them.
+  void setBorrowBitcodeNames(bool Borrow);
+
+  /// Return true if materializing all the functions of a module read from
+  /// bitcode parses their bodies on several threads.
+  bool shouldMaterializeBitcodeInParallel() const;
+
+  /// Set whether materializing all the functions of a module read from bitcode
+  /// parses their bodies on several threads, which speeds up reading large
+  /// modules. Enabling it also enables the thread-safe mode of the context.
+  void setMaterializeBitcodeInParallel(bool Parallel);
+
   /// Whether there is a string map for uniquing debug info
   /// identifiers across the context.  Off by default.
   bool isODRUniquingDebugTypes() const;
   void enableDebugTypeODRUniquing();
   void disableDebugTypeODRUniquing();
 
+  /// Let several threads build and optimize IR in the context at the same
+  /// time, each in its own functions. The uniquing tables of the types,
+  /// constants, attributes and metadata, the value names, value handles and
+  /// metadata attachments, and the use lists of the constants are then each
+  /// guarded by their own lock. Must be called before the context is shared
+  /// between threads. Off by default, as it slows down single-threaded use.
+  ///
+  /// The threads must still not walk the users of the constants, nor modify
+  /// the same module, function or global at the same time.
+  void enableThreadSafety();
+  bool isThreadSafe() const;
+
   using InlineAsmDiagHandlerTy = void (*)(const SMDiagnostic&, void *Context,
                                           unsigned LocCookie);
 
@@ -39,21 +39,26 @@
 #define LLVM_IR_PASSMANAGER_H
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManagerInternal.h"
+#include "llvm/IR/ValueArena.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/TypeName.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <functional>
 #include <iterator>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -453,7 +458,12 @@ public:
         dbgs() << "Running pass: " << Passes[Idx]->name() << " on "
                << IR.getName() << "\n";
 
-      PreservedAnalyses PassPA = Passes[Idx]->run(IR, AM, ExtraArgs...);
+      PreservedAnalyses PassPA;
+      {
+        TimeTraceScope PassScope(Passes[Idx]->name(),
+                                 [&] { return std::string(IR.getName()); });
+        PassPA = Passes[Idx]->run(IR, AM, ExtraArgs...);
+      }
 
       // Update the analysis manager as each pass runs and potentially
       // invalidates analyses.
@@ -641,8 +651,19 @@ public:
   AnalysisManager(AnalysisManager &&) = default;
   AnalysisManager &operator=(AnalysisManager &&) = default;
 
+  /// Let several threads use the manager at the same time, each on its own IR
+  /// units, like the functions a ParallelModuleToFunctionPassAdaptor runs its
+  /// passes on. The cached results are then guarded by a lock, which is not
+  /// held while an analysis runs. Must be called before the manager is shared
+  /// between threads.
+  void enableThreadSafety() {
+    if (!ResultsLock)
+      ResultsLock.reset(new std::recursive_mutex());
+  }
+
   /// Returns true if the analysis manager has an empty results cache.
   bool empty() const {
+    auto Lock = lockResults();
     assert(AnalysisResults.empty() == AnalysisResultLists.empty() &&
            "The storage and index of analysis results disagree on how many "
            "there are!");
@@ -658,6 +679,7 @@ public:
     if (DebugLogging)
       dbgs() << "Clearing all analysis results for: " << Name << "\n";
 
+    auto Lock = lockResults();
     auto ResultsListI = AnalysisResultLists.find(&IR);
     if (ResultsListI == AnalysisResultLists.end())
       return;
@@ -676,6 +698,7 @@ public:
   /// IR units itself has potentially changed, and thus we can't even look up a
   /// a result and invalidate/clear it directly.
   void clear() {
+    auto Lock = lockResults();
     AnalysisResults.clear();
     AnalysisResultLists.clear();
   }
@@ -777,6 +800,7 @@ public:
 
     // Track whether each analysis's result is invalidated in
     // IsResultInvalidated.
+    auto Lock = lockResults();
     SmallDenseMap<AnalysisKey *, bool, 8> IsResultInvalidated;
     Invalidator Inv(IsResultInvalidated, AnalysisResults);
     AnalysisResultListT &ResultsList = AnalysisResultLists[&IR];
@@ -829,6 +853,14 @@ public:
   }
 
 private:
+  /// Lock the cached results until the returned lock is destroyed, if the
+  /// manager is thread-safe.
+  std::unique_lock<std::recursive_mutex> lockResults() const {
+    if (LLVM_LIKELY(!ResultsLock))
+      return std::unique_lock<std::recursive_mutex>();
+    return std::unique_lock<std::recursive_mutex>(*ResultsLock);
+  }
+
   /// Look up a registered analysis pass.
   PassConceptT &lookUpPass(AnalysisKey *ID) {
     typename AnalysisPassMapT::iterator PI = AnalysisPasses.find(ID);
@@ -848,6 +880,7 @@ private:
   /// Get an analysis result, running the pass if necessary.
   ResultConceptT &getResultImpl(AnalysisKey *ID, IRUnitT &IR,
                                 ExtraArgTs... ExtraArgs) {
+    auto Lock = lockResults();
     typename AnalysisResultMapT::iterator RI;
     bool Inserted;
     std::tie(RI, Inserted) = AnalysisResults.insert(std::make_pair(
@@ -860,8 +893,18 @@ private:
       if (DebugLogging)
         dbgs() << "Running analysis: " << P.name() << " on " << IR.getName()
                << "\n";
+
+      // Let the other threads use the manager while the analysis runs. They
+      // do not look at the results for IR, so the entry inserted above stays
+      // ours.
+      if (Lock)
+        Lock.unlock();
+      auto Result = P.run(IR, *this, ExtraArgs...);
+      if (Lock.mutex())
+        Lock.lock();
+
       AnalysisResultListT &ResultList = AnalysisResultLists[&IR];
-      ResultList.emplace_back(ID, P.run(IR, *this, ExtraArgs...));
+      ResultList.emplace_back(ID, std::move(Result));
 
       // P.run may have inserted elements into AnalysisResults and invalidated
       // RI.
@@ -876,6 +919,7 @@ private:
 
   /// Get a cached analysis result or return null.
   ResultConceptT *getCachedResultImpl(AnalysisKey *ID, IRUnitT &IR) const {
+    auto Lock = lockResults();
     typename AnalysisResultMapT::const_iterator RI =
         AnalysisResults.find({ID, &IR});
     return RI == AnalysisResults.end() ? nullptr : &*RI->second->second;
@@ -883,6 +927,7 @@ private:
 
   /// Invalidate a function pass result.
   void invalidateImpl(AnalysisKey *ID, IRUnitT &IR) {
+    auto Lock = lockResults();
     typename AnalysisResultMapT::iterator RI =
         AnalysisResults.find({ID, &IR});
     if (RI == AnalysisResults.end())
@@ -914,6 +959,9 @@ private:
 
   /// Indicates whether we log to \c llvm::dbgs().
   bool DebugLogging;
+
+  /// Guards the maps above when the manager is thread-safe, null otherwise.
+  std::unique_ptr<std::recursive_mutex> ResultsLock;
 };
 
 extern template class AnalysisManager<Module>;
@@ -1180,12 +1228,17 @@ using ModuleAnalysisManagerFunctionProxy =
 /// Note that although function passes can access module analyses, module
 /// analyses are not invalidated while the function passes are running, so they
 /// may be stale.  Function analyses will not be stale.
+///
+/// If a callback is given, it is called on every function once the pass is
+/// done with it, after its analyses are cleared. The callback may delete the
+/// body of the function, like when streaming it out.
 template <typename FunctionPassT>
 class ModuleToFunctionPassAdaptor
     : public PassInfoMixin<ModuleToFunctionPassAdaptor<FunctionPassT>> {
 public:
-  explicit ModuleToFunctionPassAdaptor(FunctionPassT Pass)
-      : Pass(std::move(Pass)) {}
+  explicit ModuleToFunctionPassAdaptor(
+      FunctionPassT Pass, std::function<void(Function &)> Callback = nullptr)
+      : Pass(std::move(Pass)), Callback(std::move(Callback)) {}
 
   /// Runs the function pass across every function in the module.
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM) {
@@ -1197,7 +1250,13 @@ public:
       if (F.isDeclaration())
         continue;
 
-      PreservedAnalyses PassPA = Pass.run(F, FAM);
+      PreservedAnalyses PassPA;
+      {
+        // Allocate the instructions the pass creates from the arena of the
+        // function, if it has one.
+        ValueArenaScope ArenaScope(F.getArena());
+        PassPA = Pass.run(F, FAM);
+      }
 
       // We know that the function pass couldn't have invalidated any other
       // function's analyses (that's the contract of a function pass), so
@@ -1207,6 +1266,11 @@ public:
       // Then intersect the preserved set so that invalidation of module
       // analyses will eventually occur when the module pass completes.
       PA.intersect(std::move(PassPA));
+
+      if (Callback) {
+        FAM.clear(F, F.getName());
+        Callback(F);
+      }
     }
 
     // The FunctionAnalysisManagerModuleProxy is preserved because (we assume)
@@ -1221,16 +1285,49 @@ public:
 
 private:
   FunctionPassT Pass;
+  std::function<void(Function &)> Callback;
 };
 
 /// A function to deduce a function pass type and wrap it in the
 /// templated adaptor.
 template <typename FunctionPassT>
 ModuleToFunctionPassAdaptor<FunctionPassT>
-createModuleToFunctionPassAdaptor(FunctionPassT Pass) {
-  return ModuleToFunctionPassAdaptor<FunctionPassT>(std::move(Pass));
+createModuleToFunctionPassAdaptor(
+    FunctionPassT Pass, std::function<void(Function &)> Callback = nullptr) {
+  return ModuleToFunctionPassAdaptor<FunctionPassT>(std::move(Pass),
+                                                    std::move(Callback));
 }
 
+/// An adaptor that runs a function pipeline over the functions of a module on
+/// several threads.
+///
+/// Each thread runs its own copy of the pipeline, as passes keep state between
+/// their runs, and takes the next function not yet optimized. The functions
+/// are the ones defined in the module when the adaptor starts. Running on
+/// several threads enables the thread-safe mode of the LLVMContext, which
+/// guards the uniquing of the types, constants and metadata, and of the
+/// function analysis manager, which guards its cached results.
+///
+/// Beyond the contract of the ModuleToFunctionPassAdaptor, the passes must
+/// not walk the users of constants or globals other than the functions they
+/// run on, and their instrumentation, like the debug logging of the pass
+/// managers, must be off. The declarations and globals they add to the module
+/// are added under a lock, in the order the threads get to them.
+class ParallelModuleToFunctionPassAdaptor
+    : public PassInfoMixin<ParallelModuleToFunctionPassAdaptor> {
+public:
+  /// Call \p BuildPipeline to build the pipeline of each of \p ThreadCount
+  /// threads, or of one thread per core if it is 0.
+  ParallelModuleToFunctionPassAdaptor(
+      function_ref<FunctionPassManager()> BuildPipeline, unsigned ThreadCount);
+
+  /// Runs the function pipeline across every function in the module.
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
+
+private:
+  std::vector<FunctionPassManager> Pipelines;
+};
+
 /// A utility pass template to force an analysis result to be available.
 ///
 /// If there are extra arguments at the pass's run level there may also be
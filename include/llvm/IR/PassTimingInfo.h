@@ -38,6 +38,8 @@ private:
   StringMap<unsigned> PassIDCountMap; ///< Map that counts instances of passes
   DenseMap<PassInstanceID, Timer *> TimingData; ///< timers for pass instances
   TimerGroup TG;
+  StringMap<Timer *> FunctionTimingData; ///< timers for functions
+  TimerGroup FunctionTG;
 
 public:
   /// Default constructor for yet-inactive timeinfo.
@@ -59,6 +61,10 @@ public:
   /// Returns the timer for the specified pass if it exists.
   Timer *getPassTimer(PassInfoT, PassInstanceID);
 
+  /// Returns the timer for the passes run on the function named
+  /// \p FunctionName, if -time-passes-per-function is enabled.
+  Timer *getFunctionTimer(StringRef FunctionName);
+
   static PassTimingInfo *TheTimeInfo;
 
 private:
@@ -67,6 +73,7 @@ private:
 
 Timer *getPassTimer(Pass *);
 Timer *getPassTimer(StringRef);
+Timer *getFunctionTimer(StringRef FunctionName);
 
 /// If the user specifies the -time-passes argument on an LLVM tool command line
 /// then the value of this boolean will be true, otherwise false.
@@ -0,0 +1,42 @@
+//===- llvm/IR/StructuralHash.h - Content hash of a function ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file
+/// This file declares StructuralHash, a hash of the contents of a function
+/// that is stable across executions and modules.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_STRUCTURALHASH_H
+#define LLVM_IR_STRUCTURALHASH_H
+
+#include <cstdint>
+
+namespace llvm {
+
+class Function;
+
+/// Return a hash of what a function pass can see of \p F: its signature and
+/// attributes, and the instructions of its body in order, with their operands,
+/// flags and metadata. The globals it references contribute their name, type
+/// and attributes, and the constant ones their initializer as well. Unlike
+/// FunctionComparator::functionHash(), which only walks the opcodes to bucket
+/// functions that may be merged, two functions with the same hash may be
+/// assumed to be the same.
+///
+/// The debug info nodes other than tuples only contribute their kind and
+/// operands, not their other fields, such as line numbers.
+///
+/// The hash only depends on the contents of the module, so it does not change
+/// across executions, and functions from different modules can be compared.
+uint64_t StructuralHash(const Function &F);
+
+} // end namespace llvm
+
+#endif // LLVM_IR_STRUCTURALHASH_H
@@ -35,6 +35,7 @@ namespace llvm {
 
 template <typename T> class ArrayRef;
 template <typename T> class MutableArrayRef;
+class ValueArena;
 
 /// Compile-time customization of User operands.
 ///
@@ -47,7 +48,12 @@ class User : public Value {
   friend struct HungoffOperandTraits;
 
   LLVM_ATTRIBUTE_ALWAYS_INLINE inline static void *
-  allocateFixedOperandUser(size_t, unsigned, unsigned);
+  allocateFixedOperandUser(size_t, unsigned, unsigned, ValueArena *);
+  LLVM_ATTRIBUTE_ALWAYS_INLINE inline static void *
+  allocateHungoffOperandUser(size_t, ValueArena *);
+
+  /// Free an array of Uses allocated by allocHungoffUses.
+  void deallocateHungoffUses(Use *Ops);
 
 protected:
   /// Allocate a User with an operand pointer co-allocated.
@@ -71,6 +77,12 @@ protected:
   /// This is used for subclasses which have a fixed number of operands.
   void *operator new(size_t Size, unsigned Us, unsigned DescBytes);
 
+  /// Allocate a User like the operator new with the same parameters, from
+  /// \p Arena if it is not null.
+  static void *allocateUser(size_t Size, ValueArena *Arena);
+  static void *allocateUser(size_t Size, unsigned Us, unsigned DescBytes,
+                            ValueArena *Arena);
+
   User(Type *ty, unsigned vty, Use *, unsigned NumOps)
       : Value(ty, vty) {
     assert(NumOps < (1u << NumUserOperandsBits) && "Too many operands");
@@ -19,6 +19,8 @@
 #include "llvm/IR/Use.h"
 #include "llvm/Support/CBindingWrapping.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
 #include <cassert>
 #include <iterator>
 #include <memory>
@@ -111,7 +113,7 @@ protected:
   ///
   /// Note, this should *NOT* be used directly by any class other than User.
   /// User uses this value to find the Use list.
-  enum : unsigned { NumUserOperandsBits = 28 };
+  enum : unsigned { NumUserOperandsBits = 27 };
   unsigned NumUserOperands : NumUserOperandsBits;
 
   // Use the same type as the bitfield above so that MSVC will pack them.
@@ -119,6 +121,9 @@ protected:
   unsigned HasName : 1;
   unsigned HasHungOffUses : 1;
   unsigned HasDescriptor : 1;
+  /// Whether the memory of the value comes from a ValueArena. Set by the
+  /// operator new of the Users and BasicBlocks, and only meaningful for them.
+  unsigned IsArenaAllocated : 1;
 
 private:
   template <typename UseT> // UseT == 'Use' or 'const Use'
@@ -249,11 +254,16 @@ public:
 
   // All values can potentially be named.
   bool hasName() const { return HasName; }
+  /// Return the symbol table entry holding the name of the value. A borrowed
+  /// name is copied into one first.
   ValueName *getValueName() const;
   void setValueName(ValueName *VN);
 
 private:
   void destroyValueName();
+  ValueName *findValueName() const;
+  ValueName *materializeBorrowedName();
+  bool dropBorrowedName();
   enum class ReplaceMetadataUses { No, Yes };
   void doRAUW(Value *New, ReplaceMetadataUses);
   void setNameImpl(const Twine &Name);
@@ -280,6 +290,16 @@ public:
   /// \note It is an error to call V->takeName(V).
   void takeName(Value *V);
 
+  /// Set the name of the value to \p Name without copying it.
+  ///
+  /// \p Name must outlive the value, and unlike the other names it is not
+  /// null-terminated. The name is copied when it changes or when its
+  /// ValueName is needed. If \p Name is taken, this behaves like setName().
+  void setBorrowedName(StringRef Name);
+
+  /// Return true if the name of the value is borrowed, see setBorrowedName().
+  bool hasBorrowedName() const;
+
   /// Change all uses of this to point to a new Value.
   ///
   /// Go through the uses list for this definition and make each use point to
@@ -411,6 +431,8 @@ public:
   /// This is specialized because it is a common request and does not require
   /// traversing the whole use list.
   bool hasOneUse() const {
+    if (hasUseCount())
+      return getUseCount() == 1;
     const_use_iterator I = use_begin(), E = use_end();
     if (I == E) return false;
     return ++I == E;
@@ -429,12 +451,30 @@ public:
 
   /// This method computes the number of uses of this Value.
   ///
-  /// This is a linear time operation.  Use hasOneUse, hasNUses, or
+  /// This is a linear time operation, except for the values that keep count
+  /// of their uses (see hasUseCount()).  Use hasOneUse, hasNUses, or
   /// hasNUsesOrMore to check for specific values.
   unsigned getNumUses() const;
 
+  /// Return true if the value keeps count of its uses, which makes getNumUses,
+  /// hasOneUse, hasNUses and hasNUsesOrMore constant time operations. This is
+  /// the case of the constants, including the globals, and of the arguments,
+  /// the values that commonly have the longest use lists.
+  bool hasUseCount() const { return getValueID() <= ArgumentVal; }
+
   /// This method should only be used by the Use class.
-  void addUse(Use &U) { U.addToList(&UseList); }
+  void addUse(Use &U) {
+    if (hasUseCount())
+      return addCountedUse(U);
+    U.addToList(&UseList);
+  }
+
+  /// This method should only be used by the Use class.
+  void removeUse(Use &U) {
+    if (hasUseCount())
+      return removeCountedUse(U);
+    U.removeFromList();
+  }
 
   /// Concrete subclass of this.
   ///
@@ -614,7 +654,30 @@ public:
   /// Reverse the use-list.
   void reverseUseList();
 
+  /// The number of live contexts that several threads may use at the same
+  /// time. Only used to skip the locking of the use lists when there is none.
+  static std::atomic<unsigned> NumThreadSafeContexts;
+
 private:
+  /// Return true if the use list of this value may be modified by several
+  /// threads at the same time, which is the case of the constants, including
+  /// the globals, of a thread-safe context.
+  bool hasSharedUseList() const {
+    return NumThreadSafeContexts.load(std::memory_order_relaxed) &&
+           getValueID() <= ConstantLastVal && isInThreadSafeContext();
+  }
+  bool isInThreadSafeContext() const;
+
+  /// Return the number of uses of a value for which hasUseCount() is true.
+  unsigned getUseCount() const;
+  unsigned &getUseCountRef();
+  void addCountedUse(Use &U);
+  void removeCountedUse(Use &U);
+
+  /// Set all the uses of this value to \p New. Used by replaceAllUsesWith()
+  /// when the use lists are not shared between threads.
+  void transferUsesTo(Value *New);
+
   /// Merge two lists together.
   ///
   /// Merges \c L and \c R using \c Cmp.  To enable stable sorts, always pushes
@@ -668,8 +731,13 @@ inline raw_ostream &operator<<(raw_ostream &OS, const Value &V) {
   return OS;
 }
 
+Use::~Use() {
+  if (Val)
+    Val->removeUse(*this);
+}
+
 void Use::set(Value *V) {
-  if (Val) removeFromList();
+  if (Val) Val->removeUse(*this);
   Val = V;
   if (V) V->addUse(*this);
 }
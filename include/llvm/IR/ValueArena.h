@@ -0,0 +1,116 @@
+//===- llvm/IR/ValueArena.h - Bulk allocation of IR values ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the ValueArena class, a bump allocator for the
+// instructions, their operands and the basic blocks of a function, and the
+// ValueArenaScope class, which directs the allocations of the calling thread
+// to an arena.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_VALUEARENA_H
+#define LLVM_IR_VALUEARENA_H
+
+#include "llvm/Support/Allocator.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace llvm {
+
+/// A bump allocator for the instructions, their operands and the basic blocks
+/// of a function. The memory of the small values deleted while the arena is
+/// current goes to free lists, by size, that the next allocations reuse. The
+/// arena releases all of its memory at once, when its owner and all the
+/// values allocated from it are gone. Values may therefore move to other
+/// functions or modules, but the arena of a function may outlive it.
+///
+/// Only the thread for which the arena is current allocates from it and
+/// reuses its memory, as one thread at a time works on a function. Values
+/// deleted by other threads, e.g. after moving to another function, only
+/// drop their reference to the arena, which is counted atomically.
+class ValueArena {
+public:
+  /// Create an arena, owned by the caller until it calls release().
+  static ValueArena *create() { return new ValueArena(); }
+
+  /// Give up the ownership of the arena. The arena is deleted once all the
+  /// values allocated from it are deleted too.
+  void release() { dropRef(); }
+
+  /// Reuse the memory of the arena if no value allocated from it is alive,
+  /// like when the body of its function was deleted.
+  void resetIfUnused() {
+    if (RefCount == 1) {
+      Allocator.Reset();
+      FreeLists.reset();
+    }
+  }
+
+  /// Return the arena the calling thread allocates values from, if any.
+  static ValueArena *getCurrent();
+
+  /// Allocate \p Size bytes from the arena, preceded by their size and a
+  /// pointer to the arena. This must be the current arena of the calling
+  /// thread, unless no other thread may be using it.
+  void *allocate(size_t Size);
+
+  /// Return the arena memory returned by allocate() comes from.
+  static ValueArena *getArenaOf(const void *Ptr) {
+    return *(static_cast<ValueArena *const *>(Ptr) - 1);
+  }
+
+  /// Free memory returned by allocate(). The memory is reused if its arena
+  /// is the current arena of the calling thread.
+  static void deallocate(void *Ptr);
+
+  /// Return the number of bytes allocated from the arena since it was last
+  /// reset.
+  size_t getBytesAllocated() const { return Allocator.getBytesAllocated(); }
+
+private:
+  ValueArena() = default;
+  ValueArena(const ValueArena &) = delete;
+  ValueArena &operator=(const ValueArena &) = delete;
+
+  void dropRef() {
+    if (--RefCount == 0)
+      delete this;
+  }
+
+  /// The number of free lists, for the sizes from 0 to NumFreeLists - 1
+  /// pointers. Larger blocks are only released with the arena.
+  static const size_t NumFreeLists = 64;
+
+  BumpPtrAllocator Allocator;
+  /// The heads of the lists of freed blocks, linked through their first
+  /// word, indexed by size in pointers. Allocated on the first free.
+  std::unique_ptr<void *[]> FreeLists;
+  /// One reference for the owner and one per live allocation.
+  std::atomic<size_t> RefCount{1};
+};
+
+/// Allocate the instructions and basic blocks created by the calling thread
+/// during the lifetime of the object from \p Arena, or from the heap if it is
+/// null. Scopes nest.
+class ValueArenaScope {
+public:
+  explicit ValueArenaScope(ValueArena *Arena);
+  ~ValueArenaScope();
+
+  ValueArenaScope(const ValueArenaScope &) = delete;
+  ValueArenaScope &operator=(const ValueArenaScope &) = delete;
+
+private:
+  ValueArena *Prev;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_IR_VALUEARENA_H
@@ -14,6 +14,7 @@
 #ifndef LLVM_IR_VALUESYMBOLTABLE_H
 #define LLVM_IR_VALUESYMBOLTABLE_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Value.h"
@@ -35,6 +36,9 @@ template <typename ValueSubClass> class SymbolTableListTraits;
 /// a std::map<std::string,Value*> but has a controlled interface provided by
 /// LLVM as well as ensuring uniqueness of names.
 ///
+/// The borrowed names of the values (see Value::setBorrowedName()) are kept
+/// in a separate map, and only moved to the ValueMap when they are copied.
+///
 class ValueSymbolTable {
   friend class SymbolTableListTraits<Argument>;
   friend class SymbolTableListTraits<BasicBlock>;
@@ -72,14 +76,20 @@ public:
   /// the symbol table.
   /// @returns the value associated with the \p Name
   /// Lookup a named Value.
-  Value *lookup(StringRef Name) const { return vmap.lookup(Name); }
+  Value *lookup(StringRef Name) const {
+    if (Value *V = vmap.lookup(Name))
+      return V;
+    return BorrowedNames.lookup(Name);
+  }
 
   /// @returns true iff the symbol table is empty
   /// Determine if the symbol table is empty
-  inline bool empty() const { return vmap.empty(); }
+  inline bool empty() const { return vmap.empty() && BorrowedNames.empty(); }
 
   /// The number of name/type pairs is returned.
-  inline unsigned size() const { return unsigned(vmap.size()); }
+  inline unsigned size() const {
+    return unsigned(vmap.size() + BorrowedNames.size());
+  }
 
   /// This function can be used from the debugger to display the
   /// content of the symbol table while debugging.
@@ -90,11 +100,19 @@ public:
 /// @name Iteration
 /// @{
 
-  /// Get an iterator that from the beginning of the symbol table.
-  inline iterator begin() { return vmap.begin(); }
+  /// Get an iterator that from the beginning of the symbol table. This copies
+  /// the borrowed names, which the iterators do not visit otherwise.
+  inline iterator begin() {
+    materializeBorrowedNames();
+    return vmap.begin();
+  }
 
-  /// Get a const_iterator that from the beginning of the symbol table.
-  inline const_iterator begin() const { return vmap.begin(); }
+  /// Get a const_iterator that from the beginning of the symbol table. This
+  /// copies the borrowed names, which the iterators do not visit otherwise.
+  inline const_iterator begin() const {
+    materializeBorrowedNames();
+    return vmap.begin();
+  }
 
   /// Get an iterator to the end of the symbol table.
   inline iterator end() { return vmap.end(); }
@@ -124,11 +142,27 @@ private:
   /// symtab.
   void removeValueName(ValueName *V);
 
+  /// Remove the value \p V from the symbol table, without copying its name
+  /// if it is borrowed.
+  void removeValue(Value *V);
+
+  /// Add the value \p V with the borrowed name \p Name, which must not be
+  /// in the symbol table.
+  void insertBorrowedName(StringRef Name, Value *V);
+
+  /// Move the borrowed name \p Name of \p V to a new ValueName, and return
+  /// it, or return null if \p V is not in the symbol table under that name.
+  ValueName *materializeBorrowedName(StringRef Name, Value *V);
+
+  /// Copy all the borrowed names of the symbol table.
+  void materializeBorrowedNames() const;
+
   /// @}
   /// @name Internal Data
   /// @{
 
   ValueMap vmap;                    ///< The map that holds the symbol table.
+  DenseMap<StringRef, Value *> BorrowedNames; ///< The borrowed names.
   mutable uint32_t LastUnique = 0;  ///< Counter for tracking unique names
 
 /// @}
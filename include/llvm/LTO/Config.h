@@ -94,6 +94,13 @@ struct Config {
   std::string StatsFile;
 
   bool ShouldDiscardValueNames = true;
+
+  /// Whether the names of the global values are borrowed from the input
+  /// bitcode files rather than copied, see
+  /// LLVMContext::setBorrowBitcodeNames(). The buffers of the input files must
+  /// then outlive the LTO run.
+  bool BorrowBitcodeNames = false;
+
   DiagnosticHandlerFunction DiagHandler;
 
   /// If this field is set, LTO will write input file paths and symbol
@@ -200,6 +207,7 @@ struct LTOLLVMContext : LLVMContext {
 
   LTOLLVMContext(const Config &C) : DiagHandler(C.DiagHandler) {
     setDiscardValueNames(C.ShouldDiscardValueNames);
+    setBorrowBitcodeNames(C.BorrowBitcodeNames);
     enableDebugTypeODRUniquing();
     setDiagnosticHandler(
         llvm::make_unique<LTOLLVMDiagnosticHandler>(&DiagHandler), true);
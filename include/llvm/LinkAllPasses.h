@@ -124,6 +124,8 @@ namespace {
       (void) llvm::createLegacyDivergenceAnalysisPass();
       (void) llvm::createLICMPass();
       (void) llvm::createLoopSinkPass();
+      (void) llvm::createLockElisionPass();
+      (void) llvm::createShrinkTransactionsPass();
       (void) llvm::createLazyValueInfoPass();
       (void) llvm::createLoopExtractorPass();
       (void) llvm::createLoopInterchangePass();
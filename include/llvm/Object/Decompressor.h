@@ -39,6 +39,11 @@ public:
   /// @param Buffer      Destination buffer.
   Error decompress(MutableArrayRef<char> Buffer);
 
+  /// Uncompress section data chunk by chunk, without a buffer holding the
+  /// whole uncompressed section.
+  /// @param Output      Called with every chunk of uncompressed data.
+  Error decompressStream(function_ref<Error(StringRef)> Output);
+
   /// Return memory buffer size required for decompression.
   uint64_t getDecompressedSize() { return DecompressedSize; }
 
@@ -59,6 +64,8 @@ private:
 
   StringRef SectionData;
   uint64_t DecompressedSize;
+  /// The ELFCOMPRESS_* algorithm of the section.
+  uint32_t CompressionType;
 };
 
 } // end namespace object
@@ -582,6 +582,17 @@ private:
                                ArrayRef<PipelineElement> Pipeline,
                                bool VerifyEachPass, bool DebugLogging);
 
+  /// Build the inliner driven CGSCC pipeline at the core of the module
+  /// simplification pipeline, once for each thread that walks the call graph.
+  DevirtSCCRepeatedPass<CGSCCPassManager>
+  buildMainCGSCCPipeline(OptimizationLevel Level, ThinLTOPhase Phase,
+                         bool DebugLogging);
+
+  /// Build the function pipeline at the core of the module optimization
+  /// pipeline, once for each thread that runs it.
+  FunctionPassManager buildFunctionOptimizationPipeline(OptimizationLevel Level,
+                                                        bool DebugLogging);
+
   void addPGOInstrPasses(ModulePassManager &MPM, bool DebugLogging,
                          OptimizationLevel Level, bool RunProfileGen,
                          std::string ProfileGenFile,
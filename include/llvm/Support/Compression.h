@@ -14,12 +14,14 @@
 #ifndef LLVM_SUPPORT_COMPRESSION_H
 #define LLVM_SUPPORT_COMPRESSION_H
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/DataTypes.h"
 
 namespace llvm {
 template <typename T> class SmallVectorImpl;
 class Error;
 class StringRef;
+class raw_ostream;
 
 namespace zlib {
 
@@ -33,6 +35,15 @@ bool isAvailable();
 Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
                int Level = DefaultCompression);
 
+/// Compress \p InputBuffer like compress(), but deflate chunks of it in
+/// parallel. The chunks are concatenated into a single zlib stream, whose
+/// checksum is combined from the checksums of the chunks, so that any zlib
+/// reader can uncompress it. The result does not depend on the number of
+/// threads.
+Error compressParallel(StringRef InputBuffer,
+                       SmallVectorImpl<char> &CompressedBuffer,
+                       int Level = DefaultCompression);
+
 Error uncompress(StringRef InputBuffer, char *UncompressedBuffer,
                  size_t &UncompressedSize);
 
@@ -42,8 +53,52 @@ Error uncompress(StringRef InputBuffer,
 
 uint32_t crc32(StringRef Buffer);
 
+/// Compress the data that \p Write writes to the stream it is passed, chunk
+/// by chunk, so that the uncompressed data is never held in memory as a whole.
+Error compressStream(function_ref<void(raw_ostream &)> Write,
+                     SmallVectorImpl<char> &CompressedBuffer,
+                     int Level = DefaultCompression);
+
+/// Uncompress \p InputBuffer chunk by chunk, passing every chunk of
+/// uncompressed data to \p Output as soon as it is available. Stops at the
+/// first error returned by \p Output.
+Error uncompressStream(StringRef InputBuffer,
+                       function_ref<Error(StringRef)> Output);
+
 }  // End of namespace zlib
 
+namespace zstd {
+
+static constexpr int BestSpeedCompression = 1;
+static constexpr int DefaultCompression = 5;
+static constexpr int BestSizeCompression = 12;
+
+bool isAvailable();
+
+Error compress(StringRef InputBuffer, SmallVectorImpl<char> &CompressedBuffer,
+               int Level = DefaultCompression);
+
+Error uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                 size_t &UncompressedSize);
+
+Error uncompress(StringRef InputBuffer,
+                 SmallVectorImpl<char> &UncompressedBuffer,
+                 size_t UncompressedSize);
+
+/// Compress the data that \p Write writes to the stream it is passed, chunk
+/// by chunk, so that the uncompressed data is never held in memory as a whole.
+Error compressStream(function_ref<void(raw_ostream &)> Write,
+                     SmallVectorImpl<char> &CompressedBuffer,
+                     int Level = DefaultCompression);
+
+/// Uncompress \p InputBuffer chunk by chunk, passing every chunk of
+/// uncompressed data to \p Output as soon as it is available. Stops at the
+/// first error returned by \p Output.
+Error uncompressStream(StringRef InputBuffer,
+                       function_ref<Error(StringRef)> Output);
+
+}  // End of namespace zstd
+
 } // End of namespace llvm
 
 #endif
@@ -0,0 +1,69 @@
+//===- llvm/Support/ConcurrencyLimit.h - Process-wide task limit -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the tokens that bound the number of threads running tasks
+// at the same time in the process, across all the ThreadPools and the
+// parallel algorithms.
+//
+// The threads of a pool hold a token while they run tasks. The process has
+// getMaxConcurrency() tokens, or as many as needed when no limit is set. When
+// the process runs under a GNU make jobserver, every token but one also takes
+// a job slot of the jobserver, so that several tools running side by side
+// share the cores handed out by make.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_CONCURRENCYLIMIT_H
+#define LLVM_SUPPORT_CONCURRENCYLIMIT_H
+
+namespace llvm {
+namespace parallel {
+
+/// Set the maximum number of threads of the process running tasks at the same
+/// time, or remove the limit if \p N is 0, which is the default. Tasks that
+/// wait for other tasks by other means than ThreadPool::wait() or the parallel
+/// algorithms may deadlock under a limit.
+void setMaxConcurrency(unsigned N);
+
+/// Return the maximum number of threads of the process running tasks at the
+/// same time, or 0 if there is no limit.
+unsigned getMaxConcurrency();
+
+/// A token allowing the calling thread to run tasks, held for the lifetime of
+/// the object. Acquiring a token blocks until one is available. A thread holds
+/// at most one token: the nested tokens of a thread share the first one.
+class ConcurrencyToken {
+public:
+  ConcurrencyToken();
+  ~ConcurrencyToken();
+
+  ConcurrencyToken(const ConcurrencyToken &) = delete;
+  ConcurrencyToken &operator=(const ConcurrencyToken &) = delete;
+};
+
+/// Give back the token of the calling thread, if any, for the lifetime of the
+/// object. Threads that block waiting for other tasks to complete must do so
+/// in a BlockingRegion, so that the tasks they wait for can get a token.
+class BlockingRegion {
+public:
+  BlockingRegion();
+  ~BlockingRegion();
+
+  BlockingRegion(const BlockingRegion &) = delete;
+  BlockingRegion &operator=(const BlockingRegion &) = delete;
+
+private:
+  /// The nesting depth of the tokens of the thread when it entered the region.
+  unsigned Depth;
+};
+
+} // end namespace parallel
+} // end namespace llvm
+
+#endif // LLVM_SUPPORT_CONCURRENCYLIMIT_H
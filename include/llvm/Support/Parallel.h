@@ -12,6 +12,7 @@
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/ConcurrencyLimit.h"
 #include "llvm/Support/MathExtras.h"
 
 #include <algorithm>
@@ -67,6 +68,8 @@ public:
   }
 
   void sync() const {
+    // Let the tasks we wait for run in our place if we run a task ourselves.
+    BlockingRegion Blocking;
     std::unique_lock<std::mutex> lock(Mutex);
     Cond.wait(lock, [&] { return Count == 0; });
   }
@@ -51,6 +51,10 @@ public:
   /// allocated space.
   static size_t GetMallocUsage();
 
+  /// Return the largest amount of physical memory, in bytes, that the process
+  /// has used so far, or 0 if the operating system does not support it.
+  static size_t GetPeakResidentSetSize();
+
   /// This static function will set \p user_time to the amount of CPU time
   /// spent in user (non-kernel) mode and \p sys_time to the amount of CPU
   /// time spent in system (kernel) mode.  If the operating system does not
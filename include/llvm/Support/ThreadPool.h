@@ -7,7 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file defines a crude C++11 based thread pool.
+// This file defines a C++11 based work-stealing thread pool.
 //
 //===----------------------------------------------------------------------===//
 
@@ -21,19 +21,29 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <utility>
+#include <vector>
 
 namespace llvm {
 
 /// A ThreadPool for asynchronous parallel execution on a defined number of
 /// threads.
 ///
-/// The pool keeps a vector of threads alive, waiting on a condition variable
-/// for some work to become available.
+/// The pool keeps a vector of threads alive, each with its own deque of tasks.
+/// Tasks submitted from a thread of the pool are pushed on the deque of that
+/// thread, which runs them last-in first-out for locality, and tasks
+/// submitted from other threads are pushed on a shared queue. Threads that
+/// run out of work steal the oldest tasks of the other threads, and wait on a
+/// condition variable when there is nothing left to steal.
+///
+/// The threads of all the pools of the process, including the pool running
+/// the parallel algorithms, share the limit set by parallel::setMaxConcurrency()
+/// and the jobserver of make, if any: a thread holds a
+/// parallel::ConcurrencyToken while it runs tasks.
 class ThreadPool {
 public:
   using TaskTy = std::function<void()>;
@@ -65,22 +75,54 @@ public:
     return asyncImpl(std::forward<Function>(F));
   }
 
-  /// Blocking wait for all the threads to complete and the queue to be empty.
-  /// It is an error to try to add new tasks while blocking on this call.
+  /// Blocking wait for all the submitted tasks to complete, including the
+  /// tasks they submit while it blocks, so that a task can queue the work it
+  /// makes ready. It is an error to call it from a task running in the pool.
   void wait();
 
+  /// Blocking wait for the task of \p Future to complete. When called from a
+  /// task running in the pool, the calling thread runs other tasks meanwhile,
+  /// so that tasks can wait for the tasks they submit without deadlocking,
+  /// even when all the threads of the pool are busy.
+  void wait(const std::shared_future<void> &Future);
+
 private:
+  /// A deque of tasks. Its owner pushes and pops tasks at the back, while
+  /// other threads steal them from the front.
+  struct WorkQueue {
+    std::mutex Lock;
+    std::deque<PackagedTaskTy> Tasks;
+  };
+
   /// Asynchronous submission of a task to the pool. The returned future can be
   /// used to wait for the task to finish and is *non-blocking* on destruction.
   std::shared_future<void> asyncImpl(TaskTy F);
 
+  /// Index of the queue of the calling thread: its own deque if it belongs to
+  /// the pool, or the shared queue otherwise.
+  unsigned getQueueIndex() const;
+
+  /// Take a task to run on the thread owning queue \p Self: the newest task
+  /// of its own queue, or else the oldest task of another queue.
+  bool popTask(unsigned Self, PackagedTaskTy &Task);
+
+  /// Run \p Task and signal its completion.
+  void runTask(PackagedTaskTy &Task);
+
   /// Threads in flight
   std::vector<llvm::thread> Threads;
 
-  /// Tasks waiting for execution in the pool.
-  std::queue<PackagedTaskTy> Tasks;
+  /// One deque per thread, followed by the queue of the tasks submitted from
+  /// outside of the pool.
+  std::vector<std::unique_ptr<WorkQueue>> Queues;
+
+  /// Number of tasks waiting in the queues.
+  std::atomic<unsigned> QueuedTasks;
+
+  /// Number of threads waiting on QueueCondition for tasks to be queued.
+  std::atomic<unsigned> IdleThreads;
 
-  /// Locking and signaling for accessing the Tasks queue.
+  /// Locking and signaling for idle threads.
   std::mutex QueueLock;
   std::condition_variable QueueCondition;
 
@@ -88,8 +130,8 @@ private:
   std::mutex CompletionLock;
   std::condition_variable CompletionCondition;
 
-  /// Keep track of the number of thread actually busy
-  std::atomic<unsigned> ActiveThreads;
+  /// Number of tasks submitted and not yet completed.
+  std::atomic<unsigned> UnfinishedTasks;
 
 #if LLVM_ENABLE_THREADS // avoids warning for unused variable
   /// Signal for the destruction of the pool, asking thread to exit.
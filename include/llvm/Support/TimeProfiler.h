@@ -0,0 +1,103 @@
+//===- llvm/Support/TimeProfiler.h - Hierarchical Time Profiler -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares a profiler recording nested time sections, such as the
+// passes run on every function of a module, and writing them as a trace that
+// Chrome's about:tracing and similar viewers display as a flame graph.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_TIMEPROFILER_H
+#define LLVM_SUPPORT_TIMEPROFILER_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include <string>
+
+namespace llvm {
+
+class raw_ostream;
+
+struct TimeTraceProfiler;
+extern TimeTraceProfiler *TimeTraceProfilerInstance;
+
+/// Initialize the time trace profiler, which sets up the global
+/// TimeTraceProfilerInstance. Sections shorter than \p TimeTraceGranularity
+/// microseconds are only accounted for in the totals of the trace. \p ProcName
+/// names the process in the trace.
+void timeTraceProfilerInitialize(unsigned TimeTraceGranularity,
+                                 StringRef ProcName);
+
+/// Destroy the time trace profiler, if it was initialized.
+void timeTraceProfilerCleanup();
+
+/// Is the time trace profiler enabled, i.e. initialized?
+inline bool timeTraceProfilerEnabled() {
+  return TimeTraceProfilerInstance != nullptr;
+}
+
+/// Write the sections recorded by all threads to \p OS, as JSON in the Chrome
+/// "Trace Event" format, followed by the total time spent in the sections of
+/// every name. No thread may be recording sections meanwhile.
+void timeTraceProfilerWrite(raw_ostream &OS);
+
+/// Write the trace to \p PreferredFileName if it is not empty, and to
+/// \p FallbackFileName with a ".time-trace" suffix otherwise.
+Error timeTraceProfilerWrite(StringRef PreferredFileName,
+                             StringRef FallbackFileName);
+
+/// Begin a time section named \p Name, on the calling thread. The profiler
+/// copies the strings, so they can refer to temporaries. Sections nest: every
+/// call must be matched by a call to timeTraceProfilerEnd() on the same
+/// thread.
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail);
+
+/// Begin a time section named \p Name, computing its detail, such as the name
+/// of the function it applies to, only when the profiler is enabled.
+void timeTraceProfilerBegin(StringRef Name,
+                            function_ref<std::string()> Detail);
+
+/// End the innermost time section of the calling thread.
+void timeTraceProfilerEnd();
+
+/// Record a time section for the lifetime of the object. When the profiler is
+/// not enabled, the overhead is a single branch.
+class TimeTraceScope {
+public:
+  TimeTraceScope(StringRef Name, StringRef Detail = StringRef())
+      : Enabled(timeTraceProfilerEnabled()) {
+    if (Enabled)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+
+  TimeTraceScope(StringRef Name, const std::string &Detail)
+      : TimeTraceScope(Name, StringRef(Detail)) {}
+
+  TimeTraceScope(StringRef Name, function_ref<std::string()> Detail)
+      : Enabled(timeTraceProfilerEnabled()) {
+    if (Enabled)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+
+  ~TimeTraceScope() {
+    if (Enabled)
+      timeTraceProfilerEnd();
+  }
+
+  TimeTraceScope(const TimeTraceScope &) = delete;
+  TimeTraceScope &operator=(const TimeTraceScope &) = delete;
+
+private:
+  bool Enabled;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_SUPPORT_TIMEPROFILER_H
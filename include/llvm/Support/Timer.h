@@ -29,8 +29,10 @@ class TimeRecord {
   double UserTime;       ///< User time elapsed.
   double SystemTime;     ///< System time elapsed.
   ssize_t MemUsed;       ///< Memory allocated (in bytes).
+  ssize_t PeakRSS;       ///< Growth of the peak resident set size (in bytes).
 public:
-  TimeRecord() : WallTime(0), UserTime(0), SystemTime(0), MemUsed(0) {}
+  TimeRecord()
+      : WallTime(0), UserTime(0), SystemTime(0), MemUsed(0), PeakRSS(0) {}
 
   /// Get the current time and memory usage.  If Start is true we get the memory
   /// usage before the time, otherwise we get time before memory usage.  This
@@ -43,6 +45,7 @@ public:
   double getSystemTime() const { return SystemTime; }
   double getWallTime() const { return WallTime; }
   ssize_t getMemUsed() const { return MemUsed; }
+  ssize_t getPeakRSS() const { return PeakRSS; }
 
   bool operator<(const TimeRecord &T) const {
     // Sort by Wall Time elapsed, as it is the only thing really accurate
@@ -54,12 +57,14 @@ public:
     UserTime   += RHS.UserTime;
     SystemTime += RHS.SystemTime;
     MemUsed    += RHS.MemUsed;
+    PeakRSS    += RHS.PeakRSS;
   }
   void operator-=(const TimeRecord &RHS) {
     WallTime   -= RHS.WallTime;
     UserTime   -= RHS.UserTime;
     SystemTime -= RHS.SystemTime;
     MemUsed    -= RHS.MemUsed;
+    PeakRSS    -= RHS.PeakRSS;
   }
 
   /// Print the current time record to \p OS, with a breakdown showing
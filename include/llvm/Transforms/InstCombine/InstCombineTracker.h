@@ -0,0 +1,107 @@
+//===- InstCombineTracker.h - Instructions left unchanged -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains an analysis that remembers the instructions InstCombine
+// visited without changing them, so that its later runs on the function only
+// visit the instructions that changed in between.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_INSTCOMBINE_INSTCOMBINETRACKER_H
+#define LLVM_TRANSFORMS_INSTCOMBINE_INSTCOMBINETRACKER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
+#include <cassert>
+#include <cstddef>
+
+namespace llvm {
+
+class Function;
+class Instruction;
+class Value;
+
+/// The instructions InstCombine visited and left unchanged, each with a
+/// signature of what the combines looked at: its opcode, type, flags, block
+/// and operands, the predicate of a compare, the alignment and volatility of a
+/// memory access, the attributes of a call and of its callee, and whether it
+/// has no, one or more uses.
+///
+/// An instruction whose signature still matches the recorded one when
+/// InstCombine runs again is not visited, unless one of its operands or users
+/// is. The IR does not notify anyone of its changes, so the signature is the
+/// only way to tell. It does not cover the values further away, which
+/// computeKnownBits() and a few combines look through, so a later run may
+/// miss folds that a run over every instruction would find.
+///
+/// Deleted instructions are dropped automatically, and the signatures make up
+/// for the other changes, so the results never need to be invalidated.
+class InstCombineTracker {
+  class InstCallbackVH final : public CallbackVH {
+    InstCombineTracker *Tracker;
+
+    void deleted() override;
+
+  public:
+    using DMI = DenseMapInfo<Value *>;
+
+    InstCallbackVH(Value *V, InstCombineTracker *Tracker = nullptr)
+        : CallbackVH(V), Tracker(Tracker) {}
+  };
+
+  friend InstCallbackVH;
+
+  DenseMap<InstCallbackVH, size_t, InstCallbackVH::DMI> Unchanged;
+
+public:
+  InstCombineTracker() = default;
+
+  /// The tracker is only moved by the analysis manager, before any instruction
+  /// is recorded, as the value handles point back to it.
+  InstCombineTracker(InstCombineTracker &&Arg) {
+    assert(Arg.Unchanged.empty() && "Moving a non-empty InstCombine tracker!");
+  }
+
+  /// Record that InstCombine visited \p I and left it unchanged.
+  void markUnchanged(Instruction &I);
+
+  /// Return true if \p I was not visited by InstCombine, or changed since it
+  /// was left unchanged.
+  bool isChanged(Instruction &I) const;
+
+  /// Forget all the instructions.
+  void clear() { Unchanged.clear(); }
+
+  /// The tracker stays valid whatever the other passes do.
+  bool invalidate(Function &, const PreservedAnalyses &,
+                  FunctionAnalysisManager::Invalidator &) {
+    return false;
+  }
+};
+
+/// A function analysis which provides an \c InstCombineTracker.
+///
+/// It is only used when -instcombine-incremental is set.
+class InstCombineTrackerAnalysis
+    : public AnalysisInfoMixin<InstCombineTrackerAnalysis> {
+  friend AnalysisInfoMixin<InstCombineTrackerAnalysis>;
+
+  static AnalysisKey Key;
+
+public:
+  using Result = InstCombineTracker;
+
+  InstCombineTracker run(Function &F, FunctionAnalysisManager &AM);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_TRANSFORMS_INSTCOMBINE_INSTCOMBINETRACKER_H
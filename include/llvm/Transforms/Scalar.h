@@ -16,6 +16,7 @@
 #define LLVM_TRANSFORMS_SCALAR_H
 
 #include <functional>
+#include <string>
 
 namespace llvm {
 
@@ -320,6 +321,23 @@ FunctionPass *createNewGVNPass();
 //
 FunctionPass *createDivRemPairsPass();
 
+//===----------------------------------------------------------------------===//
+//
+// LockElision - Execute pthread mutex critical sections as hardware memory
+// transactions, falling back to the lock when the transaction aborts.
+// Optionally instruments the elided sections to profile their aborts, or uses
+// such a profile to decide which sections to elide.
+//
+FunctionPass *createLockElisionPass(bool InstrumentAborts = false,
+                                    std::string ProfileFileName = "");
+
+//===----------------------------------------------------------------------===//
+//
+// ShrinkTransactions - Hoist and sink instructions that do not need to run
+// transactionally out of hardware memory transactions.
+//
+FunctionPass *createShrinkTransactionsPass();
+
 //===----------------------------------------------------------------------===//
 //
 // MemCpyOpt - This pass performs optimizations related to eliminating memcpy
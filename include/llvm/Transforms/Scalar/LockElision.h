@@ -0,0 +1,48 @@
+//===- LockElision.h - Elide pthread mutex critical sections ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass rewrites pthread mutex critical sections into hardware memory
+// transactions that fall back to taking the real lock when the transaction
+// aborts.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCALAR_LOCKELISION_H
+#define LLVM_TRANSFORMS_SCALAR_LOCKELISION_H
+
+#include "llvm/IR/PassManager.h"
+#include <memory>
+#include <string>
+
+namespace llvm {
+
+class IndexedInstrProfReader;
+
+/// Speculatively execute short pthread mutex critical sections as hardware
+/// transactions, taking the lock only when the transaction aborts.
+///
+/// With \p InstrumentAborts, the commits and aborts of every elided section
+/// are counted into the instrumentation profile, bucketed by abort cause. With
+/// a \p ProfileFileName, these counts are read back from the indexed profile
+/// to disable or tune the elision of each section.
+class LockElisionPass : public PassInfoMixin<LockElisionPass> {
+public:
+  LockElisionPass(bool InstrumentAborts = false,
+                  std::string ProfileFileName = "");
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &);
+
+private:
+  bool InstrumentAborts;
+  std::string ProfileFileName;
+  std::shared_ptr<IndexedInstrProfReader> ProfileReader;
+  bool ProfileLoaded = false;
+};
+
+}
+#endif // LLVM_TRANSFORMS_SCALAR_LOCKELISION_H
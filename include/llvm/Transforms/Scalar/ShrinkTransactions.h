@@ -0,0 +1,32 @@
+//===- ShrinkTransactions.h - Move code out of transactions -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass hoists and sinks instructions that do not need to run inside a
+// hardware memory transaction out of it, so that transactions touch less
+// memory and run for a shorter time.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_SCALAR_SHRINKTRANSACTIONS_H
+#define LLVM_TRANSFORMS_SCALAR_SHRINKTRANSACTIONS_H
+
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+
+/// Move pure computations and loads of thread-private memory out of the
+/// regions delimited by llvm.htm.begin and llvm.htm.commit.
+class ShrinkTransactionsPass : public PassInfoMixin<ShrinkTransactionsPass> {
+public:
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+};
+
+} // end namespace llvm
+
+#endif // LLVM_TRANSFORMS_SCALAR_SHRINKTRANSACTIONS_H
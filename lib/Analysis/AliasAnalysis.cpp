@@ -25,6 +25,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/CFLAndersAliasAnalysis.h"
 #include "llvm/Analysis/CFLSteensAliasAnalysis.h"
@@ -54,16 +56,79 @@
 #include <cassert>
 #include <functional>
 #include <iterator>
+#include <utility>
 
 using namespace llvm;
 
+#define DEBUG_TYPE "aa"
+
+STATISTIC(NumResultLookups, "Number of alias queries looked up in the cache");
+STATISTIC(NumResultHits, "Number of alias results read from the cache");
+
 /// Allow disabling BasicAA from the AA results. This is particularly useful
 /// when testing to isolate a single AA implementation.
 static cl::opt<bool> DisableBasicAA("disable-basicaa", cl::Hidden,
                                     cl::init(false));
 
+static cl::opt<bool> CacheResults(
+    "aa-cache-results", cl::Hidden, cl::init(false),
+    cl::desc("Cache the results of the alias queries made by a batch of "
+             "queries that does not change the IR"));
+
+static cl::opt<unsigned> ResultCacheLimit(
+    "aa-result-cache-limit", cl::Hidden, cl::init(1 << 16),
+    cl::desc("The number of alias results cached before the cache is "
+             "cleared"));
+
+/// The results of the outermost alias queries of a batch.
+class AAResults::ResultCache {
+  using LocPair = std::pair<MemoryLocation, MemoryLocation>;
+
+  DenseMap<LocPair, AliasResult> Results;
+
+public:
+  bool lookup(const MemoryLocation &LocA, const MemoryLocation &LocB,
+              AliasResult &Result);
+  void insert(const MemoryLocation &LocA, const MemoryLocation &LocB,
+              AliasResult Result);
+};
+
+bool AAResults::ResultCache::lookup(const MemoryLocation &LocA,
+                                    const MemoryLocation &LocB,
+                                    AliasResult &Result) {
+  ++NumResultLookups;
+  auto It = Results.find(LocPair(LocA, LocB));
+  if (It == Results.end())
+    return false;
+  ++NumResultHits;
+  Result = It->second;
+  return true;
+}
+
+void AAResults::ResultCache::insert(const MemoryLocation &LocA,
+                                    const MemoryLocation &LocB,
+                                    AliasResult Result) {
+  if (Results.size() >= ResultCacheLimit)
+    Results.clear();
+  Results.insert({LocPair(LocA, LocB), Result});
+}
+
+AAResults::BatchScope::BatchScope(AAResults &AAR) : AAR(AAR) {
+  if (AAR.NumBatches++ == 0 && CacheResults)
+    AAR.Cache.reset(new ResultCache());
+}
+
+AAResults::BatchScope::~BatchScope() {
+  if (--AAR.NumBatches == 0)
+    AAR.Cache.reset();
+}
+
+AAResults::AAResults(const TargetLibraryInfo &TLI) : TLI(TLI) {}
+
 AAResults::AAResults(AAResults &&Arg)
-    : TLI(Arg.TLI), AAs(std::move(Arg.AAs)), AADeps(std::move(Arg.AADeps)) {
+    : TLI(Arg.TLI), AAs(std::move(Arg.AAs)), AADeps(std::move(Arg.AADeps)),
+      Cache(std::move(Arg.Cache)), QueryDepth(Arg.QueryDepth),
+      NumBatches(Arg.NumBatches) {
   for (auto &AA : AAs)
     AA->setAAResults(this);
 }
@@ -101,12 +166,26 @@ bool AAResults::invalidate(Function &F, const PreservedAnalyses &PA,
 
 AliasResult AAResults::alias(const MemoryLocation &LocA,
                              const MemoryLocation &LocB) {
+  // The nested queries may be answered under assumptions that only hold
+  // within the outermost one, e.g. BasicAA assumes that the phis it walks do
+  // not alias, so only the outermost results are cached.
+  bool UseCache = Cache && QueryDepth == 0;
+  AliasResult Result;
+  if (UseCache && Cache->lookup(LocA, LocB, Result))
+    return Result;
+
+  Result = MayAlias;
+  ++QueryDepth;
   for (const auto &AA : AAs) {
-    auto Result = AA->alias(LocA, LocB);
+    Result = AA->alias(LocA, LocB);
     if (Result != MayAlias)
-      return Result;
+      break;
   }
-  return MayAlias;
+  --QueryDepth;
+
+  if (UseCache)
+    Cache->insert(LocA, LocB, Result);
+  return Result;
 }
 
 bool AAResults::pointsToConstantMemory(const MemoryLocation &Loc,
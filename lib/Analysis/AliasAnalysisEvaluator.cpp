@@ -94,6 +94,7 @@ PreservedAnalyses AAEvaluator::run(Function &F, FunctionAnalysisManager &AM) {
 
 void AAEvaluator::runInternal(Function &F, AAResults &AA) {
   const DataLayout &DL = F.getParent()->getDataLayout();
+  AAResults::BatchScope Batch(AA);
 
   ++FunctionCount;
 
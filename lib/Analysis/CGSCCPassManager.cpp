@@ -9,6 +9,8 @@
 
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
@@ -23,10 +25,15 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
+#include <functional>
 #include <iterator>
+#include <mutex>
+#include <vector>
 
 #define DEBUG_TYPE "cgscc"
 
@@ -74,7 +81,12 @@ PassManager<LazyCallGraph::SCC, CGSCCAnalysisManager, LazyCallGraph &,
 
     // If the CGSCC pass wasn't able to provide a valid updated SCC, the
     // current SCC may simply need to be skipped if invalid.
-    if (UR.InvalidatedSCCs.count(C)) {
+    bool InvalidatedC;
+    {
+      auto CallGraphLock = UR.lockCallGraph();
+      InvalidatedC = UR.InvalidatedSCCs.count(C);
+    }
+    if (InvalidatedC) {
       LLVM_DEBUG(dbgs() << "Skipping invalidated root or island SCC!\n");
       break;
     }
@@ -687,3 +699,248 @@ LazyCallGraph::SCC &llvm::updateCGAndAnalysisManagerForFunctionPass(
 
   return *C;
 }
+
+PreservedAnalyses llvm::runOnRefSCCWorklist(
+    CGSCCAnalysisManager &AM, CGSCCUpdateResult &UR,
+    function_ref<PreservedAnalyses(LazyCallGraph::SCC &)> RunPass) {
+  PreservedAnalyses PA = PreservedAnalyses::all();
+  do {
+    LazyCallGraph::RefSCC *RC = UR.RCWorklist.pop_back_val();
+    if (UR.InvalidatedRefSCCs.count(RC)) {
+      LLVM_DEBUG(dbgs() << "Skipping an invalid RefSCC...\n");
+      continue;
+    }
+
+    assert(UR.CWorklist.empty() &&
+           "Should always start with an empty SCC worklist");
+
+    LLVM_DEBUG(dbgs() << "Running an SCC pass across the RefSCC: " << *RC
+                      << "\n");
+
+    // Push the initial SCCs in reverse post-order as we'll pop off the
+    // back and so see this in post-order.
+    for (LazyCallGraph::SCC &C : llvm::reverse(*RC))
+      UR.CWorklist.insert(&C);
+
+    do {
+      LazyCallGraph::SCC *C = UR.CWorklist.pop_back_val();
+      // Due to call graph mutations, we may have invalid SCCs or SCCs from
+      // other RefSCCs in the worklist. The invalid ones are dead and the
+      // other RefSCCs should be queued above, so we just need to skip both
+      // scenarios here.
+      if (UR.InvalidatedSCCs.count(C)) {
+        LLVM_DEBUG(dbgs() << "Skipping an invalid SCC...\n");
+        continue;
+      }
+      if (&C->getOuterRefSCC() != RC) {
+        LLVM_DEBUG(dbgs()
+                   << "Skipping an SCC that is now part of some other "
+                      "RefSCC...\n");
+        continue;
+      }
+
+      do {
+        // Check that we didn't miss any update scenario.
+        assert(!UR.InvalidatedSCCs.count(C) && "Processing an invalid SCC!");
+        assert(C->begin() != C->end() && "Cannot have an empty SCC!");
+        assert(&C->getOuterRefSCC() == RC &&
+               "Processing an SCC in a different RefSCC!");
+
+        UR.UpdatedRC = nullptr;
+        UR.UpdatedC = nullptr;
+        PreservedAnalyses PassPA = RunPass(*C);
+
+        // Update the SCC and RefSCC if necessary.
+        C = UR.UpdatedC ? UR.UpdatedC : C;
+        RC = UR.UpdatedRC ? UR.UpdatedRC : RC;
+
+        // If the CGSCC pass wasn't able to provide a valid updated SCC,
+        // the current SCC may simply need to be skipped if invalid.
+        if (UR.InvalidatedSCCs.count(C)) {
+          LLVM_DEBUG(dbgs() << "Skipping invalidated root or island SCC!\n");
+          break;
+        }
+        // Check that we didn't miss any update scenario.
+        assert(C->begin() != C->end() && "Cannot have an empty SCC!");
+
+        // We handle invalidating the CGSCC analysis manager's information
+        // for the (potentially updated) SCC here. Note that any other SCCs
+        // whose structure has changed should have been invalidated by
+        // whatever was updating the call graph. This SCC gets invalidated
+        // late as it contains the nodes that were actively being
+        // processed.
+        AM.invalidate(*C, PassPA);
+
+        // Then intersect the preserved set so that invalidation of module
+        // analyses will eventually occur when the module pass completes.
+        PA.intersect(std::move(PassPA));
+
+        // The pass may have restructured the call graph and refined the
+        // current SCC and/or RefSCC. We need to update our current SCC and
+        // RefSCC pointers to follow these. Also, when the current SCC is
+        // refined, re-run the SCC pass over the newly refined SCC in order
+        // to observe the most precise SCC model available. This inherently
+        // cannot cycle excessively as it only happens when we split SCCs
+        // apart, at most converging on a DAG of single nodes.
+        // FIXME: If we ever start having RefSCC passes, we'll want to
+        // iterate there too.
+        if (UR.UpdatedC)
+          LLVM_DEBUG(dbgs()
+                     << "Re-running SCC passes after a refinement of the "
+                        "current SCC: "
+                     << *UR.UpdatedC << "\n");
+
+        // Note that both `C` and `RC` may at this point refer to deleted,
+        // invalid SCC and RefSCCs respectively. But we will short circuit
+        // the processing when we check them in the loop above.
+      } while (UR.UpdatedC);
+    } while (!UR.CWorklist.empty());
+
+    // We only need to keep internal inlined edge information within
+    // a RefSCC, clear it to save on space and let the next time we visit
+    // any of these functions have a fresh start.
+    UR.InlinedInternalEdges.clear();
+  } while (!UR.RCWorklist.empty());
+
+  return PA;
+}
+
+ParallelModuleToPostOrderCGSCCPassAdaptor::
+    ParallelModuleToPostOrderCGSCCPassAdaptor(
+        function_ref<CGSCCPassManager()> BuildPipeline, unsigned ThreadCount) {
+  if (ThreadCount == 0)
+    ThreadCount = heavyweight_hardware_concurrency();
+  for (unsigned Thread = 0; Thread != ThreadCount; ++Thread)
+    Pipelines.push_back(BuildPipeline());
+}
+
+PreservedAnalyses
+ParallelModuleToPostOrderCGSCCPassAdaptor::run(Module &M,
+                                               ModuleAnalysisManager &AM) {
+  // Setup the CGSCC analysis manager from its proxy.
+  CGSCCAnalysisManager &CGAM =
+      AM.getResult<CGSCCAnalysisManagerModuleProxy>(M).getManager();
+  FunctionAnalysisManager &FAM =
+      AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+  // Get the call graph for this module.
+  LazyCallGraph &CG = AM.getResult<LazyCallGraphAnalysis>(M);
+
+  // Number the RefSCCs in post-order, and find the ones each of them waits
+  // for. The passes only split the RefSCC they run on, and the new RefSCCs
+  // are walked by the same thread, so the numbering stays valid.
+  CG.buildRefSCCs();
+  std::vector<LazyCallGraph::RefSCC *> RefSCCs;
+  DenseMap<LazyCallGraph::RefSCC *, unsigned> RefSCCIndices;
+  for (LazyCallGraph::RefSCC &RC : CG.postorder_ref_sccs()) {
+    RefSCCIndices[&RC] = RefSCCs.size();
+    RefSCCs.push_back(&RC);
+  }
+
+  std::vector<unsigned> NumPending(RefSCCs.size());
+  std::vector<SmallVector<unsigned, 4>> Dependents(RefSCCs.size());
+  // The last RefSCC so far with an edge to each node.
+  DenseMap<LazyCallGraph::Node *, unsigned> LastReferrers;
+  for (unsigned I = 0, E = RefSCCs.size(); I != E; ++I) {
+    SmallDenseSet<unsigned, 8> Dependencies;
+    for (LazyCallGraph::SCC &C : *RefSCCs[I])
+      for (LazyCallGraph::Node &N : C)
+        for (LazyCallGraph::Edge &Edge : *N) {
+          LazyCallGraph::Node &Target = Edge.getNode();
+          LazyCallGraph::RefSCC *TargetRC = CG.lookupRefSCC(Target);
+          if (TargetRC != RefSCCs[I])
+            Dependencies.insert(RefSCCIndices[TargetRC]);
+
+          auto Inserted = LastReferrers.insert({&Target, I});
+          if (!Inserted.second && Inserted.first->second != I) {
+            Dependencies.insert(Inserted.first->second);
+            Inserted.first->second = I;
+          }
+        }
+
+    NumPending[I] = Dependencies.size();
+    for (unsigned Dependency : Dependencies)
+      Dependents[Dependency].push_back(I);
+  }
+
+  if (Pipelines.size() > 1) {
+    M.getContext().enableThreadSafety();
+    CGAM.enableThreadSafety();
+    FAM.enableThreadSafety();
+  }
+
+  // The RefSCCs and SCCs deleted by the passes, which are only updated with
+  // the call graph, under CallGraphMutex.
+  SmallPtrSet<LazyCallGraph::RefSCC *, 4> InvalidRefSCCSet;
+  SmallPtrSet<LazyCallGraph::SCC *, 4> InvalidSCCSet;
+  std::mutex CallGraphMutex;
+
+  // Guards the state of the walk below.
+  std::mutex WalkMutex;
+  std::vector<CGSCCPassManager *> FreePipelines;
+  for (CGSCCPassManager &Pipeline : Pipelines)
+    FreePipelines.push_back(&Pipeline);
+  PreservedAnalyses PA = PreservedAnalyses::all();
+
+  // There are as many threads as pipelines, so a task always finds one free.
+  ThreadPool Pool(Pipelines.size());
+  std::function<void(unsigned)> RunOnRefSCC = [&](unsigned I) {
+    CGSCCPassManager *Pipeline;
+    {
+      std::lock_guard<std::mutex> Lock(WalkMutex);
+      Pipeline = FreePipelines.back();
+      FreePipelines.pop_back();
+    }
+
+    SmallPriorityWorklist<LazyCallGraph::RefSCC *, 1> RCWorklist;
+    SmallPriorityWorklist<LazyCallGraph::SCC *, 1> CWorklist;
+    SmallDenseSet<std::pair<LazyCallGraph::Node *, LazyCallGraph::SCC *>, 4>
+        InlinedInternalEdges;
+
+    // The walk of the worklists reads the call graph, so hold the lock for it,
+    // but not while the passes run: they only lock the call graph around
+    // their reads and updates of it.
+    std::unique_lock<std::mutex> CallGraphLock(CallGraphMutex);
+    CGSCCUpdateResult UR = {RCWorklist,           CWorklist, InvalidRefSCCSet,
+                            InvalidSCCSet,        nullptr,   nullptr,
+                            InlinedInternalEdges, &CallGraphMutex};
+    RCWorklist.insert(RefSCCs[I]);
+    PreservedAnalyses PassPA =
+        runOnRefSCCWorklist(CGAM, UR, [&](LazyCallGraph::SCC &C) {
+          CallGraphLock.unlock();
+          PreservedAnalyses PassPA = Pipeline->run(C, CGAM, CG, UR);
+          CallGraphLock.lock();
+          return PassPA;
+        });
+    CallGraphLock.unlock();
+
+    SmallVector<unsigned, 4> Ready;
+    {
+      std::lock_guard<std::mutex> Lock(WalkMutex);
+      PA.intersect(std::move(PassPA));
+      FreePipelines.push_back(Pipeline);
+      for (unsigned Dependent : Dependents[I])
+        if (--NumPending[Dependent] == 0)
+          Ready.push_back(Dependent);
+    }
+    for (unsigned Dependent : Ready)
+      Pool.async(RunOnRefSCC, Dependent);
+  };
+
+  // Find all the leaves before the first task can make more RefSCCs ready.
+  SmallVector<unsigned, 16> Leaves;
+  for (unsigned I = 0, E = RefSCCs.size(); I != E; ++I)
+    if (NumPending[I] == 0)
+      Leaves.push_back(I);
+  for (unsigned I : Leaves)
+    Pool.async(RunOnRefSCC, I);
+  Pool.wait();
+
+  // As in ModuleToPostOrderCGSCCPassAdaptor, we preserve the call graph, all
+  // SCC analyses, and the analysis manager proxies.
+  PA.preserveSet<AllAnalysesOn<LazyCallGraph::SCC>>();
+  PA.preserve<LazyCallGraphAnalysis>();
+  PA.preserve<CGSCCAnalysisManagerModuleProxy>();
+  PA.preserve<FunctionAnalysisManagerModuleProxy>();
+  return PA;
+}
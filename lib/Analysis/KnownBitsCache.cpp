@@ -0,0 +1,135 @@
+//===- KnownBitsCache.cpp - Memoize known bits ----------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains an analysis that memoizes the results of computeKnownBits
+// and ComputeNumSignBits for the values of a function.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/KnownBitsCache.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/IR/Argument.h"
+#include "llvm/IR/Instruction.h"
+#include <cassert>
+#include <tuple>
+#include <utility>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "known-bits-cache"
+
+STATISTIC(NumKnownBitsLookups, "Number of lookups of known bits");
+STATISTIC(NumKnownBitsHits, "Number of known bits read from the cache");
+STATISTIC(NumSignBitsLookups, "Number of lookups of sign bits");
+STATISTIC(NumSignBitsHits, "Number of sign bits read from the cache");
+STATISTIC(NumForgotten, "Number of cached results dropped by changes");
+
+/// The depth at which ValueTracking stops following operands.
+static const unsigned MaxDepth = 6;
+
+void KnownBitsCache::ValueCallbackVH::deleted() {
+  KBC->Cache.erase(getValPtr());
+  // 'this' now dangles!
+}
+
+KnownBitsCache::CachedBits &KnownBitsCache::getOrInsert(const Value *V) {
+  assert((isa<Instruction>(V) || isa<Argument>(V)) &&
+         "Only the values of the function are cached!");
+  auto It = Cache.find_as(const_cast<Value *>(V));
+  if (It != Cache.end())
+    return It->second;
+  return Cache
+      .insert({ValueCallbackVH(const_cast<Value *>(V), this), CachedBits()})
+      .first->second;
+}
+
+bool KnownBitsCache::lookupKnownBits(const Value *V, unsigned Depth,
+                                     KnownBits &Known) {
+  ++NumKnownBitsLookups;
+  auto It = Cache.find_as(const_cast<Value *>(V));
+  if (It == Cache.end() || It->second.KnownBitsDepth > Depth)
+    return false;
+  ++NumKnownBitsHits;
+  Known = It->second.Known;
+  return true;
+}
+
+void KnownBitsCache::insertKnownBits(const Value *V, unsigned Depth,
+                                     const KnownBits &Known) {
+  CachedBits &Bits = getOrInsert(V);
+  if (Bits.KnownBitsDepth < Depth)
+    return;
+  Bits.Known = Known;
+  Bits.KnownBitsDepth = Depth;
+}
+
+unsigned KnownBitsCache::lookupNumSignBits(const Value *V, unsigned Depth) {
+  ++NumSignBitsLookups;
+  auto It = Cache.find_as(const_cast<Value *>(V));
+  if (It == Cache.end() || It->second.NumSignBitsDepth > Depth)
+    return 0;
+  ++NumSignBitsHits;
+  return It->second.NumSignBits;
+}
+
+void KnownBitsCache::insertNumSignBits(const Value *V, unsigned Depth,
+                                       unsigned NumSignBits) {
+  assert(NumSignBits > 0 && "At least one sign bit needs to be present!");
+  CachedBits &Bits = getOrInsert(V);
+  if (Bits.NumSignBitsDepth < Depth)
+    return;
+  Bits.NumSignBits = NumSignBits;
+  Bits.NumSignBitsDepth = Depth;
+}
+
+void KnownBitsCache::forgetValue(const Value *V) {
+  // A result depends on the values up to MaxDepth uses away from it, and on
+  // the ones the results it read from the cache depend on. So follow the users
+  // of V up to MaxDepth uses past the last result dropped. Not all the values
+  // in between need to be cached: e.g. isKnownNonZero looks at the operands of
+  // a value without asking for its known bits.
+  DenseMap<const Value *, unsigned> Visited;
+  SmallVector<std::pair<const Value *, unsigned>, 16> Worklist;
+  Worklist.push_back({V, MaxDepth});
+  while (!Worklist.empty()) {
+    const Value *Cur;
+    unsigned Remaining;
+    std::tie(Cur, Remaining) = Worklist.pop_back_val();
+
+    auto It = Cache.find_as(const_cast<Value *>(Cur));
+    if (It != Cache.end()) {
+      Cache.erase(It);
+      ++NumForgotten;
+      Remaining = MaxDepth;
+    }
+
+    // Only walk the users again if we can now go further.
+    auto Inserted = Visited.insert({Cur, Remaining});
+    if (!Inserted.second) {
+      if (Inserted.first->second >= Remaining)
+        continue;
+      Inserted.first->second = Remaining;
+    }
+
+    if (Remaining == 0)
+      continue;
+    for (const User *U : Cur->users())
+      if (isa<Instruction>(U))
+        Worklist.push_back({U, Remaining - 1});
+  }
+}
+
+AnalysisKey KnownBitsAnalysis::Key;
+
+KnownBitsCache KnownBitsAnalysis::run(Function &F,
+                                     FunctionAnalysisManager &AM) {
+  return KnownBitsCache(AM.getResult<AssumptionAnalysis>(F));
+}
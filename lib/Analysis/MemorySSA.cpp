@@ -1365,6 +1365,9 @@ void MemorySSA::placePHINodes(
 }
 
 void MemorySSA::buildMemorySSA() {
+  // The IR does not change while the accesses are built and optimized.
+  AAResults::BatchScope Batch(*AA);
+
   // We create an access to represent "live on entry", for things like
   // arguments or users of globals, where the memory they use is defined before
   // the beginning of the function. We do not actually insert it into the IR.
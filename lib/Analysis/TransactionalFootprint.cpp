@@ -0,0 +1,526 @@
+//===- TransactionalFootprint.cpp - Transaction footprint -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the transactional footprint analysis. The memory
+// accesses of a region are found through MemorySSA, which tells us which
+// instructions read or write memory. Each accessed address is split by
+// ScalarEvolution into a region-invariant base and a constant byte range, where
+// recurrences of loops inside the region are widened by their trip counts. The
+// ranges are then merged per base and rounded to cache lines.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/TransactionalFootprint.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+#define DEBUG_TYPE "tx-footprint"
+
+static cl::opt<unsigned> MaxReadLinesOpt(
+    "tx-max-read-lines", cl::init(0), cl::Hidden,
+    cl::desc("Maximum number of cache lines a transaction can read (default "
+             "derived from the L2 cache size of the target)"));
+
+static cl::opt<unsigned> MaxWrittenLinesOpt(
+    "tx-max-written-lines", cl::init(0), cl::Hidden,
+    cl::desc("Maximum number of cache lines a transaction can write (default "
+             "derived from the L1 cache size of the target)"));
+
+static bool isIntrinsicCall(const Instruction &I, Intrinsic::ID GenericID,
+                            Intrinsic::ID X86ID) {
+  auto *II = dyn_cast<IntrinsicInst>(&I);
+  return II && (II->getIntrinsicID() == GenericID ||
+                II->getIntrinsicID() == X86ID);
+}
+
+bool llvm::isTransactionBegin(const Instruction &I) {
+  return isIntrinsicCall(I, Intrinsic::htm_begin, Intrinsic::x86_xbegin);
+}
+
+bool llvm::isTransactionCommit(const Instruction &I) {
+  return isIntrinsicCall(I, Intrinsic::htm_commit, Intrinsic::x86_xend);
+}
+
+bool llvm::isTransactionAbort(const Instruction &I) {
+  return isIntrinsicCall(I, Intrinsic::htm_abort, Intrinsic::x86_xabort);
+}
+
+namespace {
+
+/// A range of instructions of a basic block that belongs to a region.
+struct RegionSegment {
+  const BasicBlock *BB;
+  BasicBlock::const_iterator Begin, End;
+};
+
+/// Byte ranges accessed relative to region-invariant base addresses.
+using AccessRanges =
+    DenseMap<const SCEV *, SmallVector<std::pair<int64_t, int64_t>, 4>>;
+
+/// Collects and sizes the memory accesses of one region.
+class FootprintBuilder {
+  ScalarEvolution &SE;
+  MemorySSA &MSSA;
+  LoopInfo &LI;
+  const TransactionalFootprintInfo &TFI;
+  const SmallPtrSetImpl<const BasicBlock *> &RegionBlocks;
+  TransactionalFootprint &FP;
+
+  AccessRanges Reads, Writes;
+
+  bool isRegionLoop(const Loop *L) const {
+    return RegionBlocks.count(L->getHeader());
+  }
+  bool getRange(const SCEV *S, const SCEV *&Base, int64_t &Lo, int64_t &Hi);
+  void addAccess(const Instruction &I, const Value *Ptr, uint64_t Size,
+                 bool IsWrite);
+  void addAccess(const Instruction &I, const Value *Ptr, const Value *Size,
+                 bool IsWrite);
+  unsigned countLines(AccessRanges &Ranges) const;
+
+public:
+  FootprintBuilder(ScalarEvolution &SE, MemorySSA &MSSA, LoopInfo &LI,
+                   const TransactionalFootprintInfo &TFI,
+                   const SmallPtrSetImpl<const BasicBlock *> &RegionBlocks,
+                   TransactionalFootprint &FP)
+      : SE(SE), MSSA(MSSA), LI(LI), TFI(TFI), RegionBlocks(RegionBlocks),
+        FP(FP) {}
+
+  void visit(const Instruction &I);
+  void finish();
+};
+
+} // end anonymous namespace
+
+/// Split \p S into a region-invariant \p Base and the byte range [Lo, Hi]
+/// relative to it that \p S covers while the region executes.
+bool FootprintBuilder::getRange(const SCEV *S, const SCEV *&Base, int64_t &Lo,
+                                int64_t &Hi) {
+  if (auto *AR = dyn_cast<SCEVAddRecExpr>(S))
+    if (isRegionLoop(AR->getLoop())) {
+      if (!AR->isAffine())
+        return false;
+      const Loop *L = AR->getLoop();
+      auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE));
+      auto *BTC = dyn_cast<SCEVConstant>(SE.getBackedgeTakenCount(L));
+      if (!BTC)
+        BTC = dyn_cast<SCEVConstant>(SE.getMaxBackedgeTakenCount(L));
+      if (!Step || !BTC || Step->getAPInt().getMinSignedBits() > 32 ||
+          BTC->getAPInt().getActiveBits() > 31)
+        return false;
+      if (!getRange(AR->getStart(), Base, Lo, Hi))
+        return false;
+      int64_t Extent =
+          Step->getAPInt().getSExtValue() * BTC->getAPInt().getSExtValue();
+      Lo += std::min<int64_t>(Extent, 0);
+      Hi += std::max<int64_t>(Extent, 0);
+      return true;
+    }
+
+  // Constants are canonically the first operand of an add.
+  if (auto *Add = dyn_cast<SCEVAddExpr>(S))
+    if (auto *C = dyn_cast<SCEVConstant>(Add->getOperand(0))) {
+      if (C->getAPInt().getMinSignedBits() > 32)
+        return false;
+      SmallVector<const SCEV *, 4> Ops(std::next(Add->op_begin()),
+                                       Add->op_end());
+      if (!getRange(SE.getAddExpr(Ops), Base, Lo, Hi))
+        return false;
+      Lo += C->getAPInt().getSExtValue();
+      Hi += C->getAPInt().getSExtValue();
+      return true;
+    }
+
+  Base = S;
+  return true;
+}
+
+void FootprintBuilder::addAccess(const Instruction &I, const Value *Ptr,
+                                 uint64_t Size, bool IsWrite) {
+  const SCEV *Base = nullptr;
+  int64_t Lo = 0, Hi = 0;
+  if (!SE.isSCEVable(Ptr->getType()) ||
+      !getRange(SE.getSCEV(const_cast<Value *>(Ptr)), Base, Lo, Hi)) {
+    // We do not know how many lines the access touches, but it touches at
+    // least one.
+    FP.Unbounded = true;
+    Base = SE.getUnknown(const_cast<Value *>(Ptr));
+    Lo = Hi = 0;
+  }
+
+  // An access repeated by a loop of the region must either be invariant in
+  // that loop or have been described by one of its recurrences.
+  for (const Loop *L = LI.getLoopFor(I.getParent()); L && isRegionLoop(L);
+       L = L->getParentLoop())
+    if (!SE.isLoopInvariant(Base, L)) {
+      FP.Unbounded = true;
+      break;
+    }
+
+  AccessRanges &Ranges = IsWrite ? Writes : Reads;
+  Ranges[Base].push_back({Lo, Hi + int64_t(std::max<uint64_t>(Size, 1)) - 1});
+}
+
+void FootprintBuilder::addAccess(const Instruction &I, const Value *Ptr,
+                                 const Value *Size, bool IsWrite) {
+  if (auto *C = dyn_cast<ConstantInt>(Size))
+    if (C->getValue().getActiveBits() <= 32)
+      return addAccess(I, Ptr, C->getZExtValue(), IsWrite);
+  FP.Unbounded = true;
+  addAccess(I, Ptr, uint64_t(1), IsWrite);
+}
+
+void FootprintBuilder::visit(const Instruction &I) {
+  // The accesses of aborting instructions never become part of the
+  // transaction.
+  if (TFI.isAbortingInstruction(I)) {
+    FP.AbortingInsts.push_back(&I);
+    return;
+  }
+
+  MemoryUseOrDef *MA = MSSA.getMemoryAccess(&I);
+  if (!MA)
+    return;
+  bool IsWrite = isa<MemoryDef>(MA);
+
+  if (auto *MI = dyn_cast<MemIntrinsic>(&I)) {
+    addAccess(I, MI->getRawDest(), MI->getLength(), /*IsWrite=*/true);
+    if (auto *MTI = dyn_cast<MemTransferInst>(MI))
+      addAccess(I, MTI->getRawSource(), MTI->getLength(), /*IsWrite=*/false);
+    return;
+  }
+
+  if (isa<LoadInst>(I) || isa<StoreInst>(I) || isa<AtomicRMWInst>(I) ||
+      isa<AtomicCmpXchgInst>(I)) {
+    MemoryLocation Loc = MemoryLocation::get(&I);
+    uint64_t Size = Loc.Size == MemoryLocation::UnknownSize ? 1 : Loc.Size;
+    addAccess(I, Loc.Ptr, Size, IsWrite);
+    return;
+  }
+
+  // Calls and other instructions whose accesses we cannot enumerate.
+  FP.Unbounded = true;
+}
+
+unsigned FootprintBuilder::countLines(AccessRanges &Ranges) const {
+  int64_t LineSize = TFI.getCacheLineSize();
+  auto LineOf = [LineSize](int64_t Offset) {
+    return Offset >= 0 ? Offset / LineSize
+                       : -((-Offset + LineSize - 1) / LineSize);
+  };
+
+  // Bases are assumed to be line aligned, so that the byte ranges relative to
+  // each base can be merged at line granularity.
+  unsigned Lines = 0;
+  for (auto &Entry : Ranges) {
+    auto &Intervals = Entry.second;
+    for (auto &Interval : Intervals)
+      Interval = {LineOf(Interval.first), LineOf(Interval.second)};
+    llvm::sort(Intervals);
+    int64_t First = Intervals.front().first, Last = Intervals.front().second;
+    for (auto &Interval : Intervals) {
+      if (Interval.first > Last + 1) {
+        Lines += Last - First + 1;
+        First = Interval.first;
+      }
+      Last = std::max(Last, Interval.second);
+    }
+    Lines += Last - First + 1;
+  }
+  return Lines;
+}
+
+void FootprintBuilder::finish() {
+  FP.ReadLines = countLines(Reads);
+  FP.WrittenLines = countLines(Writes);
+}
+
+TransactionalFootprintInfo::TransactionalFootprintInfo(
+    Function &F, ScalarEvolution &SE, MemorySSA &MSSA, LoopInfo &LI,
+    DominatorTree &DT, const TargetTransformInfo &TTI,
+    const TargetLibraryInfo &TLI)
+    : F(F), SE(SE), MSSA(MSSA), LI(LI), DT(DT), TLI(TLI) {
+  using CacheLevel = TargetTransformInfo::CacheLevel;
+  CacheLineSize = TTI.getCacheLineSize();
+  if (!CacheLineSize)
+    CacheLineSize = 64;
+
+  // Writes are tracked in the L1 data cache. Reads can usually spill out of
+  // it into some secondary tracking structure, which we approximate with the
+  // L2.
+  MaxWrittenLines = MaxWrittenLinesOpt;
+  if (!MaxWrittenLines)
+    MaxWrittenLines =
+        TTI.getCacheSize(CacheLevel::L1D).getValueOr(32 * 1024) / CacheLineSize;
+  MaxReadLines = MaxReadLinesOpt;
+  if (!MaxReadLines)
+    MaxReadLines = TTI.getCacheSize(CacheLevel::L2D).getValueOr(256 * 1024) /
+                   CacheLineSize;
+}
+
+/// Return true if the inline assembly \p IA contains an instruction that
+/// aborts transactions.
+static bool hasAbortingAsm(const InlineAsm &IA) {
+  SmallVector<StringRef, 4> Lines, Stmts;
+  StringRef(IA.getAsmString()).split(Lines, '\n');
+  for (StringRef Line : Lines)
+    Line.split(Stmts, ';');
+  for (StringRef Stmt : Stmts) {
+    StringRef Mnemonic = Stmt.trim().split(' ').first.split('\t').first;
+    if (StringSwitch<bool>(Mnemonic.lower())
+            .Cases("syscall", "sysenter", "int", "int3", "cpuid", true)
+            .Cases("in", "inb", "inw", "inl", "out", "outb", "outw", "outl",
+                   true)
+            .Cases("hlt", "ud2", "xabort", true)
+            .Default(false))
+      return true;
+  }
+  return false;
+}
+
+bool TransactionalFootprintInfo::isAbortingInstruction(
+    const Instruction &I) const {
+  ImmutableCallSite CS(&I);
+  if (!CS)
+    return false;
+  if (CS.isInlineAsm())
+    return hasAbortingAsm(*cast<InlineAsm>(CS.getCalledValue()));
+
+  const Function *Callee = CS.getCalledFunction();
+  if (!Callee)
+    return false;
+  switch (Callee->getIntrinsicID()) {
+  case Intrinsic::htm_abort:
+  case Intrinsic::x86_xabort:
+  case Intrinsic::trap:
+  case Intrinsic::debugtrap:
+    return true;
+  case Intrinsic::not_intrinsic:
+    break;
+  default:
+    return false;
+  }
+
+  // Library functions that always enter the kernel.
+  LibFunc Func;
+  if (TLI.getLibFunc(*Callee, Func)) {
+    switch (Func) {
+    case LibFunc_access: case LibFunc_chmod: case LibFunc_chown:
+    case LibFunc_closedir: case LibFunc_fclose: case LibFunc_fflush:
+    case LibFunc_fopen: case LibFunc_fopen64: case LibFunc_fstat:
+    case LibFunc_fstat64: case LibFunc_lchown: case LibFunc_lstat:
+    case LibFunc_lstat64: case LibFunc_mkdir: case LibFunc_open:
+    case LibFunc_open64: case LibFunc_opendir: case LibFunc_pclose:
+    case LibFunc_perror: case LibFunc_popen: case LibFunc_pread:
+    case LibFunc_pwrite: case LibFunc_read: case LibFunc_readlink:
+    case LibFunc_remove: case LibFunc_rename: case LibFunc_rmdir:
+    case LibFunc_stat: case LibFunc_stat64: case LibFunc_system:
+    case LibFunc_times: case LibFunc_uname: case LibFunc_unlink:
+    case LibFunc_utime: case LibFunc_utimes: case LibFunc_write:
+      return true;
+    default:
+      return false;
+    }
+  }
+  return StringSwitch<bool>(Callee->getName())
+      .Cases("syscall", "sched_yield", "nanosleep", "usleep", "sleep", true)
+      .Default(false);
+}
+
+TransactionalFootprint TransactionalFootprintInfo::getFootprint(
+    const Instruction *Begin, ArrayRef<const Instruction *> Ends) const {
+  TransactionalFootprint FP;
+
+  // Branches on the status returned by the start of the transaction only
+  // continue the region on the side where the transaction started.
+  const Value *Status = isTransactionBegin(*Begin) ? Begin : nullptr;
+  auto StartedSucc = [&](const BasicBlock *BB) -> const BasicBlock * {
+    ICmpInst::Predicate Pred;
+    auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+    if (!Status || !BI || !BI->isConditional() ||
+        !match(BI->getCondition(),
+               m_ICmp(Pred, m_Specific(Status), m_AllOnes())) ||
+        !ICmpInst::isEquality(Pred))
+      return nullptr;
+    return BI->getSuccessor(Pred == ICmpInst::ICMP_EQ ? 0 : 1);
+  };
+
+  // Collect the parts of the blocks executed between Begin and the Ends.
+  SmallVector<RegionSegment, 8> Segments;
+  SmallPtrSet<const BasicBlock *, 8> RegionBlocks;
+  SmallVector<std::pair<const BasicBlock *, BasicBlock::const_iterator>, 8>
+      Worklist;
+  Worklist.push_back({Begin->getParent(), std::next(Begin->getIterator())});
+  RegionBlocks.insert(Begin->getParent());
+  while (!Worklist.empty()) {
+    const BasicBlock *BB = Worklist.back().first;
+    BasicBlock::const_iterator It = Worklist.pop_back_val().second, E = It;
+    bool Exits = false;
+    for (; E != BB->end() && !Exits; ++E) {
+      if (is_contained(Ends, &*E))
+        break;
+      // Execution does not continue past an explicit abort.
+      Exits = isTransactionAbort(*E);
+    }
+    Exits |= E != BB->end();
+    Segments.push_back({BB, It, E});
+    if (Exits)
+      continue;
+    auto Visit = [&](const BasicBlock *Succ) {
+      if (RegionBlocks.insert(Succ).second)
+        Worklist.push_back({Succ, Succ->begin()});
+    };
+    if (const BasicBlock *Succ = StartedSucc(BB))
+      Visit(Succ);
+    else
+      for (const BasicBlock *Succ : successors(BB))
+        Visit(Succ);
+  }
+
+  FootprintBuilder Builder(SE, MSSA, LI, *this, RegionBlocks, FP);
+  for (RegionSegment &Seg : Segments)
+    for (const Instruction &I : make_range(Seg.Begin, Seg.End))
+      Builder.visit(I);
+  Builder.finish();
+
+  FP.AlwaysAborts =
+      !Ends.empty() && any_of(FP.AbortingInsts, [&](const Instruction *I) {
+        return all_of(Ends, [&](const Instruction *End) {
+          return DT.dominates(I, End);
+        });
+      });
+  return FP;
+}
+
+bool TransactionalFootprintInfo::isCertainToAbort(
+    const TransactionalFootprint &FP) const {
+  return FP.AlwaysAborts || FP.ReadLines > MaxReadLines ||
+         FP.WrittenLines > MaxWrittenLines;
+}
+
+void TransactionalFootprintInfo::print(raw_ostream &OS) const {
+  SmallVector<const Instruction *, 4> Begins, Ends;
+  for (const Instruction &I : instructions(F)) {
+    if (isTransactionBegin(I))
+      Begins.push_back(&I);
+    else if (isTransactionCommit(I))
+      Ends.push_back(&I);
+  }
+
+  OS << "Transactional footprint for function: " << F.getName() << "\n";
+  for (const Instruction *Begin : Begins) {
+    TransactionalFootprint FP = getFootprint(Begin, Ends);
+    OS << "  Region at:" << *Begin << "\n"
+       << "    read lines: " << FP.ReadLines
+       << ", written lines: " << FP.WrittenLines
+       << (FP.Unbounded ? " (lower bound)" : "") << "\n";
+    for (const Instruction *I : FP.AbortingInsts)
+      OS << "    aborts at:" << *I << "\n";
+    if (isCertainToAbort(FP))
+      OS << "    certain to abort\n";
+  }
+}
+
+bool TransactionalFootprintInfo::invalidate(
+    Function &F, const PreservedAnalyses &PA,
+    FunctionAnalysisManager::Invalidator &Inv) {
+  auto PAC = PA.getChecker<TransactionalFootprintAnalysis>();
+  return !(PAC.preserved() || PAC.preservedSet<AllAnalysesOn<Function>>()) ||
+         Inv.invalidate<ScalarEvolutionAnalysis>(F, PA) ||
+         Inv.invalidate<MemorySSAAnalysis>(F, PA) ||
+         Inv.invalidate<LoopAnalysis>(F, PA) ||
+         Inv.invalidate<DominatorTreeAnalysis>(F, PA);
+}
+
+AnalysisKey TransactionalFootprintAnalysis::Key;
+
+TransactionalFootprintInfo
+TransactionalFootprintAnalysis::run(Function &F, FunctionAnalysisManager &AM) {
+  return TransactionalFootprintInfo(
+      F, AM.getResult<ScalarEvolutionAnalysis>(F),
+      AM.getResult<MemorySSAAnalysis>(F).getMSSA(),
+      AM.getResult<LoopAnalysis>(F), AM.getResult<DominatorTreeAnalysis>(F),
+      AM.getResult<TargetIRAnalysis>(F),
+      AM.getResult<TargetLibraryAnalysis>(F));
+}
+
+PreservedAnalyses
+TransactionalFootprintPrinterPass::run(Function &F,
+                                       FunctionAnalysisManager &AM) {
+  AM.getResult<TransactionalFootprintAnalysis>(F).print(OS);
+  return PreservedAnalyses::all();
+}
+
+char TransactionalFootprintWrapperPass::ID = 0;
+INITIALIZE_PASS_BEGIN(TransactionalFootprintWrapperPass, "tx-footprint",
+                      "Transactional Footprint Analysis", false, true)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MemorySSAWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_END(TransactionalFootprintWrapperPass, "tx-footprint",
+                    "Transactional Footprint Analysis", false, true)
+
+TransactionalFootprintWrapperPass::TransactionalFootprintWrapperPass()
+    : FunctionPass(ID) {
+  initializeTransactionalFootprintWrapperPassPass(
+      *PassRegistry::getPassRegistry());
+}
+
+bool TransactionalFootprintWrapperPass::runOnFunction(Function &F) {
+  TFI.reset(new TransactionalFootprintInfo(
+      F, getAnalysis<ScalarEvolutionWrapperPass>().getSE(),
+      getAnalysis<MemorySSAWrapperPass>().getMSSA(),
+      getAnalysis<LoopInfoWrapperPass>().getLoopInfo(),
+      getAnalysis<DominatorTreeWrapperPass>().getDomTree(),
+      getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F),
+      getAnalysis<TargetLibraryInfoWrapperPass>().getTLI()));
+  return false;
+}
+
+void TransactionalFootprintWrapperPass::getAnalysisUsage(
+    AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequiredTransitive<DominatorTreeWrapperPass>();
+  AU.addRequiredTransitive<LoopInfoWrapperPass>();
+  AU.addRequiredTransitive<MemorySSAWrapperPass>();
+  AU.addRequiredTransitive<ScalarEvolutionWrapperPass>();
+  AU.addRequiredTransitive<TargetLibraryInfoWrapperPass>();
+  AU.addRequired<TargetTransformInfoWrapperPass>();
+}
+
+void TransactionalFootprintWrapperPass::releaseMemory() { TFI.reset(); }
+
+void TransactionalFootprintWrapperPass::print(raw_ostream &OS,
+                                              const Module *) const {
+  TFI->print(OS);
+}
@@ -28,6 +28,7 @@
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/GuardUtils.h"
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/Loads.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
@@ -64,6 +65,7 @@
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/KnownBits.h"
 #include "llvm/Support/MathExtras.h"
@@ -84,6 +86,14 @@ const unsigned MaxDepth = 6;
 static cl::opt<unsigned> DomConditionsMaxUses("dom-conditions-max-uses",
                                               cl::Hidden, cl::init(20));
 
+// Recompute the known bits read from a KnownBitsCache, and check that they
+// agree with the cached ones.
+static cl::opt<bool>
+    VerifyKnownBitsCache("verify-known-bits-cache", cl::Hidden,
+                         cl::desc("Verify the results read from the known "
+                                  "bits cache"),
+                         cl::init(false));
+
 /// Returns the bitwidth of the given scalar or pointer type. For vector types,
 /// returns the element type's bitwidth.
 static unsigned getBitWidth(Type *Ty, const DataLayout &DL) {
@@ -124,14 +134,24 @@ struct Query {
 
   unsigned NumExcluded = 0;
 
+  /// The cache memoizing the known bits and sign bits computed for the query,
+  /// if any.
+  KnownBitsCache *KBC;
+
+  /// Set when the result of the value being computed depends on the context
+  /// instruction, and so cannot be cached.
+  mutable bool UsesContext = false;
+
   Query(const DataLayout &DL, AssumptionCache *AC, const Instruction *CxtI,
         const DominatorTree *DT, bool UseInstrInfo,
-        OptimizationRemarkEmitter *ORE = nullptr)
-      : DL(DL), AC(AC), CxtI(CxtI), DT(DT), ORE(ORE), IIQ(UseInstrInfo) {}
+        OptimizationRemarkEmitter *ORE = nullptr,
+        KnownBitsCache *KBC = nullptr)
+      : DL(DL), AC(AC), CxtI(CxtI), DT(DT), ORE(ORE), IIQ(UseInstrInfo),
+        KBC(KBC) {}
 
   Query(const Query &Q, const Value *NewExcl)
       : DL(Q.DL), AC(Q.AC), CxtI(Q.CxtI), DT(Q.DT), ORE(Q.ORE), IIQ(Q.IIQ),
-        NumExcluded(Q.NumExcluded) {
+        NumExcluded(Q.NumExcluded), KBC(Q.KBC) {
     Excluded = Q.Excluded;
     Excluded[NumExcluded++] = NewExcl;
     assert(NumExcluded <= Excluded.size());
@@ -143,6 +163,17 @@ struct Query {
     auto End = Excluded.begin() + NumExcluded;
     return std::find(Excluded.begin(), End, Value) != End;
   }
+
+  /// Return the cache to memoize the results for V in, if any. The cached
+  /// results must not depend on metadata being usable or not, nor on the
+  /// assumptions that are known.
+  KnownBitsCache *getCache(const Value *V) const {
+    if (!KBC || !IIQ.UseInstrInfo || AC != &KBC->getAssumptionCache())
+      return nullptr;
+    if (const auto *I = dyn_cast<Instruction>(V))
+      return I->getParent() ? KBC : nullptr;
+    return isa<Argument>(V) ? KBC : nullptr;
+  }
 };
 
 } // end anonymous namespace
@@ -170,9 +201,11 @@ void llvm::computeKnownBits(const Value *V, KnownBits &Known,
                             const DataLayout &DL, unsigned Depth,
                             AssumptionCache *AC, const Instruction *CxtI,
                             const DominatorTree *DT,
-                            OptimizationRemarkEmitter *ORE, bool UseInstrInfo) {
-  ::computeKnownBits(V, Known, Depth,
-                     Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo, ORE));
+                            OptimizationRemarkEmitter *ORE, bool UseInstrInfo,
+                            KnownBitsCache *KBC) {
+  ::computeKnownBits(
+      V, Known, Depth,
+      Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo, ORE, KBC));
 }
 
 static KnownBits computeKnownBits(const Value *V, unsigned Depth,
@@ -183,9 +216,9 @@ KnownBits llvm::computeKnownBits(const Value *V, const DataLayout &DL,
                                  const Instruction *CxtI,
                                  const DominatorTree *DT,
                                  OptimizationRemarkEmitter *ORE,
-                                 bool UseInstrInfo) {
+                                 bool UseInstrInfo, KnownBitsCache *KBC) {
   return ::computeKnownBits(
-      V, Depth, Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo, ORE));
+      V, Depth, Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo, ORE, KBC));
 }
 
 bool llvm::haveNoCommonBitsSet(const Value *LHS, const Value *RHS,
@@ -290,9 +323,11 @@ static bool MaskedValueIsZero(const Value *V, const APInt &Mask, unsigned Depth,
 bool llvm::MaskedValueIsZero(const Value *V, const APInt &Mask,
                              const DataLayout &DL, unsigned Depth,
                              AssumptionCache *AC, const Instruction *CxtI,
-                             const DominatorTree *DT, bool UseInstrInfo) {
-  return ::MaskedValueIsZero(
-      V, Mask, Depth, Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo));
+                             const DominatorTree *DT, bool UseInstrInfo,
+                             KnownBitsCache *KBC) {
+  return ::MaskedValueIsZero(V, Mask, Depth,
+                             Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo,
+                                   /*ORE=*/nullptr, KBC));
 }
 
 static unsigned ComputeNumSignBits(const Value *V, unsigned Depth,
@@ -301,9 +336,11 @@ static unsigned ComputeNumSignBits(const Value *V, unsigned Depth,
 unsigned llvm::ComputeNumSignBits(const Value *V, const DataLayout &DL,
                                   unsigned Depth, AssumptionCache *AC,
                                   const Instruction *CxtI,
-                                  const DominatorTree *DT, bool UseInstrInfo) {
-  return ::ComputeNumSignBits(
-      V, Depth, Query(DL, AC, safeCxtI(V, CxtI), DT, UseInstrInfo));
+                                  const DominatorTree *DT, bool UseInstrInfo,
+                                  KnownBitsCache *KBC) {
+  return ::ComputeNumSignBits(V, Depth,
+                              Query(DL, AC, safeCxtI(V, CxtI), DT,
+                                    UseInstrInfo, /*ORE=*/nullptr, KBC));
 }
 
 static void computeKnownBitsAddSub(bool Add, const Value *Op0, const Value *Op1,
@@ -573,6 +610,11 @@ bool llvm::isValidAssumeForContext(const Instruction *Inv,
 
 static void computeKnownBitsFromAssume(const Value *V, KnownBits &Known,
                                        unsigned Depth, const Query &Q) {
+  // Whether the assumptions about V hold depends on the context, so the known
+  // bits of V cannot be cached if there are any.
+  if (Q.KBC && Q.AC && !Q.AC->assumptionsFor(V).empty())
+    Q.UsesContext = true;
+
   // Use of assumptions is context-sensitive. If we don't have a context, we
   // cannot use them!
   if (!Q.AC || !Q.CxtI)
@@ -1557,6 +1599,45 @@ KnownBits computeKnownBits(const Value *V, unsigned Depth, const Query &Q) {
   return Known;
 }
 
+static void computeKnownBitsImpl(const Value *V, KnownBits &Known,
+                                 unsigned Depth, const Query &Q);
+
+/// Compute the known bits of V, or read them from the known bits cache of the
+/// query. The results which do not depend on the context are added to it.
+void computeKnownBits(const Value *V, KnownBits &Known, unsigned Depth,
+                      const Query &Q) {
+  KnownBitsCache *KBC = Q.getCache(V);
+  if (!KBC) {
+    computeKnownBitsImpl(V, Known, Depth, Q);
+    return;
+  }
+
+  unsigned BitWidth = Known.getBitWidth();
+  (void)BitWidth;
+  if (KBC->lookupKnownBits(V, Depth, Known)) {
+    assert(Known.getBitWidth() == BitWidth && "Cached bits of another width!");
+    if (VerifyKnownBitsCache) {
+      Query Uncached(Q);
+      Uncached.KBC = nullptr;
+      KnownBits Computed(BitWidth);
+      computeKnownBitsImpl(V, Computed, Depth, Uncached);
+      if (Known.Zero.intersects(Computed.One) ||
+          Known.One.intersects(Computed.Zero)) {
+        dbgs() << "Cached known bits of " << *V << " are out of date\n";
+        report_fatal_error("Broken known bits cache!");
+      }
+    }
+    return;
+  }
+
+  bool OuterUsesContext = Q.UsesContext;
+  Q.UsesContext = false;
+  computeKnownBitsImpl(V, Known, Depth, Q);
+  if (!Q.UsesContext && Depth < MaxDepth)
+    KBC->insertKnownBits(V, Depth, Known);
+  Q.UsesContext |= OuterUsesContext;
+}
+
 /// Determine which bits of V are known to be either zero or one and return
 /// them in the Known bit set.
 ///
@@ -1572,8 +1653,8 @@ KnownBits computeKnownBits(const Value *V, unsigned Depth, const Query &Q) {
 /// where V is a vector, known zero, and known one values are the
 /// same width as the vector element, and the bit is set only if it is true
 /// for all of the elements in the vector.
-void computeKnownBits(const Value *V, KnownBits &Known, unsigned Depth,
-                      const Query &Q) {
+static void computeKnownBitsImpl(const Value *V, KnownBits &Known,
+                                 unsigned Depth, const Query &Q) {
   assert(V && "No Value?");
   assert(Depth <= MaxDepth && "Limit Search Depth");
   unsigned BitWidth = Known.getBitWidth();
@@ -2013,6 +2094,7 @@ bool isKnownNonZero(const Value *V, unsigned Depth, const Query &Q) {
 
   // Check for recursive pointer simplifications.
   if (V->getType()->isPointerTy()) {
+    Q.UsesContext = true;
     if (isKnownNonNullFromDominatingCondition(V, Q.CxtI, Q.DT))
       return true;
 
@@ -2268,8 +2350,18 @@ static unsigned ComputeNumSignBitsImpl(const Value *V, unsigned Depth,
 
 static unsigned ComputeNumSignBits(const Value *V, unsigned Depth,
                                    const Query &Q) {
+  KnownBitsCache *KBC = Q.getCache(V);
+  if (KBC)
+    if (unsigned Cached = KBC->lookupNumSignBits(V, Depth))
+      return Cached;
+
+  bool OuterUsesContext = Q.UsesContext;
+  Q.UsesContext = false;
   unsigned Result = ComputeNumSignBitsImpl(V, Depth, Q);
   assert(Result > 0 && "At least one sign bit needs to be present!");
+  if (KBC && !Q.UsesContext && Depth < MaxDepth)
+    KBC->insertNumSignBits(V, Depth, Result);
+  Q.UsesContext |= OuterUsesContext;
   return Result;
 }
 
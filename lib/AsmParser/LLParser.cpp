@@ -40,6 +40,7 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueArena.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/ErrorHandling.h"
@@ -5363,6 +5364,9 @@ bool LLParser::ParseFunctionBody(Function &Fn) {
 
   PerFunctionState PFS(*this, Fn, FunctionNumber);
 
+  // Allocate the body from the arena of the function, if it has one.
+  ValueArenaScope ArenaScope(Fn.getArena());
+
   // Resolve block addresses and allow basic blocks to be forward-declared
   // within this function.
   if (PFS.resolveForwardRefBlockAddresses())
@@ -59,6 +59,7 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueArena.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/AtomicOrdering.h"
 #include "llvm/Support/Casting.h"
@@ -71,14 +72,19 @@
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <system_error>
@@ -436,6 +442,14 @@ BitcodeReaderBase::readNameFromStrtab(ArrayRef<uint64_t> Record) {
   return {StringRef(Strtab.data() + Record[0], Record[1]), Record.slice(2)};
 }
 
+/// Return true if the global value named \p Name, read from the string table,
+/// may keep it as a borrowed name. Intrinsics are named at creation, which
+/// sets their attributes.
+static bool shouldBorrowName(LLVMContext &Context, StringRef Name) {
+  return Context.shouldBorrowBitcodeNames() && !Name.empty() &&
+         !Name.startswith("llvm.");
+}
+
 namespace {
 
 class BitcodeReader : public BitcodeReaderBase, public GVMaterializer {
@@ -546,6 +560,11 @@ public:
   void setStripDebugInfo() override;
 
 private:
+  /// Create a reader for the function bodies of the module read by \p Parent,
+  /// which parses them on another thread. It starts with copies of the
+  /// module-level types, values, attributes and metadata of \p Parent.
+  explicit BitcodeReader(BitcodeReader *Parent);
+
   std::vector<StructType *> IdentifiedStructTypes;
   StructType *createIdentifiedStructType(LLVMContext &Context, StringRef Name);
   StructType *createIdentifiedStructType(LLVMContext &Context);
@@ -672,6 +691,10 @@ private:
   Error rememberAndSkipMetadata();
   Error typeCheckLoadStoreInst(Type *ValType, Type *PtrType);
   Error parseFunctionBody(Function *F);
+  Error scanFunctionBody(BitstreamCursor &Cursor, bool &HasBlockAddresses,
+                         bool &HasUseLists);
+  void finishFunctionBody(Function *F);
+  Error materializeFunctionsInParallel();
   Error globalCleanup();
   Error resolveGlobalAndIndirectSymbolInits();
   Error parseUseLists();
@@ -779,6 +802,24 @@ BitcodeReader::BitcodeReader(BitstreamCursor Stream, StringRef Strtab,
   this->ProducerIdentification = ProducerIdentification;
 }
 
+BitcodeReader::BitcodeReader(BitcodeReader *Parent)
+    : BitcodeReaderBase(Parent->Stream, Parent->Strtab),
+      Context(Parent->Context), TheModule(Parent->TheModule),
+      TypeList(Parent->TypeList), ValueList(Context),
+      MAttributes(Parent->MAttributes), UseRelativeIDs(Parent->UseRelativeIDs),
+      WillMaterializeAllForwardRefs(true), BundleTags(Parent->BundleTags),
+      SSIDs(Parent->SSIDs) {
+  BlockInfo = Parent->BlockInfo;
+  UseStrtab = Parent->UseStrtab;
+  ProducerIdentification = Parent->ProducerIdentification;
+  // Track the values with new handles: copying those of Parent would splice
+  // them into the lists of handles without the lock of the context.
+  for (unsigned I = 0, E = Parent->ValueList.size(); I != E; ++I)
+    ValueList.push_back(Parent->ValueList[I]);
+  MDLoader = MetadataLoader(*Parent->MDLoader, Stream, ValueList,
+                            [&](unsigned ID) { return getTypeByID(ID); });
+}
+
 Error BitcodeReader::materializeForwardReferencedFunctions() {
   if (WillMaterializeAllForwardRefs)
     return Error::success();
@@ -2687,6 +2728,8 @@ Error BitcodeReader::rememberAndSkipMetadata() {
 }
 
 Error BitcodeReader::materializeMetadata() {
+  TimeTraceScope TimeScope("MaterializeMetadata",
+                           TheModule->getModuleIdentifier());
   for (uint64_t BitPos : DeferredMetadataInfo) {
     // Move the bit stream to the saved position.
     Stream.JumpToBit(BitPos);
@@ -2896,9 +2939,12 @@ Error BitcodeReader::parseGlobalVarRecord(ArrayRef<uint64_t> Record) {
   if (Record.size() > 9)
     ExternallyInitialized = Record[9];
 
-  GlobalVariable *NewGV =
-      new GlobalVariable(*TheModule, Ty, isConstant, Linkage, nullptr, Name,
-                         nullptr, TLM, AddressSpace, ExternallyInitialized);
+  bool BorrowName = UseStrtab && shouldBorrowName(Context, Name);
+  GlobalVariable *NewGV = new GlobalVariable(
+      *TheModule, Ty, isConstant, Linkage, nullptr, BorrowName ? "" : Name,
+      nullptr, TLM, AddressSpace, ExternallyInitialized);
+  if (BorrowName)
+    NewGV->setBorrowedName(Name);
   NewGV->setAlignment(Alignment);
   if (!Section.empty())
     NewGV->setSection(Section);
@@ -2965,8 +3011,12 @@ Error BitcodeReader::parseFunctionRecord(ArrayRef<uint64_t> Record) {
   if (Record.size() > 16)
     AddrSpace = Record[16];
 
-  Function *Func = Function::Create(FTy, GlobalValue::ExternalLinkage,
-                                    AddrSpace, Name, TheModule);
+  bool BorrowName = UseStrtab && shouldBorrowName(Context, Name);
+  Function *Func =
+      Function::Create(FTy, GlobalValue::ExternalLinkage, AddrSpace,
+                       BorrowName ? "" : Name, TheModule);
+  if (BorrowName)
+    Func->setBorrowedName(Name);
 
   Func->setCallingConv(CC);
   bool isProto = Record[2];
@@ -3071,14 +3121,17 @@ Error BitcodeReader::parseGlobalIndirectSymbolRecord(
 
   auto Val = Record[OpNum++];
   auto Linkage = Record[OpNum++];
+  bool BorrowName = UseStrtab && shouldBorrowName(Context, Name);
   GlobalIndirectSymbol *NewGA;
   if (BitCode == bitc::MODULE_CODE_ALIAS ||
       BitCode == bitc::MODULE_CODE_ALIAS_OLD)
-    NewGA = GlobalAlias::create(Ty, AddrSpace, getDecodedLinkage(Linkage), Name,
-                                TheModule);
+    NewGA = GlobalAlias::create(Ty, AddrSpace, getDecodedLinkage(Linkage),
+                                BorrowName ? "" : Name, TheModule);
   else
-    NewGA = GlobalIFunc::create(Ty, AddrSpace, getDecodedLinkage(Linkage), Name,
-                                nullptr, TheModule);
+    NewGA = GlobalIFunc::create(Ty, AddrSpace, getDecodedLinkage(Linkage),
+                                BorrowName ? "" : Name, nullptr, TheModule);
+  if (BorrowName)
+    NewGA->setBorrowedName(Name);
   // Old bitcode files didn't have visibility field.
   // Local linkage must have default visibility.
   if (OpNum != Record.size()) {
@@ -3355,8 +3408,10 @@ Error BitcodeReader::parseModule(uint64_t ResumeBit,
 
 Error BitcodeReader::parseBitcodeInto(Module *M, bool ShouldLazyLoadMetadata,
                                       bool IsImporting) {
+  TimeTraceScope TimeScope("ParseBitcode", M->getModuleIdentifier());
   TheModule = M;
   MDLoader = MetadataLoader(Stream, *M, ValueList, IsImporting,
+                            ShouldLazyLoadMetadata,
                             [&](unsigned ID) { return getTypeByID(ID); });
   return parseModule(0, ShouldLazyLoadMetadata);
 }
@@ -3383,6 +3438,9 @@ Error BitcodeReader::parseFunctionBody(Function *F) {
   if (MDLoader->hasFwdRefs())
     return error("Invalid function metadata: incoming forward references");
 
+  // Allocate the body from the arena of the function, if it has one.
+  ValueArenaScope ArenaScope(F->getArena());
+
   InstructionList.clear();
   unsigned ModuleValueListSize = ValueList.size();
   unsigned ModuleMDLoaderSize = MDLoader->size();
@@ -4700,6 +4758,7 @@ Error BitcodeReader::materialize(GlobalValue *GV) {
   if (!F || !F->isMaterializable())
     return Error::success();
 
+  TimeTraceScope TimeScope("MaterializeFunction", F->getName());
   DenseMap<Function*, uint64_t>::iterator DFII = DeferredFunctionInfo.find(F);
   assert(DFII != DeferredFunctionInfo.end() && "Deferred function not found!");
   // If its position is recorded as 0, its body is somewhere in the stream
@@ -4717,6 +4776,15 @@ Error BitcodeReader::materialize(GlobalValue *GV) {
 
   if (Error Err = parseFunctionBody(F))
     return Err;
+  finishFunctionBody(F);
+
+  // Bring in any functions that this function forward-referenced via
+  // blockaddresses.
+  return materializeForwardReferencedFunctions();
+}
+
+/// Upgrade and check the body of \p F once it is parsed.
+void BitcodeReader::finishFunctionBody(Function *F) {
   F->setIsMaterializable(false);
 
   if (StripDebugInfo)
@@ -4754,10 +4822,129 @@ Error BitcodeReader::materialize(GlobalValue *GV) {
       stripTBAA(F->getParent());
     }
   }
+}
 
-  // Bring in any functions that this function forward-referenced via
-  // blockaddresses.
-  return materializeForwardReferencedFunctions();
+/// Check whether the function body at the position of \p Cursor takes the
+/// address of basic blocks, which may be in a function being parsed on another
+/// thread, or orders the uses of values, which include the constants shared by
+/// all the functions.
+Error BitcodeReader::scanFunctionBody(BitstreamCursor &Cursor,
+                                      bool &HasBlockAddresses,
+                                      bool &HasUseLists) {
+  if (Cursor.EnterSubBlock(bitc::FUNCTION_BLOCK_ID))
+    return error("Invalid record");
+
+  bool InConstants = false;
+  while (true) {
+    BitstreamEntry Entry = Cursor.advance();
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      if (!InConstants)
+        return Error::success();
+      InConstants = false;
+      break;
+    case BitstreamEntry::SubBlock:
+      if (Entry.ID == bitc::USELIST_BLOCK_ID)
+        HasUseLists = true;
+      if (Entry.ID == bitc::CONSTANTS_BLOCK_ID && !InConstants) {
+        if (Cursor.EnterSubBlock(Entry.ID))
+          return error("Invalid record");
+        InConstants = true;
+      } else if (Cursor.SkipBlock()) {
+        return error("Invalid record");
+      }
+      break;
+    case BitstreamEntry::Record:
+      if (Cursor.skipRecord(Entry.ID) == bitc::CST_CODE_BLOCKADDRESS &&
+          InConstants)
+        HasBlockAddresses = true;
+      break;
+    }
+  }
+}
+
+/// Parse the bodies left to materialize on several threads, each with its own
+/// BitcodeReader for the tables that grow while parsing a body. The bodies
+/// that take the address of blocks, and the functions whose blocks have their
+/// address taken by module-level constants, are left to materialize().
+Error BitcodeReader::materializeFunctionsInParallel() {
+  // The module-level metadata loaded on demand is only read on this thread.
+  if (MDLoader->isLazyLoading())
+    return Error::success();
+
+  std::vector<std::pair<Function *, uint64_t>> Bodies;
+  for (Function &F : *TheModule) {
+    if (!F.isMaterializable() || BasicBlockFwdRefs.count(&F))
+      continue;
+    auto DFII = DeferredFunctionInfo.find(&F);
+    assert(DFII != DeferredFunctionInfo.end() &&
+           "Deferred function not found!");
+    if (DFII->second == 0)
+      if (Error Err = findFunctionInStream(&F, DFII))
+        return Err;
+    Bodies.push_back({&F, DFII->second});
+  }
+  if (Bodies.size() < 2)
+    return Error::success();
+
+  TimeTraceScope TimeScope("MaterializeFunctionsInParallel",
+                           TheModule->getModuleIdentifier());
+  unsigned NumThreads =
+      std::min<size_t>(heavyweight_hardware_concurrency(), Bodies.size());
+  std::mutex ErrMutex;
+  Error Err = Error::success();
+  auto addError = [&](Error E) {
+    std::lock_guard<std::mutex> Lock(ErrMutex);
+    Err = joinErrors(std::move(Err), std::move(E));
+  };
+
+  // Find the bodies to leave to this thread.
+  std::vector<char> IsSerial(Bodies.size());
+  std::atomic<bool> HasUseLists(false);
+  std::atomic<size_t> NextBody(0);
+  parallel::for_each_n(parallel::par, 0u, NumThreads, [&](unsigned) {
+    BitstreamCursor Cursor = Stream;
+    for (size_t I = NextBody++; I < Bodies.size(); I = NextBody++) {
+      Cursor.JumpToBit(Bodies[I].second);
+      bool BodyHasBlockAddresses = false, BodyHasUseLists = false;
+      if (Error E = scanFunctionBody(Cursor, BodyHasBlockAddresses,
+                                     BodyHasUseLists))
+        addError(std::move(E));
+      IsSerial[I] = BodyHasBlockAddresses;
+      if (BodyHasUseLists)
+        HasUseLists = true;
+    }
+  });
+  if (Err)
+    return Err;
+  // Parsing the bodies in any order would scramble the use lists they order.
+  if (HasUseLists)
+    return Error::success();
+
+  std::vector<char> IsParsed(Bodies.size());
+  NextBody = 0;
+  parallel::for_each_n(parallel::par, 0u, NumThreads, [&](unsigned) {
+    BitcodeReader Worker(this);
+    for (size_t I = NextBody++; I < Bodies.size(); I = NextBody++) {
+      if (IsSerial[I])
+        continue;
+      Worker.Stream.JumpToBit(Bodies[I].second);
+      if (Error E = Worker.parseFunctionBody(Bodies[I].first))
+        addError(std::move(E));
+      else
+        IsParsed[I] = true;
+    }
+  });
+  if (Err)
+    return Err;
+
+  // Upgrade the bodies here, as it walks the users of the functions.
+  for (size_t I = 0, E = Bodies.size(); I != E; ++I)
+    if (IsParsed[I])
+      finishFunctionBody(Bodies[I].first);
+  return Error::success();
 }
 
 Error BitcodeReader::materializeModule() {
@@ -4767,6 +4954,10 @@ Error BitcodeReader::materializeModule() {
   // Promise to materialize all forward references.
   WillMaterializeAllForwardRefs = true;
 
+  if (Context.shouldMaterializeBitcodeInParallel())
+    if (Error Err = materializeFunctionsInParallel())
+      return Err;
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Function &F : *TheModule) {
@@ -5855,6 +6046,43 @@ Expected<BitcodeLTOInfo> BitcodeModule::getLTOInfo() {
   }
 }
 
+Expected<StringMap<uint64_t>> BitcodeModule::getFunctionHashes() {
+  BitstreamCursor Stream(Buffer);
+  Stream.JumpToBit(ModuleBit);
+
+  if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
+    return error("Invalid record");
+
+  StringMap<uint64_t> Hashes;
+  SmallVector<uint64_t, 3> Record;
+  while (true) {
+    BitstreamEntry Entry = Stream.advance();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return std::move(Hashes);
+
+    case BitstreamEntry::SubBlock:
+      if (Stream.SkipBlock())
+        return error("Malformed block");
+      continue;
+
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    // FUNCTION_HASH: [strtab offset, strtab size, hash]
+    if (Stream.readRecord(Entry.ID, Record) != bitc::MODULE_CODE_FUNCTION_HASH)
+      continue;
+    if (Record.size() != 3 || Record[0] + Record[1] > Strtab.size())
+      return error("Invalid record");
+    Hashes[Strtab.substr(Record[0], Record[1])] = Record[2];
+  }
+}
+
 static Expected<BitcodeModule> getSingleModule(MemoryBufferRef Buffer) {
   Expected<std::vector<BitcodeModule>> MsOrErr = getBitcodeModuleList(Buffer);
   if (!MsOrErr)
@@ -5936,6 +6164,15 @@ Error llvm::readModuleSummaryIndex(MemoryBufferRef Buffer,
   return BM->readSummary(CombinedIndex, BM->getModuleIdentifier(), ModuleId);
 }
 
+Expected<StringMap<uint64_t>>
+llvm::getBitcodeFunctionHashes(MemoryBufferRef Buffer) {
+  Expected<BitcodeModule> BM = getSingleModule(Buffer);
+  if (!BM)
+    return BM.takeError();
+
+  return BM->getFunctionHashes();
+}
+
 Expected<std::unique_ptr<ModuleSummaryIndex>>
 llvm::getModuleSummaryIndex(MemoryBufferRef Buffer) {
   Expected<BitcodeModule> BM = getSingleModule(Buffer);
@@ -459,6 +459,10 @@ class MetadataLoader::MetadataLoaderImpl {
   /// True if metadata is being parsed for a module being ThinLTO imported.
   bool IsImporting = false;
 
+  /// True if the module-level metadata is loaded on demand, as the functions
+  /// using it are materialized, rather than all at once.
+  bool ShouldLazyLoad = false;
+
   Error parseOneMetadata(SmallVectorImpl<uint64_t> &Record, unsigned Code,
                          PlaceholderQueue &Placeholders, StringRef Blob,
                          unsigned &NextMetadataNo);
@@ -625,15 +629,40 @@ public:
   MetadataLoaderImpl(BitstreamCursor &Stream, Module &TheModule,
                      BitcodeReaderValueList &ValueList,
                      std::function<Type *(unsigned)> getTypeByID,
-                     bool IsImporting)
+                     bool IsImporting, bool ShouldLazyLoad)
       : MetadataList(TheModule.getContext()), ValueList(ValueList),
         Stream(Stream), Context(TheModule.getContext()), TheModule(TheModule),
-        getTypeByID(std::move(getTypeByID)), IsImporting(IsImporting) {}
+        getTypeByID(std::move(getTypeByID)), IsImporting(IsImporting),
+        ShouldLazyLoad(ShouldLazyLoad) {}
+
+  /// Copy the module-level state of \p Parent. The global variables were
+  /// upgraded along with the module-level metadata, so they are not upgraded
+  /// again from the function-level metadata, which would modify them on
+  /// several threads.
+  MetadataLoaderImpl(const MetadataLoaderImpl &Parent, BitstreamCursor &Stream,
+                     BitcodeReaderValueList &ValueList,
+                     std::function<Type *(unsigned)> getTypeByID)
+      : MetadataList(Parent.Context), ValueList(ValueList), Stream(Stream),
+        Context(Parent.Context), TheModule(Parent.TheModule),
+        getTypeByID(std::move(getTypeByID)), MDKindMap(Parent.MDKindMap),
+        StripTBAA(Parent.StripTBAA),
+        HasSeenOldLoopTags(Parent.HasSeenOldLoopTags),
+        NeedDeclareExpressionUpgrade(Parent.NeedDeclareExpressionUpgrade),
+        IsImporting(Parent.IsImporting) {
+    assert(!Parent.isLazyLoading() && !Parent.hasFwdRefs() &&
+           "Module-level metadata is not fully loaded");
+    for (unsigned I = 0, E = Parent.MetadataList.size(); I != E; ++I)
+      MetadataList.push_back(Parent.MetadataList[I]);
+  }
 
   Error parseMetadata(bool ModuleLevel);
 
   bool hasFwdRefs() const { return MetadataList.hasFwdRefs(); }
 
+  bool isLazyLoading() const {
+    return !MDStringRef.empty() || !GlobalMetadataBitPosIndex.empty();
+  }
+
   Metadata *getMetadataFwdRefOrLoad(unsigned ID) {
     if (ID < MDStringRef.size())
       return lazyLoadOneMDString(ID);
@@ -651,6 +680,10 @@ public:
   }
 
   MDNode *getMDNodeFwdRefOrNull(unsigned Idx) {
+    // Load the scopes of the debug locations of a function body along with
+    // the body, since the body may have no attachment to load them.
+    if (Idx < MDStringRef.size() + GlobalMetadataBitPosIndex.size())
+      return dyn_cast_or_null<MDNode>(getMetadataFwdRefOrLoad(Idx));
     return MetadataList.getMDNodeFwdRefOrNull(Idx);
   }
 
@@ -857,7 +890,9 @@ Error MetadataLoader::MetadataLoaderImpl::parseMetadata(bool ModuleLevel) {
 
   // We lazy-load module-level metadata: we build an index for each record, and
   // then load individual record as needed, starting with the named metadata.
-  if (ModuleLevel && IsImporting && MetadataList.empty() &&
+  // The metadata used by a single function is in the block of the function,
+  // so it is only loaded when the function is materialized.
+  if (ModuleLevel && (IsImporting || ShouldLazyLoad) && MetadataList.empty() &&
       !DisableLazyLoading) {
     auto SuccessOrErr = lazyLoadModuleMetadataBlock();
     if (!SuccessOrErr)
@@ -1970,10 +2005,17 @@ MetadataLoader::MetadataLoader(MetadataLoader &&RHS)
 MetadataLoader::~MetadataLoader() = default;
 MetadataLoader::MetadataLoader(BitstreamCursor &Stream, Module &TheModule,
                                BitcodeReaderValueList &ValueList,
-                               bool IsImporting,
+                               bool IsImporting, bool ShouldLazyLoad,
                                std::function<Type *(unsigned)> getTypeByID)
     : Pimpl(llvm::make_unique<MetadataLoaderImpl>(
-          Stream, TheModule, ValueList, std::move(getTypeByID), IsImporting)) {}
+          Stream, TheModule, ValueList, std::move(getTypeByID), IsImporting,
+          ShouldLazyLoad)) {}
+MetadataLoader::MetadataLoader(const MetadataLoader &Parent,
+                               BitstreamCursor &Stream,
+                               BitcodeReaderValueList &ValueList,
+                               std::function<Type *(unsigned)> getTypeByID)
+    : Pimpl(llvm::make_unique<MetadataLoaderImpl>(
+          *Parent.Pimpl, Stream, ValueList, std::move(getTypeByID))) {}
 
 Error MetadataLoader::parseMetadata(bool ModuleLevel) {
   return Pimpl->parseMetadata(ModuleLevel);
@@ -1981,6 +2023,8 @@ Error MetadataLoader::parseMetadata(bool ModuleLevel) {
 
 bool MetadataLoader::hasFwdRefs() const { return Pimpl->hasFwdRefs(); }
 
+bool MetadataLoader::isLazyLoading() const { return Pimpl->isLazyLoading(); }
+
 /// Return the given metadata, creating a replaceable forward reference if
 /// necessary.
 Metadata *MetadataLoader::getMetadataFwdRefOrLoad(unsigned Idx) {
@@ -40,8 +40,18 @@ class MetadataLoader {
 
 public:
   ~MetadataLoader();
+  /// Create a loader for the metadata of \p TheModule. If \p ShouldLazyLoad
+  /// is true, the module-level metadata is indexed and each node is loaded
+  /// when first used, such as by a function being materialized.
   MetadataLoader(BitstreamCursor &Stream, Module &TheModule,
                  BitcodeReaderValueList &ValueList, bool IsImporting,
+                 bool ShouldLazyLoad,
+                 std::function<Type *(unsigned)> getTypeByID);
+  /// Create a loader for the function-level metadata read from \p Stream on
+  /// another thread than \p Parent, starting with a copy of the module-level
+  /// metadata loaded by \p Parent.
+  MetadataLoader(const MetadataLoader &Parent, BitstreamCursor &Stream,
+                 BitcodeReaderValueList &ValueList,
                  std::function<Type *(unsigned)> getTypeByID);
   MetadataLoader &operator=(MetadataLoader &&);
   MetadataLoader(MetadataLoader &&);
@@ -61,6 +71,9 @@ public:
   // Return true there are remaining unresolved forward references.
   bool hasFwdRefs() const;
 
+  /// Return true if the module-level metadata is loaded on demand.
+  bool isLazyLoading() const;
+
   /// Return the given metadata, creating a replaceable forward reference if
   /// necessary.
   Metadata *getMetadataFwdRefOrLoad(unsigned Idx);
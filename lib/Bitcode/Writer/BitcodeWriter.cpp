@@ -53,9 +53,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/IR/StructuralHash.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/UseListOrder.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueArena.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/MC/StringTableBuilder.h"
 #include "llvm/Object/IRSymtab.h"
@@ -153,8 +155,11 @@ protected:
   /// The Module to write to bitcode.
   const Module &M;
 
+  /// The enumerator created by the writer, unless it shares one.
+  std::unique_ptr<ValueEnumerator> OwnedVE;
+
   /// Enumerates ids for all values in the module.
-  ValueEnumerator VE;
+  ValueEnumerator &VE;
 
   /// Optional per-module index to write for ThinLTO.
   const ModuleSummaryIndex *Index;
@@ -179,7 +184,9 @@ public:
                           bool ShouldPreserveUseListOrder,
                           const ModuleSummaryIndex *Index)
       : BitcodeWriterBase(Stream, StrtabBuilder), M(M),
-        VE(M, ShouldPreserveUseListOrder), Index(Index) {
+        OwnedVE(llvm::make_unique<ValueEnumerator>(M,
+                                                   ShouldPreserveUseListOrder)),
+        VE(*OwnedVE), Index(Index) {
     // Assign ValueIds to any callee values in the index that came from
     // indirect call profiles and were recorded as a GUID not a Value*
     // (which would have been assigned an ID by the ValueEnumerator).
@@ -201,6 +208,14 @@ public:
               assignValueId(CallEdge.first.getGUID());
   }
 
+  /// Constructs a ModuleBitcodeWriterBase object for the given Module, using
+  /// the IDs of \p VE.
+  ModuleBitcodeWriterBase(const Module &M, ValueEnumerator &VE,
+                          StringTableBuilder &StrtabBuilder,
+                          BitstreamWriter &Stream)
+      : BitcodeWriterBase(Stream, StrtabBuilder), M(M), VE(VE), Index(nullptr),
+        GlobalValueId(VE.getValues().size()) {}
+
 protected:
   void writePerModuleGlobalValueSummary();
 
@@ -250,11 +265,25 @@ class ModuleBitcodeWriter : public ModuleBitcodeWriterBase {
   /// into ModHash.
   ModuleHash *ModHash;
 
+  /// True if the structural hash of each function should be written.
+  bool GenerateFunctionHashes = false;
+
   SHA1 Hasher;
 
   /// The start bit of the identification block.
   uint64_t BitcodeStartBit;
 
+  /// The function blocks encoded by a StreamingBitcodeWriter, and their bit
+  /// ranges in it.
+  const SmallVectorImpl<char> *StreamedBuffer = nullptr;
+  const StreamedFunctionMap *StreamedFunctions = nullptr;
+
+  /// The section and GC name IDs, and the abbrev of the simple global
+  /// variables, used by the module-level records.
+  std::map<std::string, unsigned> SectionMap;
+  std::map<std::string, unsigned> GCMap;
+  unsigned SimpleGVarAbbrev = 0;
+
 public:
   /// Constructs a ModuleBitcodeWriter object for the given Module,
   /// writing to the provided \p Buffer.
@@ -262,15 +291,47 @@ public:
                       StringTableBuilder &StrtabBuilder,
                       BitstreamWriter &Stream, bool ShouldPreserveUseListOrder,
                       const ModuleSummaryIndex *Index, bool GenerateHash,
-                      ModuleHash *ModHash = nullptr)
+                      ModuleHash *ModHash = nullptr,
+                      bool GenerateFunctionHashes = false)
       : ModuleBitcodeWriterBase(M, StrtabBuilder, Stream,
                                 ShouldPreserveUseListOrder, Index),
         Buffer(Buffer), GenerateHash(GenerateHash), ModHash(ModHash),
+        GenerateFunctionHashes(GenerateFunctionHashes),
         BitcodeStartBit(Stream.GetCurrentBitNo()) {}
 
+  /// Constructs a ModuleBitcodeWriter object for the given Module, using the
+  /// IDs of \p VE, which were reserved for streaming. The blocks of the
+  /// functions in \p StreamedFunctions are copied from \p StreamedBuffer.
+  ModuleBitcodeWriter(const Module &M, ValueEnumerator &VE,
+                      SmallVectorImpl<char> &Buffer,
+                      StringTableBuilder &StrtabBuilder,
+                      BitstreamWriter &Stream,
+                      const SmallVectorImpl<char> *StreamedBuffer = nullptr,
+                      const StreamedFunctionMap *StreamedFunctions = nullptr)
+      : ModuleBitcodeWriterBase(M, VE, StrtabBuilder, Stream), Buffer(Buffer),
+        GenerateHash(false), ModHash(nullptr),
+        BitcodeStartBit(Stream.GetCurrentBitNo()),
+        StreamedBuffer(StreamedBuffer), StreamedFunctions(StreamedFunctions) {
+    assert(VE.isStreaming() && "Expected reserved IDs");
+  }
+
   /// Emit the current module to the bitstream.
   void write();
 
+  /// Enter the module block and emit the blockinfo, so that function blocks
+  /// can be streamed.
+  void writeStreamHeader() {
+    Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
+    writeBlockInfo();
+  }
+
+  /// Emit the block of \p F, returning its range of bits in the stream.
+  std::pair<uint64_t, uint64_t> writeStreamedFunction(const Function &F) {
+    DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
+    writeFunction(F, FunctionToBitcodeIndex);
+    return {FunctionToBitcodeIndex[&F], Stream.GetCurrentBitNo()};
+  }
+
 private:
   uint64_t bitcodeStartBit() { return BitcodeStartBit; }
 
@@ -282,6 +343,14 @@ private:
   void writeComdats();
   void writeValueSymbolTableForwardDecl();
   void writeModuleInfo();
+  void writeFunctionHashes();
+  void writeGlobalVariableRecord(const GlobalVariable &GV,
+                                 SmallVectorImpl<unsigned> &Vals);
+  void writeFunctionRecord(const Function &F, SmallVectorImpl<unsigned> &Vals);
+  void writeAliasRecord(const GlobalAlias &A, SmallVectorImpl<unsigned> &Vals);
+  void writeIFuncRecord(const GlobalIFunc &I, SmallVectorImpl<unsigned> &Vals);
+  void writeGlobalValueRecord(const GlobalValue &GV,
+                              SmallVectorImpl<unsigned> &Vals);
   void writeValueAsMetadata(const ValueAsMetadata *MD,
                             SmallVectorImpl<uint64_t> &Record);
   void writeMDTuple(const MDTuple *N, SmallVectorImpl<uint64_t> &Record,
@@ -367,6 +436,7 @@ private:
   void writeSyncScopeNames();
   void writeConstants(unsigned FirstVal, unsigned LastVal, bool isGlobal);
   void writeModuleConstants();
+  void writeReservedValues();
   bool pushValueAndType(const Value *V, unsigned InstID,
                         SmallVectorImpl<unsigned> &Vals);
   void writeOperandBundles(ImmutableCallSite CS, unsigned InstID);
@@ -384,6 +454,10 @@ private:
   void
   writeFunction(const Function &F,
                 DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
+  void copyStreamedFunction(
+      const Function &F, std::pair<uint64_t, uint64_t> Bits,
+      DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex);
+  BitCodeAbbrevOp getTypeIDAbbrevOp() const;
   void writeBlockInfo();
   void writeModuleHash(size_t BlockStartPos);
 
@@ -1122,8 +1196,6 @@ void ModuleBitcodeWriter::writeModuleInfo() {
 
   // Emit information about sections and GC, computing how many there are. Also
   // compute the maximum alignment value.
-  std::map<std::string, unsigned> SectionMap;
-  std::map<std::string, unsigned> GCMap;
   unsigned MaxAlignment = 0;
   unsigned MaxGlobalType = 0;
   for (const GlobalValue &GV : M.globals()) {
@@ -1162,7 +1234,6 @@ void ModuleBitcodeWriter::writeModuleInfo() {
   }
 
   // Emit abbrev for globals, now that we know # sections and max alignment.
-  unsigned SimpleGVarAbbrev = 0;
   if (!M.global_empty()) {
     // Add an abbrev for common globals with no visibility or thread localness.
     auto Abbv = std::make_shared<BitCodeAbbrev>();
@@ -1217,124 +1288,177 @@ void ModuleBitcodeWriter::writeModuleInfo() {
     Vals.clear();
   }
 
-  // Emit the global variable information.
-  for (const GlobalVariable &GV : M.globals()) {
-    unsigned AbbrevToUse = 0;
-
-    // GLOBALVAR: [strtab offset, strtab size, type, isconst, initid,
-    //             linkage, alignment, section, visibility, threadlocal,
-    //             unnamed_addr, externally_initialized, dllstorageclass,
-    //             comdat, attributes, DSO_Local]
-    Vals.push_back(addToStrtab(GV.getName()));
-    Vals.push_back(GV.getName().size());
-    Vals.push_back(VE.getTypeID(GV.getValueType()));
-    Vals.push_back(GV.getType()->getAddressSpace() << 2 | 2 | GV.isConstant());
-    Vals.push_back(GV.isDeclaration() ? 0 :
-                   (VE.getValueID(GV.getInitializer()) + 1));
-    Vals.push_back(getEncodedLinkage(GV));
-    Vals.push_back(Log2_32(GV.getAlignment())+1);
-    Vals.push_back(GV.hasSection() ? SectionMap[GV.getSection()] : 0);
-    if (GV.isThreadLocal() ||
-        GV.getVisibility() != GlobalValue::DefaultVisibility ||
-        GV.getUnnamedAddr() != GlobalValue::UnnamedAddr::None ||
-        GV.isExternallyInitialized() ||
-        GV.getDLLStorageClass() != GlobalValue::DefaultStorageClass ||
-        GV.hasComdat() ||
-        GV.hasAttributes() ||
-        GV.isDSOLocal()) {
-      Vals.push_back(getEncodedVisibility(GV));
-      Vals.push_back(getEncodedThreadLocalMode(GV));
-      Vals.push_back(getEncodedUnnamedAddr(GV));
-      Vals.push_back(GV.isExternallyInitialized());
-      Vals.push_back(getEncodedDLLStorageClass(GV));
-      Vals.push_back(GV.hasComdat() ? VE.getComdatID(GV.getComdat()) : 0);
-
-      auto AL = GV.getAttributesAsList(AttributeList::FunctionIndex);
-      Vals.push_back(VE.getAttributeListID(AL));
-
-      Vals.push_back(GV.isDSOLocal());
-    } else {
-      AbbrevToUse = SimpleGVarAbbrev;
+  if (VE.isStreaming()) {
+    // Emit the records of the global values in the order of their IDs: the
+    // ones created after the IDs were reserved follow the module constants.
+    for (const auto &V : VE.getValues()) {
+      auto *GV = dyn_cast<GlobalValue>(V.first);
+      if (!GV)
+        break;
+      writeGlobalValueRecord(*GV, Vals);
     }
+  } else {
+    // Emit the global variable information.
+    for (const GlobalVariable &GV : M.globals())
+      writeGlobalVariableRecord(GV, Vals);
 
-    Stream.EmitRecord(bitc::MODULE_CODE_GLOBALVAR, Vals, AbbrevToUse);
-    Vals.clear();
+    // Emit the function proto information.
+    for (const Function &F : M)
+      writeFunctionRecord(F, Vals);
+
+    // Emit the alias information.
+    for (const GlobalAlias &A : M.aliases())
+      writeAliasRecord(A, Vals);
+
+    // Emit the ifunc information.
+    for (const GlobalIFunc &I : M.ifuncs())
+      writeIFuncRecord(I, Vals);
   }
 
-  // Emit the function proto information.
+  writeValueSymbolTableForwardDecl();
+}
+
+void ModuleBitcodeWriter::writeFunctionHashes() {
+  // FUNCTION_HASH: [strtab offset, strtab size, hash]
+  SmallVector<uint64_t, 3> Vals;
   for (const Function &F : M) {
-    // FUNCTION:  [strtab offset, strtab size, type, callingconv, isproto,
-    //             linkage, paramattrs, alignment, section, visibility, gc,
-    //             unnamed_addr, prologuedata, dllstorageclass, comdat,
-    //             prefixdata, personalityfn, DSO_Local, addrspace]
+    if (F.isDeclaration() || !F.hasName())
+      continue;
     Vals.push_back(addToStrtab(F.getName()));
     Vals.push_back(F.getName().size());
-    Vals.push_back(VE.getTypeID(F.getFunctionType()));
-    Vals.push_back(F.getCallingConv());
-    Vals.push_back(F.isDeclaration());
-    Vals.push_back(getEncodedLinkage(F));
-    Vals.push_back(VE.getAttributeListID(F.getAttributes()));
-    Vals.push_back(Log2_32(F.getAlignment())+1);
-    Vals.push_back(F.hasSection() ? SectionMap[F.getSection()] : 0);
-    Vals.push_back(getEncodedVisibility(F));
-    Vals.push_back(F.hasGC() ? GCMap[F.getGC()] : 0);
-    Vals.push_back(getEncodedUnnamedAddr(F));
-    Vals.push_back(F.hasPrologueData() ? (VE.getValueID(F.getPrologueData()) + 1)
-                                       : 0);
-    Vals.push_back(getEncodedDLLStorageClass(F));
-    Vals.push_back(F.hasComdat() ? VE.getComdatID(F.getComdat()) : 0);
-    Vals.push_back(F.hasPrefixData() ? (VE.getValueID(F.getPrefixData()) + 1)
-                                     : 0);
-    Vals.push_back(
-        F.hasPersonalityFn() ? (VE.getValueID(F.getPersonalityFn()) + 1) : 0);
-
-    Vals.push_back(F.isDSOLocal());
-    Vals.push_back(F.getAddressSpace());
-
-    unsigned AbbrevToUse = 0;
-    Stream.EmitRecord(bitc::MODULE_CODE_FUNCTION, Vals, AbbrevToUse);
+    Vals.push_back(StructuralHash(F));
+    Stream.EmitRecord(bitc::MODULE_CODE_FUNCTION_HASH, Vals);
     Vals.clear();
   }
+}
 
-  // Emit the alias information.
-  for (const GlobalAlias &A : M.aliases()) {
-    // ALIAS: [strtab offset, strtab size, alias type, aliasee val#, linkage,
-    //         visibility, dllstorageclass, threadlocal, unnamed_addr,
-    //         DSO_Local]
-    Vals.push_back(addToStrtab(A.getName()));
-    Vals.push_back(A.getName().size());
-    Vals.push_back(VE.getTypeID(A.getValueType()));
-    Vals.push_back(A.getType()->getAddressSpace());
-    Vals.push_back(VE.getValueID(A.getAliasee()));
-    Vals.push_back(getEncodedLinkage(A));
-    Vals.push_back(getEncodedVisibility(A));
-    Vals.push_back(getEncodedDLLStorageClass(A));
-    Vals.push_back(getEncodedThreadLocalMode(A));
-    Vals.push_back(getEncodedUnnamedAddr(A));
-    Vals.push_back(A.isDSOLocal());
+void ModuleBitcodeWriter::writeGlobalVariableRecord(
+    const GlobalVariable &GV, SmallVectorImpl<unsigned> &Vals) {
+  unsigned AbbrevToUse = 0;
 
-    unsigned AbbrevToUse = 0;
-    Stream.EmitRecord(bitc::MODULE_CODE_ALIAS, Vals, AbbrevToUse);
-    Vals.clear();
+  // GLOBALVAR: [strtab offset, strtab size, type, isconst, initid,
+  //             linkage, alignment, section, visibility, threadlocal,
+  //             unnamed_addr, externally_initialized, dllstorageclass,
+  //             comdat, attributes, DSO_Local]
+  Vals.push_back(addToStrtab(GV.getName()));
+  Vals.push_back(GV.getName().size());
+  Vals.push_back(VE.getTypeID(GV.getValueType()));
+  Vals.push_back(GV.getType()->getAddressSpace() << 2 | 2 | GV.isConstant());
+  Vals.push_back(GV.isDeclaration() ? 0 :
+                 (VE.getValueID(GV.getInitializer()) + 1));
+  Vals.push_back(getEncodedLinkage(GV));
+  Vals.push_back(Log2_32(GV.getAlignment())+1);
+  Vals.push_back(GV.hasSection() ? SectionMap[GV.getSection()] : 0);
+  if (GV.isThreadLocal() ||
+      GV.getVisibility() != GlobalValue::DefaultVisibility ||
+      GV.getUnnamedAddr() != GlobalValue::UnnamedAddr::None ||
+      GV.isExternallyInitialized() ||
+      GV.getDLLStorageClass() != GlobalValue::DefaultStorageClass ||
+      GV.hasComdat() ||
+      GV.hasAttributes() ||
+      GV.isDSOLocal()) {
+    Vals.push_back(getEncodedVisibility(GV));
+    Vals.push_back(getEncodedThreadLocalMode(GV));
+    Vals.push_back(getEncodedUnnamedAddr(GV));
+    Vals.push_back(GV.isExternallyInitialized());
+    Vals.push_back(getEncodedDLLStorageClass(GV));
+    Vals.push_back(GV.hasComdat() ? VE.getComdatID(GV.getComdat()) : 0);
+
+    auto AL = GV.getAttributesAsList(AttributeList::FunctionIndex);
+    Vals.push_back(VE.getAttributeListID(AL));
+
+    Vals.push_back(GV.isDSOLocal());
+  } else {
+    AbbrevToUse = SimpleGVarAbbrev;
   }
 
-  // Emit the ifunc information.
-  for (const GlobalIFunc &I : M.ifuncs()) {
-    // IFUNC: [strtab offset, strtab size, ifunc type, address space, resolver
-    //         val#, linkage, visibility, DSO_Local]
-    Vals.push_back(addToStrtab(I.getName()));
-    Vals.push_back(I.getName().size());
-    Vals.push_back(VE.getTypeID(I.getValueType()));
-    Vals.push_back(I.getType()->getAddressSpace());
-    Vals.push_back(VE.getValueID(I.getResolver()));
-    Vals.push_back(getEncodedLinkage(I));
-    Vals.push_back(getEncodedVisibility(I));
-    Vals.push_back(I.isDSOLocal());
-    Stream.EmitRecord(bitc::MODULE_CODE_IFUNC, Vals);
-    Vals.clear();
-  }
+  Stream.EmitRecord(bitc::MODULE_CODE_GLOBALVAR, Vals, AbbrevToUse);
+  Vals.clear();
+}
 
-  writeValueSymbolTableForwardDecl();
+void ModuleBitcodeWriter::writeFunctionRecord(const Function &F,
+                                              SmallVectorImpl<unsigned> &Vals) {
+  // FUNCTION:  [strtab offset, strtab size, type, callingconv, isproto,
+  //             linkage, paramattrs, alignment, section, visibility, gc,
+  //             unnamed_addr, prologuedata, dllstorageclass, comdat,
+  //             prefixdata, personalityfn, DSO_Local, addrspace]
+  Vals.push_back(addToStrtab(F.getName()));
+  Vals.push_back(F.getName().size());
+  Vals.push_back(VE.getTypeID(F.getFunctionType()));
+  Vals.push_back(F.getCallingConv());
+  Vals.push_back(F.isDeclaration());
+  Vals.push_back(getEncodedLinkage(F));
+  Vals.push_back(VE.getAttributeListID(F.getAttributes()));
+  Vals.push_back(Log2_32(F.getAlignment())+1);
+  Vals.push_back(F.hasSection() ? SectionMap[F.getSection()] : 0);
+  Vals.push_back(getEncodedVisibility(F));
+  Vals.push_back(F.hasGC() ? GCMap[F.getGC()] : 0);
+  Vals.push_back(getEncodedUnnamedAddr(F));
+  Vals.push_back(F.hasPrologueData() ? (VE.getValueID(F.getPrologueData()) + 1)
+                                     : 0);
+  Vals.push_back(getEncodedDLLStorageClass(F));
+  Vals.push_back(F.hasComdat() ? VE.getComdatID(F.getComdat()) : 0);
+  Vals.push_back(F.hasPrefixData() ? (VE.getValueID(F.getPrefixData()) + 1)
+                                   : 0);
+  Vals.push_back(
+      F.hasPersonalityFn() ? (VE.getValueID(F.getPersonalityFn()) + 1) : 0);
+
+  Vals.push_back(F.isDSOLocal());
+  Vals.push_back(F.getAddressSpace());
+
+  unsigned AbbrevToUse = 0;
+  Stream.EmitRecord(bitc::MODULE_CODE_FUNCTION, Vals, AbbrevToUse);
+  Vals.clear();
+}
+
+void ModuleBitcodeWriter::writeAliasRecord(const GlobalAlias &A,
+                                           SmallVectorImpl<unsigned> &Vals) {
+  // ALIAS: [strtab offset, strtab size, alias type, aliasee val#, linkage,
+  //         visibility, dllstorageclass, threadlocal, unnamed_addr,
+  //         DSO_Local]
+  Vals.push_back(addToStrtab(A.getName()));
+  Vals.push_back(A.getName().size());
+  Vals.push_back(VE.getTypeID(A.getValueType()));
+  Vals.push_back(A.getType()->getAddressSpace());
+  Vals.push_back(VE.getValueID(A.getAliasee()));
+  Vals.push_back(getEncodedLinkage(A));
+  Vals.push_back(getEncodedVisibility(A));
+  Vals.push_back(getEncodedDLLStorageClass(A));
+  Vals.push_back(getEncodedThreadLocalMode(A));
+  Vals.push_back(getEncodedUnnamedAddr(A));
+  Vals.push_back(A.isDSOLocal());
+
+  unsigned AbbrevToUse = 0;
+  Stream.EmitRecord(bitc::MODULE_CODE_ALIAS, Vals, AbbrevToUse);
+  Vals.clear();
+}
+
+void ModuleBitcodeWriter::writeIFuncRecord(const GlobalIFunc &I,
+                                           SmallVectorImpl<unsigned> &Vals) {
+  // IFUNC: [strtab offset, strtab size, ifunc type, address space, resolver
+  //         val#, linkage, visibility, DSO_Local]
+  Vals.push_back(addToStrtab(I.getName()));
+  Vals.push_back(I.getName().size());
+  Vals.push_back(VE.getTypeID(I.getValueType()));
+  Vals.push_back(I.getType()->getAddressSpace());
+  Vals.push_back(VE.getValueID(I.getResolver()));
+  Vals.push_back(getEncodedLinkage(I));
+  Vals.push_back(getEncodedVisibility(I));
+  Vals.push_back(I.isDSOLocal());
+  Stream.EmitRecord(bitc::MODULE_CODE_IFUNC, Vals);
+  Vals.clear();
+}
+
+void ModuleBitcodeWriter::writeGlobalValueRecord(
+    const GlobalValue &GV, SmallVectorImpl<unsigned> &Vals) {
+  if (auto *GVar = dyn_cast<GlobalVariable>(&GV))
+    writeGlobalVariableRecord(*GVar, Vals);
+  else if (auto *F = dyn_cast<Function>(&GV))
+    writeFunctionRecord(*F, Vals);
+  else if (auto *A = dyn_cast<GlobalAlias>(&GV))
+    writeAliasRecord(*A, Vals);
+  else
+    writeIFuncRecord(cast<GlobalIFunc>(GV), Vals);
 }
 
 static uint64_t getOptimizationFlags(const Value *V) {
@@ -1968,6 +2092,14 @@ void ModuleBitcodeWriter::writeMetadataRecords(
 #include "llvm/IR/Metadata.def"
       }
     }
+    if (const MDString *S = dyn_cast<MDString>(MD)) {
+      // When streaming, the strings created after the IDs were reserved are
+      // numbered among the other metadata.
+      Record.append(S->bytes_begin(), S->bytes_end());
+      Stream.EmitRecord(bitc::METADATA_STRING_OLD, Record);
+      Record.clear();
+      continue;
+    }
     writeValueAsMetadata(cast<ValueAsMetadata>(MD), Record);
   }
 }
@@ -2004,8 +2136,11 @@ void ModuleBitcodeWriter::writeModuleMetadata() {
   writeMetadataStrings(VE.getMDStrings(), Record);
 
   // We only emit an index for the metadata record if we have more than a given
-  // (naive) threshold of metadatas, otherwise it is not worth it.
-  if (VE.getNonMDStrings().size() > IndexThreshold) {
+  // (naive) threshold of metadatas, otherwise it is not worth it. The index
+  // does not cover the strings among the records of a streamed module.
+  bool WriteIndex =
+      !VE.isStreaming() && VE.getNonMDStrings().size() > IndexThreshold;
+  if (WriteIndex) {
     // Write a placeholder value in for the offset of the metadata index,
     // which is written after the records, so that it can include
     // the offset of each entry. The placeholder offset will be
@@ -2026,7 +2161,7 @@ void ModuleBitcodeWriter::writeModuleMetadata() {
   // Write all the records
   writeMetadataRecords(VE.getNonMDStrings(), Record, &MDAbbrevs, &IndexPos);
 
-  if (VE.getNonMDStrings().size() > IndexThreshold) {
+  if (WriteIndex) {
     // Now that we have emitted all the records we will emit the index. But
     // first
     // backpatch the forward reference so that the reader can skip the records
@@ -2460,17 +2595,37 @@ void ModuleBitcodeWriter::writeConstants(unsigned FirstVal, unsigned LastVal,
 
 void ModuleBitcodeWriter::writeModuleConstants() {
   const ValueEnumerator::ValueList &Vals = VE.getValues();
+  unsigned End = VE.isStreaming() ? VE.getFirstReservedValueID() : Vals.size();
 
   // Find the first constant to emit, which is the first non-globalvalue value.
   // We know globalvalues have been emitted by WriteModuleInfo.
-  for (unsigned i = 0, e = Vals.size(); i != e; ++i) {
+  for (unsigned i = 0; i != End; ++i) {
     if (!isa<GlobalValue>(Vals[i].first)) {
-      writeConstants(i, Vals.size(), true);
+      writeConstants(i, End, true);
       return;
     }
   }
 }
 
+/// Emit the global values and the constants that got the IDs reserved for
+/// streaming, in order, since they may be interleaved.
+void ModuleBitcodeWriter::writeReservedValues() {
+  const ValueEnumerator::ValueList &Vals = VE.getValues();
+  SmallVector<unsigned, 64> Record;
+  for (unsigned I = VE.getFirstReservedValueID(), E = Vals.size(); I != E;) {
+    if (auto *GV = dyn_cast<GlobalValue>(Vals[I].first)) {
+      writeGlobalValueRecord(*GV, Record);
+      ++I;
+      continue;
+    }
+    unsigned J = I + 1;
+    while (J != E && !isa<GlobalValue>(Vals[J].first))
+      ++J;
+    writeConstants(I, J, true);
+    I = J;
+  }
+}
+
 /// pushValueAndType - The file has to encode both the value and type id for
 /// many values, because we need to know what type to create for forward
 /// references.  However, most operands are not forward references, so this type
@@ -3111,6 +3266,27 @@ void ModuleBitcodeWriter::writeFunction(
   Stream.ExitBlock();
 }
 
+/// Copy the block of \p F encoded by a StreamingBitcodeWriter. Both streams are
+/// in a module block, and the block is aligned to 32 bits in both.
+void ModuleBitcodeWriter::copyStreamedFunction(
+    const Function &F, std::pair<uint64_t, uint64_t> Bits,
+    DenseMap<const Function *, uint64_t> &FunctionToBitcodeIndex) {
+  FunctionToBitcodeIndex[&F] = Stream.GetCurrentBitNo();
+  assert((Stream.GetCurrentBitNo() & 31) == 0 && (Bits.first & 31) == 0 &&
+         (Bits.second & 31) == 0 && "function block not 32-bit aligned");
+  for (uint64_t Bit = Bits.first; Bit != Bits.second; Bit += 32)
+    Stream.Emit(support::endian::read32le(&(*StreamedBuffer)[Bit / 8]), 32);
+}
+
+/// Return the abbrev operand for type IDs. When streaming, the function blocks
+/// are encoded before the number of types is known.
+BitCodeAbbrevOp ModuleBitcodeWriter::getTypeIDAbbrevOp() const {
+  if (VE.isStreaming())
+    return BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6);
+  return BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed,
+                         VE.computeBitsRequiredForTypeIndicies());
+}
+
 // Emit blockinfo, which defines the standard abbreviations etc.
 void ModuleBitcodeWriter::writeBlockInfo() {
   // We only want to emit block info records for blocks that have multiple
@@ -3163,8 +3339,7 @@ void ModuleBitcodeWriter::writeBlockInfo() {
   { // SETTYPE abbrev for CONSTANTS_BLOCK.
     auto Abbv = std::make_shared<BitCodeAbbrev>();
     Abbv->Add(BitCodeAbbrevOp(bitc::CST_CODE_SETTYPE));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed,
-                              VE.computeBitsRequiredForTypeIndicies()));
+    Abbv->Add(getTypeIDAbbrevOp());
     if (Stream.EmitBlockInfoAbbrev(bitc::CONSTANTS_BLOCK_ID, Abbv) !=
         CONSTANTS_SETTYPE_ABBREV)
       llvm_unreachable("Unexpected abbrev ordering!");
@@ -3183,8 +3358,7 @@ void ModuleBitcodeWriter::writeBlockInfo() {
     auto Abbv = std::make_shared<BitCodeAbbrev>();
     Abbv->Add(BitCodeAbbrevOp(bitc::CST_CODE_CE_CAST));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 4));  // cast opc
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed,       // typeid
-                              VE.computeBitsRequiredForTypeIndicies()));
+    Abbv->Add(getTypeIDAbbrevOp());                         // typeid
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 8));    // value id
 
     if (Stream.EmitBlockInfoAbbrev(bitc::CONSTANTS_BLOCK_ID, Abbv) !=
@@ -3205,8 +3379,7 @@ void ModuleBitcodeWriter::writeBlockInfo() {
     auto Abbv = std::make_shared<BitCodeAbbrev>();
     Abbv->Add(BitCodeAbbrevOp(bitc::FUNC_CODE_INST_LOAD));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // Ptr
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed,    // dest ty
-                              VE.computeBitsRequiredForTypeIndicies()));
+    Abbv->Add(getTypeIDAbbrevOp());                      // dest ty
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 4)); // Align
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 1)); // volatile
     if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_BLOCK_ID, Abbv) !=
@@ -3238,8 +3411,7 @@ void ModuleBitcodeWriter::writeBlockInfo() {
     auto Abbv = std::make_shared<BitCodeAbbrev>();
     Abbv->Add(BitCodeAbbrevOp(bitc::FUNC_CODE_INST_CAST));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));    // OpVal
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed,       // dest ty
-                              VE.computeBitsRequiredForTypeIndicies()));
+    Abbv->Add(getTypeIDAbbrevOp());                         // dest ty
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 4));  // opc
     if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_BLOCK_ID, Abbv) !=
         FUNCTION_INST_CAST_ABBREV)
@@ -3272,8 +3444,7 @@ void ModuleBitcodeWriter::writeBlockInfo() {
     auto Abbv = std::make_shared<BitCodeAbbrev>();
     Abbv->Add(BitCodeAbbrevOp(bitc::FUNC_CODE_INST_GEP));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 1));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, // dest ty
-                              Log2_32_Ceil(VE.getTypes().size() + 1)));
+    Abbv->Add(getTypeIDAbbrevOp()); // dest ty
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
     Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
     if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_BLOCK_ID, Abbv) !=
@@ -3961,8 +4132,13 @@ void ModuleBitcodeWriter::write() {
   // descriptors for global variables, and function prototype info.
   writeModuleInfo();
 
+  if (GenerateFunctionHashes)
+    writeFunctionHashes();
+
   // Emit constants.
   writeModuleConstants();
+  if (VE.isStreaming())
+    writeReservedValues();
 
   // Emit metadata kind names.
   writeModuleMetadataKinds();
@@ -3979,9 +4155,28 @@ void ModuleBitcodeWriter::write() {
 
   // Emit function bodies.
   DenseMap<const Function *, uint64_t> FunctionToBitcodeIndex;
-  for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
-    if (!F->isDeclaration())
-      writeFunction(*F, FunctionToBitcodeIndex);
+  if (VE.isStreaming()) {
+    // The function blocks follow the order of the function records, which is
+    // the order of the IDs.
+    std::vector<const Function *> Functions;
+    for (const Function &F : M)
+      if (!F.isDeclaration())
+        Functions.push_back(&F);
+    llvm::sort(Functions, [&](const Function *LHS, const Function *RHS) {
+      return VE.getValueID(LHS) < VE.getValueID(RHS);
+    });
+    for (const Function *F : Functions) {
+      auto Streamed = StreamedFunctions->find(F);
+      if (Streamed != StreamedFunctions->end())
+        copyStreamedFunction(*F, Streamed->second, FunctionToBitcodeIndex);
+      else
+        writeFunction(*F, FunctionToBitcodeIndex);
+    }
+  } else {
+    for (Module::const_iterator F = M.begin(), E = M.end(); F != E; ++F)
+      if (!F->isDeclaration())
+        writeFunction(*F, FunctionToBitcodeIndex);
+  }
 
   // Need to write after the above call to WriteFunction which populates
   // the summary information in the index.
@@ -4145,7 +4340,8 @@ void BitcodeWriter::copyStrtab(StringRef Strtab) {
 void BitcodeWriter::writeModule(const Module &M,
                                 bool ShouldPreserveUseListOrder,
                                 const ModuleSummaryIndex *Index,
-                                bool GenerateHash, ModuleHash *ModHash) {
+                                bool GenerateHash, ModuleHash *ModHash,
+                                bool GenerateFunctionHashes) {
   assert(!WroteStrtab);
 
   // The Mods vector is used by irsymtab::build, which requires non-const
@@ -4157,7 +4353,19 @@ void BitcodeWriter::writeModule(const Module &M,
 
   ModuleBitcodeWriter ModuleWriter(M, Buffer, StrtabBuilder, *Stream,
                                    ShouldPreserveUseListOrder, Index,
-                                   GenerateHash, ModHash);
+                                   GenerateHash, ModHash,
+                                   GenerateFunctionHashes);
+  ModuleWriter.write();
+}
+
+void BitcodeWriter::writeStreamedModule(
+    Module &M, ValueEnumerator &VE, const SmallVectorImpl<char> &FunctionBuffer,
+    const StreamedFunctionMap &FunctionBlocks) {
+  assert(!WroteStrtab);
+  Mods.push_back(&M);
+
+  ModuleBitcodeWriter ModuleWriter(M, VE, Buffer, StrtabBuilder, *Stream,
+                                   &FunctionBuffer, &FunctionBlocks);
   ModuleWriter.write();
 }
 
@@ -4173,7 +4381,8 @@ void BitcodeWriter::writeIndex(
 void llvm::WriteBitcodeToFile(const Module &M, raw_ostream &Out,
                               bool ShouldPreserveUseListOrder,
                               const ModuleSummaryIndex *Index,
-                              bool GenerateHash, ModuleHash *ModHash) {
+                              bool GenerateHash, ModuleHash *ModHash,
+                              bool GenerateFunctionHashes) {
   SmallVector<char, 0> Buffer;
   Buffer.reserve(256*1024);
 
@@ -4185,7 +4394,7 @@ void llvm::WriteBitcodeToFile(const Module &M, raw_ostream &Out,
 
   BitcodeWriter Writer(Buffer);
   Writer.writeModule(M, ShouldPreserveUseListOrder, Index, GenerateHash,
-                     ModHash);
+                     ModHash, GenerateFunctionHashes);
   Writer.writeSymtab();
   Writer.writeStrtab();
 
@@ -4196,6 +4405,86 @@ void llvm::WriteBitcodeToFile(const Module &M, raw_ostream &Out,
   Out.write((char*)&Buffer.front(), Buffer.size());
 }
 
+StreamingBitcodeWriter::StreamingBitcodeWriter(Module &M,
+                                               unsigned NumReservedIDs)
+    : M(M), VE(llvm::make_unique<ValueEnumerator>(
+                M, /*ShouldPreserveUseListOrder=*/false)),
+      FunctionStream(llvm::make_unique<BitstreamWriter>(FunctionBuffer)) {
+  VE->reserveIDs(NumReservedIDs, NumReservedIDs);
+
+  // Encode the function blocks in a module block with the same blockinfo as
+  // the final one, so that they can be copied as is.
+  ModuleBitcodeWriter(M, *VE, FunctionBuffer, StrtabBuilder, *FunctionStream)
+      .writeStreamHeader();
+}
+
+StreamingBitcodeWriter::~StreamingBitcodeWriter() {
+  if (!Finished)
+    FunctionStream->ExitBlock();
+}
+
+bool StreamingBitcodeWriter::writeFunction(Function &F) {
+  assert(!Finished && "The module was already written");
+  assert(!F.isDeclaration() && !F.isMaterializable() &&
+         "Expected a function body");
+
+  // The IDs of the blocks whose address is taken depend on the whole module.
+  for (const BasicBlock &BB : F)
+    if (BB.hasAddressTaken())
+      return false;
+  if (!VE->enumerateNewValues(F))
+    return false;
+
+  FunctionBlocks[&F] =
+      ModuleBitcodeWriter(M, *VE, FunctionBuffer, StrtabBuilder,
+                          *FunctionStream)
+          .writeStreamedFunction(F);
+
+  // Delete the body, but not the personality, prefix and prologue data of the
+  // function, which are written with the module.
+  for (BasicBlock &BB : F)
+    BB.dropAllReferences();
+  while (!F.empty())
+    F.begin()->eraseFromParent();
+  if (ValueArena *Arena = F.getArena())
+    Arena->resetIfUnused();
+  F.clearMetadata();
+  F.setIsMaterializable(true);
+  return true;
+}
+
+void StreamingBitcodeWriter::finish(raw_ostream &Out) {
+  assert(!Finished && "The module was already written");
+  FunctionStream->ExitBlock();
+  Finished = true;
+
+  // The bodies that were not streamed may refer to new values as well.
+  for (const Function &F : M)
+    if (!F.isDeclaration() && !F.isMaterializable())
+      VE->enumerateNewValues(F);
+  VE->enumerateNewValues(M);
+
+  SmallVector<char, 0> Buffer;
+  Buffer.reserve(256 * 1024);
+
+  // If this is darwin or another generic macho target, reserve space for the
+  // header.
+  Triple TT(M.getTargetTriple());
+  if (TT.isOSDarwin() || TT.isOSBinFormatMachO())
+    Buffer.insert(Buffer.begin(), BWH_HeaderSize, 0);
+
+  BitcodeWriter Writer(Buffer);
+  Writer.writeStreamedModule(M, *VE, FunctionBuffer, FunctionBlocks);
+  Writer.writeSymtab();
+  Writer.writeStrtab();
+
+  if (TT.isOSDarwin() || TT.isOSBinFormatMachO())
+    emitDarwinBCHeaderAndTrailer(Buffer, TT);
+
+  // Write the generated bitstream to "Out".
+  Out.write((char *)&Buffer.front(), Buffer.size());
+}
+
 void IndexBitcodeWriter::write() {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
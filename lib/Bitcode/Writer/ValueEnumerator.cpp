@@ -19,6 +19,7 @@
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Constant.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
@@ -40,6 +41,7 @@
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -803,6 +805,43 @@ void ValueEnumerator::incorporateFunctionMetadata(const Function &F) {
              FunctionMDs.begin() + R.Last);
 }
 
+void ValueEnumerator::enumerateFunctionMetadata(const Function &F) {
+  SmallVector<std::pair<unsigned, MDNode *>, 8> Attachments;
+  F.getAllMetadata(Attachments);
+  for (const auto &I : Attachments)
+    EnumerateMetadata(&F, I.second);
+
+  for (const BasicBlock &BB : F)
+    for (const Instruction &I : BB) {
+      for (const Use &Op : I.operands())
+        if (auto *MD = dyn_cast<MetadataAsValue>(&Op))
+          if (!isa<LocalAsMetadata>(MD->getMetadata()))
+            EnumerateMetadata(&F, MD->getMetadata());
+
+      Attachments.clear();
+      I.getAllMetadataOtherThanDebugLoc(Attachments);
+      for (const auto &A : Attachments)
+        EnumerateMetadata(&F, A.second);
+
+      if (DILocation *L = I.getDebugLoc())
+        for (const Metadata *Op : L->operands())
+          EnumerateMetadata(&F, Op);
+    }
+
+  // The metadata was enumerated in post-order: partition it the same way
+  // organizeMetadata() does.
+  std::stable_sort(MDs.begin() + NumModuleMDs, MDs.end(),
+                   [](const Metadata *LHS, const Metadata *RHS) {
+                     return getMetadataTypeOrder(LHS) <
+                            getMetadataTypeOrder(RHS);
+                   });
+  for (unsigned I = NumModuleMDs, E = MDs.size(); I != E; ++I) {
+    MetadataMap[MDs[I]].ID = I + 1;
+    if (isa<MDString>(MDs[I]))
+      ++NumMDStrings;
+  }
+}
+
 void ValueEnumerator::EnumerateValue(const Value *V) {
   assert(!V->getType()->isVoidTy() && "Can't insert void values!");
   assert(!isa<MetadataAsValue>(V) && "EnumerateValue doesn't handle Metadata!");
@@ -944,11 +983,23 @@ void ValueEnumerator::EnumerateAttributes(AttributeList PAL) {
 
 void ValueEnumerator::incorporateFunction(const Function &F) {
   InstructionCount = 0;
+
+  // When streaming, the function-local IDs come after all the reserved IDs,
+  // including the ones not used yet.
+  if (Streaming) {
+    Values.resize(FirstReservedValueID + NumReservedValues);
+    MDs.resize(FirstReservedMDID + NumReservedMDs);
+  }
   NumModuleValues = Values.size();
 
   // Add global metadata to the function block.  This doesn't include
   // LocalAsMetadata.
-  incorporateFunctionMetadata(F);
+  if (Streaming) {
+    NumModuleMDs = MDs.size();
+    NumMDStrings = 0;
+  } else {
+    incorporateFunctionMetadata(F);
+  }
 
   // Adding function arguments to the value table.
   for (const auto &I : F.args())
@@ -967,6 +1018,11 @@ void ValueEnumerator::incorporateFunction(const Function &F) {
     ValueMap[&BB] = BasicBlocks.size();
   }
 
+  // When streaming, the constants the metadata refers to may be local to the
+  // function.
+  if (Streaming)
+    enumerateFunctionMetadata(F);
+
   // Optimize the constant layout.
   OptimizeConstants(FirstFuncConstantID, Values.size());
 
@@ -1015,6 +1071,14 @@ void ValueEnumerator::purgeFunction() {
   MDs.resize(NumModuleMDs);
   BasicBlocks.clear();
   NumMDStrings = 0;
+
+  // Drop the padding of the reserved IDs.
+  if (Streaming) {
+    while (!Values.empty() && !Values.back().first)
+      Values.pop_back();
+    while (!MDs.empty() && !MDs.back())
+      MDs.pop_back();
+  }
 }
 
 static void IncorporateFunctionInfoGlobalBBIDs(const Function *F,
@@ -1039,3 +1103,182 @@ unsigned ValueEnumerator::getGlobalBasicBlockID(const BasicBlock *BB) const {
 uint64_t ValueEnumerator::computeBitsRequiredForTypeIndicies() const {
   return Log2_32_Ceil(getTypes().size() + 1);
 }
+
+void ValueEnumerator::reserveIDs(unsigned NumValues, unsigned NumMDs) {
+  assert(!Streaming && "IDs already reserved");
+  assert(!ShouldPreserveUseListOrder &&
+         "Cannot preserve the use-list order of a module being changed");
+  Streaming = true;
+  FirstReservedValueID = Values.size();
+  NumReservedValues = NumValues;
+  FirstReservedMDID = MDs.size();
+  NumReservedMDs = NumMDs;
+  NumModuleMDStrings = NumMDStrings;
+
+  // The functions change until they are written, so their metadata is
+  // enumerated when they are.
+  for (const Metadata *MD : FunctionMDs)
+    MetadataMap.erase(MD);
+  FunctionMDs.clear();
+  FunctionMDInfo.clear();
+}
+
+bool ValueEnumerator::enumerateNewGlobals(
+    const Constant *C, SmallPtrSetImpl<const Constant *> &Visited) {
+  if (ValueMap.count(C) || !Visited.insert(C).second)
+    return true;
+  if (isa<BlockAddress>(C))
+    return false;
+
+  bool Result = true;
+  if (auto *GV = dyn_cast<GlobalValue>(C)) {
+    EnumerateValue(GV);
+    if (auto *F = dyn_cast<Function>(GV))
+      EnumerateAttributes(F->getAttributes());
+    else if (auto *GVar = dyn_cast<GlobalVariable>(GV))
+      if (GVar->hasAttributes())
+        EnumerateAttributes(
+            GVar->getAttributesAsList(AttributeList::FunctionIndex));
+
+    // The initializer, aliasee, resolver or function data is a module-level
+    // constant as well.
+    for (const Use &Op : GV->operands()) {
+      Result &= enumerateNewGlobals(cast<Constant>(Op), Visited);
+      EnumerateValue(Op);
+    }
+    return Result;
+  }
+
+  for (const Use &Op : C->operands())
+    Result &= enumerateNewGlobals(cast<Constant>(Op), Visited);
+  return Result;
+}
+
+bool ValueEnumerator::enumerateNewValues(const Function &F) {
+  assert(Streaming && "Expected reserved IDs");
+  SmallPtrSet<const Constant *, 32> Visited;
+  SmallPtrSet<const Metadata *, 32> VisitedMDs;
+  SmallVector<const Metadata *, 32> Worklist;
+  auto addMetadata = [&](const Metadata *MD) {
+    if (MD && !MetadataMap.count(MD) && VisitedMDs.insert(MD).second)
+      Worklist.push_back(MD);
+  };
+  bool Result = true;
+
+  for (const Argument &A : F.args())
+    EnumerateType(A.getType());
+
+  SmallVector<std::pair<unsigned, MDNode *>, 8> Attachments;
+  F.getAllMetadata(Attachments);
+  for (const auto &I : Attachments)
+    addMetadata(I.second);
+
+  for (const BasicBlock &BB : F)
+    for (const Instruction &I : BB) {
+      for (const Use &Op : I.operands()) {
+        if (auto *MD = dyn_cast<MetadataAsValue>(&Op)) {
+          if (!isa<LocalAsMetadata>(MD->getMetadata()))
+            addMetadata(MD->getMetadata());
+          continue;
+        }
+        EnumerateOperandType(Op);
+        if (auto *C = dyn_cast<Constant>(Op))
+          Result &= enumerateNewGlobals(C, Visited);
+      }
+      EnumerateType(I.getType());
+      if (const CallInst *CI = dyn_cast<CallInst>(&I))
+        EnumerateAttributes(CI->getAttributes());
+      else if (const InvokeInst *II = dyn_cast<InvokeInst>(&I))
+        EnumerateAttributes(II->getAttributes());
+
+      Attachments.clear();
+      I.getAllMetadataOtherThanDebugLoc(Attachments);
+      for (const auto &A : Attachments)
+        addMetadata(A.second);
+      addMetadata(I.getDebugLoc().get());
+    }
+
+  // The metadata created since the IDs were reserved is written in the
+  // function block, along with the constants it refers to, but the global
+  // values are not local to the function.
+  while (!Worklist.empty()) {
+    const Metadata *MD = Worklist.pop_back_val();
+    if (auto *N = dyn_cast<MDNode>(MD)) {
+      for (const Metadata *Op : N->operands())
+        addMetadata(Op);
+    } else if (auto *C = dyn_cast<ConstantAsMetadata>(MD)) {
+      Result &= enumerateNewGlobals(C->getValue(), Visited);
+    }
+  }
+
+  checkReservedIDs();
+  return Result;
+}
+
+void ValueEnumerator::enumerateNewValues(const Module &M) {
+  assert(Streaming && "Expected reserved IDs");
+  SmallPtrSet<const Constant *, 32> Visited;
+  auto enumerateGlobal = [&](const GlobalValue &GV) {
+    enumerateNewGlobals(&GV, Visited);
+    // The initializers of the older globals may have changed too.
+    for (const Use &Op : GV.operands()) {
+      enumerateNewGlobals(cast<Constant>(Op), Visited);
+      EnumerateValue(Op);
+    }
+  };
+
+  for (const GlobalVariable &GV : M.globals()) {
+    enumerateGlobal(GV);
+    if (GV.hasAttributes())
+      EnumerateAttributes(GV.getAttributesAsList(AttributeList::FunctionIndex));
+  }
+  for (const Function &F : M) {
+    enumerateGlobal(F);
+    EnumerateAttributes(F.getAttributes());
+  }
+  for (const GlobalAlias &GA : M.aliases())
+    enumerateGlobal(GA);
+  for (const GlobalIFunc &GIF : M.ifuncs())
+    enumerateGlobal(GIF);
+
+  EnumerateNamedMetadata(M);
+  SmallVector<std::pair<unsigned, MDNode *>, 8> Attachments;
+  for (const GlobalVariable &GV : M.globals()) {
+    Attachments.clear();
+    GV.getAllMetadata(Attachments);
+    for (const auto &I : Attachments)
+      EnumerateMetadata(nullptr, I.second);
+  }
+  for (const Function &F : M) {
+    if (!F.isDeclaration())
+      continue;
+    Attachments.clear();
+    F.getAllMetadata(Attachments);
+    for (const auto &I : Attachments)
+      EnumerateMetadata(nullptr, I.second);
+  }
+
+  checkReservedIDs();
+
+  // Fill the reserved IDs left, since the function blocks written so far
+  // number their values and metadata after all of them.
+  LLVMContext &Context = M.getContext();
+  Type *PlaceholderTy = Type::getInt1Ty(Context);
+  EnumerateType(PlaceholderTy);
+  Values.resize(FirstReservedValueID + NumReservedValues,
+                std::make_pair(UndefValue::get(PlaceholderTy), 0U));
+  MDs.resize(FirstReservedMDID + NumReservedMDs, MDTuple::get(Context, None));
+
+  // The module metadata block is written next.
+  NumModuleMDs = 0;
+  NumMDStrings = NumModuleMDStrings;
+}
+
+void ValueEnumerator::checkReservedIDs() const {
+  if (Values.size() > FirstReservedValueID + NumReservedValues)
+    report_fatal_error("Too many module-level values were created while "
+                       "streaming bitcode");
+  if (MDs.size() > FirstReservedMDID + NumReservedMDs)
+    report_fatal_error("Too many module-level metadata nodes were created "
+                       "while streaming bitcode");
+}
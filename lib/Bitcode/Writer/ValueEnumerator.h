@@ -16,6 +16,7 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/UniqueVector.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/Metadata.h"
@@ -30,6 +31,7 @@ namespace llvm {
 
 class BasicBlock;
 class Comdat;
+class Constant;
 class Function;
 class Instruction;
 class LocalAsMetadata;
@@ -139,6 +141,16 @@ private:
   unsigned FirstFuncConstantID;
   unsigned FirstInstID;
 
+  /// When streaming, the IDs of the module-level values and metadata from
+  /// which the IDs are reserved for the ones created afterwards, the number of
+  /// reserved IDs, and the number of module-level metadata strings.
+  bool Streaming = false;
+  unsigned FirstReservedValueID = 0;
+  unsigned NumReservedValues = 0;
+  unsigned FirstReservedMDID = 0;
+  unsigned NumReservedMDs = 0;
+  unsigned NumModuleMDStrings = 0;
+
 public:
   ValueEnumerator(const Module &M, bool ShouldPreserveUseListOrder);
   ValueEnumerator(const ValueEnumerator &) = delete;
@@ -238,6 +250,30 @@ public:
   void purgeFunction();
   uint64_t computeBitsRequiredForTypeIndicies() const;
 
+  /// Freeze the IDs of the module-level values and metadata, so that the
+  /// function bodies can be written one at a time before the rest of the
+  /// module. The module-level values and metadata created afterwards get the
+  /// next of \p NumValues and \p NumMDs reserved IDs, and the function-local
+  /// ones are numbered after all the reserved IDs.
+  void reserveIDs(unsigned NumValues, unsigned NumMDs);
+
+  /// Check whether the IDs were frozen by reserveIDs().
+  bool isStreaming() const { return Streaming; }
+
+  /// Return the ID of the first reserved value.
+  unsigned getFirstReservedValueID() const { return FirstReservedValueID; }
+
+  /// Enumerate the module-level values and the types used by the body of \p F
+  /// that were created after reserveIDs(). Return false if the body refers to
+  /// the blocks of a function, which are only numbered once the module is
+  /// final.
+  bool enumerateNewValues(const Function &F);
+
+  /// Enumerate the module-level values and metadata of \p M created after
+  /// reserveIDs(), and fill the reserved IDs left with placeholders, before the
+  /// module is written.
+  void enumerateNewValues(const Module &M);
+
 private:
   void OptimizeConstants(unsigned CstStart, unsigned CstEnd);
 
@@ -256,6 +292,20 @@ private:
   /// function.
   void incorporateFunctionMetadata(const Function &F);
 
+  /// Enumerate the metadata of the function when streaming, since it was not
+  /// partitioned up front, in the order organizeMetadata() gives it.
+  void enumerateFunctionMetadata(const Function &F);
+
+  /// Enumerate the global values created after reserveIDs() that \p C refers
+  /// to, along with their initializers. Return false if \p C refers to a
+  /// function-local block address.
+  bool enumerateNewGlobals(const Constant *C,
+                           SmallPtrSetImpl<const Constant *> &Visited);
+
+  /// Report an error if the values or the metadata created after reserveIDs()
+  /// overflow the reserved IDs.
+  void checkReservedIDs() const;
+
   /// Enumerate a single instance of metadata with the given function tag.
   ///
   /// If \c MD has already been enumerated, check that \c F matches its
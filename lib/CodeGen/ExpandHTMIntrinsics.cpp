@@ -0,0 +1,128 @@
+//===- ExpandHTMIntrinsics.cpp - Lower hardware transaction intrinsics ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass replaces the target-independent llvm.htm.begin, llvm.htm.commit
+// and llvm.htm.abort intrinsics with the transactional instructions of the
+// target, as provided by the emitTransaction* hooks of TargetLowering. This
+// lets the optimizer create and transform transactions without knowing which
+// flavor of hardware transactional memory the code will run on.
+//
+// On targets without hardware transactional memory, transactions never
+// start: llvm.htm.begin returns an abort status that does not ask for a
+// retry, and the other intrinsics are dropped.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/CodeGen/TargetLowering.h"
+#include "llvm/CodeGen/TargetPassConfig.h"
+#include "llvm/CodeGen/TargetSubtargetInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "expand-htm-intrinsics"
+
+STATISTIC(NumExpanded, "Number of hardware transaction intrinsics expanded");
+
+namespace {
+
+class ExpandHTMIntrinsics : public FunctionPass {
+public:
+  static char ID;
+
+  ExpandHTMIntrinsics() : FunctionPass(ID) {
+    initializeExpandHTMIntrinsicsPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+} // end anonymous namespace
+
+static bool isHTMIntrinsic(Intrinsic::ID ID) {
+  return ID == Intrinsic::htm_begin || ID == Intrinsic::htm_commit ||
+         ID == Intrinsic::htm_abort;
+}
+
+/// Return true if \p M declares any of the llvm.htm.* intrinsics.
+static bool hasHTMIntrinsics(const Module &M) {
+  for (Intrinsic::ID ID :
+       {Intrinsic::htm_begin, Intrinsic::htm_commit, Intrinsic::htm_abort})
+    if (M.getFunction(Intrinsic::getName(ID)))
+      return true;
+  return false;
+}
+
+static void expandIntrinsic(IntrinsicInst *II, const TargetLowering &TLI) {
+  bool HasHTM = TLI.hasHardwareTransactionalMemory();
+  IRBuilder<> Builder(II);
+  switch (II->getIntrinsicID()) {
+  case Intrinsic::htm_begin: {
+    Value *Status =
+        HasHTM ? TLI.emitTransactionBegin(Builder) : Builder.getInt32(0);
+    Status->takeName(II);
+    II->replaceAllUsesWith(Status);
+    break;
+  }
+  case Intrinsic::htm_commit:
+    if (HasHTM)
+      TLI.emitTransactionCommit(Builder);
+    break;
+  case Intrinsic::htm_abort:
+    if (HasHTM)
+      TLI.emitTransactionAbort(Builder, II->getArgOperand(0));
+    break;
+  default:
+    llvm_unreachable("Not a hardware transaction intrinsic");
+  }
+  II->eraseFromParent();
+}
+
+bool ExpandHTMIntrinsics::runOnFunction(Function &F) {
+  if (!hasHTMIntrinsics(*F.getParent()))
+    return false;
+
+  auto *TPC = getAnalysisIfAvailable<TargetPassConfig>();
+  if (!TPC)
+    return false;
+
+  auto &TM = TPC->getTM<TargetMachine>();
+  const TargetLowering &TLI = *TM.getSubtargetImpl(F)->getTargetLowering();
+
+  SmallVector<IntrinsicInst *, 8> Worklist;
+  for (Instruction &I : instructions(F))
+    if (auto *II = dyn_cast<IntrinsicInst>(&I))
+      if (isHTMIntrinsic(II->getIntrinsicID()))
+        Worklist.push_back(II);
+
+  for (IntrinsicInst *II : Worklist) {
+    expandIntrinsic(II, TLI);
+    ++NumExpanded;
+  }
+  return !Worklist.empty();
+}
+
+char ExpandHTMIntrinsics::ID = 0;
+
+INITIALIZE_PASS(ExpandHTMIntrinsics, DEBUG_TYPE,
+                "Expand hardware transaction intrinsics", false, false)
+
+FunctionPass *llvm::createExpandHTMIntrinsicsPass() {
+  return new ExpandHTMIntrinsics();
+}
@@ -634,6 +634,9 @@ void TargetPassConfig::addIRPasses() {
 
   // Expand reduction intrinsics into shuffle sequences if the target wants to.
   addPass(createExpandReductionsPass());
+
+  // Lower the target-independent hardware transaction intrinsics.
+  addPass(createExpandHTMIntrinsicsPass());
 }
 
 /// Turn exception handling constructs into something the code generators can
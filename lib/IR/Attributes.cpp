@@ -85,6 +85,7 @@ Attribute Attribute::get(LLVMContext &Context, Attribute::AttrKind Kind,
   ID.AddInteger(Kind);
   if (Val) ID.AddInteger(Val);
 
+  ContextTableLock Lock(pImpl, LLVMContextImpl::AttributesTable);
   void *InsertPoint;
   AttributeImpl *PA = pImpl->AttrsSet.FindNodeOrInsertPos(ID, InsertPoint);
 
@@ -108,6 +109,7 @@ Attribute Attribute::get(LLVMContext &Context, StringRef Kind, StringRef Val) {
   ID.AddString(Kind);
   if (!Val.empty()) ID.AddString(Val);
 
+  ContextTableLock Lock(pImpl, LLVMContextImpl::AttributesTable);
   void *InsertPoint;
   AttributeImpl *PA = pImpl->AttrsSet.FindNodeOrInsertPos(ID, InsertPoint);
 
@@ -663,6 +665,7 @@ AttributeSetNode *AttributeSetNode::get(LLVMContext &C,
   for (const auto Attr : SortedAttrs)
     Attr.Profile(ID);
 
+  ContextTableLock Lock(pImpl, LLVMContextImpl::AttributesTable);
   void *InsertPoint;
   AttributeSetNode *PA =
     pImpl->AttrsSetNodes.FindNodeOrInsertPos(ID, InsertPoint);
@@ -851,6 +854,7 @@ AttributeList AttributeList::getImpl(LLVMContext &C,
   FoldingSetNodeID ID;
   AttributeListImpl::Profile(ID, AttrSets);
 
+  ContextTableLock Lock(pImpl, LLVMContextImpl::AttributesTable);
   void *InsertPoint;
   AttributeListImpl *PA =
       pImpl->AttrsLists.FindNodeOrInsertPos(ID, InsertPoint);
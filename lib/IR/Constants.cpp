@@ -608,6 +608,7 @@ Constant *ConstantInt::getFalse(Type *Ty) {
 ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   // get an existing value or the insertion position
   LLVMContextImpl *pImpl = Context.pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::IntConstantsTable);
   std::unique_ptr<ConstantInt> &Slot = pImpl->IntConstants[V];
   if (!Slot) {
     // Get the corresponding integer type for the bit width of the value.
@@ -756,6 +757,7 @@ Constant *ConstantFP::getZeroValueForNegation(Type *Ty) {
 // ConstantFP accessors.
 ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   LLVMContextImpl* pImpl = Context.pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::FPConstantsTable);
 
   std::unique_ptr<ConstantFP> &Slot = pImpl->FPConstants[V];
 
@@ -960,6 +962,8 @@ ConstantArray::ConstantArray(ArrayType *T, ArrayRef<Constant *> V)
 Constant *ConstantArray::get(ArrayType *Ty, ArrayRef<Constant*> V) {
   if (Constant *C = getImpl(Ty, V))
     return C;
+  ContextTableLock Lock(Ty->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   return Ty->getContext().pImpl->ArrayConstants.getOrCreate(Ty, V);
 }
 
@@ -1043,6 +1047,8 @@ Constant *ConstantStruct::get(StructType *ST, ArrayRef<Constant*> V) {
   if (isUndef)
     return UndefValue::get(ST);
 
+  ContextTableLock Lock(ST->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   return ST->getContext().pImpl->StructConstants.getOrCreate(ST, V);
 }
 
@@ -1057,6 +1063,8 @@ Constant *ConstantVector::get(ArrayRef<Constant*> V) {
   if (Constant *C = getImpl(V))
     return C;
   VectorType *Ty = VectorType::get(V.front()->getType(), V.size());
+  ContextTableLock Lock(Ty->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   return Ty->getContext().pImpl->VectorConstants.getOrCreate(Ty, V);
 }
 
@@ -1106,6 +1114,7 @@ Constant *ConstantVector::getSplat(unsigned NumElts, Constant *V) {
 
 ConstantTokenNone *ConstantTokenNone::get(LLVMContext &Context) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   if (!pImpl->TheNoneToken)
     pImpl->TheNoneToken.reset(new ConstantTokenNone(Context));
   return pImpl->TheNoneToken.get();
@@ -1310,6 +1319,8 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
   assert((Ty->isStructTy() || Ty->isArrayTy() || Ty->isVectorTy()) &&
          "Cannot create an aggregate zero of non-aggregate type!");
 
+  ContextTableLock Lock(Ty->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   std::unique_ptr<ConstantAggregateZero> &Entry =
       Ty->getContext().pImpl->CAZConstants[Ty];
   if (!Entry)
@@ -1320,11 +1331,14 @@ ConstantAggregateZero *ConstantAggregateZero::get(Type *Ty) {
 
 /// Remove the constant from the constant table.
 void ConstantAggregateZero::destroyConstantImpl() {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   getContext().pImpl->CAZConstants.erase(getType());
 }
 
 /// Remove the constant from the constant table.
 void ConstantArray::destroyConstantImpl() {
+  ContextTableLock Lock(getType()->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   getType()->getContext().pImpl->ArrayConstants.remove(this);
 }
 
@@ -1334,11 +1348,15 @@ void ConstantArray::destroyConstantImpl() {
 
 /// Remove the constant from the constant table.
 void ConstantStruct::destroyConstantImpl() {
+  ContextTableLock Lock(getType()->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   getType()->getContext().pImpl->StructConstants.remove(this);
 }
 
 /// Remove the constant from the constant table.
 void ConstantVector::destroyConstantImpl() {
+  ContextTableLock Lock(getType()->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   getType()->getContext().pImpl->VectorConstants.remove(this);
 }
 
@@ -1376,6 +1394,8 @@ const APInt &Constant::getUniqueInteger() const {
 //
 
 ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
+  ContextTableLock Lock(Ty->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   std::unique_ptr<ConstantPointerNull> &Entry =
       Ty->getContext().pImpl->CPNConstants[Ty];
   if (!Entry)
@@ -1386,10 +1406,13 @@ ConstantPointerNull *ConstantPointerNull::get(PointerType *Ty) {
 
 /// Remove the constant from the constant table.
 void ConstantPointerNull::destroyConstantImpl() {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   getContext().pImpl->CPNConstants.erase(getType());
 }
 
 UndefValue *UndefValue::get(Type *Ty) {
+  ContextTableLock Lock(Ty->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   std::unique_ptr<UndefValue> &Entry = Ty->getContext().pImpl->UVConstants[Ty];
   if (!Entry)
     Entry.reset(new UndefValue(Ty));
@@ -1400,6 +1423,7 @@ UndefValue *UndefValue::get(Type *Ty) {
 /// Remove the constant from the constant table.
 void UndefValue::destroyConstantImpl() {
   // Free the constant and any dangling references to it.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   getContext().pImpl->UVConstants.erase(getType());
 }
 
@@ -1409,6 +1433,8 @@ BlockAddress *BlockAddress::get(BasicBlock *BB) {
 }
 
 BlockAddress *BlockAddress::get(Function *F, BasicBlock *BB) {
+  ContextTableLock Lock(F->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   BlockAddress *&BA =
     F->getContext().pImpl->BlockAddresses[std::make_pair(F, BB)];
   if (!BA)
@@ -1432,6 +1458,8 @@ BlockAddress *BlockAddress::lookup(const BasicBlock *BB) {
 
   const Function *F = BB->getParent();
   assert(F && "Block must have a parent");
+  ContextTableLock Lock(F->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   BlockAddress *BA =
       F->getContext().pImpl->BlockAddresses.lookup(std::make_pair(F, BB));
   assert(BA && "Refcount and block address map disagree!");
@@ -1440,6 +1468,7 @@ BlockAddress *BlockAddress::lookup(const BasicBlock *BB) {
 
 /// Remove the constant from the constant table.
 void BlockAddress::destroyConstantImpl() {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   getFunction()->getType()->getContext().pImpl
     ->BlockAddresses.erase(std::make_pair(getFunction(), getBasicBlock()));
   getBasicBlock()->AdjustBlockAddressRefCount(-1);
@@ -1460,6 +1489,7 @@ Value *BlockAddress::handleOperandChangeImpl(Value *From, Value *To) {
 
   // See if the 'new' entry already exists, if not, just update this in place
   // and return early.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   BlockAddress *&NewBA =
     getContext().pImpl->BlockAddresses[std::make_pair(NewF, NewBB)];
   if (NewBA)
@@ -1501,6 +1531,7 @@ static Constant *getFoldedCast(Instruction::CastOps opc, Constant *C, Type *Ty,
   // Look up the constant in the table first to ensure uniqueness.
   ConstantExprKeyType Key(opc, C);
 
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(Ty, Key);
 }
 
@@ -1856,6 +1887,7 @@ Constant *ConstantExpr::get(unsigned Opcode, Constant *C1, Constant *C2,
   ConstantExprKeyType Key(Opcode, ArgVec, 0, Flags);
 
   LLVMContextImpl *pImpl = C1->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(C1->getType(), Key);
 }
 
@@ -1936,6 +1968,7 @@ Constant *ConstantExpr::getSelect(Constant *C, Constant *V1, Constant *V2,
   ConstantExprKeyType Key(Instruction::Select, ArgVec);
 
   LLVMContextImpl *pImpl = C->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(V1->getType(), Key);
 }
 
@@ -1995,6 +2028,7 @@ Constant *ConstantExpr::getGetElementPtr(Type *Ty, Constant *C,
                                 SubClassOptionalData, None, Ty);
 
   LLVMContextImpl *pImpl = C->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2020,6 +2054,7 @@ Constant *ConstantExpr::getICmp(unsigned short pred, Constant *LHS,
     ResultTy = VectorType::get(ResultTy, VT->getNumElements());
 
   LLVMContextImpl *pImpl = LHS->getType()->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ResultTy, Key);
 }
 
@@ -2045,6 +2080,7 @@ Constant *ConstantExpr::getFCmp(unsigned short pred, Constant *LHS,
     ResultTy = VectorType::get(ResultTy, VT->getNumElements());
 
   LLVMContextImpl *pImpl = LHS->getType()->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ResultTy, Key);
 }
 
@@ -2067,6 +2103,7 @@ Constant *ConstantExpr::getExtractElement(Constant *Val, Constant *Idx,
   const ConstantExprKeyType Key(Instruction::ExtractElement, ArgVec);
 
   LLVMContextImpl *pImpl = Val->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2090,6 +2127,7 @@ Constant *ConstantExpr::getInsertElement(Constant *Val, Constant *Elt,
   const ConstantExprKeyType Key(Instruction::InsertElement, ArgVec);
 
   LLVMContextImpl *pImpl = Val->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(Val->getType(), Key);
 }
 
@@ -2113,6 +2151,7 @@ Constant *ConstantExpr::getShuffleVector(Constant *V1, Constant *V2,
   const ConstantExprKeyType Key(Instruction::ShuffleVector, ArgVec);
 
   LLVMContextImpl *pImpl = ShufTy->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ShufTy, Key);
 }
 
@@ -2137,6 +2176,7 @@ Constant *ConstantExpr::getInsertValue(Constant *Agg, Constant *Val,
   const ConstantExprKeyType Key(Instruction::InsertValue, ArgVec, 0, 0, Idxs);
 
   LLVMContextImpl *pImpl = Agg->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2161,6 +2201,7 @@ Constant *ConstantExpr::getExtractValue(Constant *Agg, ArrayRef<unsigned> Idxs,
   const ConstantExprKeyType Key(Instruction::ExtractValue, ArgVec, 0, 0, Idxs);
 
   LLVMContextImpl *pImpl = Agg->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->ExprConstants.getOrCreate(ReqTy, Key);
 }
 
@@ -2334,6 +2375,8 @@ Constant *ConstantExpr::getBinOpAbsorber(unsigned Opcode, Type *Ty) {
 
 /// Remove the constant from the constant table.
 void ConstantExpr::destroyConstantImpl() {
+  ContextTableLock Lock(getType()->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   getType()->getContext().pImpl->ExprConstants.remove(this);
 }
 
@@ -2427,6 +2470,8 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
     return ConstantAggregateZero::get(Ty);
 
   // Do a lookup to see if we have already formed one of these.
+  ContextTableLock Lock(Ty->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   auto &Slot =
       *Ty->getContext()
            .pImpl->CDSConstants.insert(std::make_pair(Elements, nullptr))
@@ -2453,6 +2498,7 @@ Constant *ConstantDataSequential::getImpl(StringRef Elements, Type *Ty) {
 
 void ConstantDataSequential::destroyConstantImpl() {
   // Remove the constant from the StringMap.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   StringMap<ConstantDataSequential*> &CDSConstants =
     getType()->getContext().pImpl->CDSConstants;
 
@@ -2826,6 +2872,7 @@ Value *ConstantArray::handleOperandChangeImpl(Value *From, Value *To) {
     return C;
 
   // Update to the new value.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   return getContext().pImpl->ArrayConstants.replaceOperandsInPlace(
       Values, this, From, ToC, NumUpdated, OperandNo);
 }
@@ -2862,6 +2909,7 @@ Value *ConstantStruct::handleOperandChangeImpl(Value *From, Value *To) {
     return UndefValue::get(getType());
 
   // Update to the new value.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   return getContext().pImpl->StructConstants.replaceOperandsInPlace(
       Values, this, From, ToC, NumUpdated, OperandNo);
 }
@@ -2888,6 +2936,7 @@ Value *ConstantVector::handleOperandChangeImpl(Value *From, Value *To) {
     return C;
 
   // Update to the new value.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   return getContext().pImpl->VectorConstants.replaceOperandsInPlace(
       Values, this, From, ToC, NumUpdated, OperandNo);
 }
@@ -2914,6 +2963,7 @@ Value *ConstantExpr::handleOperandChangeImpl(Value *From, Value *ToV) {
     return C;
 
   // Update to the new value.
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::ConstantsTable);
   return getContext().pImpl->ExprConstants.replaceOperandsInPlace(
       NewOps, this, From, To, NumUpdated, OperandNo);
 }
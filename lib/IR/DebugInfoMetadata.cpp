@@ -48,6 +48,7 @@ DILocation *DILocation::getImpl(LLVMContext &Context, unsigned Line,
   // Fixup column.
   adjustColumn(Column);
 
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   if (Storage == Uniqued) {
     if (auto *N =
             getUniqued(Context.pImpl->DILocations,
@@ -210,6 +211,7 @@ GenericDINode *GenericDINode::getImpl(LLVMContext &Context, unsigned Tag,
                                       MDString *Header,
                                       ArrayRef<Metadata *> DwarfOps,
                                       StorageType Storage, bool ShouldCreate) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   unsigned Hash = 0;
   if (Storage == Uniqued) {
     GenericDINodeInfo::KeyTy Key(Tag, Header, DwarfOps);
@@ -237,6 +239,7 @@ void GenericDINode::recalculateHash() {
 #define UNWRAP_ARGS_IMPL(...) __VA_ARGS__
 #define UNWRAP_ARGS(ARGS) UNWRAP_ARGS_IMPL ARGS
 #define DEFINE_GETIMPL_LOOKUP(CLASS, ARGS)                                     \
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);        \
   do {                                                                         \
     if (Storage == Uniqued) {                                                  \
       if (auto *N = getUniqued(Context.pImpl->CLASS##s,                        \
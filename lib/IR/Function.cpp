@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Function.h"
+#include "LLVMContextImpl.h"
 #include "SymbolTableListTraitsImpl.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseSet.h"
@@ -43,6 +44,7 @@
 #include "llvm/IR/Use.h"
 #include "llvm/IR/User.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueArena.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Compiler.h"
@@ -209,10 +211,12 @@ Function *Function::Create(FunctionType *Ty, LinkageTypes Linkage,
 }
 
 void Function::removeFromParent() {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::GlobalsTable);
   getParent()->getFunctionList().remove(getIterator());
 }
 
 void Function::eraseFromParent() {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::GlobalsTable);
   getParent()->getFunctionList().erase(getIterator());
 }
 
@@ -242,12 +246,17 @@ Function::Function(FunctionType *Ty, LinkageTypes Linkage, unsigned AddrSpace,
   if (!getContext().shouldDiscardValueNames())
     SymTab = make_unique<ValueSymbolTable>();
 
+  if (getContext().shouldUseFunctionArenas())
+    Arena = ValueArena::create();
+
   // If the function has arguments, mark them as lazily built.
   if (Ty->getNumParams())
     setValueSubclassData(1);   // Set the "has lazy arguments" bit.
 
-  if (ParentModule)
+  if (ParentModule) {
+    ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::GlobalsTable);
     ParentModule->getFunctionList().push_back(this);
+  }
 
   HasLLVMReservedName = getName().startswith("llvm.");
   // Ensure intrinsics have the right parameter attributes.
@@ -266,6 +275,11 @@ Function::~Function() {
 
   // Remove the function from the on-the-side GC table.
   clearGC();
+
+  // The arena stays alive until the values moved out of the function are
+  // deleted.
+  if (Arena)
+    Arena->release();
 }
 
 void Function::BuildLazyArguments() const {
@@ -355,6 +369,10 @@ void Function::dropAllReferences() {
   while (!BasicBlocks.empty())
     BasicBlocks.begin()->eraseFromParent();
 
+  // Reuse the memory of the deleted body.
+  if (Arena)
+    Arena->resetIfUnused();
+
   // Drop uses of any optional data (real or placeholder).
   if (getNumOperands()) {
     User::dropAllReferences();
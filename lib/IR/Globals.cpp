@@ -346,6 +346,7 @@ GlobalVariable::GlobalVariable(Module &M, Type *Ty, bool constant,
     Op<0>() = InitVal;
   }
 
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::GlobalsTable);
   if (Before)
     Before->getParent()->getGlobalList().insert(Before->getIterator(), this);
   else
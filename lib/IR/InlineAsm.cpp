@@ -46,10 +46,13 @@ InlineAsm *InlineAsm::get(FunctionType *FTy, StringRef AsmString,
   InlineAsmKeyType Key(AsmString, Constraints, FTy, hasSideEffects,
                        isAlignStack, asmDialect);
   LLVMContextImpl *pImpl = FTy->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ConstantsTable);
   return pImpl->InlineAsms.getOrCreate(PointerType::getUnqual(FTy), Key);
 }
 
 void InlineAsm::destroyConstant() {
+  ContextTableLock Lock(getType()->getContext().pImpl,
+                        LLVMContextImpl::ConstantsTable);
   getType()->getContext().pImpl->InlineAsms.remove(this);
   delete this;
 }
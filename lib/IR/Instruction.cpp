@@ -19,8 +19,21 @@
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/Type.h"
+#include "llvm/IR/ValueArena.h"
 using namespace llvm;
 
+void *Instruction::operator new(size_t Size) {
+  return allocateUser(Size, ValueArena::getCurrent());
+}
+
+void *Instruction::operator new(size_t Size, unsigned Us) {
+  return allocateUser(Size, Us, 0, ValueArena::getCurrent());
+}
+
+void *Instruction::operator new(size_t Size, unsigned Us, unsigned DescBytes) {
+  return allocateUser(Size, Us, DescBytes, ValueArena::getCurrent());
+}
+
 Instruction::Instruction(Type *ty, unsigned it, Use *Ops, unsigned NumOps,
                          Instruction *InsertBefore)
   : User(ty, Value::InstructionVal + it, Ops, NumOps), Parent(nullptr) {
@@ -227,6 +227,9 @@ LLVMContext::getDiagnosticMessagePrefix(DiagnosticSeverity Severity) {
 }
 
 void LLVMContext::diagnose(const DiagnosticInfo &DI) {
+  // The passes running on several threads report their diagnostics one at a
+  // time.
+  ContextTableLock Lock(pImpl, LLVMContextImpl::DiagnosticsTable);
   if (auto *OptDiagBase = dyn_cast<DiagnosticInfoOptimizationBase>(&DI)) {
     yaml::Output *Out = getDiagnosticsOutputFile();
     if (Out) {
@@ -328,10 +331,40 @@ void LLVMContext::enableDebugTypeODRUniquing() {
 
 void LLVMContext::disableDebugTypeODRUniquing() { pImpl->DITypeMap.reset(); }
 
+void LLVMContext::enableThreadSafety() { pImpl->enableThreadSafety(); }
+
+bool LLVMContext::isThreadSafe() const { return pImpl->ThreadSafe; }
+
 void LLVMContext::setDiscardValueNames(bool Discard) {
   pImpl->DiscardValueNames = Discard;
 }
 
+bool LLVMContext::shouldUseFunctionArenas() const {
+  return pImpl->UseFunctionArenas;
+}
+
+void LLVMContext::setUseFunctionArenas(bool Enable) {
+  pImpl->UseFunctionArenas = Enable;
+}
+
+bool LLVMContext::shouldBorrowBitcodeNames() const {
+  return pImpl->BorrowBitcodeNames;
+}
+
+void LLVMContext::setBorrowBitcodeNames(bool Borrow) {
+  pImpl->BorrowBitcodeNames = Borrow;
+}
+
+bool LLVMContext::shouldMaterializeBitcodeInParallel() const {
+  return pImpl->MaterializeBitcodeInParallel;
+}
+
+void LLVMContext::setMaterializeBitcodeInParallel(bool Parallel) {
+  if (Parallel)
+    enableThreadSafety();
+  pImpl->MaterializeBitcodeInParallel = Parallel;
+}
+
 OptPassGate &LLVMContext::getOptPassGate() const {
   return pImpl->getOptPassGate();
 }
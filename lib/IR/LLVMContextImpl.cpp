@@ -42,6 +42,12 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
     Int128Ty(C, 128) {}
 
 LLVMContextImpl::~LLVMContextImpl() {
+  // Only one thread may destroy the context: stop locking while it does.
+  if (ThreadSafe) {
+    ThreadSafe = false;
+    --Value::NumThreadSafeContexts;
+  }
+
   // NOTE: We need to delete the contents of OwnedModules, but Module's dtor
   // will call LLVMContextImpl::removeModule, thus invalidating iterators into
   // the container. Avoid iterators during this operation:
@@ -250,3 +256,12 @@ OptPassGate &LLVMContextImpl::getOptPassGate() const {
 void LLVMContextImpl::setOptPassGate(OptPassGate& OPG) {
   this->OPG = &OPG;
 }
+
+void LLVMContextImpl::enableThreadSafety() {
+  if (ThreadSafe)
+    return;
+  TableLocks.reset(new sys::Mutex[NumLockedTables]);
+  UseListLocks.reset(new sys::Mutex[NumUseListLocks]);
+  ThreadSafe = true;
+  ++Value::NumThreadSafeContexts;
+}
@@ -41,6 +41,7 @@
 #include "llvm/IR/TrackingMDRef.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/YAMLTraits.h"
 #include <algorithm>
 #include <cassert>
@@ -1249,6 +1250,9 @@ public:
   DenseMap<Metadata *, MetadataAsValue *> MetadataAsValues;
 
   DenseMap<const Value*, ValueName*> ValueNames;
+  /// The names of the values that are not copied in a ValueName, see
+  /// Value::setBorrowedName().
+  DenseMap<const Value *, StringRef> BorrowedValueNames;
 
 #define HANDLE_MDNODE_LEAF_UNIQUABLE(CLASS)                                    \
   DenseSet<CLASS *, CLASS##Info> CLASS##s;
@@ -1378,6 +1382,51 @@ public:
   /// not.
   bool DiscardValueNames = false;
 
+  /// Flag to indicate if the functions own a ValueArena.
+  bool UseFunctionArenas = false;
+
+  /// Flag to indicate if the names of the global values read from bitcode are
+  /// borrowed from the bitcode buffer.
+  bool BorrowBitcodeNames = false;
+
+  /// Flag to indicate if the bodies of the functions read from bitcode are
+  /// parsed on several threads when a whole module is materialized.
+  bool MaterializeBitcodeInParallel = false;
+
+  /// The tables guarded by their own lock when the context is thread-safe.
+  enum LockedTable {
+    TypesTable,        ///< The derived types and the TypeAllocator.
+    IntConstantsTable, ///< IntConstants.
+    FPConstantsTable,  ///< FPConstants.
+    ConstantsTable,    ///< The other constants, including the InlineAsms.
+    AttributesTable,   ///< The attributes, attribute sets and lists.
+    MetadataTable,     ///< The metadata and their uses.
+    ValueNamesTable,   ///< ValueNames and BorrowedValueNames.
+    ValueHandlesTable, ///< ValueHandles.
+    AttachmentsTable,  ///< InstructionMetadata and GlobalObjectMetadata.
+    GlobalsTable,      ///< The global lists and symbol tables of the modules.
+    DiagnosticsTable,  ///< The diagnostic handler and the remarks file.
+    NumLockedTables
+  };
+
+  /// Flag to indicate if several threads may use the context at the same time.
+  bool ThreadSafe = false;
+
+  /// The locks of the tables, indexed by LockedTable.
+  std::unique_ptr<sys::Mutex[]> TableLocks;
+
+  /// The locks of the use lists of the constants, picked by the address of
+  /// the constant.
+  static constexpr unsigned NumUseListLocks = 64;
+  std::unique_ptr<sys::Mutex[]> UseListLocks;
+
+  void enableThreadSafety();
+
+  sys::Mutex &getUseListLock(const Value *V) {
+    return UseListLocks[(reinterpret_cast<uintptr_t>(V) / alignof(Value)) %
+                        NumUseListLocks];
+  }
+
   LLVMContextImpl(LLVMContext &C);
   ~LLVMContextImpl();
 
@@ -1398,6 +1447,31 @@ public:
   void setOptPassGate(OptPassGate&);
 };
 
+/// Lock a table of a thread-safe context for the lifetime of the object. The
+/// locks are recursive. When they nest, the value handles lock, held while
+/// the callbacks of the handles run, is taken first, then the diagnostics and
+/// globals locks, the metadata attachments lock is taken before the metadata
+/// lock, which is taken before the constant locks, which are taken before the
+/// types lock.
+class ContextTableLock {
+  sys::Mutex *M = nullptr;
+
+public:
+  ContextTableLock(LLVMContextImpl *Impl, LLVMContextImpl::LockedTable Table) {
+    if (LLVM_UNLIKELY(Impl->ThreadSafe)) {
+      M = &Impl->TableLocks[Table];
+      M->lock();
+    }
+  }
+  ~ContextTableLock() {
+    if (M)
+      M->unlock();
+  }
+
+  ContextTableLock(const ContextTableLock &) = delete;
+  ContextTableLock &operator=(const ContextTableLock &) = delete;
+};
+
 } // end namespace llvm
 
 #endif // LLVM_LIB_IR_LLVMCONTEXTIMPL_H
@@ -21,6 +21,7 @@
 #include "llvm/IR/LegacyPassNameParser.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassTimingInfo.h"
+#include "llvm/IR/ValueArena.h"
 #include "llvm/Support/Chrono.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -28,6 +29,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -1625,6 +1627,18 @@ bool FPPassManager::runOnFunction(Function &F) {
     FunctionSize = F.getInstructionCount();
   }
 
+  TimeTraceScope FunctionScope("OptFunction", F.getName());
+  // Functions may be run on recursively by on-the-fly pass managers: only
+  // time the outermost run.
+  Timer *FunctionTimer = getFunctionTimer(F.getName());
+  if (FunctionTimer && FunctionTimer->isRunning())
+    FunctionTimer = nullptr;
+  TimeRegion FunctionTimeRegion(FunctionTimer);
+
+  // Allocate the instructions the passes create from the arena of the
+  // function, if it has one.
+  ValueArenaScope ArenaScope(F.getArena());
+
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
     FunctionPass *FP = getContainedPass(Index);
     bool LocalChanged = false;
@@ -1637,6 +1651,7 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      TimeTraceScope PassScope(FP->getPassName(), F.getName());
       LocalChanged |= FP->runOnFunction(F);
       if (EmitICRemark) {
         unsigned NewSize = F.getInstructionCount();
@@ -1736,6 +1751,7 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      TimeTraceScope PassScope(MP->getPassName(), M.getModuleIdentifier());
 
       LocalChanged |= MP->runOnModule(M);
       if (EmitICRemark) {
@@ -66,6 +66,8 @@ MetadataAsValue::MetadataAsValue(Type *Ty, Metadata *MD)
 }
 
 MetadataAsValue::~MetadataAsValue() {
+  ContextTableLock Lock(getType()->getContext().pImpl,
+                        LLVMContextImpl::MetadataTable);
   getType()->getContext().pImpl->MetadataAsValues.erase(MD);
   untrack();
 }
@@ -105,6 +107,7 @@ static Metadata *canonicalizeMetadataForValue(LLVMContext &Context,
 
 MetadataAsValue *MetadataAsValue::get(LLVMContext &Context, Metadata *MD) {
   MD = canonicalizeMetadataForValue(Context, MD);
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   auto *&Entry = Context.pImpl->MetadataAsValues[MD];
   if (!Entry)
     Entry = new MetadataAsValue(Type::getMetadataTy(Context), MD);
@@ -114,6 +117,7 @@ MetadataAsValue *MetadataAsValue::get(LLVMContext &Context, Metadata *MD) {
 MetadataAsValue *MetadataAsValue::getIfExists(LLVMContext &Context,
                                               Metadata *MD) {
   MD = canonicalizeMetadataForValue(Context, MD);
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   auto &Store = Context.pImpl->MetadataAsValues;
   return Store.lookup(MD);
 }
@@ -196,6 +200,7 @@ bool MetadataTracking::isReplaceable(const Metadata &MD) {
 }
 
 void ReplaceableMetadataImpl::addRef(void *Ref, OwnerTy Owner) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   bool WasInserted =
       UseMap.insert(std::make_pair(Ref, std::make_pair(Owner, NextIndex)))
           .second;
@@ -207,6 +212,7 @@ void ReplaceableMetadataImpl::addRef(void *Ref, OwnerTy Owner) {
 }
 
 void ReplaceableMetadataImpl::dropRef(void *Ref) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   bool WasErased = UseMap.erase(Ref);
   (void)WasErased;
   assert(WasErased && "Expected to drop a reference");
@@ -214,6 +220,7 @@ void ReplaceableMetadataImpl::dropRef(void *Ref) {
 
 void ReplaceableMetadataImpl::moveRef(void *Ref, void *New,
                                       const Metadata &MD) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   auto I = UseMap.find(Ref);
   assert(I != UseMap.end() && "Expected to move a reference");
   auto OwnerAndIndex = I->second;
@@ -350,6 +357,7 @@ ValueAsMetadata *ValueAsMetadata::get(Value *V) {
   assert(V && "Unexpected null Value");
 
   auto &Context = V->getContext();
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   auto *&Entry = Context.pImpl->ValuesAsMetadata[V];
   if (!Entry) {
     assert((isa<Constant>(V) || isa<Argument>(V) || isa<Instruction>(V)) &&
@@ -367,13 +375,16 @@ ValueAsMetadata *ValueAsMetadata::get(Value *V) {
 
 ValueAsMetadata *ValueAsMetadata::getIfExists(Value *V) {
   assert(V && "Unexpected null Value");
+  ContextTableLock Lock(V->getContext().pImpl, LLVMContextImpl::MetadataTable);
   return V->getContext().pImpl->ValuesAsMetadata.lookup(V);
 }
 
 void ValueAsMetadata::handleDeletion(Value *V) {
   assert(V && "Expected valid value");
 
-  auto &Store = V->getType()->getContext().pImpl->ValuesAsMetadata;
+  LLVMContextImpl *pImpl = V->getType()->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::MetadataTable);
+  auto &Store = pImpl->ValuesAsMetadata;
   auto I = Store.find(V);
   if (I == Store.end())
     return;
@@ -452,6 +463,7 @@ void ValueAsMetadata::handleRAUW(Value *From, Value *To) {
 //
 
 MDString *MDString::get(LLVMContext &Context, StringRef Str) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   auto &Store = Context.pImpl->MDStringCache;
   auto I = Store.try_emplace(Str);
   auto &MapEntry = I.first->getValue();
@@ -781,6 +793,7 @@ template <class NodeTy> struct MDNode::HasCachedHash {
 
 MDNode *MDNode::uniquify() {
   assert(!hasSelfReference(this) && "Cannot uniquify a self-referencing node");
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::MetadataTable);
 
   // Try to insert into uniquing store.
   switch (getMetadataID()) {
@@ -799,6 +812,7 @@ MDNode *MDNode::uniquify() {
 }
 
 void MDNode::eraseFromStore() {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::MetadataTable);
   switch (getMetadataID()) {
   default:
     llvm_unreachable("Invalid or non-uniquable subclass of MDNode");
@@ -812,6 +826,7 @@ void MDNode::eraseFromStore() {
 
 MDTuple *MDTuple::getImpl(LLVMContext &Context, ArrayRef<Metadata *> MDs,
                           StorageType Storage, bool ShouldCreate) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::MetadataTable);
   unsigned Hash = 0;
   if (Storage == Uniqued) {
     MDTupleInfo::KeyTy Key(MDs);
@@ -853,6 +868,7 @@ void MDNode::storeDistinctInContext() {
 #include "llvm/IR/Metadata.def"
   }
 
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::MetadataTable);
   getContext().pImpl->DistinctMDNodes.push_back(this);
 }
 
@@ -1200,6 +1216,8 @@ void Instruction::dropUnknownNonDebugMetadata(ArrayRef<unsigned> KnownIDs) {
   if (!hasMetadataHashEntry())
     return; // Nothing to remove!
 
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   auto &InstructionMetadata = getContext().pImpl->InstructionMetadata;
 
   SmallSet<unsigned, 4> KnownSet;
@@ -1233,6 +1251,9 @@ void Instruction::setMetadata(unsigned KindID, MDNode *Node) {
     return;
   }
 
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
+
   // Handle the case when we're adding/updating metadata on an instruction.
   if (Node) {
     auto &Info = getContext().pImpl->InstructionMetadata[this];
@@ -1275,6 +1296,8 @@ MDNode *Instruction::getMetadataImpl(unsigned KindID) const {
 
   if (!hasMetadataHashEntry())
     return nullptr;
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   auto &Info = getContext().pImpl->InstructionMetadata[this];
   assert(!Info.empty() && "bit out of sync with hash table");
 
@@ -1293,6 +1316,8 @@ void Instruction::getAllMetadataImpl(
       return;
   }
 
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   assert(hasMetadataHashEntry() &&
          getContext().pImpl->InstructionMetadata.count(this) &&
          "Shouldn't have called this");
@@ -1304,6 +1329,8 @@ void Instruction::getAllMetadataImpl(
 void Instruction::getAllMetadataOtherThanDebugLocImpl(
     SmallVectorImpl<std::pair<unsigned, MDNode *>> &Result) const {
   Result.clear();
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   assert(hasMetadataHashEntry() &&
          getContext().pImpl->InstructionMetadata.count(this) &&
          "Shouldn't have called this");
@@ -1375,14 +1402,19 @@ bool Instruction::extractProfTotalWeight(uint64_t &TotalVal) const {
 
 void Instruction::clearMetadataHashEntries() {
   assert(hasMetadataHashEntry() && "Caller should check");
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   getContext().pImpl->InstructionMetadata.erase(this);
   setHasMetadataHashEntry(false);
 }
 
 void GlobalObject::getMetadata(unsigned KindID,
                                SmallVectorImpl<MDNode *> &MDs) const {
-  if (hasMetadata())
-    getContext().pImpl->GlobalObjectMetadata[this].get(KindID, MDs);
+  if (!hasMetadata())
+    return;
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
+  getContext().pImpl->GlobalObjectMetadata[this].get(KindID, MDs);
 }
 
 void GlobalObject::getMetadata(StringRef Kind,
@@ -1395,6 +1427,8 @@ void GlobalObject::addMetadata(unsigned KindID, MDNode &MD) {
   if (!hasMetadata())
     setHasMetadataHashEntry(true);
 
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   getContext().pImpl->GlobalObjectMetadata[this].insert(KindID, MD);
 }
 
@@ -1407,6 +1441,8 @@ bool GlobalObject::eraseMetadata(unsigned KindID) {
   if (!hasMetadata())
     return false;
 
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   auto &Store = getContext().pImpl->GlobalObjectMetadata[this];
   bool Changed = Store.erase(KindID);
   if (Store.empty())
@@ -1421,12 +1457,16 @@ void GlobalObject::getAllMetadata(
   if (!hasMetadata())
     return;
 
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   getContext().pImpl->GlobalObjectMetadata[this].getAll(MDs);
 }
 
 void GlobalObject::clearMetadata() {
   if (!hasMetadata())
     return;
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
   getContext().pImpl->GlobalObjectMetadata.erase(this);
   setHasMetadataHashEntry(false);
 }
@@ -1442,9 +1482,11 @@ void GlobalObject::setMetadata(StringRef Kind, MDNode *N) {
 }
 
 MDNode *GlobalObject::getMetadata(unsigned KindID) const {
-  if (hasMetadata())
-    return getContext().pImpl->GlobalObjectMetadata[this].lookup(KindID);
-  return nullptr;
+  if (!hasMetadata())
+    return nullptr;
+  ContextTableLock Lock(getContext().pImpl,
+                        LLVMContextImpl::AttachmentsTable);
+  return getContext().pImpl->GlobalObjectMetadata[this].lookup(KindID);
 }
 
 MDNode *GlobalObject::getMetadata(StringRef Kind) const {
@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Module.h"
+#include "LLVMContextImpl.h"
 #include "SymbolTableListTraitsImpl.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
@@ -110,6 +111,7 @@ std::unique_ptr<RandomNumberGenerator> Module::createRNG(const Pass* P) const {
 /// the specified name, of arbitrary type.  This method returns null
 /// if a global with the specified name is not found.
 GlobalValue *Module::getNamedValue(StringRef Name) const {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::GlobalsTable);
   return cast_or_null<GlobalValue>(getValueSymbolTable().lookup(Name));
 }
 
@@ -141,6 +143,10 @@ void Module::getOperandBundleTags(SmallVectorImpl<StringRef> &Result) const {
 //
 Constant *Module::getOrInsertFunction(StringRef Name, FunctionType *Ty,
                                       AttributeList AttributeList) {
+  // Look up and insert the function at once if function passes run on
+  // several threads.
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::GlobalsTable);
+
   // See if we have a definition for the specified function already.
   GlobalValue *F = getNamedValue(Name);
   if (!F) {
@@ -202,6 +208,8 @@ GlobalVariable *Module::getGlobalVariable(StringRef Name,
 ///   3. Finally, if the existing global is the correct declaration, return the
 ///      existing global.
 Constant *Module::getOrInsertGlobal(StringRef Name, Type *Ty) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::GlobalsTable);
+
   // See if we have a definition for the specified global already.
   GlobalVariable *GV = dyn_cast_or_null<GlobalVariable>(getNamedValue(Name));
   if (!GV) {
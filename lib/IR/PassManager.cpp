@@ -10,6 +10,9 @@
 #include "llvm/IR/PassManager.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <atomic>
 
 using namespace llvm;
 
@@ -91,6 +94,71 @@ bool FunctionAnalysisManagerModuleProxy::Result::invalidate(
 }
 }
 
+ParallelModuleToFunctionPassAdaptor::ParallelModuleToFunctionPassAdaptor(
+    function_ref<FunctionPassManager()> BuildPipeline, unsigned ThreadCount) {
+  if (ThreadCount == 0)
+    ThreadCount = heavyweight_hardware_concurrency();
+  for (unsigned Thread = 0; Thread != ThreadCount; ++Thread)
+    Pipelines.push_back(BuildPipeline());
+}
+
+PreservedAnalyses ParallelModuleToFunctionPassAdaptor::run(
+    Module &M, ModuleAnalysisManager &AM) {
+  FunctionAnalysisManager &FAM =
+      AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+  // The passes may add declarations to the module while the threads run, so
+  // take the functions to optimize up front.
+  std::vector<Function *> Functions;
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      Functions.push_back(&F);
+
+  unsigned ThreadCount = std::min<size_t>(Pipelines.size(), Functions.size());
+  std::vector<PreservedAnalyses> ThreadPAs(ThreadCount,
+                                           PreservedAnalyses::all());
+  std::atomic<unsigned> NextFunction(0);
+  auto RunPipeline = [&](unsigned Thread) {
+    for (unsigned I = NextFunction++; I < Functions.size();
+         I = NextFunction++) {
+      Function &F = *Functions[I];
+      PreservedAnalyses PassPA;
+      {
+        ValueArenaScope ArenaScope(F.getArena());
+        PassPA = Pipelines[Thread].run(F, FAM);
+      }
+
+      // As in ModuleToFunctionPassAdaptor, the pipeline only invalidated the
+      // analyses of F.
+      FAM.invalidate(F, PassPA);
+      ThreadPAs[Thread].intersect(std::move(PassPA));
+    }
+  };
+
+  if (ThreadCount > 1) {
+    M.getContext().enableThreadSafety();
+    FAM.enableThreadSafety();
+
+    // The calling thread runs the first pipeline.
+    ThreadPool Pool(ThreadCount - 1);
+    for (unsigned Thread = 1; Thread != ThreadCount; ++Thread)
+      Pool.async(RunPipeline, Thread);
+    RunPipeline(0);
+    Pool.wait();
+  } else if (ThreadCount == 1) {
+    RunPipeline(0);
+  }
+
+  PreservedAnalyses PA = PreservedAnalyses::all();
+  for (PreservedAnalyses &ThreadPA : ThreadPAs)
+    PA.intersect(std::move(ThreadPA));
+
+  // See ModuleToFunctionPassAdaptor::run.
+  PA.preserveSet<AllAnalysesOn<Function>>();
+  PA.preserve<FunctionAnalysisManagerModuleProxy>();
+  return PA;
+}
+
 AnalysisSetKey CFGAnalyses::SetKey;
 
 AnalysisSetKey PreservedAnalyses::AllAnalysesKey;
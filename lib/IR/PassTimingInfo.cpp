@@ -19,6 +19,7 @@
 #include "llvm/IR/PassTimingInfo.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/CommandLine.h"
@@ -42,19 +43,27 @@ static cl::opt<bool, true> EnableTiming(
     "time-passes", cl::location(TimePassesIsEnabled), cl::Hidden,
     cl::desc("Time each pass, printing elapsed time for each on exit"));
 
+static cl::opt<bool> TimePassesPerFunction(
+    "time-passes-per-function", cl::Hidden,
+    cl::desc("With -time-passes, also print the time spent in the passes run "
+             "on each function"));
+
 namespace {
 static ManagedStatic<sys::SmartMutex<true>> TimingInfoMutex;
 }
 
 template <typename PassT>
 PassTimingInfo<PassT>::PassTimingInfo()
-    : TG("pass", "... Pass execution timing report ...") {}
+    : TG("pass", "... Pass execution timing report ..."),
+      FunctionTG("function", "... Function execution timing report ...") {}
 
 template <typename PassT> PassTimingInfo<PassT>::~PassTimingInfo() {
-  // Deleting the timers accumulates their info into the TG member.
-  // Then TG member is (implicitly) deleted, actually printing the report.
+  // Deleting the timers accumulates their info into the TG members.
+  // Then TG members are (implicitly) deleted, actually printing the reports.
   for (auto &I : TimingData)
     delete I.getSecond();
+  for (auto &I : FunctionTimingData)
+    delete I.getValue();
 }
 
 template <typename PassT> void PassTimingInfo<PassT>::init() {
@@ -71,6 +80,7 @@ template <typename PassT> void PassTimingInfo<PassT>::init() {
 /// Prints out timing information and then resets the timers.
 template <typename PassT> void PassTimingInfo<PassT>::print() {
   TG.print(*CreateInfoOutputFile());
+  FunctionTG.print(*CreateInfoOutputFile());
 }
 
 template <typename PassInfoT>
@@ -117,6 +127,23 @@ Timer *PassTimingInfo<Pass *>::getPassTimer(Pass *P, PassInstanceID Pass) {
   return T;
 }
 
+template <typename PassInfoT>
+Timer *PassTimingInfo<PassInfoT>::getFunctionTimer(StringRef FunctionName) {
+  if (!TimePassesPerFunction)
+    return nullptr;
+
+  sys::SmartScopedLock<true> Lock(*TimingInfoMutex);
+  Timer *&T = FunctionTimingData[FunctionName];
+  if (!T) {
+    // Keep the timer name usable as a key of the JSON statistics.
+    std::string TimerName = "fn.";
+    for (char C : FunctionName)
+      TimerName += isAlnum(C) ? C : '_';
+    T = new Timer(TimerName, FunctionName, FunctionTG);
+  }
+  return T;
+}
+
 template <typename PassInfoT>
 PassTimingInfo<PassInfoT> *PassTimingInfo<PassInfoT>::TheTimeInfo;
 
@@ -138,6 +165,13 @@ Timer *getPassTimer(StringRef PassName) {
   return nullptr;
 }
 
+Timer *getFunctionTimer(StringRef FunctionName) {
+  PassTimingInfo<Pass *>::init();
+  if (PassTimingInfo<Pass *>::TheTimeInfo)
+    return PassTimingInfo<Pass *>::TheTimeInfo->getFunctionTimer(FunctionName);
+  return nullptr;
+}
+
 /// If timing is enabled, report the times collected up to now and then reset
 /// them.
 void reportAndResetTimings() {
@@ -0,0 +1,395 @@
+//===- StructuralHash.cpp - Content hash of a function --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements StructuralHash, which hashes a function the way
+// FunctionComparator walks it, but looks at every operand.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/MD5.h"
+
+using namespace llvm;
+
+namespace {
+
+// Accumulate a hash like FunctionComparator does. The hash of a value only
+// depends on its contents: the IDs the context gives to custom metadata kinds
+// and sync scopes vary across executions, so they are hashed by name.
+class HashAccumulator64 {
+  uint64_t Hash = 0x6acaa36bef8325c5ULL;
+
+public:
+  void add(uint64_t V) { Hash = hashing::detail::hash_16_bytes(Hash, V); }
+  void addString(StringRef S) {
+    add(S.size());
+    add(MD5Hash(S));
+  }
+  uint64_t getHash() const { return Hash; }
+};
+
+class StructuralHasher {
+  const Function &F;
+  HashAccumulator64 H;
+
+  /// The numbers of the arguments, blocks and instructions of F.
+  DenseMap<const Value *, unsigned> LocalNumbers;
+  /// The numbers of the metadata visited so far, to hash cycles.
+  DenseMap<const Metadata *, unsigned> MDNumbers;
+  DenseMap<const Type *, uint64_t> TypeHashes;
+  DenseMap<const Constant *, uint64_t> ConstantHashes;
+  /// The globals referenced by the body of F.
+  SetVector<const GlobalValue *> Globals;
+  bool InBody = true;
+
+  SmallVector<StringRef, 8> MDKindNames;
+  SmallVector<StringRef, 8> SyncScopeNames;
+
+public:
+  explicit StructuralHasher(const Function &F) : F(F) {
+    F.getContext().getMDKindNames(MDKindNames);
+    F.getContext().getSyncScopeNames(SyncScopeNames);
+  }
+
+  uint64_t run();
+
+private:
+  uint64_t hashType(Type *T);
+  uint64_t hashConstant(const Constant *C);
+  void addValue(HashAccumulator64 &Acc, const Value *V);
+  void addMetadata(HashAccumulator64 &Acc, const Metadata *MD);
+  void addAttributes(HashAccumulator64 &Acc, AttributeList Attrs);
+  void addSyncScope(HashAccumulator64 &Acc, SyncScope::ID SSID);
+  void addAttachments(ArrayRef<std::pair<unsigned, MDNode *>> MDs);
+  void addInstruction(const Instruction &I);
+  void addGlobal(const GlobalValue &GV);
+};
+
+} // end anonymous namespace
+
+uint64_t StructuralHasher::hashType(Type *T) {
+  auto It = TypeHashes.find(T);
+  if (It != TypeHashes.end())
+    return It->second;
+
+  HashAccumulator64 Acc;
+  Acc.add(T->getTypeID());
+  switch (T->getTypeID()) {
+  case Type::IntegerTyID:
+    Acc.add(T->getIntegerBitWidth());
+    break;
+  case Type::PointerTyID:
+    Acc.add(T->getPointerAddressSpace());
+    Acc.add(hashType(T->getPointerElementType()));
+    break;
+  case Type::ArrayTyID:
+  case Type::VectorTyID:
+    Acc.add(cast<SequentialType>(T)->getNumElements());
+    Acc.add(hashType(T->getSequentialElementType()));
+    break;
+  case Type::FunctionTyID:
+    Acc.add(T->isFunctionVarArg());
+    for (Type *Sub : T->subtypes())
+      Acc.add(hashType(Sub));
+    break;
+  case Type::StructTyID: {
+    auto *ST = cast<StructType>(T);
+    // A named struct may contain a pointer to itself, so its name stands for
+    // it while its body is hashed.
+    if (ST->hasName()) {
+      Acc.addString(ST->getName());
+      TypeHashes[T] = Acc.getHash();
+    }
+    Acc.add(ST->isPacked());
+    Acc.add(ST->isOpaque());
+    for (Type *Sub : ST->elements())
+      Acc.add(hashType(Sub));
+    break;
+  }
+  default:
+    break;
+  }
+  return TypeHashes[T] = Acc.getHash();
+}
+
+uint64_t StructuralHasher::hashConstant(const Constant *C) {
+  auto It = ConstantHashes.find(C);
+  if (It != ConstantHashes.end())
+    return It->second;
+
+  HashAccumulator64 Acc;
+  Acc.add(C->getValueID());
+  Acc.add(hashType(C->getType()));
+  if (auto *GV = dyn_cast<GlobalValue>(C)) {
+    // The contents of the global are hashed once the body is done.
+    Acc.addString(GV->getName());
+    if (InBody)
+      Globals.insert(GV);
+  } else if (auto *CI = dyn_cast<ConstantInt>(C)) {
+    for (uint64_t Word : makeArrayRef(CI->getValue().getRawData(),
+                                      CI->getValue().getNumWords()))
+      Acc.add(Word);
+  } else if (auto *CFP = dyn_cast<ConstantFP>(C)) {
+    APInt Bits = CFP->getValueAPF().bitcastToAPInt();
+    for (uint64_t Word : makeArrayRef(Bits.getRawData(), Bits.getNumWords()))
+      Acc.add(Word);
+  } else if (auto *CDS = dyn_cast<ConstantDataSequential>(C)) {
+    Acc.addString(CDS->getRawDataValues());
+  } else if (auto *BA = dyn_cast<BlockAddress>(C)) {
+    Acc.add(hashConstant(BA->getFunction()));
+    unsigned Number = 0;
+    for (const BasicBlock &BB : *BA->getFunction()) {
+      if (&BB == BA->getBasicBlock())
+        break;
+      ++Number;
+    }
+    Acc.add(Number);
+  } else {
+    if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+      Acc.add(CE->getOpcode());
+      Acc.add(CE->getRawSubclassOptionalData());
+      if (CE->isCompare())
+        Acc.add(CE->getPredicate());
+      if (CE->hasIndices())
+        for (unsigned Idx : CE->getIndices())
+          Acc.add(Idx);
+      if (auto *GEP = dyn_cast<GEPOperator>(CE))
+        Acc.add(hashType(GEP->getSourceElementType()));
+    }
+    for (const Use &Op : C->operands())
+      Acc.add(hashConstant(cast<Constant>(Op)));
+  }
+  return ConstantHashes[C] = Acc.getHash();
+}
+
+void StructuralHasher::addValue(HashAccumulator64 &Acc, const Value *V) {
+  Acc.add(V->getValueID());
+  if (auto *C = dyn_cast<Constant>(V)) {
+    Acc.add(hashConstant(C));
+    return;
+  }
+  if (auto *MAV = dyn_cast<MetadataAsValue>(V)) {
+    addMetadata(Acc, MAV->getMetadata());
+    return;
+  }
+  if (auto *IA = dyn_cast<InlineAsm>(V)) {
+    Acc.add(hashType(IA->getFunctionType()));
+    Acc.addString(IA->getAsmString());
+    Acc.addString(IA->getConstraintString());
+    Acc.add(IA->hasSideEffects());
+    Acc.add(IA->isAlignStack());
+    Acc.add(IA->getDialect());
+    return;
+  }
+  // An argument, a block or an instruction of F, or of another function for
+  // the uses of a broken module.
+  auto It = LocalNumbers.find(V);
+  Acc.add(It == LocalNumbers.end() ? ~0u : It->second);
+}
+
+void StructuralHasher::addMetadata(HashAccumulator64 &Acc,
+                                   const Metadata *MD) {
+  if (!MD) {
+    Acc.add(0);
+    return;
+  }
+  auto Inserted = MDNumbers.insert({MD, MDNumbers.size()});
+  if (!Inserted.second) {
+    Acc.add(1);
+    Acc.add(Inserted.first->second);
+    return;
+  }
+
+  Acc.add(2);
+  Acc.add(MD->getMetadataID());
+  if (auto *S = dyn_cast<MDString>(MD)) {
+    Acc.addString(S->getString());
+  } else if (auto *VAM = dyn_cast<ValueAsMetadata>(MD)) {
+    addValue(Acc, VAM->getValue());
+  } else if (auto *N = dyn_cast<MDNode>(MD)) {
+    Acc.add(N->isDistinct());
+    Acc.add(N->getNumOperands());
+    for (const MDOperand &Op : N->operands())
+      addMetadata(Acc, Op);
+  }
+}
+
+void StructuralHasher::addAttributes(HashAccumulator64 &Acc,
+                                     AttributeList Attrs) {
+  for (unsigned Index = Attrs.index_begin(), End = Attrs.index_end();
+       Index != End; ++Index) {
+    if (!Attrs.hasAttributes(Index))
+      continue;
+    Acc.add(Index);
+    Acc.addString(Attrs.getAsString(Index));
+  }
+}
+
+void StructuralHasher::addSyncScope(HashAccumulator64 &Acc,
+                                    SyncScope::ID SSID) {
+  Acc.addString(SSID < SyncScopeNames.size() ? SyncScopeNames[SSID]
+                                             : StringRef());
+}
+
+void StructuralHasher::addAttachments(
+    ArrayRef<std::pair<unsigned, MDNode *>> MDs) {
+  H.add(MDs.size());
+  for (const auto &MD : MDs) {
+    H.addString(MD.first < MDKindNames.size() ? MDKindNames[MD.first]
+                                              : StringRef());
+    addMetadata(H, MD.second);
+  }
+}
+
+void StructuralHasher::addInstruction(const Instruction &I) {
+  H.add(I.getOpcode());
+  H.add(hashType(I.getType()));
+  H.add(I.getRawSubclassOptionalData());
+  H.add(I.getNumOperands());
+  for (const Use &Op : I.operands())
+    addValue(H, Op);
+
+  if (auto *AI = dyn_cast<AllocaInst>(&I)) {
+    H.add(hashType(AI->getAllocatedType()));
+    H.add(AI->getAlignment());
+    H.add(AI->isUsedWithInAlloca());
+    H.add(AI->isSwiftError());
+  } else if (auto *LI = dyn_cast<LoadInst>(&I)) {
+    H.add(LI->isVolatile());
+    H.add(LI->getAlignment());
+    H.add((unsigned)LI->getOrdering());
+    addSyncScope(H, LI->getSyncScopeID());
+  } else if (auto *SI = dyn_cast<StoreInst>(&I)) {
+    H.add(SI->isVolatile());
+    H.add(SI->getAlignment());
+    H.add((unsigned)SI->getOrdering());
+    addSyncScope(H, SI->getSyncScopeID());
+  } else if (auto *CI = dyn_cast<CmpInst>(&I)) {
+    H.add(CI->getPredicate());
+  } else if (auto CS = ImmutableCallSite(&I)) {
+    H.add(hashType(CS.getFunctionType()));
+    H.add(CS.getCallingConv());
+    addAttributes(H, CS.getAttributes());
+    if (CS.isCall())
+      H.add(cast<CallInst>(&I)->getTailCallKind());
+    for (unsigned Idx = 0, E = CS.getNumOperandBundles(); Idx != E; ++Idx)
+      H.addString(CS.getOperandBundleAt(Idx).getTagName());
+  } else if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
+    H.add(hashType(GEP->getSourceElementType()));
+  } else if (auto *EVI = dyn_cast<ExtractValueInst>(&I)) {
+    for (unsigned Idx : EVI->indices())
+      H.add(Idx);
+  } else if (auto *IVI = dyn_cast<InsertValueInst>(&I)) {
+    for (unsigned Idx : IVI->indices())
+      H.add(Idx);
+  } else if (auto *FI = dyn_cast<FenceInst>(&I)) {
+    H.add((unsigned)FI->getOrdering());
+    addSyncScope(H, FI->getSyncScopeID());
+  } else if (auto *CXI = dyn_cast<AtomicCmpXchgInst>(&I)) {
+    H.add(CXI->isVolatile());
+    H.add(CXI->isWeak());
+    H.add((unsigned)CXI->getSuccessOrdering());
+    H.add((unsigned)CXI->getFailureOrdering());
+    addSyncScope(H, CXI->getSyncScopeID());
+  } else if (auto *RMWI = dyn_cast<AtomicRMWInst>(&I)) {
+    H.add(RMWI->getOperation());
+    H.add(RMWI->isVolatile());
+    H.add((unsigned)RMWI->getOrdering());
+    addSyncScope(H, RMWI->getSyncScopeID());
+  } else if (auto *PN = dyn_cast<PHINode>(&I)) {
+    for (const BasicBlock *BB : PN->blocks())
+      addValue(H, BB);
+  } else if (auto *LPI = dyn_cast<LandingPadInst>(&I)) {
+    H.add(LPI->isCleanup());
+  }
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  I.getAllMetadata(MDs);
+  addAttachments(MDs);
+}
+
+void StructuralHasher::addGlobal(const GlobalValue &GV) {
+  H.add(hashConstant(&GV));
+  H.add(GV.getLinkage());
+  H.add(GV.getVisibility());
+  H.add(GV.isDeclaration());
+  if (auto *Callee = dyn_cast<Function>(&GV)) {
+    addAttributes(H, Callee->getAttributes());
+    H.add(Callee->getCallingConv());
+  } else if (auto *GVar = dyn_cast<GlobalVariable>(&GV)) {
+    H.add(GVar->isConstant());
+    H.add(GVar->getAlignment());
+    H.add(GVar->isExternallyInitialized());
+    // The passes may fold the loads from a constant global.
+    H.add(GVar->isConstant() && GVar->hasDefinitiveInitializer());
+    if (GVar->isConstant() && GVar->hasDefinitiveInitializer())
+      H.add(hashConstant(GVar->getInitializer()));
+  }
+}
+
+uint64_t StructuralHasher::run() {
+  H.addString(F.getName());
+  H.add(hashType(F.getFunctionType()));
+  H.add(F.getLinkage());
+  H.add(F.getVisibility());
+  H.add(F.getCallingConv());
+  H.add(F.getAlignment());
+  H.addString(F.hasSection() ? F.getSection() : StringRef());
+  H.addString(F.hasGC() ? F.getGC() : std::string());
+  addAttributes(H, F.getAttributes());
+  for (const Constant *C :
+       {F.hasPersonalityFn() ? F.getPersonalityFn() : nullptr,
+        F.hasPrefixData() ? F.getPrefixData() : nullptr,
+        F.hasPrologueData() ? F.getPrologueData() : nullptr})
+    H.add(C ? hashConstant(C) : 0);
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  F.getAllMetadata(MDs);
+  addAttachments(MDs);
+
+  for (const Argument &A : F.args())
+    LocalNumbers[&A] = LocalNumbers.size();
+  for (const BasicBlock &BB : F) {
+    LocalNumbers[&BB] = LocalNumbers.size();
+    for (const Instruction &I : BB)
+      LocalNumbers[&I] = LocalNumbers.size();
+  }
+
+  H.add(F.size());
+  for (const BasicBlock &BB : F) {
+    // This acts as a block header, as otherwise the partition of the
+    // instructions into blocks would not affect the hash.
+    H.add(45798);
+    for (const Instruction &I : BB)
+      addInstruction(I);
+  }
+
+  // The initializers may refer to other globals, which are not followed.
+  InBody = false;
+  H.add(Globals.size());
+  for (const GlobalValue *GV : Globals)
+    addGlobal(*GV);
+  return H.getHash();
+}
+
+uint64_t llvm::StructuralHash(const Function &F) {
+  return StructuralHasher(F).run();
+}
@@ -48,7 +48,7 @@ void SymbolTableListTraits<ValueSubClass>::setSymTabObject(TPtr *Dest,
     // Remove all entries from the previous symtab.
     for (auto I = ItemList.begin(); I != ItemList.end(); ++I)
       if (I->hasName())
-        OldST->removeValueName(I->getValueName());
+        OldST->removeValue(&*I);
   }
 
   if (NewST) {
@@ -76,7 +76,7 @@ void SymbolTableListTraits<ValueSubClass>::removeNodeFromList(
   V->setParent(nullptr);
   if (V->hasName())
     if (ValueSymbolTable *ST = getSymTab(getListOwner()))
-      ST->removeValueName(V->getValueName());
+      ST->removeValue(V);
 }
 
 template <typename ValueSubClass>
@@ -95,7 +95,7 @@ void SymbolTableListTraits<ValueSubClass>::transferNodesFromList(
       ValueSubClass &V = *first;
       bool HasName = V.hasName();
       if (OldST && HasName)
-        OldST->removeValueName(V.getValueName());
+        OldST->removeValue(&V);
       V.setParent(NewIP);
       if (NewST && HasName)
         NewST->reinsertValue(&V);
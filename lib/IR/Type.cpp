@@ -253,6 +253,7 @@ IntegerType *IntegerType::get(LLVMContext &C, unsigned NumBits) {
     break;
   }
 
+  ContextTableLock Lock(C.pImpl, LLVMContextImpl::TypesTable);
   IntegerType *&Entry = C.pImpl->IntegerTypes[NumBits];
 
   if (!Entry)
@@ -297,6 +298,7 @@ FunctionType::FunctionType(Type *Result, ArrayRef<Type*> Params,
 FunctionType *FunctionType::get(Type *ReturnType,
                                 ArrayRef<Type*> Params, bool isVarArg) {
   LLVMContextImpl *pImpl = ReturnType->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::TypesTable);
   FunctionTypeKeyInfo::KeyTy Key(ReturnType, Params, isVarArg);
   auto I = pImpl->FunctionTypes.find_as(Key);
   FunctionType *FT;
@@ -336,6 +338,7 @@ bool FunctionType::isValidArgumentType(Type *ArgTy) {
 StructType *StructType::get(LLVMContext &Context, ArrayRef<Type*> ETypes,
                             bool isPacked) {
   LLVMContextImpl *pImpl = Context.pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::TypesTable);
   AnonStructTypeKeyInfo::KeyTy Key(ETypes, isPacked);
   auto I = pImpl->AnonStructTypes.find_as(Key);
   StructType *ST;
@@ -367,10 +370,12 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
     return;
   }
 
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::TypesTable);
   ContainedTys = Elements.copy(getContext().pImpl->TypeAllocator).data();
 }
 
 void StructType::setName(StringRef Name) {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::TypesTable);
   if (Name == getName()) return;
 
   StringMap<StructType *> &SymbolTable = getContext().pImpl->NamedStructTypes;
@@ -422,6 +427,7 @@ void StructType::setName(StringRef Name) {
 // StructType Helper functions.
 
 StructType *StructType::create(LLVMContext &Context, StringRef Name) {
+  ContextTableLock Lock(Context.pImpl, LLVMContextImpl::TypesTable);
   StructType *ST = new (Context.pImpl->TypeAllocator) StructType(Context);
   if (!Name.empty())
     ST->setName(Name);
@@ -507,6 +513,7 @@ bool StructType::isLayoutIdentical(StructType *Other) const {
 }
 
 StructType *Module::getTypeByName(StringRef Name) const {
+  ContextTableLock Lock(getContext().pImpl, LLVMContextImpl::TypesTable);
   return getContext().pImpl->NamedStructTypes.lookup(Name);
 }
 
@@ -569,6 +576,7 @@ ArrayType *ArrayType::get(Type *ElementType, uint64_t NumElements) {
   assert(isValidElementType(ElementType) && "Invalid type for array element!");
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::TypesTable);
   ArrayType *&Entry =
     pImpl->ArrayTypes[std::make_pair(ElementType, NumElements)];
 
@@ -597,6 +605,7 @@ VectorType *VectorType::get(Type *ElementType, unsigned NumElements) {
                                             "pointer type.");
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::TypesTable);
   VectorType *&Entry = ElementType->getContext().pImpl
     ->VectorTypes[std::make_pair(ElementType, NumElements)];
 
@@ -619,6 +628,7 @@ PointerType *PointerType::get(Type *EltTy, unsigned AddressSpace) {
   assert(isValidElementType(EltTy) && "Invalid type for pointer element!");
 
   LLVMContextImpl *CImpl = EltTy->getContext().pImpl;
+  ContextTableLock Lock(CImpl, LLVMContextImpl::TypesTable);
 
   // Since AddressSpace #0 is the common case, we special case it.
   PointerType *&Entry = AddressSpace == 0 ? CImpl->PointerTypes[EltTy]
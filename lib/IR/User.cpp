@@ -10,6 +10,7 @@
 #include "llvm/IR/User.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/ValueArena.h"
 
 namespace llvm {
 class BasicBlock;
@@ -50,7 +51,17 @@ void User::allocHungoffUses(unsigned N, bool IsPhi) {
   size_t size = N * sizeof(Use) + sizeof(Use::UserRef);
   if (IsPhi)
     size += N * sizeof(BasicBlock *);
-  Use *Begin = static_cast<Use*>(::operator new(size));
+  // The uses of a User allocated from an arena come from an arena too: the
+  // current one, which the calling thread may allocate from, or else the one
+  // of the User.
+  Use *Begin;
+  if (IsArenaAllocated) {
+    ValueArena *Arena = ValueArena::getCurrent();
+    if (!Arena)
+      Arena = ValueArena::getArenaOf(reinterpret_cast<Use **>(this) - 1);
+    Begin = static_cast<Use *>(Arena->allocate(size));
+  } else
+    Begin = static_cast<Use *>(::operator new(size));
   Use *End = Begin + N;
   (void) new(End) Use::UserRef(const_cast<User*>(this), 1);
   setOperandList(Use::initTags(Begin, End));
@@ -80,7 +91,15 @@ void User::growHungoffUses(unsigned NewNumUses, bool IsPhi) {
         reinterpret_cast<char *>(NewOps + NewNumUses) + sizeof(Use::UserRef);
     std::copy(OldPtr, OldPtr + (OldNumUses * sizeof(BasicBlock *)), NewPtr);
   }
-  Use::zap(OldOps, OldOps + OldNumUses, true);
+  Use::zap(OldOps, OldOps + OldNumUses);
+  deallocateHungoffUses(OldOps);
+}
+
+void User::deallocateHungoffUses(Use *Ops) {
+  if (IsArenaAllocated)
+    ValueArena::deallocate(Ops);
+  else
+    ::operator delete(Ops);
 }
 
 
@@ -111,7 +130,7 @@ MutableArrayRef<uint8_t> User::getDescriptor() {
 //===----------------------------------------------------------------------===//
 
 void *User::allocateFixedOperandUser(size_t Size, unsigned Us,
-                                     unsigned DescBytes) {
+                                     unsigned DescBytes, ValueArena *Arena) {
   assert(Us < (1u << NumUserOperandsBits) && "Too many operands");
 
   static_assert(sizeof(DescriptorInfo) % sizeof(void *) == 0, "Required below");
@@ -121,14 +140,16 @@ void *User::allocateFixedOperandUser(size_t Size, unsigned Us,
   assert(DescBytesToAllocate % sizeof(void *) == 0 &&
          "We need this to satisfy alignment constraints for Uses");
 
+  size_t TotalSize = Size + sizeof(Use) * Us + DescBytesToAllocate;
   uint8_t *Storage = static_cast<uint8_t *>(
-      ::operator new(Size + sizeof(Use) * Us + DescBytesToAllocate));
+      Arena ? Arena->allocate(TotalSize) : ::operator new(TotalSize));
   Use *Start = reinterpret_cast<Use *>(Storage + DescBytesToAllocate);
   Use *End = Start + Us;
   User *Obj = reinterpret_cast<User*>(End);
   Obj->NumUserOperands = Us;
   Obj->HasHungOffUses = false;
   Obj->HasDescriptor = DescBytes != 0;
+  Obj->IsArenaAllocated = Arena != nullptr;
   Use::initTags(Start, End);
 
   if (DescBytes != 0) {
@@ -140,29 +161,51 @@ void *User::allocateFixedOperandUser(size_t Size, unsigned Us,
 }
 
 void *User::operator new(size_t Size, unsigned Us) {
-  return allocateFixedOperandUser(Size, Us, 0);
+  return allocateFixedOperandUser(Size, Us, 0, nullptr);
 }
 
 void *User::operator new(size_t Size, unsigned Us, unsigned DescBytes) {
-  return allocateFixedOperandUser(Size, Us, DescBytes);
+  return allocateFixedOperandUser(Size, Us, DescBytes, nullptr);
 }
 
-void *User::operator new(size_t Size) {
+void *User::allocateUser(size_t Size, unsigned Us, unsigned DescBytes,
+                         ValueArena *Arena) {
+  return allocateFixedOperandUser(Size, Us, DescBytes, Arena);
+}
+
+void *User::allocateHungoffOperandUser(size_t Size, ValueArena *Arena) {
   // Allocate space for a single Use*
-  void *Storage = ::operator new(Size + sizeof(Use *));
+  size_t TotalSize = Size + sizeof(Use *);
+  void *Storage = Arena ? Arena->allocate(TotalSize) : ::operator new(TotalSize);
   Use **HungOffOperandList = static_cast<Use **>(Storage);
   User *Obj = reinterpret_cast<User *>(HungOffOperandList + 1);
   Obj->NumUserOperands = 0;
   Obj->HasHungOffUses = true;
   Obj->HasDescriptor = false;
+  Obj->IsArenaAllocated = Arena != nullptr;
   *HungOffOperandList = nullptr;
   return Obj;
 }
 
+void *User::operator new(size_t Size) {
+  return allocateHungoffOperandUser(Size, nullptr);
+}
+
+void *User::allocateUser(size_t Size, ValueArena *Arena) {
+  return allocateHungoffOperandUser(Size, Arena);
+}
+
 //===----------------------------------------------------------------------===//
 //                         User operator delete Implementation
 //===----------------------------------------------------------------------===//
 
+static void deallocateStorage(void *Storage, bool IsArenaAllocated) {
+  if (IsArenaAllocated)
+    ValueArena::deallocate(Storage);
+  else
+    ::operator delete(Storage);
+}
+
 void User::operator delete(void *Usr) {
   // Hung off uses use a single Use* before the User, while other subclasses
   // use a Use[] allocated prior to the user.
@@ -172,21 +215,23 @@ void User::operator delete(void *Usr) {
 
     Use **HungOffOperandList = static_cast<Use **>(Usr) - 1;
     // drop the hung off uses.
-    Use::zap(*HungOffOperandList, *HungOffOperandList + Obj->NumUserOperands,
-             /* Delete */ true);
-    ::operator delete(HungOffOperandList);
+    Use *Ops = *HungOffOperandList;
+    Use::zap(Ops, Ops + Obj->NumUserOperands, /* Delete */ false);
+    if (Ops)
+      Obj->deallocateHungoffUses(Ops);
+    deallocateStorage(HungOffOperandList, Obj->IsArenaAllocated);
   } else if (Obj->HasDescriptor) {
     Use *UseBegin = static_cast<Use *>(Usr) - Obj->NumUserOperands;
     Use::zap(UseBegin, UseBegin + Obj->NumUserOperands, /* Delete */ false);
 
     auto *DI = reinterpret_cast<DescriptorInfo *>(UseBegin) - 1;
     uint8_t *Storage = reinterpret_cast<uint8_t *>(DI) - DI->SizeInBytes;
-    ::operator delete(Storage);
+    deallocateStorage(Storage, Obj->IsArenaAllocated);
   } else {
     Use *Storage = static_cast<Use *>(Usr) - Obj->NumUserOperands;
     Use::zap(Storage, Storage + Obj->NumUserOperands,
              /* Delete */ false);
-    ::operator delete(Storage);
+    deallocateStorage(Storage, Obj->IsArenaAllocated);
   }
 }
 
@@ -16,6 +16,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Argument.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
@@ -71,8 +72,9 @@ Value::Value(Type *ty, unsigned scid)
 }
 
 Value::~Value() {
-  // Notify all ValueHandles (if present) that this value is going away.
-  if (HasValueHandle)
+  // Notify all ValueHandles (if present) that this value is going away. The
+  // flag of a shared value is only read under the lock of the handles.
+  if (hasSharedUseList() || HasValueHandle)
     ValueHandleBase::ValueIsDeleted(this);
   if (isUsedByMetadata())
     ValueAsMetadata::handleDeletion(this);
@@ -123,6 +125,8 @@ void Value::deleteValue() {
 }
 
 void Value::destroyValueName() {
+  if (dropBorrowedName())
+    return;
   ValueName *Name = getValueName();
   if (Name)
     Name->Destroy();
@@ -130,6 +134,9 @@ void Value::destroyValueName() {
 }
 
 bool Value::hasNUses(unsigned N) const {
+  if (hasUseCount())
+    return getUseCount() == N;
+
   const_use_iterator UI = use_begin(), E = use_end();
 
   for (; N; --N, ++UI)
@@ -138,6 +145,9 @@ bool Value::hasNUses(unsigned N) const {
 }
 
 bool Value::hasNUsesOrMore(unsigned N) const {
+  if (hasUseCount())
+    return getUseCount() >= N;
+
   const_use_iterator UI = use_begin(), E = use_end();
 
   for (; N; --N, ++UI)
@@ -168,6 +178,8 @@ bool Value::isUsedInBasicBlock(const BasicBlock *BB) const {
 }
 
 unsigned Value::getNumUses() const {
+  if (hasUseCount())
+    return getUseCount();
   return (unsigned)std::distance(use_begin(), use_end());
 }
 
@@ -196,16 +208,62 @@ static bool getSymTab(Value *V, ValueSymbolTable *&ST) {
 ValueName *Value::getValueName() const {
   if (!HasName) return nullptr;
 
+  if (ValueName *VN = findValueName())
+    return VN;
+  return const_cast<Value *>(this)->materializeBorrowedName();
+}
+
+ValueName *Value::findValueName() const {
   LLVMContext &Ctx = getContext();
+  ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
   auto I = Ctx.pImpl->ValueNames.find(this);
-  assert(I != Ctx.pImpl->ValueNames.end() &&
-         "No name entry found!");
+  if (I != Ctx.pImpl->ValueNames.end())
+    return I->second;
+  assert(Ctx.pImpl->BorrowedValueNames.count(this) && "No name entry found!");
+  return nullptr;
+}
+
+bool Value::hasBorrowedName() const {
+  if (!HasName)
+    return false;
+  LLVMContext &Ctx = getContext();
+  ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
+  return Ctx.pImpl->BorrowedValueNames.count(this);
+}
 
-  return I->second;
+ValueName *Value::materializeBorrowedName() {
+  LLVMContext &Ctx = getContext();
+  ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
+  auto I = Ctx.pImpl->BorrowedValueNames.find(this);
+  StringRef Name = I->second;
+  Ctx.pImpl->BorrowedValueNames.erase(I);
+
+  // Replace the borrowed entry of the symbol table, if the value is in one.
+  ValueSymbolTable *ST;
+  getSymTab(this, ST);
+  ValueName *VN = ST ? ST->materializeBorrowedName(Name, this) : nullptr;
+  if (!VN) {
+    VN = ValueName::Create(Name);
+    VN->setValue(this);
+  }
+  Ctx.pImpl->ValueNames[this] = VN;
+  return VN;
+}
+
+bool Value::dropBorrowedName() {
+  if (!HasName)
+    return false;
+  LLVMContext &Ctx = getContext();
+  ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
+  if (!Ctx.pImpl->BorrowedValueNames.erase(this))
+    return false;
+  HasName = false;
+  return true;
 }
 
 void Value::setValueName(ValueName *VN) {
   LLVMContext &Ctx = getContext();
+  ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
 
   assert(HasName == Ctx.pImpl->ValueNames.count(this) &&
          "HasName bit out of sync!");
@@ -227,7 +285,11 @@ StringRef Value::getName() const {
   // terminated.
   if (!hasName())
     return StringRef("", 0);
-  return getValueName()->getKey();
+  if (ValueName *VN = findValueName())
+    return VN->getKey();
+  LLVMContext &Ctx = getContext();
+  ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
+  return Ctx.pImpl->BorrowedValueNames.lookup(this);
 }
 
 void Value::setNameImpl(const Twine &NewName) {
@@ -298,6 +360,36 @@ void Value::setName(const Twine &NewName) {
     F->recalculateIntrinsicID();
 }
 
+void Value::setBorrowedName(StringRef Name) {
+  ValueSymbolTable *ST;
+  if (getSymTab(this, ST))
+    return; // Cannot set a name on this value (e.g. constant).
+
+  // Names that are taken are renamed, which copies them.
+  if (Name.empty() || (ST && ST->lookup(Name))) {
+    setName(Name);
+    return;
+  }
+
+  if (hasName()) {
+    if (ST)
+      ST->removeValueName(getValueName());
+    destroyValueName();
+  }
+
+  if (ST)
+    ST->insertBorrowedName(Name, this);
+  {
+    LLVMContext &Ctx = getContext();
+    ContextTableLock Lock(Ctx.pImpl, LLVMContextImpl::ValueNamesTable);
+    Ctx.pImpl->BorrowedValueNames[this] = Name;
+    HasName = true;
+  }
+
+  if (Function *F = dyn_cast<Function>(this))
+    F->recalculateIntrinsicID();
+}
+
 void Value::takeName(Value *V) {
   ValueSymbolTable *ST = nullptr;
   // If this value has a name, drop it.
@@ -413,27 +505,79 @@ void Value::doRAUW(Value *New, ReplaceMetadataUses ReplaceMetaUses) {
          "replaceAllUses of value with new value of different type!");
 
   // Notify all ValueHandles (if present) that this value is going away.
-  if (HasValueHandle)
+  if (hasSharedUseList() || HasValueHandle)
     ValueHandleBase::ValueIsRAUWd(this, New);
   if (ReplaceMetaUses == ReplaceMetadataUses::Yes && isUsedByMetadata())
     ValueAsMetadata::handleRAUW(this, New);
 
+  if (LLVM_UNLIKELY(hasSharedUseList() || New->hasSharedUseList())) {
+    while (!materialized_use_empty()) {
+      Use &U = *UseList;
+      // Must handle Constants specially, we cannot call replaceUsesOfWith on
+      // a constant because they are uniqued.
+      if (auto *C = dyn_cast<Constant>(U.getUser())) {
+        if (!isa<GlobalValue>(C)) {
+          C->handleOperandChange(this, New);
+          continue;
+        }
+      }
+
+      U.set(New);
+    }
+  } else {
+    transferUsesTo(New);
+  }
+
+  if (BasicBlock *BB = dyn_cast<BasicBlock>(this))
+    BB->replaceSuccessorsPhiUsesWith(cast<BasicBlock>(New));
+}
+
+void Value::transferUsesTo(Value *New) {
+  // Unlink the uses one at a time from the head of the list, but link them to
+  // New in batches, which saves touching the use list of New, and its use
+  // count, for every use. The uses are batched in reverse order, so that they
+  // end up in the same order as if they had been set to New one at a time.
+  Use *Batch = nullptr, *BatchTail = nullptr;
+  unsigned BatchSize = 0;
+  auto FlushBatch = [&]() {
+    if (!Batch)
+      return;
+    BatchTail->Next = New->UseList;
+    if (New->UseList)
+      New->UseList->setPrev(&BatchTail->Next);
+    Batch->setPrev(&New->UseList);
+    New->UseList = Batch;
+    if (New->hasUseCount())
+      New->getUseCountRef() += BatchSize;
+    Batch = BatchTail = nullptr;
+    BatchSize = 0;
+  };
+
   while (!materialized_use_empty()) {
-    Use &U = *UseList;
+    Use *U = UseList;
     // Must handle Constants specially, we cannot call replaceUsesOfWith on a
     // constant because they are uniqued.
-    if (auto *C = dyn_cast<Constant>(U.getUser())) {
+    if (auto *C = dyn_cast<Constant>(U->getUser())) {
       if (!isa<GlobalValue>(C)) {
+        FlushBatch();
         C->handleOperandChange(this, New);
         continue;
       }
     }
 
-    U.set(New);
+    U->removeFromList();
+    if (hasUseCount())
+      --getUseCountRef();
+    U->Val = New;
+    U->Next = Batch;
+    if (Batch)
+      Batch->setPrev(&U->Next);
+    else
+      BatchTail = U;
+    Batch = U;
+    ++BatchSize;
   }
-
-  if (BasicBlock *BB = dyn_cast<BasicBlock>(this))
-    BB->replaceSuccessorsPhiUsesWith(cast<BasicBlock>(New));
+  FlushBatch();
 }
 
 void Value::replaceAllUsesWith(Value *New) {
@@ -713,6 +857,49 @@ const Value *Value::DoPHITranslation(const BasicBlock *CurBB,
 
 LLVMContext &Value::getContext() const { return VTy->getContext(); }
 
+std::atomic<unsigned> Value::NumThreadSafeContexts(0);
+
+bool Value::isInThreadSafeContext() const {
+  return getContext().pImpl->ThreadSafe;
+}
+
+static_assert(Value::ArgumentVal == Value::ConstantLastVal + 1,
+              "hasUseCount() expects the arguments to follow the constants");
+
+unsigned Value::getUseCount() const {
+  assertModuleIsMaterialized();
+  return const_cast<Value *>(this)->getUseCountRef();
+}
+
+unsigned &Value::getUseCountRef() {
+  assert(hasUseCount() && "Value does not count its uses");
+  if (auto *A = dyn_cast<Argument>(this))
+    return A->NumUses;
+  return cast<Constant>(this)->NumUses;
+}
+
+void Value::addCountedUse(Use &U) {
+  if (LLVM_UNLIKELY(hasSharedUseList())) {
+    sys::ScopedLock Lock(getContext().pImpl->getUseListLock(this));
+    U.addToList(&UseList);
+    ++getUseCountRef();
+    return;
+  }
+  U.addToList(&UseList);
+  ++getUseCountRef();
+}
+
+void Value::removeCountedUse(Use &U) {
+  if (LLVM_UNLIKELY(hasSharedUseList())) {
+    sys::ScopedLock Lock(getContext().pImpl->getUseListLock(this));
+    U.removeFromList();
+    --getUseCountRef();
+    return;
+  }
+  U.removeFromList();
+  --getUseCountRef();
+}
+
 void Value::reverseUseList() {
   if (!UseList || !UseList->Next)
     // No need to reverse 0 or 1 uses.
@@ -773,6 +960,7 @@ void ValueHandleBase::AddToUseList() {
   assert(getValPtr() && "Null pointer doesn't have a use list!");
 
   LLVMContextImpl *pImpl = getValPtr()->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ValueHandlesTable);
 
   if (getValPtr()->HasValueHandle) {
     // If this value already has a ValueHandle, then it must be in the
@@ -816,6 +1004,9 @@ void ValueHandleBase::RemoveFromUseList() {
   assert(getValPtr() && getValPtr()->HasValueHandle &&
          "Pointer doesn't have a use list!");
 
+  LLVMContextImpl *pImpl = getValPtr()->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ValueHandlesTable);
+
   // Unlink this from its use list.
   ValueHandleBase **PrevPtr = getPrevPtr();
   assert(*PrevPtr == this && "List invariant broken");
@@ -830,7 +1021,6 @@ void ValueHandleBase::RemoveFromUseList() {
   // If the Next pointer was null, then it is possible that this was the last
   // ValueHandle watching VP.  If so, delete its entry from the ValueHandles
   // map.
-  LLVMContextImpl *pImpl = getValPtr()->getContext().pImpl;
   DenseMap<Value*, ValueHandleBase*> &Handles = pImpl->ValueHandles;
   if (Handles.isPointerIntoBucketsArray(PrevPtr)) {
     Handles.erase(getValPtr());
@@ -839,11 +1029,19 @@ void ValueHandleBase::RemoveFromUseList() {
 }
 
 void ValueHandleBase::ValueIsDeleted(Value *V) {
-  assert(V->HasValueHandle && "Should only be called if ValueHandles present");
+  // Other threads may add handles to the list and remove them while we walk
+  // it, when V is shared, so hold the lock until we are done. The handles
+  // update their lists and flag under it too.
+  LLVMContextImpl *pImpl = V->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ValueHandlesTable);
+  if (!V->HasValueHandle) {
+    assert(V->hasSharedUseList() &&
+           "Should only be called if ValueHandles present");
+    return;
+  }
 
   // Get the linked list base, which is guaranteed to exist since the
   // HasValueHandle flag is set.
-  LLVMContextImpl *pImpl = V->getContext().pImpl;
   ValueHandleBase *Entry = pImpl->ValueHandles[V];
   assert(Entry && "Value bit set but no entries exist");
 
@@ -892,16 +1090,21 @@ void ValueHandleBase::ValueIsDeleted(Value *V) {
 }
 
 void ValueHandleBase::ValueIsRAUWd(Value *Old, Value *New) {
-  assert(Old->HasValueHandle &&"Should only be called if ValueHandles present");
+  // As in ValueIsDeleted, hold the lock for the whole walk.
+  LLVMContextImpl *pImpl = Old->getContext().pImpl;
+  ContextTableLock Lock(pImpl, LLVMContextImpl::ValueHandlesTable);
+  if (!Old->HasValueHandle) {
+    assert(Old->hasSharedUseList() &&
+           "Should only be called if ValueHandles present");
+    return;
+  }
   assert(Old != New && "Changing value into itself!");
   assert(Old->getType() == New->getType() &&
          "replaceAllUses of value with new value of different type!");
 
   // Get the linked list base, which is guaranteed to exist since the
   // HasValueHandle flag is set.
-  LLVMContextImpl *pImpl = Old->getContext().pImpl;
   ValueHandleBase *Entry = pImpl->ValueHandles[Old];
-
   assert(Entry && "Value bit set but no entries exist");
 
   // We use a local ValueHandleBase as an iterator so that
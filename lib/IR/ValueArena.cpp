@@ -0,0 +1,67 @@
+//===- ValueArena.cpp - Bulk allocation of IR values ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ValueArena and ValueArenaScope classes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/ValueArena.h"
+#include "llvm/IR/Use.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+
+using namespace llvm;
+
+static LLVM_THREAD_LOCAL ValueArena *CurrentArena = nullptr;
+
+ValueArena *ValueArena::getCurrent() { return CurrentArena; }
+
+void *ValueArena::allocate(size_t Size) {
+  static_assert(alignof(Use) <= alignof(ValueArena *),
+                "The operands must be aligned after the arena pointer");
+  static_assert(sizeof(size_t) == sizeof(ValueArena *),
+                "The size must keep the arena pointer aligned");
+  // Round the size up so that a freed block can hold the link of its free
+  // list, and fits any later allocation in the same list.
+  Size = alignTo(std::max(Size, sizeof(void *)), sizeof(void *));
+  ++RefCount;
+
+  size_t Index = Size / sizeof(void *);
+  if (FreeLists && Index < NumFreeLists && FreeLists[Index]) {
+    void *Ptr = FreeLists[Index];
+    FreeLists[Index] = *static_cast<void **>(Ptr);
+    return Ptr;
+  }
+
+  auto *Storage = static_cast<size_t *>(Allocator.Allocate(
+      sizeof(size_t) + sizeof(ValueArena *) + Size, alignof(ValueArena *)));
+  *Storage = Size;
+  auto **ArenaPtr = reinterpret_cast<ValueArena **>(Storage + 1);
+  *ArenaPtr = this;
+  return ArenaPtr + 1;
+}
+
+void ValueArena::deallocate(void *Ptr) {
+  ValueArena *Arena = getArenaOf(Ptr);
+  size_t Index = *(static_cast<size_t *>(Ptr) - 2) / sizeof(void *);
+  if (Arena == CurrentArena && Index < NumFreeLists) {
+    if (!Arena->FreeLists)
+      Arena->FreeLists.reset(new void *[NumFreeLists]());
+    *static_cast<void **>(Ptr) = Arena->FreeLists[Index];
+    Arena->FreeLists[Index] = Ptr;
+  }
+  Arena->dropRef();
+}
+
+ValueArenaScope::ValueArenaScope(ValueArena *Arena) : Prev(CurrentArena) {
+  CurrentArena = Arena;
+}
+
+ValueArenaScope::~ValueArenaScope() { CurrentArena = Prev; }
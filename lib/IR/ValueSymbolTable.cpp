@@ -37,7 +37,11 @@ ValueSymbolTable::~ValueSymbolTable() {
     dbgs() << "Value still in symbol table! Type = '"
            << *VI.getValue()->getType() << "' Name = '" << VI.getKeyData()
            << "'\n";
-  assert(vmap.empty() && "Values remain in symbol table!");
+  for (const auto &BI : BorrowedNames)
+    dbgs() << "Value still in symbol table! Type = '"
+           << *BI.second->getType() << "' Name = '" << BI.first << "'\n";
+  assert(vmap.empty() && BorrowedNames.empty() &&
+         "Values remain in symbol table!");
 #endif
 }
 
@@ -62,6 +66,8 @@ ValueName *ValueSymbolTable::makeUniqueName(Value *V,
     S << ++LastUnique;
 
     // Try insert the vmap entry with this suffix.
+    if (BorrowedNames.count(UniqueName))
+      continue;
     auto IterBool = vmap.insert(std::make_pair(UniqueName, V));
     if (IterBool.second)
       return &*IterBool.first;
@@ -73,8 +79,15 @@ ValueName *ValueSymbolTable::makeUniqueName(Value *V,
 void ValueSymbolTable::reinsertValue(Value* V) {
   assert(V->hasName() && "Can't insert nameless Value into symbol table");
 
+  // Keep borrowed names borrowed if they do not conflict.
+  if (V->hasBorrowedName() && !lookup(V->getName())) {
+    insertBorrowedName(V->getName(), V);
+    return;
+  }
+
   // Try inserting the name, assuming it won't conflict.
-  if (vmap.insert(V->getValueName())) {
+  if ((BorrowedNames.empty() || !BorrowedNames.count(V->getName())) &&
+      vmap.insert(V->getValueName())) {
     // LLVM_DEBUG(dbgs() << " Inserted value: " << V->getValueName() << ": " <<
     // *V << "\n");
     return;
@@ -96,12 +109,53 @@ void ValueSymbolTable::removeValueName(ValueName *V) {
   vmap.remove(V);
 }
 
+void ValueSymbolTable::removeValue(Value *V) {
+  if (!BorrowedNames.empty()) {
+    auto I = BorrowedNames.find(V->getName());
+    if (I != BorrowedNames.end() && I->second == V) {
+      BorrowedNames.erase(I);
+      return;
+    }
+  }
+  removeValueName(V->getValueName());
+}
+
+void ValueSymbolTable::insertBorrowedName(StringRef Name, Value *V) {
+  assert(!lookup(Name) && "Name already in the symbol table!");
+  BorrowedNames[Name] = V;
+}
+
+ValueName *ValueSymbolTable::materializeBorrowedName(StringRef Name,
+                                                     Value *V) {
+  auto I = BorrowedNames.find(Name);
+  if (I == BorrowedNames.end() || I->second != V)
+    return nullptr;
+  BorrowedNames.erase(I);
+  auto IterBool = vmap.insert(std::make_pair(Name, V));
+  assert(IterBool.second && "Borrowed name also in the symbol table!");
+  return &*IterBool.first;
+}
+
+void ValueSymbolTable::materializeBorrowedNames() const {
+  if (BorrowedNames.empty())
+    return;
+  SmallVector<Value *, 16> Values;
+  for (const auto &BI : BorrowedNames)
+    Values.push_back(BI.second);
+  // Getting the ValueName of a value with a borrowed name copies the name
+  // into this table.
+  for (Value *V : Values)
+    V->getValueName();
+}
+
 /// createValueName - This method attempts to create a value name and insert
 /// it into the symbol table with the specified name.  If it conflicts, it
 /// auto-renames the name and returns that instead.
 ValueName *ValueSymbolTable::createValueName(StringRef Name, Value *V) {
   // In the common case, the name is not already in the symbol table.
-  auto IterBool = vmap.insert(std::make_pair(Name, V));
+  auto IterBool = BorrowedNames.count(Name)
+                      ? std::make_pair(vmap.end(), false)
+                      : vmap.insert(std::make_pair(Name, V));
   if (IterBool.second) {
     // LLVM_DEBUG(dbgs() << " Inserted value: " << Entry.getKeyData() << ": "
     //           << *V << "\n");
@@ -4214,6 +4214,10 @@ void Verifier::visitIntrinsicCallSite(Intrinsic::ID ID, CallSite CS) {
     Assert(isa<ConstantInt>(CS.getArgOperand(1)),
            "llvm.invariant.end parameter #2 must be a constant integer", CS);
     break;
+  case Intrinsic::htm_abort:
+    Assert(isa<ConstantInt>(CS.getArgOperand(0)),
+           "llvm.htm.abort parameter #1 must be a constant integer", CS);
+    break;
 
   case Intrinsic::localescape: {
     BasicBlock *BB = CS.getParent();
@@ -62,6 +62,10 @@
 
 using namespace llvm;
 
+/// The size from which debug sections are compressed with zlib on several
+/// threads.
+static const uint64_t ParallelCompressionThreshold = 1 << 20;
+
 #undef  DEBUG_TYPE
 #define DEBUG_TYPE "reloc-info"
 
@@ -160,7 +164,8 @@ struct ELFWriter {
 
   bool maybeWriteCompression(uint64_t Size,
                              SmallVectorImpl<char> &CompressedContents,
-                             bool ZLibStyle, unsigned Alignment);
+                             DebugCompressionType CompressionType,
+                             unsigned Alignment);
 
 public:
   ELFWriter(ELFObjectWriter &OWriter, raw_pwrite_stream &OS,
@@ -792,23 +797,26 @@ MCSectionELF *ELFWriter::createRelocationSection(MCContext &Ctx,
 
 // Include the debug info compression header.
 bool ELFWriter::maybeWriteCompression(
-    uint64_t Size, SmallVectorImpl<char> &CompressedContents, bool ZLibStyle,
-    unsigned Alignment) {
-  if (ZLibStyle) {
+    uint64_t Size, SmallVectorImpl<char> &CompressedContents,
+    DebugCompressionType CompressionType, unsigned Alignment) {
+  if (CompressionType != DebugCompressionType::GNU) {
     uint64_t HdrSize =
         is64Bit() ? sizeof(ELF::Elf32_Chdr) : sizeof(ELF::Elf64_Chdr);
     if (Size <= HdrSize + CompressedContents.size())
       return false;
+    unsigned ChType = CompressionType == DebugCompressionType::Zstd
+                          ? ELF::ELFCOMPRESS_ZSTD
+                          : ELF::ELFCOMPRESS_ZLIB;
     // Platform specific header is followed by compressed data.
     if (is64Bit()) {
       // Write Elf64_Chdr header.
-      write(static_cast<ELF::Elf64_Word>(ELF::ELFCOMPRESS_ZLIB));
+      write(static_cast<ELF::Elf64_Word>(ChType));
       write(static_cast<ELF::Elf64_Word>(0)); // ch_reserved field.
       write(static_cast<ELF::Elf64_Xword>(Size));
       write(static_cast<ELF::Elf64_Xword>(Alignment));
     } else {
       // Write Elf32_Chdr header otherwise.
-      write(static_cast<ELF::Elf32_Word>(ELF::ELFCOMPRESS_ZLIB));
+      write(static_cast<ELF::Elf32_Word>(ChType));
       write(static_cast<ELF::Elf32_Word>(Size));
       write(static_cast<ELF::Elf32_Word>(Alignment));
     }
@@ -844,32 +852,48 @@ void ELFWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
     return;
   }
 
-  assert((MAI->compressDebugSections() == DebugCompressionType::Z ||
-          MAI->compressDebugSections() == DebugCompressionType::GNU) &&
-         "expected zlib or zlib-gnu style compression");
-
-  SmallVector<char, 128> UncompressedData;
-  raw_svector_ostream VecOS(UncompressedData);
-  Asm.writeSectionData(VecOS, &Section, Layout);
-
+  DebugCompressionType CompressionType = MAI->compressDebugSections();
+  assert((CompressionType == DebugCompressionType::Z ||
+          CompressionType == DebugCompressionType::GNU ||
+          CompressionType == DebugCompressionType::Zstd) &&
+         "expected zlib, zlib-gnu or zstd style compression");
+
+  // Compress the section data as the fragments write it, rather than
+  // buffering the whole uncompressed section first. In the rare cases where
+  // the section is left uncompressed, the fragments write it again.
+  auto WriteUncompressed = [&](raw_ostream &OS) {
+    Asm.writeSectionData(OS, &Section, Layout);
+  };
+  uint64_t Size = Layout.getSectionAddressSize(&Section);
   SmallVector<char, 128> CompressedContents;
-  if (Error E = zlib::compress(
-          StringRef(UncompressedData.data(), UncompressedData.size()),
-          CompressedContents)) {
+  auto Compress = [&]() -> Error {
+    if (CompressionType == DebugCompressionType::Zstd)
+      return zstd::compressStream(WriteUncompressed, CompressedContents);
+    if (Size < ParallelCompressionThreshold)
+      return zlib::compressStream(WriteUncompressed, CompressedContents);
+    // Large sections are worth buffering to deflate them on all the cores.
+    SmallVector<char, 0> UncompressedData;
+    UncompressedData.reserve(Size);
+    raw_svector_ostream VecOS(UncompressedData);
+    WriteUncompressed(VecOS);
+    return zlib::compressParallel(
+        StringRef(UncompressedData.data(), UncompressedData.size()),
+        CompressedContents);
+  };
+  if (Error E = Compress()) {
     consumeError(std::move(E));
-    W.OS << UncompressedData;
+    WriteUncompressed(W.OS);
     return;
   }
 
-  bool ZlibStyle = MAI->compressDebugSections() == DebugCompressionType::Z;
-  if (!maybeWriteCompression(UncompressedData.size(), CompressedContents,
-                             ZlibStyle, Sec.getAlignment())) {
-    W.OS << UncompressedData;
+  if (!maybeWriteCompression(Size, CompressedContents, CompressionType,
+                             Sec.getAlignment())) {
+    WriteUncompressed(W.OS);
     return;
   }
 
-  if (ZlibStyle)
-    // Set the compressed flag. That is zlib style.
+  if (CompressionType != DebugCompressionType::GNU)
+    // Set the compressed flag. That is zlib and zstd style.
     Section.setFlags(Section.getFlags() | ELF::SHF_COMPRESSED);
   else
     // Add "z" prefix to section name. This is zlib-gnu style.
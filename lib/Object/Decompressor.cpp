@@ -20,19 +20,24 @@ using namespace object;
 
 Expected<Decompressor> Decompressor::create(StringRef Name, StringRef Data,
                                             bool IsLE, bool Is64Bit) {
-  if (!zlib::isAvailable())
-    return createError("zlib is not available");
-
   Decompressor D(Data);
   Error Err = isGnuStyle(Name) ? D.consumeCompressedGnuHeader()
                                : D.consumeCompressedZLibHeader(Is64Bit, IsLE);
   if (Err)
     return std::move(Err);
+
+  if (D.CompressionType == ELF::ELFCOMPRESS_ZSTD) {
+    if (!zstd::isAvailable())
+      return createError("zstd is not available");
+  } else if (!zlib::isAvailable()) {
+    return createError("zlib is not available");
+  }
   return D;
 }
 
 Decompressor::Decompressor(StringRef Data)
-    : SectionData(Data), DecompressedSize(0) {}
+    : SectionData(Data), DecompressedSize(0),
+      CompressionType(ELF::ELFCOMPRESS_ZLIB) {}
 
 Error Decompressor::consumeCompressedGnuHeader() {
   if (!SectionData.startswith("ZLIB"))
@@ -58,9 +63,10 @@ Error Decompressor::consumeCompressedZLibHeader(bool Is64Bit,
 
   DataExtractor Extractor(SectionData, IsLittleEndian, 0);
   uint32_t Offset = 0;
-  if (Extractor.getUnsigned(&Offset, Is64Bit ? sizeof(Elf64_Word)
-                                             : sizeof(Elf32_Word)) !=
-      ELFCOMPRESS_ZLIB)
+  CompressionType = Extractor.getUnsigned(
+      &Offset, Is64Bit ? sizeof(Elf64_Word) : sizeof(Elf32_Word));
+  if (CompressionType != ELFCOMPRESS_ZLIB &&
+      CompressionType != ELFCOMPRESS_ZSTD)
     return createError("unsupported compression type");
 
   // Skip Elf64_Chdr::ch_reserved field.
@@ -90,5 +96,13 @@ bool Decompressor::isCompressedELFSection(uint64_t Flags, StringRef Name) {
 
 Error Decompressor::decompress(MutableArrayRef<char> Buffer) {
   size_t Size = Buffer.size();
+  if (CompressionType == ELF::ELFCOMPRESS_ZSTD)
+    return zstd::uncompress(SectionData, Buffer.data(), Size);
   return zlib::uncompress(SectionData, Buffer.data(), Size);
 }
+
+Error Decompressor::decompressStream(function_ref<Error(StringRef)> Output) {
+  if (CompressionType == ELF::ELFCOMPRESS_ZSTD)
+    return zstd::uncompressStream(SectionData, Output);
+  return zlib::uncompressStream(SectionData, Output);
+}
@@ -33,6 +33,7 @@
 #include "llvm/Analysis/DominanceFrontier.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/IVUsers.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/LazyCallGraph.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/LoopAccessAnalysis.h"
@@ -50,6 +51,7 @@
 #include "llvm/Analysis/ScopedNoAliasAA.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/TransactionalFootprint.h"
 #include "llvm/Analysis/TypeBasedAliasAnalysis.h"
 #include "llvm/CodeGen/PreISelIntrinsicLowering.h"
 #include "llvm/CodeGen/UnreachableBlockElim.h"
@@ -86,6 +88,7 @@
 #include "llvm/Transforms/IPO/SyntheticCountsPropagation.h"
 #include "llvm/Transforms/IPO/WholeProgramDevirt.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/InstCombine/InstCombineTracker.h"
 #include "llvm/Transforms/Instrumentation/BoundsChecking.h"
 #include "llvm/Transforms/Instrumentation/ControlHeightReduction.h"
 #include "llvm/Transforms/Instrumentation/GCOVProfiler.h"
@@ -110,6 +113,7 @@
 #include "llvm/Transforms/Scalar/InstSimplifyPass.h"
 #include "llvm/Transforms/Scalar/JumpThreading.h"
 #include "llvm/Transforms/Scalar/LICM.h"
+#include "llvm/Transforms/Scalar/LockElision.h"
 #include "llvm/Transforms/Scalar/LoopAccessAnalysisPrinter.h"
 #include "llvm/Transforms/Scalar/LoopDataPrefetch.h"
 #include "llvm/Transforms/Scalar/LoopDeletion.h"
@@ -137,6 +141,7 @@
 #include "llvm/Transforms/Scalar/RewriteStatepointsForGC.h"
 #include "llvm/Transforms/Scalar/SCCP.h"
 #include "llvm/Transforms/Scalar/SROA.h"
+#include "llvm/Transforms/Scalar/ShrinkTransactions.h"
 #include "llvm/Transforms/Scalar/SimpleLoopUnswitch.h"
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
 #include "llvm/Transforms/Scalar/Sink.h"
@@ -186,6 +191,10 @@ static cl::opt<bool> EnableUnrollAndJam(
     "enable-npm-unroll-and-jam", cl::init(false), cl::Hidden,
     cl::desc("Enable the Unroll and Jam pass for the new PM (default = off)"));
 
+static cl::opt<bool> EnableLockElision(
+    "enable-npm-lock-elision", cl::init(false), cl::Hidden,
+    cl::desc("Enable the lock elision pass for the new PM (default = off)"));
+
 static cl::opt<bool> EnableSyntheticCounts(
     "enable-npm-synthetic-counts", cl::init(false), cl::Hidden, cl::ZeroOrMore,
     cl::desc("Run synthetic function entry count generation "
@@ -198,6 +207,16 @@ static cl::opt<bool>
     EnableCHR("enable-chr-npm", cl::init(true), cl::Hidden,
               cl::desc("Enable control height reduction optimization (CHR)"));
 
+static cl::opt<unsigned> FunctionPassThreads(
+    "function-pass-threads", cl::init(1), cl::Hidden,
+    cl::desc("Number of threads running the function pipelines of the new PM "
+             "over the functions of a module, 0 for one per core"));
+
+static cl::opt<unsigned> CGSCCPassThreads(
+    "cgscc-pass-threads", cl::init(1), cl::Hidden,
+    cl::desc("Number of threads running the CGSCC pipelines of the new PM "
+             "over the call graph of a module, 0 for one per core"));
+
 static bool isOptimizingForSize(PassBuilder::OptimizationLevel Level) {
   switch (Level) {
   case PassBuilder::O0:
@@ -213,6 +232,37 @@ static bool isOptimizingForSize(PassBuilder::OptimizationLevel Level) {
   llvm_unreachable("Invalid optimization level!");
 }
 
+/// Add the function pipeline built by \p BuildPipeline to \p MPM, running on
+/// as many threads as -function-pass-threads asks for. The debug logging of
+/// the pass managers needs a single thread.
+static void
+addFunctionPipeline(ModulePassManager &MPM, bool DebugLogging,
+                    function_ref<FunctionPassManager()> BuildPipeline) {
+  if (FunctionPassThreads == 1 || DebugLogging)
+    MPM.addPass(createModuleToFunctionPassAdaptor(BuildPipeline()));
+  else
+    MPM.addPass(
+        ParallelModuleToFunctionPassAdaptor(BuildPipeline, FunctionPassThreads));
+}
+
+/// Add the CGSCC pass built by \p BuildPipeline to \p MPM, walking the call
+/// graph on as many threads as -cgscc-pass-threads asks for.
+template <typename BuildPipelineT>
+static void addCGSCCPipeline(ModulePassManager &MPM, bool DebugLogging,
+                             BuildPipelineT BuildPipeline) {
+  if (CGSCCPassThreads == 1 || DebugLogging) {
+    MPM.addPass(createModuleToPostOrderCGSCCPassAdaptor(BuildPipeline()));
+    return;
+  }
+  MPM.addPass(ParallelModuleToPostOrderCGSCCPassAdaptor(
+      [&]() {
+        CGSCCPassManager CGPM(DebugLogging);
+        CGPM.addPass(BuildPipeline());
+        return CGPM;
+      },
+      CGSCCPassThreads));
+}
+
 namespace {
 
 /// No-op module pass which does nothing.
@@ -667,7 +717,18 @@ PassBuilder::buildModuleSimplificationPipeline(OptimizationLevel Level,
   // the inliner pass.
   MPM.addPass(RequireAnalysisPass<ProfileSummaryAnalysis, Module>());
 
-  // Now begin the main postorder CGSCC pipeline.
+  // Now begin the main postorder CGSCC pipeline, and add it to the module
+  // pipeline by walking the SCCs in postorder (or bottom-up).
+  addCGSCCPipeline(MPM, DebugLogging, [&]() {
+    return buildMainCGSCCPipeline(Level, Phase, DebugLogging);
+  });
+
+  return MPM;
+}
+
+DevirtSCCRepeatedPass<CGSCCPassManager>
+PassBuilder::buildMainCGSCCPipeline(OptimizationLevel Level,
+                                    ThinLTOPhase Phase, bool DebugLogging) {
   // FIXME: The current CGSCC pipeline has its origins in the legacy pass
   // manager and trying to emulate its precise behavior. Much of this doesn't
   // make a lot of sense and we should revisit the core CGSCC structure.
@@ -708,13 +769,9 @@ PassBuilder::buildModuleSimplificationPipeline(OptimizationLevel Level,
   // We wrap the CGSCC pipeline in a devirtualization repeater. This will try
   // to detect when we devirtualize indirect calls and iterate the SCC passes
   // in that case to try and catch knock-on inlining or function attrs
-  // opportunities. Then we add it to the module pipeline by walking the SCCs
-  // in postorder (or bottom-up).
-  MPM.addPass(
-      createModuleToPostOrderCGSCCPassAdaptor(createDevirtSCCRepeatedPass(
-          std::move(MainCGPipeline), MaxDevirtIterations)));
-
-  return MPM;
+  // opportunities.
+  return createDevirtSCCRepeatedPass(std::move(MainCGPipeline),
+                                     MaxDevirtIterations);
 }
 
 ModulePassManager
@@ -755,6 +812,35 @@ PassBuilder::buildModuleOptimizationPipeline(OptimizationLevel Level,
   // memory operations.
   MPM.addPass(RequireAnalysisPass<GlobalsAA, Module>());
 
+  bool InstrumentElidedLocks = EnableLockElision && PGOOpt &&
+                               PGOOpt->RunProfileGen;
+
+  // Add the core optimizing pipeline. Each thread running it needs its own
+  // passes.
+  addFunctionPipeline(MPM, DebugLogging, [&]() {
+    return buildFunctionOptimizationPipeline(Level, DebugLogging);
+  });
+
+  // The profile counters of the elided sections are only created by the
+  // pipeline above, long after the profile lowering pass ran.
+  if (InstrumentElidedLocks)
+    MPM.addPass(InstrProfiling(InstrProfOptions()));
+
+  MPM.addPass(CGProfilePass());
+
+  // Now we need to do some global optimization transforms.
+  // FIXME: It would seem like these should come first in the optimization
+  // pipeline and maybe be the bottom of the canonicalization pipeline? Weird
+  // ordering here.
+  MPM.addPass(GlobalDCEPass());
+  MPM.addPass(ConstantMergePass());
+
+  return MPM;
+}
+
+FunctionPassManager
+PassBuilder::buildFunctionOptimizationPipeline(OptimizationLevel Level,
+                                               bool DebugLogging) {
   FunctionPassManager OptimizePM(DebugLogging);
   OptimizePM.addPass(Float2IntPass());
   // FIXME: We need to run some loop optimizations to re-rotate loops after
@@ -841,6 +927,17 @@ PassBuilder::buildModuleOptimizationPipeline(OptimizationLevel Level,
   // flattening of blocks.
   OptimizePM.addPass(DivRemPairsPass());
 
+  // Turn critical sections into hardware transactions once inlining has
+  // brought lock and unlock calls together and the sections are in their
+  // final shape, then move what does not need to run transactionally out of
+  // the transactions.
+  if (EnableLockElision) {
+    bool InstrumentElidedLocks = PGOOpt && PGOOpt->RunProfileGen;
+    OptimizePM.addPass(LockElisionPass(
+        InstrumentElidedLocks, PGOOpt ? PGOOpt->ProfileUseFile : ""));
+    OptimizePM.addPass(ShrinkTransactionsPass());
+  }
+
   // LoopSink (and other loop passes since the last simplifyCFG) might have
   // resulted in single-entry-single-exit or empty blocks. Clean up the CFG.
   OptimizePM.addPass(SimplifyCFGPass());
@@ -850,19 +947,7 @@ PassBuilder::buildModuleOptimizationPipeline(OptimizationLevel Level,
   // inserting redudnancies into the progrem. This even includes SimplifyCFG.
   OptimizePM.addPass(SpeculateAroundPHIsPass());
 
-  // Add the core optimizing pipeline.
-  MPM.addPass(createModuleToFunctionPassAdaptor(std::move(OptimizePM)));
-
-  MPM.addPass(CGProfilePass());
-
-  // Now we need to do some global optimization transforms.
-  // FIXME: It would seem like these should come first in the optimization
-  // pipeline and maybe be the bottom of the canonicalization pipeline? Weird
-  // ordering here.
-  MPM.addPass(GlobalDCEPass());
-  MPM.addPass(ConstantMergePass());
-
-  return MPM;
+  return OptimizePM;
 }
 
 ModulePassManager
@@ -1413,7 +1498,20 @@ bool PassBuilder::parseModulePass(ModulePassManager &MPM,
       if (!parseCGSCCPassPipeline(CGPM, InnerPipeline, VerifyEachPass,
                                   DebugLogging))
         return false;
-      MPM.addPass(createModuleToPostOrderCGSCCPassAdaptor(std::move(CGPM)));
+      // The other threads running the pipeline parse it again.
+      bool Parsed = false;
+      addCGSCCPipeline(MPM, DebugLogging, [&]() {
+        if (!Parsed) {
+          Parsed = true;
+          return std::move(CGPM);
+        }
+        CGSCCPassManager ThreadCGPM(DebugLogging);
+        bool Valid = parseCGSCCPassPipeline(ThreadCGPM, InnerPipeline,
+                                            VerifyEachPass, DebugLogging);
+        assert(Valid && "The pipeline was parsed before!");
+        (void)Valid;
+        return ThreadCGPM;
+      });
       return true;
     }
     if (Name == "function") {
@@ -1421,7 +1519,20 @@ bool PassBuilder::parseModulePass(ModulePassManager &MPM,
       if (!parseFunctionPassPipeline(FPM, InnerPipeline, VerifyEachPass,
                                      DebugLogging))
         return false;
-      MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM)));
+      // The other threads running the pipeline parse it again.
+      bool Parsed = false;
+      addFunctionPipeline(MPM, DebugLogging, [&]() {
+        if (!Parsed) {
+          Parsed = true;
+          return std::move(FPM);
+        }
+        FunctionPassManager ThreadFPM(DebugLogging);
+        bool Valid = parseFunctionPassPipeline(ThreadFPM, InnerPipeline,
+                                               VerifyEachPass, DebugLogging);
+        assert(Valid && "The pipeline was parsed before!");
+        (void)Valid;
+        return ThreadFPM;
+      });
       return true;
     }
     if (auto Count = parseRepeatPassName(Name)) {
@@ -12,23 +12,70 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/Compression.h"
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Twine.h"
 #include "llvm/Config/config.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/EndianStream.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/raw_ostream.h"
 #if LLVM_ENABLE_ZLIB == 1 && HAVE_ZLIB_H
 #include <zlib.h>
 #endif
+#if LLVM_ENABLE_ZSTD == 1 && HAVE_ZSTD_H
+#include <zstd.h>
+#endif
 
 using namespace llvm;
 
-#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
-static Error createError(StringRef Err) {
+/// The size of the chunks the streaming functions work on.
+static constexpr size_t ChunkSize = 64 * 1024;
+
+/// The size of the chunks compressParallel() deflates on every thread.
+static constexpr size_t ParallelChunkSize = 256 * 1024;
+
+namespace {
+
+/// A stream passing the data written to it to a compressor, in chunks of the
+/// size of its buffer. The first error of the compressor is kept until
+/// finish() and the data written after it is dropped.
+class raw_compressing_ostream : public raw_ostream {
+  function_ref<Error(StringRef)> Compress;
+  Error Err = Error::success();
+  uint64_t Pos = 0;
+
+  void write_impl(const char *Ptr, size_t Size) override {
+    Pos += Size;
+    if (!Err)
+      Err = Compress(StringRef(Ptr, Size));
+  }
+
+  uint64_t current_pos() const override { return Pos; }
+
+public:
+  explicit raw_compressing_ostream(function_ref<Error(StringRef)> Compress)
+      : Compress(Compress) {
+    SetBufferSize(ChunkSize);
+  }
+
+  /// Pass the buffered data to the compressor and return its first error.
+  Error finish() {
+    flush();
+    return std::move(Err);
+  }
+};
+
+} // end anonymous namespace
+
+LLVM_ATTRIBUTE_UNUSED static Error createError(const Twine &Err) {
   return make_error<StringError>(Err, inconvertibleErrorCode());
 }
 
+#if LLVM_ENABLE_ZLIB == 1 && HAVE_LIBZ
 static StringRef convertZlibCodeToString(int Code) {
   switch (Code) {
   case Z_MEM_ERROR:
@@ -38,6 +85,7 @@ static StringRef convertZlibCodeToString(int Code) {
   case Z_STREAM_ERROR:
     return "zlib error: Z_STREAM_ERROR";
   case Z_DATA_ERROR:
+  case Z_NEED_DICT:
     return "zlib error: Z_DATA_ERROR";
   case Z_OK:
   default:
@@ -61,6 +109,102 @@ Error zlib::compress(StringRef InputBuffer,
   return Res ? createError(convertZlibCodeToString(Res)) : Error::success();
 }
 
+/// Deflate \p Input as part of a raw deflate stream, after \p Dictionary, and
+/// append the result to \p Output. The deflate stream ends with \p Input if
+/// \p Last is true, and continues on the next byte boundary otherwise.
+static int deflateChunk(StringRef Dictionary, StringRef Input, bool Last,
+                        int Level, SmallVectorImpl<char> &Output) {
+  z_stream Stream = {};
+  int Res = ::deflateInit2(&Stream, Level, Z_DEFLATED, -MAX_WBITS, 8,
+                           Z_DEFAULT_STRATEGY);
+  if (Res != Z_OK)
+    return Res;
+  auto EndStream = make_scope_exit([&] { ::deflateEnd(&Stream); });
+
+  // Prime the window with the end of the previous chunk, so that the chunks
+  // compress almost as well as a single stream.
+  if (!Dictionary.empty()) {
+    Res = ::deflateSetDictionary(&Stream, (const Bytef *)Dictionary.data(),
+                                 Dictionary.size());
+    if (Res != Z_OK)
+      return Res;
+  }
+
+  Stream.next_in = (Bytef *)Input.data();
+  Stream.avail_in = Input.size();
+  size_t Bound = ::deflateBound(&Stream, Input.size());
+  // Z_SYNC_FLUSH ends the output with an empty stored block, which aligns it
+  // on a byte boundary without ending the deflate stream.
+  int Flush = Last ? Z_FINISH : Z_SYNC_FLUSH;
+  do {
+    size_t Pos = Output.size();
+    Output.reserve(Pos + Bound);
+    Stream.next_out = (Bytef *)Output.data() + Pos;
+    Stream.avail_out = Bound;
+    Res = ::deflate(&Stream, Flush);
+    if (Res == Z_STREAM_ERROR)
+      return Res;
+    size_t Size = Bound - Stream.avail_out;
+    __msan_unpoison(Output.data() + Pos, Size);
+    Output.set_size(Pos + Size);
+  } while (Stream.avail_out == 0);
+  return Z_OK;
+}
+
+Error zlib::compressParallel(StringRef InputBuffer,
+                             SmallVectorImpl<char> &CompressedBuffer,
+                             int Level) {
+  size_t NumChunks =
+      (InputBuffer.size() + ParallelChunkSize - 1) / ParallelChunkSize;
+  if (NumChunks <= 1)
+    return compress(InputBuffer, CompressedBuffer, Level);
+
+  std::vector<SmallVector<char, 0>> Deflated(NumChunks);
+  std::vector<uLong> Checksums(NumChunks);
+  std::vector<int> Results(NumChunks);
+  parallel::for_each_n(parallel::par, size_t(0), NumChunks, [&](size_t I) {
+    size_t Begin = I * ParallelChunkSize;
+    StringRef Chunk = InputBuffer.substr(Begin, ParallelChunkSize);
+    StringRef Dictionary =
+        I ? InputBuffer.slice(Begin - std::min<size_t>(Begin, 1 << MAX_WBITS),
+                              Begin)
+          : StringRef();
+    Checksums[I] = ::adler32(::adler32(0, Z_NULL, 0),
+                             (const Bytef *)Chunk.data(), Chunk.size());
+    Results[I] = deflateChunk(Dictionary, Chunk, I == NumChunks - 1, Level,
+                              Deflated[I]);
+  });
+  for (int Res : Results)
+    if (Res != Z_OK)
+      return createError(convertZlibCodeToString(Res));
+
+  // The zlib header tells the compression level the same way deflate() does.
+  unsigned LevelFlags = Level == Z_DEFAULT_COMPRESSION || Level == 6
+                            ? 2
+                            : Level < 2 ? 0 : Level < 6 ? 1 : 3;
+  uint16_t Header = (0x78 << 8) | (LevelFlags << 6);
+  Header += 31 - Header % 31;
+
+  uLong Checksum = Checksums[0];
+  size_t Size = 2 + 4;
+  for (size_t I = 1; I != NumChunks; ++I) {
+    size_t ChunkLength =
+        std::min(ParallelChunkSize, InputBuffer.size() - I * ParallelChunkSize);
+    Checksum = ::adler32_combine(Checksum, Checksums[I], ChunkLength);
+  }
+  for (const auto &Chunk : Deflated)
+    Size += Chunk.size();
+
+  CompressedBuffer.clear();
+  CompressedBuffer.reserve(Size);
+  raw_svector_ostream OS(CompressedBuffer);
+  support::endian::write<uint16_t>(OS, Header, support::big);
+  for (const auto &Chunk : Deflated)
+    OS << StringRef(Chunk.data(), Chunk.size());
+  support::endian::write<uint32_t>(OS, uint32_t(Checksum), support::big);
+  return Error::success();
+}
+
 Error zlib::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
                        size_t &UncompressedSize) {
   int Res =
@@ -86,12 +230,83 @@ uint32_t zlib::crc32(StringRef Buffer) {
   return ::crc32(0, (const Bytef *)Buffer.data(), Buffer.size());
 }
 
+Error zlib::compressStream(function_ref<void(raw_ostream &)> Write,
+                           SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  z_stream Stream = {};
+  int Res = ::deflateInit(&Stream, Level);
+  if (Res != Z_OK)
+    return createError(convertZlibCodeToString(Res));
+  auto EndStream = make_scope_exit([&] { ::deflateEnd(&Stream); });
+
+  CompressedBuffer.clear();
+  auto Deflate = [&](StringRef Chunk, int Flush) -> Error {
+    Stream.next_in = (Bytef *)Chunk.data();
+    Stream.avail_in = Chunk.size();
+    // Run deflate() until it leaves room in the output buffer, which means
+    // that it consumed all the input and, for Z_FINISH, ended the stream.
+    do {
+      size_t Pos = CompressedBuffer.size();
+      CompressedBuffer.reserve(Pos + ChunkSize);
+      Stream.next_out = (Bytef *)CompressedBuffer.data() + Pos;
+      Stream.avail_out = ChunkSize;
+      int Res = ::deflate(&Stream, Flush);
+      if (Res == Z_STREAM_ERROR)
+        return createError(convertZlibCodeToString(Res));
+      size_t Size = ChunkSize - Stream.avail_out;
+      __msan_unpoison(CompressedBuffer.data() + Pos, Size);
+      CompressedBuffer.set_size(Pos + Size);
+    } while (Stream.avail_out == 0);
+    return Error::success();
+  };
+
+  raw_compressing_ostream OS(
+      [&](StringRef Chunk) { return Deflate(Chunk, Z_NO_FLUSH); });
+  Write(OS);
+  if (Error E = OS.finish())
+    return E;
+  return Deflate(StringRef(), Z_FINISH);
+}
+
+Error zlib::uncompressStream(StringRef InputBuffer,
+                             function_ref<Error(StringRef)> Output) {
+  z_stream Stream = {};
+  int Res = ::inflateInit(&Stream);
+  if (Res != Z_OK)
+    return createError(convertZlibCodeToString(Res));
+  auto EndStream = make_scope_exit([&] { ::inflateEnd(&Stream); });
+
+  SmallVector<char, 0> Chunk;
+  Chunk.resize(ChunkSize);
+  Stream.next_in = (Bytef *)InputBuffer.data();
+  Stream.avail_in = InputBuffer.size();
+  do {
+    Stream.next_out = (Bytef *)Chunk.data();
+    Stream.avail_out = ChunkSize;
+    // A truncated input makes inflate() return Z_BUF_ERROR once it consumed
+    // all of it.
+    Res = ::inflate(&Stream, Z_NO_FLUSH);
+    if (Res != Z_OK && Res != Z_STREAM_END)
+      return createError(convertZlibCodeToString(Res));
+    size_t Size = ChunkSize - Stream.avail_out;
+    __msan_unpoison(Chunk.data(), Size);
+    if (Size)
+      if (Error E = Output(StringRef(Chunk.data(), Size)))
+        return E;
+  } while (Res != Z_STREAM_END);
+  return Error::success();
+}
+
 #else
 bool zlib::isAvailable() { return false; }
 Error zlib::compress(StringRef InputBuffer,
                      SmallVectorImpl<char> &CompressedBuffer, int Level) {
   llvm_unreachable("zlib::compress is unavailable");
 }
+Error zlib::compressParallel(StringRef InputBuffer,
+                             SmallVectorImpl<char> &CompressedBuffer,
+                             int Level) {
+  llvm_unreachable("zlib::compressParallel is unavailable");
+}
 Error zlib::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
                        size_t &UncompressedSize) {
   llvm_unreachable("zlib::uncompress is unavailable");
@@ -104,4 +319,150 @@ Error zlib::uncompress(StringRef InputBuffer,
 uint32_t zlib::crc32(StringRef Buffer) {
   llvm_unreachable("zlib::crc32 is unavailable");
 }
+Error zlib::compressStream(function_ref<void(raw_ostream &)> Write,
+                           SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  llvm_unreachable("zlib::compressStream is unavailable");
+}
+Error zlib::uncompressStream(StringRef InputBuffer,
+                             function_ref<Error(StringRef)> Output) {
+  llvm_unreachable("zlib::uncompressStream is unavailable");
+}
+#endif
+
+#if LLVM_ENABLE_ZSTD == 1 && HAVE_LIBZSTD
+static Error createZstdError(size_t Code) {
+  return createError(Twine("zstd error: ") + ZSTD_getErrorName(Code));
+}
+
+bool zstd::isAvailable() { return true; }
+
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  size_t CompressedBufferSize = ::ZSTD_compressBound(InputBuffer.size());
+  CompressedBuffer.reserve(CompressedBufferSize);
+  size_t CompressedSize =
+      ::ZSTD_compress(CompressedBuffer.data(), CompressedBufferSize,
+                      InputBuffer.data(), InputBuffer.size(), Level);
+  if (ZSTD_isError(CompressedSize))
+    return createZstdError(CompressedSize);
+  // Tell MemorySanitizer that zstd output buffer is fully initialized.
+  // This avoids a false report when running LLVM with uninstrumented zstd.
+  __msan_unpoison(CompressedBuffer.data(), CompressedSize);
+  CompressedBuffer.set_size(CompressedSize);
+  return Error::success();
+}
+
+Error zstd::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                       size_t &UncompressedSize) {
+  size_t Res = ::ZSTD_decompress(UncompressedBuffer, UncompressedSize,
+                                 InputBuffer.data(), InputBuffer.size());
+  if (ZSTD_isError(Res))
+    return createZstdError(Res);
+  // Tell MemorySanitizer that zstd output buffer is fully initialized.
+  // This avoids a false report when running LLVM with uninstrumented zstd.
+  __msan_unpoison(UncompressedBuffer, Res);
+  UncompressedSize = Res;
+  return Error::success();
+}
+
+Error zstd::uncompress(StringRef InputBuffer,
+                       SmallVectorImpl<char> &UncompressedBuffer,
+                       size_t UncompressedSize) {
+  UncompressedBuffer.resize(UncompressedSize);
+  Error E =
+      uncompress(InputBuffer, UncompressedBuffer.data(), UncompressedSize);
+  UncompressedBuffer.resize(UncompressedSize);
+  return E;
+}
+
+Error zstd::compressStream(function_ref<void(raw_ostream &)> Write,
+                           SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  ZSTD_CCtx *Context = ::ZSTD_createCCtx();
+  if (!Context)
+    return createError("zstd error: cannot allocate the compression context");
+  auto FreeContext = make_scope_exit([&] { ::ZSTD_freeCCtx(Context); });
+  size_t Res =
+      ::ZSTD_CCtx_setParameter(Context, ZSTD_c_compressionLevel, Level);
+  if (ZSTD_isError(Res))
+    return createZstdError(Res);
+
+  CompressedBuffer.clear();
+  auto Compress = [&](StringRef Chunk, ZSTD_EndDirective Mode) -> Error {
+    ZSTD_inBuffer In = {Chunk.data(), Chunk.size(), 0};
+    // Run the compressor until it consumed all the input and, for
+    // ZSTD_e_end, flushed the end of the frame.
+    size_t Remaining;
+    do {
+      size_t Pos = CompressedBuffer.size();
+      CompressedBuffer.reserve(Pos + ChunkSize);
+      ZSTD_outBuffer Out = {CompressedBuffer.data() + Pos, ChunkSize, 0};
+      Remaining = ::ZSTD_compressStream2(Context, &Out, &In, Mode);
+      if (ZSTD_isError(Remaining))
+        return createZstdError(Remaining);
+      __msan_unpoison(CompressedBuffer.data() + Pos, Out.pos);
+      CompressedBuffer.set_size(Pos + Out.pos);
+    } while (Mode == ZSTD_e_end ? Remaining != 0 : In.pos != In.size);
+    return Error::success();
+  };
+
+  raw_compressing_ostream OS(
+      [&](StringRef Chunk) { return Compress(Chunk, ZSTD_e_continue); });
+  Write(OS);
+  if (Error E = OS.finish())
+    return E;
+  return Compress(StringRef(), ZSTD_e_end);
+}
+
+Error zstd::uncompressStream(StringRef InputBuffer,
+                             function_ref<Error(StringRef)> Output) {
+  ZSTD_DCtx *Context = ::ZSTD_createDCtx();
+  if (!Context)
+    return createError("zstd error: cannot allocate the decompression context");
+  auto FreeContext = make_scope_exit([&] { ::ZSTD_freeDCtx(Context); });
+
+  SmallVector<char, 0> Chunk;
+  Chunk.resize(ChunkSize);
+  ZSTD_inBuffer In = {InputBuffer.data(), InputBuffer.size(), 0};
+  size_t Res;
+  do {
+    ZSTD_outBuffer Out = {Chunk.data(), ChunkSize, 0};
+    // Res is 0 once the frame is fully decoded and flushed.
+    Res = ::ZSTD_decompressStream(Context, &Out, &In);
+    if (ZSTD_isError(Res))
+      return createZstdError(Res);
+    __msan_unpoison(Chunk.data(), Out.pos);
+    if (Out.pos)
+      if (Error E = Output(StringRef(Chunk.data(), Out.pos)))
+        return E;
+    // Without more input nor a full output buffer, the decompressor cannot
+    // make progress anymore.
+    if (Res && In.pos == In.size && Out.pos < Out.size)
+      return createError("zstd error: Src size is incorrect");
+  } while (Res);
+  return Error::success();
+}
+
+#else
+bool zstd::isAvailable() { return false; }
+Error zstd::compress(StringRef InputBuffer,
+                     SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  llvm_unreachable("zstd::compress is unavailable");
+}
+Error zstd::uncompress(StringRef InputBuffer, char *UncompressedBuffer,
+                       size_t &UncompressedSize) {
+  llvm_unreachable("zstd::uncompress is unavailable");
+}
+Error zstd::uncompress(StringRef InputBuffer,
+                       SmallVectorImpl<char> &UncompressedBuffer,
+                       size_t UncompressedSize) {
+  llvm_unreachable("zstd::uncompress is unavailable");
+}
+Error zstd::compressStream(function_ref<void(raw_ostream &)> Write,
+                           SmallVectorImpl<char> &CompressedBuffer, int Level) {
+  llvm_unreachable("zstd::compressStream is unavailable");
+}
+Error zstd::uncompressStream(StringRef InputBuffer,
+                             function_ref<Error(StringRef)> Output) {
+  llvm_unreachable("zstd::uncompressStream is unavailable");
+}
 #endif
@@ -0,0 +1,183 @@
+//===- ConcurrencyLimit.cpp - Process-wide task limit ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the tokens bounding the number of threads of the
+// process running tasks at the same time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ConcurrencyLimit.h"
+#include "llvm/Config/llvm-config.h"
+
+using namespace llvm;
+using namespace llvm::parallel;
+
+#if LLVM_ENABLE_THREADS
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Process.h"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace {
+
+/// The connection to the jobserver of a parent GNU make. Every byte read from
+/// the jobserver is a job slot, which is given back by writing the byte back.
+struct Jobserver {
+  int ReadFD = -1;
+  int WriteFD = -1;
+};
+
+} // end anonymous namespace
+
+// Include the platform-specific parts of this file. They define:
+//   static bool connectJobserver(Jobserver &Server);
+//   static bool acquireJobserverToken(Jobserver &Server, char &Token);
+//   static void releaseJobserverToken(Jobserver &Server, char Token);
+#ifdef LLVM_ON_UNIX
+#include "Unix/ConcurrencyLimit.inc"
+#endif
+#ifdef _WIN32
+#include "Windows/ConcurrencyLimit.inc"
+#endif
+
+/// The token held by a thread: none, the implicit token of the process, a
+/// token only accounted for locally, or the byte read from the jobserver.
+enum : int { NoToken = -1, ImplicitToken = -2, LocalToken = -3 };
+
+static LLVM_THREAD_LOCAL int HeldToken = NoToken;
+static LLVM_THREAD_LOCAL unsigned HeldTokenDepth = 0;
+
+namespace {
+
+/// The tokens of the process.
+class TokenPool {
+public:
+  TokenPool() { HasJobserver = connectJobserver(Server); }
+
+  void setLimit(unsigned N) {
+    std::lock_guard<std::mutex> LockGuard(Lock);
+    Limit = N;
+    Cond.notify_all();
+  }
+
+  unsigned getLimit() {
+    std::lock_guard<std::mutex> LockGuard(Lock);
+    return Limit;
+  }
+
+  int acquire() {
+    std::unique_lock<std::mutex> LockGuard(Lock);
+    Cond.wait(LockGuard, [&] { return !Limit || Running < Limit; });
+    ++Running;
+    if (ImplicitTokenAvailable) {
+      ImplicitTokenAvailable = false;
+      return ImplicitToken;
+    }
+    if (!HasJobserver)
+      return LocalToken;
+
+    // Wait for a job slot without holding the lock, so that the tokens can
+    // still be released meanwhile.
+    LockGuard.unlock();
+    char Token;
+    if (acquireJobserverToken(Server, Token))
+      return static_cast<unsigned char>(Token);
+    // Stick to the local limit when the jobserver went away.
+    return LocalToken;
+  }
+
+  void release(int Token) {
+    if (Token >= 0)
+      releaseJobserverToken(Server, static_cast<char>(Token));
+    std::lock_guard<std::mutex> LockGuard(Lock);
+    --Running;
+    if (Token == ImplicitToken)
+      ImplicitTokenAvailable = true;
+    Cond.notify_one();
+  }
+
+private:
+  std::mutex Lock;
+  std::condition_variable Cond;
+
+  /// The maximum number of tokens held at the same time, or 0 if there is no
+  /// limit.
+  unsigned Limit = 0;
+
+  /// The number of tokens currently held.
+  unsigned Running = 0;
+
+  /// Whether the token that the process holds by virtue of running, and that
+  /// does not take a job slot of the jobserver, is available.
+  bool ImplicitTokenAvailable = true;
+
+  bool HasJobserver;
+  Jobserver Server;
+};
+
+} // end anonymous namespace
+
+static TokenPool &getTokenPool() {
+  // Never destroyed, as the threads of static pools may still release their
+  // token while the process exits.
+  static TokenPool *Pool = new TokenPool();
+  return *Pool;
+}
+
+void parallel::setMaxConcurrency(unsigned N) { getTokenPool().setLimit(N); }
+
+unsigned parallel::getMaxConcurrency() { return getTokenPool().getLimit(); }
+
+ConcurrencyToken::ConcurrencyToken() {
+  if (HeldTokenDepth++ == 0)
+    HeldToken = getTokenPool().acquire();
+}
+
+ConcurrencyToken::~ConcurrencyToken() {
+  if (--HeldTokenDepth == 0) {
+    getTokenPool().release(HeldToken);
+    HeldToken = NoToken;
+  }
+}
+
+BlockingRegion::BlockingRegion() : Depth(HeldTokenDepth) {
+  if (!Depth)
+    return;
+  getTokenPool().release(HeldToken);
+  HeldToken = NoToken;
+  HeldTokenDepth = 0;
+}
+
+BlockingRegion::~BlockingRegion() {
+  if (!Depth)
+    return;
+  HeldToken = getTokenPool().acquire();
+  HeldTokenDepth = Depth;
+}
+
+#else // LLVM_ENABLE_THREADS Disabled
+
+void parallel::setMaxConcurrency(unsigned N) {}
+
+unsigned parallel::getMaxConcurrency() { return 0; }
+
+ConcurrencyToken::ConcurrencyToken() {}
+
+ConcurrencyToken::~ConcurrencyToken() {}
+
+BlockingRegion::BlockingRegion() : Depth(0) {}
+
+BlockingRegion::~BlockingRegion() {}
+
+#endif
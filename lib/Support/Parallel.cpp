@@ -12,11 +12,7 @@
 
 #if LLVM_ENABLE_THREADS
 
-#include "llvm/Support/Threading.h"
-
-#include <atomic>
-#include <stack>
-#include <thread>
+#include "llvm/Support/ThreadPool.h"
 
 using namespace llvm;
 
@@ -59,62 +55,23 @@ Executor *Executor::getDefaultExecutor() {
 }
 
 #else
-/// An implementation of an Executor that runs closures on a thread pool
-///   in filo order.
+/// An Executor that runs closures on the ThreadPool of the parallel
+/// algorithms, whose threads share the concurrency limit of the process with
+/// the other pools.
 class ThreadPoolExecutor : public Executor {
 public:
-  explicit ThreadPoolExecutor(unsigned ThreadCount = hardware_concurrency())
-      : Done(ThreadCount) {
-    // Spawn all but one of the threads in another thread as spawning threads
-    // can take a while.
-    std::thread([&, ThreadCount] {
-      for (size_t i = 1; i < ThreadCount; ++i) {
-        std::thread([=] { work(); }).detach();
-      }
-      work();
-    }).detach();
-  }
-
-  ~ThreadPoolExecutor() override {
-    std::unique_lock<std::mutex> Lock(Mutex);
-    Stop = true;
-    Lock.unlock();
-    Cond.notify_all();
-    // Wait for ~Latch.
-  }
-
-  void add(std::function<void()> F) override {
-    std::unique_lock<std::mutex> Lock(Mutex);
-    WorkStack.push(F);
-    Lock.unlock();
-    Cond.notify_one();
-  }
+  void add(std::function<void()> F) override { Pool.async(std::move(F)); }
 
 private:
-  void work() {
-    while (true) {
-      std::unique_lock<std::mutex> Lock(Mutex);
-      Cond.wait(Lock, [&] { return Stop || !WorkStack.empty(); });
-      if (Stop)
-        break;
-      auto Task = WorkStack.top();
-      WorkStack.pop();
-      Lock.unlock();
-      Task();
-    }
-    Done.dec();
-  }
-
-  std::atomic<bool> Stop{false};
-  std::stack<std::function<void()>> WorkStack;
-  std::mutex Mutex;
-  std::condition_variable Cond;
-  parallel::detail::Latch Done;
+  ThreadPool Pool;
 };
 
 Executor *Executor::getDefaultExecutor() {
-  static ThreadPoolExecutor exec;
-  return &exec;
+  // The executor is leaked on purpose: ~ThreadPool joins its threads, which
+  // would hang at exit in a child forked after the threads were started, as
+  // the threads are not copied by fork().
+  static ThreadPoolExecutor *Exec = new ThreadPoolExecutor();
+  return Exec;
 }
 #endif
 }
@@ -7,13 +7,17 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements a crude C++11 based thread pool.
+// This file implements a C++11 based work-stealing thread pool.
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/ThreadPool.h"
 
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ConcurrencyLimit.h"
 #include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -21,83 +25,164 @@ using namespace llvm;
 
 #if LLVM_ENABLE_THREADS
 
+/// The pool the current thread belongs to, if any, and the index of its
+/// deque in that pool.
+static LLVM_THREAD_LOCAL ThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentQueue = 0;
+
 // Default to hardware_concurrency
 ThreadPool::ThreadPool() : ThreadPool(hardware_concurrency()) {}
 
 ThreadPool::ThreadPool(unsigned ThreadCount)
-    : ActiveThreads(0), EnableFlag(true) {
-  // Create ThreadCount threads that will loop forever, wait on QueueCondition
-  // for tasks to be queued or the Pool to be destroyed.
+    : QueuedTasks(0), IdleThreads(0), UnfinishedTasks(0), EnableFlag(true) {
+  Queues.reserve(ThreadCount + 1);
+  for (unsigned I = 0; I <= ThreadCount; ++I)
+    Queues.push_back(llvm::make_unique<WorkQueue>());
+
+  // Create ThreadCount threads that will loop forever, running the tasks of
+  // their deque or stealing tasks from the other queues, and wait on
+  // QueueCondition for tasks to be queued or the Pool to be destroyed when
+  // there is nothing left to run.
   Threads.reserve(ThreadCount);
   for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID) {
-    Threads.emplace_back([&] {
+    Threads.emplace_back([this, ThreadID] {
+      CurrentPool = this;
+      CurrentQueue = ThreadID;
+      // The token allowing this thread to run tasks, held as long as there are
+      // tasks to run.
+      Optional<parallel::ConcurrencyToken> Token;
       while (true) {
-        PackagedTaskTy Task;
-        {
-          std::unique_lock<std::mutex> LockGuard(QueueLock);
-          // Wait for tasks to be pushed in the queue
-          QueueCondition.wait(LockGuard,
-                              [&] { return !EnableFlag || !Tasks.empty(); });
-          // Exit condition
-          if (!EnableFlag && Tasks.empty())
-            return;
-          // Yeah, we have a task, grab it and release the lock on the queue
-
-          // We first need to signal that we are active before popping the queue
-          // in order for wait() to properly detect that even if the queue is
-          // empty, there is still a task in flight.
-          {
-            std::unique_lock<std::mutex> LockGuard(CompletionLock);
-            ++ActiveThreads;
+        if (QueuedTasks) {
+          if (!Token)
+            Token.emplace();
+          PackagedTaskTy Task;
+          if (popTask(ThreadID, Task)) {
+            runTask(Task);
+            continue;
           }
-          Task = std::move(Tasks.front());
-          Tasks.pop();
-        }
-        // Run the task we just grabbed
-        Task();
-
-        {
-          // Adjust `ActiveThreads`, in case someone waits on ThreadPool::wait()
-          std::unique_lock<std::mutex> LockGuard(CompletionLock);
-          --ActiveThreads;
         }
-
-        // Notify task completion, in case someone waits on ThreadPool::wait()
-        CompletionCondition.notify_all();
+        Token.reset();
+
+        std::unique_lock<std::mutex> LockGuard(QueueLock);
+        // Announce that we are going idle before checking for tasks, so that
+        // asyncImpl() either sees us idle and notifies us, or queued its task
+        // before our check.
+        ++IdleThreads;
+        QueueCondition.wait(LockGuard,
+                            [&] { return !EnableFlag || QueuedTasks; });
+        --IdleThreads;
+        // Exit condition
+        if (!EnableFlag && !QueuedTasks)
+          return;
       }
     });
   }
 }
 
+unsigned ThreadPool::getQueueIndex() const {
+  return CurrentPool == this ? CurrentQueue : Queues.size() - 1;
+}
+
+bool ThreadPool::popTask(unsigned Self, PackagedTaskTy &Task) {
+  // Run the newest task of our own deque, whose data is most likely to still
+  // be in the cache.
+  {
+    WorkQueue &Own = *Queues[Self];
+    std::unique_lock<std::mutex> LockGuard(Own.Lock);
+    if (!Own.Tasks.empty()) {
+      Task = std::move(Own.Tasks.back());
+      Own.Tasks.pop_back();
+      --QueuedTasks;
+      return true;
+    }
+  }
+
+  // Otherwise steal the oldest task of another queue, starting with the next
+  // one so that idle threads do not all go after the same victim.
+  unsigned NumQueues = Queues.size();
+  for (unsigned I = 1; I < NumQueues; ++I) {
+    WorkQueue &Victim = *Queues[(Self + I) % NumQueues];
+    std::unique_lock<std::mutex> LockGuard(Victim.Lock);
+    if (!Victim.Tasks.empty()) {
+      Task = std::move(Victim.Tasks.front());
+      Victim.Tasks.pop_front();
+      --QueuedTasks;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runTask(PackagedTaskTy &Task) {
+  Task();
+
+  // Notify task completion, in case someone waits on ThreadPool::wait()
+  if (--UnfinishedTasks == 0) {
+    std::unique_lock<std::mutex> LockGuard(CompletionLock);
+    CompletionCondition.notify_all();
+  }
+}
+
 void ThreadPool::wait() {
-  // Wait for all threads to complete and the queue to be empty
+  assert(CurrentPool != this && "Waiting for the pool from one of its tasks");
+  // Wait for all the submitted tasks to complete, leaving our token, if we
+  // are running a task of another pool, to the threads running them.
+  parallel::BlockingRegion Blocking;
   std::unique_lock<std::mutex> LockGuard(CompletionLock);
-  // The order of the checks for ActiveThreads and Tasks.empty() matters because
-  // any active threads might be modifying the Tasks queue, and this would be a
-  // race.
-  CompletionCondition.wait(LockGuard,
-                           [&] { return !ActiveThreads && Tasks.empty(); });
+  CompletionCondition.wait(LockGuard, [&] { return !UnfinishedTasks; });
+}
+
+void ThreadPool::wait(const std::shared_future<void> &Future) {
+  if (CurrentPool != this) {
+    parallel::BlockingRegion Blocking;
+    Future.wait();
+    return;
+  }
+
+  // The task we wait for may be queued behind us, or every other thread may
+  // be waiting as well: keep running tasks until it completes.
+  while (Future.wait_for(std::chrono::seconds(0)) !=
+         std::future_status::ready) {
+    PackagedTaskTy Task;
+    if (popTask(CurrentQueue, Task))
+      runTask(Task);
+    else
+      std::this_thread::yield();
+  }
 }
 
 std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task) {
   /// Wrap the Task in a packaged_task to return a future object.
   PackagedTaskTy PackagedTask(std::move(Task));
   auto Future = PackagedTask.get_future();
-  {
-    // Lock the queue and push the new task
-    std::unique_lock<std::mutex> LockGuard(QueueLock);
 
-    // Don't allow enqueueing after disabling the pool
-    assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
+  // Don't allow enqueueing after disabling the pool
+  assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
+
+  // Account for the task before queuing it, so that it cannot complete
+  // before being counted.
+  ++UnfinishedTasks;
+  ++QueuedTasks;
+  {
+    // Push the task on our own deque when called from a task of the pool,
+    // and on the shared queue otherwise.
+    WorkQueue &Queue = *Queues[getQueueIndex()];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    Queue.Tasks.push_back(std::move(PackagedTask));
+  }
 
-    Tasks.push(std::move(PackagedTask));
+  // Wake up an idle thread, if any. Taking QueueLock makes sure that it is
+  // either waiting on QueueCondition or has yet to check QueuedTasks.
+  if (IdleThreads) {
+    { std::unique_lock<std::mutex> LockGuard(QueueLock); }
+    QueueCondition.notify_one();
   }
-  QueueCondition.notify_one();
   return Future.share();
 }
 
-// The destructor joins all threads, waiting for completion.
+// The destructor waits for all the tasks, then joins all threads.
 ThreadPool::~ThreadPool() {
+  wait();
   {
     std::unique_lock<std::mutex> LockGuard(QueueLock);
     EnableFlag = false;
@@ -113,29 +198,36 @@ ThreadPool::ThreadPool() : ThreadPool(0) {}
 
 // No threads are launched, issue a warning if ThreadCount is not 0
 ThreadPool::ThreadPool(unsigned ThreadCount)
-    : ActiveThreads(0) {
+    : QueuedTasks(0), IdleThreads(0), UnfinishedTasks(0) {
   if (ThreadCount) {
     errs() << "Warning: request a ThreadPool with " << ThreadCount
            << " threads, but LLVM_ENABLE_THREADS has been turned off\n";
   }
+  Queues.push_back(llvm::make_unique<WorkQueue>());
 }
 
 void ThreadPool::wait() {
   // Sequential implementation running the tasks
+  auto &Tasks = Queues.back()->Tasks;
   while (!Tasks.empty()) {
     auto Task = std::move(Tasks.front());
-    Tasks.pop();
+    Tasks.pop_front();
     Task();
   }
 }
 
+void ThreadPool::wait(const std::shared_future<void> &Future) {
+  // The deferred future runs its task.
+  Future.wait();
+}
+
 std::shared_future<void> ThreadPool::asyncImpl(TaskTy Task) {
   // Get a Future with launch::deferred execution using std::async
   auto Future = std::async(std::launch::deferred, std::move(Task)).share();
   // Wrap the future so that both ThreadPool::wait() can operate and the
   // returned future can be sync'ed on.
   PackagedTaskTy PackagedTask([Future]() { Future.get(); });
-  Tasks.push(std::move(PackagedTask));
+  Queues.back()->Tasks.push_back(std::move(PackagedTask));
   return Future;
 }
 
@@ -0,0 +1,263 @@
+//===- TimeProfiler.cpp - Hierarchical Time Profiler ----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file Hierarchical time profiler implementation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+using namespace std::chrono;
+
+namespace {
+
+typedef steady_clock::time_point TimePointType;
+typedef steady_clock::duration DurationType;
+typedef std::pair<size_t, DurationType> CountAndDurationType;
+
+struct Entry {
+  TimePointType Start;
+  DurationType Duration;
+  std::string Name;
+  std::string Detail;
+
+  Entry(TimePointType Start, std::string Name, std::string Detail)
+      : Start(Start), Duration(0), Name(std::move(Name)),
+        Detail(std::move(Detail)) {}
+};
+
+/// The sections of a thread. Only the thread itself updates them while it
+/// records sections, so that recording does not need any lock.
+struct ThreadSections {
+  uint64_t Tid;
+  /// The sections begun and not ended yet, innermost last.
+  SmallVector<Entry, 16> Stack;
+  /// The sections ended and longer than the granularity of the profiler.
+  std::vector<Entry> Entries;
+  /// The number of sections and the time spent in them per name, not counting
+  /// the sections nested in a section of the same name.
+  StringMap<CountAndDurationType> CountAndTotalPerName;
+};
+
+} // end anonymous namespace
+
+/// Every instance of the profiler gets a new generation, which tells the
+/// threads to drop their pointer to the sections of a previous instance.
+static std::atomic<unsigned> ProfilerGeneration(0);
+static LLVM_THREAD_LOCAL ThreadSections *CurrentThreadSections = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentThreadGeneration = 0;
+
+struct llvm::TimeTraceProfiler {
+  TimeTraceProfiler(unsigned TimeTraceGranularity, StringRef ProcName)
+      : StartTime(steady_clock::now()), ProcName(ProcName),
+        TimeTraceGranularity(TimeTraceGranularity),
+        Generation(++ProfilerGeneration) {}
+
+  ThreadSections &getThreadSections() {
+    if (CurrentThreadGeneration != Generation) {
+      std::lock_guard<std::mutex> LockGuard(Lock);
+      Threads.push_back(llvm::make_unique<ThreadSections>());
+      Threads.back()->Tid = get_threadid();
+      CurrentThreadSections = Threads.back().get();
+      CurrentThreadGeneration = Generation;
+    }
+    return *CurrentThreadSections;
+  }
+
+  void begin(std::string Name, function_ref<std::string()> Detail) {
+    getThreadSections().Stack.emplace_back(steady_clock::now(),
+                                           std::move(Name), Detail());
+  }
+
+  void end() {
+    ThreadSections &Sections = getThreadSections();
+    assert(!Sections.Stack.empty() && "Must call begin() first");
+    Entry &E = Sections.Stack.back();
+    E.Duration = steady_clock::now() - E.Start;
+
+    // Only include sections longer than TimeTraceGranularity in the trace.
+    if (duration_cast<microseconds>(E.Duration).count() >=
+        TimeTraceGranularity)
+      Sections.Entries.emplace_back(E);
+
+    // Track the total time of the sections of every name, only counting the
+    // outermost one of recursive sections, like the passes that run nested
+    // pass managers.
+    if (std::find_if(Sections.Stack.begin(), Sections.Stack.end() - 1,
+                     [&](const Entry &Val) { return Val.Name == E.Name; }) ==
+        Sections.Stack.end() - 1) {
+      auto &CountAndTotal = Sections.CountAndTotalPerName[E.Name];
+      CountAndTotal.first++;
+      CountAndTotal.second += E.Duration;
+    }
+
+    Sections.Stack.pop_back();
+  }
+
+  void write(raw_ostream &OS) {
+    std::lock_guard<std::mutex> LockGuard(Lock);
+    json::Array Events;
+
+    auto toJSONString = [](StringRef S) -> json::Value {
+      if (json::isUTF8(S))
+        return S.str();
+      return json::fixUTF8(S);
+    };
+
+    // Emit all the sections, on the thread that recorded them.
+    StringMap<CountAndDurationType> AllCountAndTotalPerName;
+    for (const auto &Sections : Threads) {
+      assert(Sections->Stack.empty() &&
+             "All sections must be ended before writing the trace");
+      for (const Entry &E : Sections->Entries) {
+        auto StartUs = duration_cast<microseconds>(E.Start - StartTime).count();
+        auto DurUs = duration_cast<microseconds>(E.Duration).count();
+        Events.push_back(json::Object{
+            {"pid", 1},
+            {"tid", int64_t(Sections->Tid)},
+            {"ph", "X"},
+            {"ts", StartUs},
+            {"dur", DurUs},
+            {"name", toJSONString(E.Name)},
+            {"args", json::Object{{"detail", toJSONString(E.Detail)}}},
+        });
+      }
+      for (const auto &Total : Sections->CountAndTotalPerName) {
+        auto &CountAndTotal = AllCountAndTotalPerName[Total.getKey()];
+        CountAndTotal.first += Total.getValue().first;
+        CountAndTotal.second += Total.getValue().second;
+      }
+    }
+
+    // Emit the totals, longest first, as sections of their own thread that
+    // start at the beginning of the trace.
+    std::vector<std::pair<std::string, CountAndDurationType>> SortedTotals;
+    for (const auto &Total : AllCountAndTotalPerName)
+      SortedTotals.emplace_back(Total.getKey(), Total.getValue());
+    std::sort(SortedTotals.begin(), SortedTotals.end(),
+              [](const std::pair<std::string, CountAndDurationType> &A,
+                 const std::pair<std::string, CountAndDurationType> &B) {
+                return A.second.second > B.second.second;
+              });
+    for (const auto &Total : SortedTotals) {
+      auto DurUs = duration_cast<microseconds>(Total.second.second).count();
+      auto Count = Total.second.first;
+      Events.push_back(json::Object{
+          {"pid", 1},
+          {"tid", 0},
+          {"ph", "X"},
+          {"ts", 0},
+          {"dur", DurUs},
+          {"name", toJSONString("Total " + Total.first)},
+          {"args", json::Object{{"count", int64_t(Count)},
+                                {"avg ms", (DurUs / Count) / 1000.0}}},
+      });
+    }
+
+    // Emit the metadata naming the process.
+    Events.push_back(json::Object{
+        {"cat", ""},
+        {"pid", 1},
+        {"tid", 0},
+        {"ts", 0},
+        {"ph", "M"},
+        {"name", "process_name"},
+        {"args", json::Object{{"name", toJSONString(ProcName)}}},
+    });
+
+    OS << formatv("{0:2}", json::Value(json::Object{
+                               {"traceEvents", std::move(Events)},
+                               {"displayTimeUnit", "ms"},
+                           }));
+    OS << "\n";
+  }
+
+  /// Guards the registration of the threads and the writing of the trace.
+  std::mutex Lock;
+  std::vector<std::unique_ptr<ThreadSections>> Threads;
+
+  const TimePointType StartTime;
+  const std::string ProcName;
+
+  /// Minimum time granularity (in microseconds).
+  const unsigned TimeTraceGranularity;
+
+  const unsigned Generation;
+};
+
+TimeTraceProfiler *llvm::TimeTraceProfilerInstance = nullptr;
+
+void llvm::timeTraceProfilerInitialize(unsigned TimeTraceGranularity,
+                                       StringRef ProcName) {
+  assert(TimeTraceProfilerInstance == nullptr &&
+         "Profiler should not be initialized");
+  TimeTraceProfilerInstance =
+      new TimeTraceProfiler(TimeTraceGranularity, ProcName);
+}
+
+void llvm::timeTraceProfilerCleanup() {
+  delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = nullptr;
+}
+
+void llvm::timeTraceProfilerWrite(raw_ostream &OS) {
+  assert(TimeTraceProfilerInstance != nullptr &&
+         "Profiler object can't be null");
+  TimeTraceProfilerInstance->write(OS);
+}
+
+Error llvm::timeTraceProfilerWrite(StringRef PreferredFileName,
+                                   StringRef FallbackFileName) {
+  assert(TimeTraceProfilerInstance != nullptr &&
+         "Profiler object can't be null");
+
+  std::string Path = PreferredFileName;
+  if (Path.empty())
+    Path = (FallbackFileName + ".time-trace").str();
+
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::F_Text);
+  if (EC)
+    return createStringError(EC, "could not open %s", Path.c_str());
+
+  timeTraceProfilerWrite(OS);
+  return Error::success();
+}
+
+void llvm::timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name, [&]() { return Detail; });
+}
+
+void llvm::timeTraceProfilerBegin(StringRef Name,
+                                  function_ref<std::string()> Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name, Detail);
+}
+
+void llvm::timeTraceProfilerEnd() {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->end();
+}
@@ -46,6 +46,20 @@ namespace {
                                       "tracking (this may be slow)"),
              cl::Hidden);
 
+  enum class TimerOrder { WallTime, MemUsed, PeakRSS };
+
+  static cl::opt<TimerOrder> SortTimers(
+      "sort-timers", cl::desc("Order of the timers in the timing reports"),
+      cl::init(TimerOrder::WallTime),
+      cl::values(clEnumValN(TimerOrder::WallTime, "wall",
+                            "Sort by wall time (default)"),
+                 clEnumValN(TimerOrder::MemUsed, "mem",
+                            "Sort by memory allocated (with -track-memory)"),
+                 clEnumValN(TimerOrder::PeakRSS, "peak-rss",
+                            "Sort by growth of the peak resident set size "
+                            "(with -track-memory)")),
+      cl::Hidden);
+
   static cl::opt<std::string, true>
   InfoOutputFilename("info-output-file", cl::value_desc("filename"),
                      cl::desc("File to append -stats and -timer output to"),
@@ -111,6 +125,11 @@ static inline size_t getMemUsage() {
   return sys::Process::GetMallocUsage();
 }
 
+static inline size_t getPeakResidentSetSize() {
+  if (!TrackSpace) return 0;
+  return sys::Process::GetPeakResidentSetSize();
+}
+
 TimeRecord TimeRecord::getCurrentTime(bool Start) {
   using Seconds = std::chrono::duration<double, std::ratio<1>>;
   TimeRecord Result;
@@ -119,10 +138,12 @@ TimeRecord TimeRecord::getCurrentTime(bool Start) {
 
   if (Start) {
     Result.MemUsed = getMemUsage();
+    Result.PeakRSS = getPeakResidentSetSize();
     sys::Process::GetTimeUsage(now, user, sys);
   } else {
     sys::Process::GetTimeUsage(now, user, sys);
     Result.MemUsed = getMemUsage();
+    Result.PeakRSS = getPeakResidentSetSize();
   }
 
   Result.WallTime = Seconds(now.time_since_epoch()).count();
@@ -169,6 +190,8 @@ void TimeRecord::print(const TimeRecord &Total, raw_ostream &OS) const {
 
   if (Total.getMemUsed())
     OS << format("%9" PRId64 "  ", (int64_t)getMemUsed());
+  if (Total.getPeakRSS())
+    OS << format("%10" PRId64 "  ", (int64_t)getPeakRSS());
 }
 
 
@@ -294,8 +317,25 @@ void TimerGroup::addTimer(Timer &T) {
 }
 
 void TimerGroup::PrintQueuedTimers(raw_ostream &OS) {
-  // Sort the timers in descending order by amount of time taken.
-  llvm::sort(TimersToPrint.begin(), TimersToPrint.end());
+  // Sort the timers in descending order by amount of time taken, or of memory
+  // used if requested.
+  switch (SortTimers) {
+  case TimerOrder::WallTime:
+    llvm::sort(TimersToPrint.begin(), TimersToPrint.end());
+    break;
+  case TimerOrder::MemUsed:
+    llvm::sort(TimersToPrint.begin(), TimersToPrint.end(),
+               [](const PrintRecord &LHS, const PrintRecord &RHS) {
+                 return LHS.Time.getMemUsed() < RHS.Time.getMemUsed();
+               });
+    break;
+  case TimerOrder::PeakRSS:
+    llvm::sort(TimersToPrint.begin(), TimersToPrint.end(),
+               [](const PrintRecord &LHS, const PrintRecord &RHS) {
+                 return LHS.Time.getPeakRSS() < RHS.Time.getPeakRSS();
+               });
+    break;
+  }
 
   TimeRecord Total;
   for (const PrintRecord &Record : TimersToPrint)
@@ -326,6 +366,8 @@ void TimerGroup::PrintQueuedTimers(raw_ostream &OS) {
   OS << "   ---Wall Time---";
   if (Total.getMemUsed())
     OS << "  ---Mem---";
+  if (Total.getPeakRSS())
+    OS << "  -Peak RSS-";
   OS << "  --- Name ---\n";
 
   // Loop through all of the timing data, printing it out.
@@ -415,6 +457,10 @@ const char *TimerGroup::printJSONValues(raw_ostream &OS, const char *delim) {
       OS << delim;
       printJSONValue(OS, R, ".mem", T.getMemUsed());
     }
+    if (T.getPeakRSS()) {
+      OS << delim;
+      printJSONValue(OS, R, ".peak-rss", T.getPeakRSS());
+    }
   }
   TimersToPrint.clear();
   return delim;
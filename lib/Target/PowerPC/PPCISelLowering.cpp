@@ -9710,6 +9710,81 @@ Instruction *PPCTargetLowering::emitTrailingFence(IRBuilder<> &Builder,
   return nullptr;
 }
 
+// TEXASRU is the upper word of the Transaction EXception And Summary
+// Register; the masks below are for its bits in big-endian numbering.
+static const unsigned TEXASRUFailureCodeShift = 31 - 7;
+static const unsigned TEXASRUFailurePersistent = 1u << (31 - 7);
+static const unsigned TEXASRUFootprintOverflow = 1u << (31 - 10);
+static const unsigned TEXASRUConflicts =
+    1u << (31 - 11) | // Self-induced conflict.
+    1u << (31 - 12) | // Non-transactional conflict.
+    1u << (31 - 13) | // Transaction conflict.
+    1u << (31 - 14) | // Translation invalidation conflict.
+    1u << (31 - 16);  // Instruction fetch conflict.
+static const unsigned TEXASRUAbort = 1u << (31 - 31);
+
+bool PPCTargetLowering::hasHardwareTransactionalMemory() const {
+  // TEXASRU can only be read with a 64-bit mfspr.
+  return Subtarget.hasHTM() && Subtarget.isPPC64();
+}
+
+// tbegin. only tells whether the transaction started. When it did not, build
+// the llvm.htm.begin abort status from the failure summary in TEXASRU. The
+// failure code set by tabort. is in its top byte, whose low bit is the
+// "failure persistent" bit, hence only the 7 bits of HTMAbortCodeMask.
+Value *PPCTargetLowering::emitTransactionBegin(IRBuilder<> &Builder) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Value *Started = Builder.CreateICmpNE(
+      Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::ppc_tbegin),
+                         Builder.getInt32(0)),
+      Builder.getInt32(0));
+  Value *TEXASRU = Builder.CreateTrunc(
+      Builder.CreateCall(
+          Intrinsic::getDeclaration(M, Intrinsic::ppc_get_texasru)),
+      Builder.getInt32Ty());
+
+  auto HasBits = [&](unsigned Mask) {
+    return Builder.CreateICmpNE(Builder.CreateAnd(TEXASRU, Mask),
+                                Builder.getInt32(0));
+  };
+  auto BitIf = [&](Value *Cond, unsigned Bit) {
+    return Builder.CreateSelect(Cond, Builder.getInt32(Bit),
+                                Builder.getInt32(0));
+  };
+  Value *Code = Builder.CreateShl(
+      Builder.CreateLShr(TEXASRU, TEXASRUFailureCodeShift + 1),
+      Intrinsic::HTMAbortCodeShift);
+  Value *Status = Builder.CreateOr(
+      Code, BitIf(HasBits(TEXASRUAbort), Intrinsic::HTMAbortExplicit));
+  Status = Builder.CreateOr(
+      Status, BitIf(Builder.CreateNot(HasBits(TEXASRUFailurePersistent)),
+                    Intrinsic::HTMAbortRetry));
+  Status = Builder.CreateOr(
+      Status, BitIf(HasBits(TEXASRUConflicts), Intrinsic::HTMAbortConflict));
+  Status = Builder.CreateOr(Status, BitIf(HasBits(TEXASRUFootprintOverflow),
+                                          Intrinsic::HTMAbortCapacity));
+  return Builder.CreateSelect(Started, Builder.getInt32(Intrinsic::HTMStarted),
+                              Status);
+}
+
+void PPCTargetLowering::emitTransactionCommit(IRBuilder<> &Builder) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::ppc_tend),
+                     Builder.getInt32(0));
+}
+
+// tabort. does nothing when its operand is zero, so pass the code shifted
+// left with the "failure persistent" bit set, as an explicit abort is not
+// worth retrying.
+void PPCTargetLowering::emitTransactionAbort(IRBuilder<> &Builder,
+                                             Value *Code) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Value *FailureCode = Builder.CreateOr(
+      Builder.CreateShl(Builder.CreateZExt(Code, Builder.getInt32Ty()), 1), 1);
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::ppc_tabort),
+                     FailureCode);
+}
+
 MachineBasicBlock *
 PPCTargetLowering::EmitAtomicBinary(MachineInstr &MI, MachineBasicBlock *BB,
                                     unsigned AtomicSize,
@@ -691,6 +691,12 @@ namespace llvm {
     Instruction *emitTrailingFence(IRBuilder<> &Builder, Instruction *Inst,
                                    AtomicOrdering Ord) const override;
 
+    bool hasHardwareTransactionalMemory() const override;
+    Value *emitTransactionBegin(IRBuilder<> &Builder) const override;
+    void emitTransactionCommit(IRBuilder<> &Builder) const override;
+    void emitTransactionAbort(IRBuilder<> &Builder,
+                              Value *Code) const override;
+
     MachineBasicBlock *
     EmitInstrWithCustomInserter(MachineInstr &MI,
                                 MachineBasicBlock *MBB) const override;
@@ -22,8 +22,10 @@
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/KnownBits.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include <cctype>
 
 using namespace llvm;
@@ -1009,6 +1011,99 @@ bool SystemZTargetLowering::mayBeEmittedAsTailCall(const CallInst *CI) const {
   return CI->isTailCall();
 }
 
+// Transaction abort codes stored in the transaction diagnostic block.
+static const uint64_t TACFetchOverflow = 7;
+static const uint64_t TACFetchConflict = 9;
+static const uint64_t TACFirstTABORT = 256;
+
+bool SystemZTargetLowering::hasHardwareTransactionalMemory() const {
+  return Subtarget.hasTransactionalExecution();
+}
+
+// TBEGIN only sets CC: 0 if the transaction started, 2 after a transient
+// abort, 1 or 3 otherwise. Have it store a transaction diagnostic block to
+// recover the cause of the abort, including the code given to TABORT. The
+// block is only stored on aborts, so it is only read on that path, which
+// keeps the load out of the transaction.
+Value *SystemZTargetLowering::emitTransactionBegin(IRBuilder<> &Builder) const {
+  Instruction *InsertPt = &*Builder.GetInsertPoint();
+  Function *F = InsertPt->getFunction();
+  Module *M = F->getParent();
+  IRBuilder<> EntryBuilder(&*F->getEntryBlock().getFirstInsertionPt());
+  AllocaInst *TDB = EntryBuilder.CreateAlloca(
+      ArrayType::get(Builder.getInt8Ty(), 256), nullptr, "tdb");
+  TDB->setAlignment(8);
+
+  // Save all general registers and allow access register and floating-point
+  // modifications, like __builtin_tbegin.
+  Value *CC = Builder.CreateCall(
+      Intrinsic::getDeclaration(M, Intrinsic::s390_tbegin),
+      {Builder.CreateConstGEP2_32(TDB->getAllocatedType(), TDB, 0, 0),
+       Builder.getInt32(0xff0c)});
+
+  BasicBlock *Head = Builder.GetInsertBlock();
+  Instruction *AbortTerm = SplitBlockAndInsertIfThen(
+      Builder.CreateICmpNE(CC, Builder.getInt32(0)), InsertPt, false,
+      MDBuilder(M->getContext()).createBranchWeights(1, 1000));
+  AbortTerm->getParent()->setName("tbegin.abort");
+  Builder.SetInsertPoint(AbortTerm);
+  Type *TACPtrTy = Builder.getInt64Ty()->getPointerTo(
+      TDB->getType()->getPointerAddressSpace());
+  Value *TACPtr = Builder.CreateBitCast(
+      Builder.CreateConstGEP2_32(TDB->getAllocatedType(), TDB, 0, 8), TACPtrTy);
+  Value *TAC = Builder.CreateAlignedLoad(TACPtr, 8);
+
+  auto BitIf = [&](Value *Cond, unsigned Bit) {
+    return Builder.CreateSelect(Cond, Builder.getInt32(Bit),
+                                Builder.getInt32(0));
+  };
+  auto TACIn = [&](uint64_t First, uint64_t Count) {
+    Value *Offset = Builder.CreateSub(TAC, Builder.getInt64(First));
+    return Builder.CreateICmpULT(Offset, Builder.getInt64(Count));
+  };
+  Value *Code = Builder.CreateTrunc(
+      Builder.CreateLShr(
+          Builder.CreateSub(TAC, Builder.getInt64(TACFirstTABORT)), 1),
+      Builder.getInt32Ty());
+  Value *Explicit = Builder.CreateSelect(
+      Builder.CreateICmpUGE(TAC, Builder.getInt64(TACFirstTABORT)),
+      Builder.CreateOr(Builder.CreateShl(Code, Intrinsic::HTMAbortCodeShift),
+                       Intrinsic::HTMAbortExplicit),
+      Builder.getInt32(0));
+  Value *Status = Builder.CreateOr(
+      Explicit, BitIf(Builder.CreateICmpEQ(CC, Builder.getInt32(2)),
+                      Intrinsic::HTMAbortRetry));
+  Status = Builder.CreateOr(
+      Status, BitIf(TACIn(TACFetchConflict, 2), Intrinsic::HTMAbortConflict));
+  Status = Builder.CreateOr(
+      Status, BitIf(TACIn(TACFetchOverflow, 2), Intrinsic::HTMAbortCapacity));
+
+  BasicBlock *Tail = InsertPt->getParent();
+  Tail->setName("tbegin.end");
+  Builder.SetInsertPoint(Tail, Tail->begin());
+  PHINode *Result = Builder.CreatePHI(Builder.getInt32Ty(), 2);
+  Result->addIncoming(Builder.getInt32(Intrinsic::HTMStarted), Head);
+  Result->addIncoming(Status, AbortTerm->getParent());
+  Builder.SetInsertPoint(InsertPt);
+  return Result;
+}
+
+void SystemZTargetLowering::emitTransactionCommit(IRBuilder<> &Builder) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::s390_tend));
+}
+
+// Codes below 256 are reserved, and an odd code makes the abort persistent.
+void SystemZTargetLowering::emitTransactionAbort(IRBuilder<> &Builder,
+                                                 Value *Code) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Value *TAC = Builder.CreateOr(
+      Builder.CreateShl(Builder.CreateZExt(Code, Builder.getInt64Ty()), 1),
+      TACFirstTABORT | 1);
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::s390_tabort),
+                     TAC);
+}
+
 // We do not yet support 128-bit single-element vector types.  If the user
 // attempts to use such types as function argument or return type, prefer
 // to error out instead of emitting code violating the ABI.
@@ -526,6 +526,11 @@ public:
     return true;
   }
 
+  bool hasHardwareTransactionalMemory() const override;
+  Value *emitTransactionBegin(IRBuilder<> &Builder) const override;
+  void emitTransactionCommit(IRBuilder<> &Builder) const override;
+  void emitTransactionAbort(IRBuilder<> &Builder, Value *Code) const override;
+
 private:
   const SystemZSubtarget &Subtarget;
 
@@ -24639,6 +24639,29 @@ X86TargetLowering::lowerIdempotentRMWIntoFencedLoad(AtomicRMWInst *AI) const {
   return Loaded;
 }
 
+bool X86TargetLowering::hasHardwareTransactionalMemory() const {
+  return Subtarget.hasRTM();
+}
+
+// The llvm.htm.begin status is the one of xbegin.
+Value *X86TargetLowering::emitTransactionBegin(IRBuilder<> &Builder) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  return Builder.CreateCall(
+      Intrinsic::getDeclaration(M, Intrinsic::x86_xbegin));
+}
+
+void X86TargetLowering::emitTransactionCommit(IRBuilder<> &Builder) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::x86_xend));
+}
+
+void X86TargetLowering::emitTransactionAbort(IRBuilder<> &Builder,
+                                             Value *Code) const {
+  Module *M = Builder.GetInsertBlock()->getParent()->getParent();
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::x86_xabort),
+                     Code);
+}
+
 static SDValue LowerATOMIC_FENCE(SDValue Op, const X86Subtarget &Subtarget,
                                  SelectionDAG &DAG) {
   SDLoc dl(Op);
@@ -1288,6 +1288,12 @@ namespace llvm {
     LoadInst *
     lowerIdempotentRMWIntoFencedLoad(AtomicRMWInst *AI) const override;
 
+    bool hasHardwareTransactionalMemory() const override;
+    Value *emitTransactionBegin(IRBuilder<> &Builder) const override;
+    void emitTransactionCommit(IRBuilder<> &Builder) const override;
+    void emitTransactionAbort(IRBuilder<> &Builder,
+                              Value *Code) const override;
+
     bool needsCmpXchgNb(Type *MemType) const;
 
     void SetupEntryBlockForSjLj(MachineInstr &MI, MachineBasicBlock *MBB,
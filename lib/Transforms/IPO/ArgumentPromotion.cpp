@@ -989,6 +989,7 @@ PreservedAnalyses ArgumentPromotionPass::run(LazyCallGraph::SCC &C,
       // replaced by the new function. It does no call graph updates, it merely
       // swaps out the particular function mapped to a particular node in the
       // graph.
+      auto CallGraphLock = UR.lockCallGraph();
       C.getOuterRefSCC().replaceNodeFunction(N, *NewF);
       OldF.eraseFromParent();
     }
@@ -960,9 +960,14 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
     // this caller. We also do any pruning we can at this layer on the caller
     // alone.
     Function &F = *Calls[i].first.getCaller();
-    LazyCallGraph::Node &N = *CG.lookup(F);
-    if (CG.lookupSCC(N) != C)
-      continue;
+    LazyCallGraph::Node *CallerN;
+    {
+      auto CallGraphLock = UR.lockCallGraph();
+      CallerN = CG.lookup(F);
+      if (CG.lookupSCC(*CallerN) != C)
+        continue;
+    }
+    LazyCallGraph::Node &N = *CallerN;
     if (F.hasFnAttribute(Attribute::OptimizeNone)) {
       setInlineRemark(Calls[i].first, "optnone attribute");
       continue;
@@ -1020,8 +1025,12 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
       // trigger infinite inlining, much like is prevented within the inliner
       // itself by the InlineHistory above, but spread across CGSCC iterations
       // and thus hidden from the full inline history.
-      if (CG.lookupSCC(*CG.lookup(Callee)) == C &&
-          UR.InlinedInternalEdges.count({&N, C})) {
+      bool InternalCallee;
+      {
+        auto CallGraphLock = UR.lockCallGraph();
+        InternalCallee = CG.lookupSCC(*CG.lookup(Callee)) == C;
+      }
+      if (InternalCallee && UR.InlinedInternalEdges.count({&N, C})) {
         LLVM_DEBUG(dbgs() << "Skipping inlining internal SCC edge from a node "
                              "previously split out of this SCC by inlining: "
                           << F.getName() << " -> " << Callee.getName() << "\n");
@@ -1124,6 +1133,9 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
       continue;
     Changed = true;
 
+    // The updates below read and change the call graph outside of the caller.
+    auto CallGraphLock = UR.lockCallGraph();
+
     // Add all the inlined callees' edges as ref edges to the caller. These are
     // by definition trivial edges as we always have *some* transitive ref edge
     // chain. While in some cases these edges are direct calls inside the
@@ -1179,6 +1191,8 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
   // that is OK as all we do is delete things and add pointers to unordered
   // sets.
   for (Function *DeadF : DeadFunctions) {
+    auto CallGraphLock = UR.lockCallGraph();
+
     // Get the necessary information out of the call graph and nuke the
     // function there. Also, cclear out any cached analyses.
     auto &DeadC = *CG.lookupSCC(*CG.lookup(*DeadF));
@@ -1196,7 +1210,7 @@ PreservedAnalyses InlinerPass::run(LazyCallGraph::SCC &InitialC,
     UR.InvalidatedRefSCCs.insert(&DeadRC);
 
     // And delete the actual function from the module.
-    M.getFunctionList().erase(DeadF);
+    DeadF->eraseFromParent();
     ++NumDeleted;
   }
 
@@ -156,6 +156,10 @@ static cl::opt<bool> EnableGVNSink(
     "enable-gvn-sink", cl::init(false), cl::Hidden,
     cl::desc("Enable the GVN sinking pass (default = off)"));
 
+static cl::opt<bool> EnableLockElision(
+    "enable-lock-elision", cl::init(false), cl::Hidden,
+    cl::desc("Enable the lock elision pass (default = off)"));
+
 static cl::opt<bool>
     EnableCHR("enable-chr", cl::init(true), cl::Hidden,
               cl::desc("Enable control height reduction optimization (CHR)"));
@@ -737,6 +741,19 @@ void PassManagerBuilder::populateModulePassManager(
   // flattening of blocks.
   MPM.add(createDivRemPairsPass());
 
+  // Turn critical sections into hardware transactions once inlining has
+  // brought lock and unlock calls together and the sections are in their
+  // final shape, then move what does not need to run transactionally out of
+  // the transactions.
+  if (EnableLockElision) {
+    MPM.add(createLockElisionPass(EnablePGOInstrGen, PGOInstrUse));
+    MPM.add(createShrinkTransactionsPass());
+    // The profile counters of the elided sections are only created now, long
+    // after the profile lowering pass ran on the rest of the module.
+    if (EnablePGOInstrGen)
+      MPM.add(createInstrProfilingLegacyPass(InstrProfOptions()));
+  }
+
   // LoopSink (and other loop passes since the last simplifyCFG) might have
   // resulted in single-entry-single-exit or empty blocks. Clean up the CFG.
   MPM.add(createCFGSimplificationPass());
@@ -3816,6 +3816,13 @@ Instruction *InstCombiner::visitCallInst(CallInst &CI) {
     // Update the cache of affected values for this assumption (we might be
     // here because we just simplified the condition).
     AC.updateAffectedValues(II);
+
+    // The known bits of the values it now affects depend on the context, so
+    // the ones computed without it are out of date.
+    SmallVector<Value *, 16> Affected;
+    AssumptionCache::findAffectedValues(II, Affected);
+    for (Value *V : Affected)
+      KBC.forgetValue(V);
     break;
   }
   case Intrinsic::experimental_gc_relocate: {
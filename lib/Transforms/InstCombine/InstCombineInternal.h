@@ -19,6 +19,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/TargetFolder.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Analysis/ValueTracking.h"
@@ -55,6 +56,7 @@ class DataLayout;
 class DominatorTree;
 class GEPOperator;
 class GlobalVariable;
+class InstCombineTracker;
 class LoopInfo;
 class OptimizationRemarkEmitter;
 class TargetLibraryInfo;
@@ -297,6 +299,7 @@ private:
   TargetLibraryInfo &TLI;
   DominatorTree &DT;
   const DataLayout &DL;
+  KnownBitsCache &KBC;
   const SimplifyQuery SQ;
   OptimizationRemarkEmitter &ORE;
 
@@ -304,6 +307,9 @@ private:
   // combining and will be updated to reflect any changes.
   LoopInfo *LI;
 
+  /// When non-null, records the instructions left unchanged.
+  InstCombineTracker *Tracker;
+
   bool MadeIRChange = false;
 
 public:
@@ -311,10 +317,12 @@ public:
                bool MinimizeSize, bool ExpensiveCombines, AliasAnalysis *AA,
                AssumptionCache &AC, TargetLibraryInfo &TLI, DominatorTree &DT,
                OptimizationRemarkEmitter &ORE, const DataLayout &DL,
-               LoopInfo *LI)
+               KnownBitsCache &KBC, LoopInfo *LI, InstCombineTracker *Tracker)
       : Worklist(Worklist), Builder(Builder), MinimizeSize(MinimizeSize),
         ExpensiveCombines(ExpensiveCombines), AA(AA), AC(AC), TLI(TLI), DT(DT),
-        DL(DL), SQ(DL, &TLI, &DT, &AC), ORE(ORE), LI(LI) {}
+        DL(DL), KBC(KBC),
+        SQ(DL, &TLI, &DT, &AC, /*CXTI=*/nullptr, /*UseInstrInfo=*/true, &KBC),
+        ORE(ORE), LI(LI), Tracker(Tracker) {}
 
   /// Run the combiner over the entire worklist until it is empty.
   ///
@@ -624,6 +632,8 @@ public:
     LLVM_DEBUG(dbgs() << "IC: Replacing " << I << "\n"
                       << "    with " << *V << '\n');
 
+    // The users are only reachable from I until their operands are replaced.
+    KBC.forgetValue(&I);
     I.replaceAllUsesWith(V);
     return &I;
   }
@@ -663,12 +673,14 @@ public:
 
   void computeKnownBits(const Value *V, KnownBits &Known,
                         unsigned Depth, const Instruction *CxtI) const {
-    llvm::computeKnownBits(V, Known, DL, Depth, &AC, CxtI, &DT);
+    llvm::computeKnownBits(V, Known, DL, Depth, &AC, CxtI, &DT,
+                           /*ORE=*/nullptr, /*UseInstrInfo=*/true, &KBC);
   }
 
   KnownBits computeKnownBits(const Value *V, unsigned Depth,
                              const Instruction *CxtI) const {
-    return llvm::computeKnownBits(V, DL, Depth, &AC, CxtI, &DT);
+    return llvm::computeKnownBits(V, DL, Depth, &AC, CxtI, &DT,
+                                  /*ORE=*/nullptr, /*UseInstrInfo=*/true, &KBC);
   }
 
   bool isKnownToBeAPowerOfTwo(const Value *V, bool OrZero = false,
@@ -679,12 +691,14 @@ public:
 
   bool MaskedValueIsZero(const Value *V, const APInt &Mask, unsigned Depth = 0,
                          const Instruction *CxtI = nullptr) const {
-    return llvm::MaskedValueIsZero(V, Mask, DL, Depth, &AC, CxtI, &DT);
+    return llvm::MaskedValueIsZero(V, Mask, DL, Depth, &AC, CxtI, &DT,
+                                   /*UseInstrInfo=*/true, &KBC);
   }
 
   unsigned ComputeNumSignBits(const Value *Op, unsigned Depth = 0,
                               const Instruction *CxtI = nullptr) const {
-    return llvm::ComputeNumSignBits(Op, DL, Depth, &AC, CxtI, &DT);
+    return llvm::ComputeNumSignBits(Op, DL, Depth, &AC, CxtI, &DT,
+                                    /*UseInstrInfo=*/true, &KBC);
   }
 
   OverflowResult computeOverflowForUnsignedMul(const Value *LHS,
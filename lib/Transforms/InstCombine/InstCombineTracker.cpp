@@ -0,0 +1,76 @@
+//===- InstCombineTracker.cpp - Instructions left unchanged ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains an analysis that remembers the instructions InstCombine
+// visited without changing them, so that its later runs on the function only
+// visit the instructions that changed in between.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/InstCombine/InstCombineTracker.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+
+using namespace llvm;
+
+/// Hash what the combines look at of \p I, see InstCombineTracker.
+static size_t getSignature(Instruction &I) {
+  unsigned NumUses = I.use_empty() ? 0 : I.hasOneUse() ? 1 : 2;
+  hash_code Hash = hash_combine(
+      I.getOpcode(), I.getType(), I.getParent(), I.getRawSubclassOptionalData(),
+      NumUses, hash_combine_range(I.value_op_begin(), I.value_op_end()));
+
+  if (auto *PN = dyn_cast<PHINode>(&I))
+    return hash_combine(Hash,
+                        hash_combine_range(PN->block_begin(), PN->block_end()));
+  if (auto *Cmp = dyn_cast<CmpInst>(&I))
+    return hash_combine(Hash, Cmp->getPredicate());
+  if (auto *LI = dyn_cast<LoadInst>(&I))
+    return hash_combine(Hash, LI->getAlignment(), LI->isVolatile());
+  if (auto *SI = dyn_cast<StoreInst>(&I))
+    return hash_combine(Hash, SI->getAlignment(), SI->isVolatile());
+  if (CallSite CS = CallSite(&I)) {
+    Hash = hash_combine(Hash, CS.getAttributes().getRawPointer());
+    if (Function *Callee = CS.getCalledFunction())
+      Hash = hash_combine(Hash, Callee->getAttributes().getRawPointer());
+  }
+  return Hash;
+}
+
+void InstCombineTracker::InstCallbackVH::deleted() {
+  Tracker->Unchanged.erase(getValPtr());
+  // 'this' now dangles!
+}
+
+void InstCombineTracker::markUnchanged(Instruction &I) {
+  size_t Signature = getSignature(I);
+  auto It = Unchanged.find_as(&I);
+  if (It != Unchanged.end()) {
+    It->second = Signature;
+    return;
+  }
+  Unchanged.insert({InstCallbackVH(&I, this), Signature});
+}
+
+bool InstCombineTracker::isChanged(Instruction &I) const {
+  auto It = Unchanged.find_as(&I);
+  return It == Unchanged.end() || It->second != getSignature(I);
+}
+
+AnalysisKey InstCombineTrackerAnalysis::Key;
+
+InstCombineTracker InstCombineTrackerAnalysis::run(Function &F,
+                                                   FunctionAnalysisManager &AM) {
+  return InstCombineTracker();
+}
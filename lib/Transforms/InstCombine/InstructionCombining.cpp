@@ -52,6 +52,7 @@
 #include "llvm/Analysis/EHPersonalities.h"
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/KnownBitsCache.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/OptimizationRemarkEmitter.h"
@@ -96,6 +97,7 @@
 #include "llvm/Support/KnownBits.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/InstCombine/InstCombineTracker.h"
 #include "llvm/Transforms/InstCombine/InstCombineWorklist.h"
 #include <algorithm>
 #include <cassert>
@@ -116,6 +118,7 @@ STATISTIC(NumSunkInst , "Number of instructions sunk");
 STATISTIC(NumExpand,    "Number of expansions");
 STATISTIC(NumFactor   , "Number of factorizations");
 STATISTIC(NumReassoc  , "Number of reassociations");
+STATISTIC(NumUnchanged, "Number of unchanged insts not visited again");
 DEBUG_COUNTER(VisitCounter, "instcombine-visit",
               "Controls which instructions are visited");
 
@@ -123,6 +126,11 @@ static cl::opt<bool>
 EnableExpensiveCombines("expensive-combines",
                         cl::desc("Enable expensive instruction combines"));
 
+static cl::opt<bool> EnableIncremental(
+    "instcombine-incremental", cl::Hidden, cl::init(false),
+    cl::desc("Only visit the instructions that changed, or whose operands or "
+             "users changed, since instcombine last visited them"));
+
 static cl::opt<unsigned>
 MaxArraySize("instcombine-maxarray-size", cl::init(1024),
              cl::desc("Maximum array size considered when doing a combine"));
@@ -3160,6 +3168,13 @@ bool InstCombiner::run() {
         }
       }
       MadeIRChange = true;
+
+      // The combines change their operands and flags in place, along with
+      // those of the instructions around, so the cached known bits of any
+      // value may now be out of date.
+      KBC.clear();
+    } else if (Tracker) {
+      Tracker->markUnchanged(*I);
     }
   }
 
@@ -3178,7 +3193,8 @@ bool InstCombiner::run() {
 static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
                                        SmallPtrSetImpl<BasicBlock *> &Visited,
                                        InstCombineWorklist &ICWorklist,
-                                       const TargetLibraryInfo *TLI) {
+                                       const TargetLibraryInfo *TLI,
+                                       InstCombineTracker *Tracker) {
   bool MadeIRChange = false;
   SmallVector<BasicBlock*, 256> Worklist;
   Worklist.push_back(BB);
@@ -3268,6 +3284,29 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
       Worklist.push_back(SuccBB);
   } while (!Worklist.empty());
 
+  // Only keep the instructions which changed since instcombine last left them
+  // unchanged, and their operands and users.
+  if (Tracker) {
+    SmallPtrSet<Instruction *, 32> Changed;
+    for (Instruction *I : InstrsForInstCombineWorklist) {
+      if (!Tracker->isChanged(*I))
+        continue;
+      Changed.insert(I);
+      for (Value *Op : I->operands())
+        if (auto *OpI = dyn_cast<Instruction>(Op))
+          Changed.insert(OpI);
+      for (User *U : I->users())
+        Changed.insert(cast<Instruction>(U));
+    }
+
+    size_t NumReachable = InstrsForInstCombineWorklist.size();
+    InstrsForInstCombineWorklist.erase(
+        remove_if(InstrsForInstCombineWorklist,
+                  [&](Instruction *I) { return !Changed.count(I); }),
+        InstrsForInstCombineWorklist.end());
+    NumUnchanged += NumReachable - InstrsForInstCombineWorklist.size();
+  }
+
   // Once we've found all of the instructions to add to instcombine's worklist,
   // add them in reverse order.  This way instcombine will visit from the top
   // of the function down.  This jives well with the way that it adds all uses
@@ -3285,7 +3324,8 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
 /// the combiner itself run much faster.
 static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
                                           TargetLibraryInfo *TLI,
-                                          InstCombineWorklist &ICWorklist) {
+                                          InstCombineWorklist &ICWorklist,
+                                          InstCombineTracker *Tracker) {
   bool MadeIRChange = false;
 
   // Do a depth-first traversal of the function, populate the worklist with
@@ -3293,7 +3333,8 @@ static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
   // track of which blocks we visit.
   SmallPtrSet<BasicBlock *, 32> Visited;
   MadeIRChange |=
-      AddReachableCodeToWorklist(&F.front(), DL, Visited, ICWorklist, TLI);
+      AddReachableCodeToWorklist(&F.front(), DL, Visited, ICWorklist, TLI,
+                                 Tracker);
 
   // Do a quick scan over the function.  If we find any blocks that are
   // unreachable, remove any instructions inside of them.  This prevents
@@ -3313,7 +3354,8 @@ static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
 static bool combineInstructionsOverFunction(
     Function &F, InstCombineWorklist &Worklist, AliasAnalysis *AA,
     AssumptionCache &AC, TargetLibraryInfo &TLI, DominatorTree &DT,
-    OptimizationRemarkEmitter &ORE, bool ExpensiveCombines = true,
+    OptimizationRemarkEmitter &ORE, KnownBitsCache &KBC,
+    InstCombineTracker *Tracker, bool ExpensiveCombines = true,
     LoopInfo *LI = nullptr) {
   auto &DL = F.getParent()->getDataLayout();
   ExpensiveCombines |= EnableExpensiveCombines;
@@ -3341,10 +3383,11 @@ static bool combineInstructionsOverFunction(
     LLVM_DEBUG(dbgs() << "\n\nINSTCOMBINE ITERATION #" << Iteration << " on "
                       << F.getName() << "\n");
 
-    MadeIRChange |= prepareICWorklistFromFunction(F, DL, &TLI, Worklist);
+    MadeIRChange |=
+        prepareICWorklistFromFunction(F, DL, &TLI, Worklist, Tracker);
 
     InstCombiner IC(Worklist, Builder, F.optForMinSize(), ExpensiveCombines, AA,
-                    AC, TLI, DT, ORE, DL, LI);
+                    AC, TLI, DT, ORE, DL, KBC, LI, Tracker);
     IC.MaxArraySizeForCombine = MaxArraySize;
 
     if (!IC.run())
@@ -3360,12 +3403,18 @@ PreservedAnalyses InstCombinePass::run(Function &F,
   auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
   auto &TLI = AM.getResult<TargetLibraryAnalysis>(F);
   auto &ORE = AM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+  auto &KBC = AM.getResult<KnownBitsAnalysis>(F);
 
   auto *LI = AM.getCachedResult<LoopAnalysis>(F);
 
+  // The tracker is kept between the runs on the function.
+  InstCombineTracker *Tracker = nullptr;
+  if (EnableIncremental)
+    Tracker = &AM.getResult<InstCombineTrackerAnalysis>(F);
+
   auto *AA = &AM.getResult<AAManager>(F);
-  if (!combineInstructionsOverFunction(F, Worklist, AA, AC, TLI, DT, ORE,
-                                       ExpensiveCombines, LI))
+  if (!combineInstructionsOverFunction(F, Worklist, AA, AC, TLI, DT, ORE, KBC,
+                                       Tracker, ExpensiveCombines, LI))
     // No changes, all analyses are preserved.
     return PreservedAnalyses::all();
 
@@ -3375,6 +3424,7 @@ PreservedAnalyses InstCombinePass::run(Function &F,
   PA.preserve<AAManager>();
   PA.preserve<BasicAA>();
   PA.preserve<GlobalsAA>();
+  PA.preserve<KnownBitsAnalysis>();
   return PA;
 }
 
@@ -3406,7 +3456,16 @@ bool InstructionCombiningPass::runOnFunction(Function &F) {
   auto *LIWP = getAnalysisIfAvailable<LoopInfoWrapperPass>();
   auto *LI = LIWP ? &LIWP->getLoopInfo() : nullptr;
 
-  return combineInstructionsOverFunction(F, Worklist, AA, AC, TLI, DT, ORE,
+  // The known bits are only kept for the duration of the pass, as the other
+  // passes do not update them.
+  KnownBitsCache KBC(AC);
+
+  // Likewise, the instructions left unchanged are only tracked across the
+  // iterations of the pass.
+  InstCombineTracker Tracker;
+
+  return combineInstructionsOverFunction(F, Worklist, AA, AC, TLI, DT, ORE, KBC,
+                                         EnableIncremental ? &Tracker : nullptr,
                                          ExpensiveCombines, LI);
 }
 
@@ -0,0 +1,863 @@
+//===- LockElision.cpp - Elide pthread mutex critical sections ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass rewrites critical sections guarded by pthread_mutex_lock and
+// pthread_mutex_unlock into hardware memory transactions. For a critical
+// section
+//
+//   %r = call i32 @pthread_mutex_lock(%m)
+//   ...
+//   %u = call i32 @pthread_mutex_unlock(%m)
+//
+// we generate
+//
+//   %status = call i32 @llvm.htm.begin()
+//   %started = icmp eq i32 %status, -1
+//   br i1 %started, label %elide.check, label %elide.fallback
+// elide.check:
+//   ; Add the lock word to the read set so that a thread taking the real lock
+//   ; aborts us, and give up right away if the lock is already held.
+//   %word = load i32, i32* %m
+//   br (%word == 0), label %elide.cont, label %elide.busy
+// elide.busy:
+//   call void @llvm.htm.abort(i8 127)
+//   br label %elide.fallback
+// elide.fallback:
+//   %r = call i32 @pthread_mutex_lock(%m)
+//   ...
+//   br i1 %started, label %elide.release, label %elide.unlock
+// elide.release:
+//   ; Like glibc, only commit if the lock word is still free: a callee may
+//   ; have taken the lock inside the transaction.
+//   %word2 = load i32, i32* %m
+//   br (%word2 == 0), label %elide.commit, label %elide.taken
+// elide.commit:
+//   call void @llvm.htm.commit()
+// elide.taken:
+//   call void @llvm.htm.abort(i8 126)
+// elide.unlock:
+//   %u = call i32 @pthread_mutex_unlock(%m)
+//
+// The critical section itself is left untouched, so it runs either inside the
+// transaction or with the lock held. Reading the lock word relies on the glibc
+// layout of pthread_mutex_t, which keeps the lock state in its first word.
+//
+// Unless disabled by the retry policy, an aborted transaction is not given up
+// right away: the abort status is inspected in %elide.abort and, if the
+// hardware reports that a retry may succeed or the lock was busy, the
+// transaction is restarted after an exponentially growing pause loop in
+// %elide.backoff.
+// The policy is read from the "lock-elision-retries", "lock-elision-backoff"
+// and "lock-elision-max-backoff" function attributes, and may be overridden
+// with the command-line options of the same name.
+//
+// Critical sections that are certain to abort, because they always execute an
+// instruction that cannot run transactionally or touch more cache lines than
+// the hardware can track, are left alone: see TransactionalFootprint.h.
+//
+// The pass can instrument the sections it elides with instrumentation profile
+// counters, recording for each section how many transactions committed, how
+// many executions fell back to the lock, and how many transactions aborted
+// for each abort cause. The counters are stored as an ordinary profile record
+// named after the function with a ".lock-elision" suffix, so they end up in
+// the .profraw file and are merged by llvm-profdata like any other counters.
+// When compiling with the resulting profile, sections that rarely commit are
+// not elided, and the retry policy of the others is adjusted to the causes of
+// their aborts.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Scalar/LockElision.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/GlobalsModRef.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/TransactionalFootprint.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DiagnosticInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "lock-elision"
+
+STATISTIC(NumCriticalSections, "Number of critical sections found");
+STATISTIC(NumElided, "Number of critical sections elided");
+STATISTIC(NumCertainToAbort,
+          "Number of critical sections not elided as they always abort");
+STATISTIC(NumUnprofitable,
+          "Number of critical sections not elided as their profile shows "
+          "that they rarely commit");
+STATISTIC(NumProfileTuned,
+          "Number of critical sections whose retry policy was tuned by the "
+          "profile");
+
+static cl::opt<unsigned> MaxCriticalSectionSize(
+    "lock-elision-max-size", cl::init(256), cl::Hidden,
+    cl::desc("Maximum number of instructions in a critical section "
+             "considered for lock elision"));
+
+static cl::opt<unsigned> Retries(
+    "lock-elision-retries", cl::init(3), cl::Hidden,
+    cl::desc("Number of times an aborted transaction is retried before "
+             "taking the lock"));
+
+static cl::opt<unsigned> Backoff(
+    "lock-elision-backoff", cl::init(16), cl::Hidden,
+    cl::desc("Number of pause iterations before the first retry of an "
+             "aborted transaction (0 retries right away)"));
+
+static cl::opt<unsigned> MaxBackoff(
+    "lock-elision-max-backoff", cl::init(1024), cl::Hidden,
+    cl::desc("Upper bound of the exponentially growing number of pause "
+             "iterations between retries"));
+
+static cl::opt<bool> ClInstrumentAborts(
+    "lock-elision-profile-gen", cl::init(false), cl::Hidden,
+    cl::desc("Count the commits and aborts of elided critical sections into "
+             "the instrumentation profile"));
+
+// Command line option to specify the profile file to read the aborts of
+// elided critical sections from. This is mainly used for testing.
+static cl::opt<std::string> ClProfileFile(
+    "lock-elision-profile-use", cl::init(""), cl::Hidden,
+    cl::value_desc("filename"),
+    cl::desc("Specify the path of the profile data file with the aborts of "
+             "elided critical sections"));
+
+static cl::opt<unsigned> ProfileMinExecutions(
+    "lock-elision-profile-min-executions", cl::init(100), cl::Hidden,
+    cl::desc("Minimum number of profiled executions of a critical section "
+             "for its profile to be used"));
+
+static cl::opt<unsigned> MinCommitPercent(
+    "lock-elision-min-commit-percent", cl::init(20), cl::Hidden,
+    cl::desc("Do not elide critical sections whose profiled executions "
+             "commit less often than this percentage"));
+
+/// Explicit abort code used when the elided lock turns out to be held.
+static const unsigned LockBusyAbortCode = Intrinsic::HTMAbortCodeMask;
+
+/// Explicit abort code used when the lock word was taken inside the
+/// transaction, e.g. by a callee that unlocks and relocks the mutex, or tries
+/// to lock it.
+static const unsigned LockTakenAbortCode = Intrinsic::HTMAbortCodeMask - 1;
+
+/// Abort status of a transaction aborted because the lock was held, and the
+/// bits of the status to compare with it.
+static const unsigned LockBusyStatus =
+    LockBusyAbortCode << Intrinsic::HTMAbortCodeShift |
+    Intrinsic::HTMAbortExplicit;
+static const unsigned LockBusyStatusMask =
+    Intrinsic::HTMAbortCodeMask << Intrinsic::HTMAbortCodeShift |
+    Intrinsic::HTMAbortExplicit;
+
+/// Profile counters of an elided critical section.
+enum ElisionCounter : unsigned {
+  /// Transactions that committed.
+  CommitCount,
+  /// Executions that took the lock.
+  FallbackCount,
+  /// Transactions aborted because the lock was held.
+  BusyAbortCount,
+  /// Transactions aborted by another llvm.htm.abort.
+  ExplicitAbortCount,
+  /// Transactions aborted by a conflicting access of another thread.
+  ConflictAbortCount,
+  /// Transactions aborted because they ran out of transactional resources.
+  CapacityAbortCount,
+  /// Transactions aborted for any other reason (interrupts, ...).
+  OtherAbortCount,
+  NumElisionCounters
+};
+
+namespace {
+
+/// How aborted transactions are retried before falling back to the lock.
+struct RetryPolicy {
+  unsigned MaxRetries;
+  unsigned InitialBackoff;
+  unsigned MaxBackoff;
+};
+
+/// A critical section started by a call to pthread_mutex_lock and ended by
+/// the matching calls to pthread_mutex_unlock on every path leaving it.
+struct CriticalSection {
+  CallInst *Lock;
+  SmallVector<CallInst *, 2> Unlocks;
+  /// Position of the section in the profile record of the function.
+  unsigned Index = 0;
+  RetryPolicy Policy;
+};
+
+class LockElision {
+  Function &F;
+  const DominatorTree &DT;
+  const TransactionalFootprintInfo &TFI;
+  OptimizationRemarkEmitter &ORE;
+  RetryPolicy DefaultPolicy;
+  bool InstrumentAborts;
+  IndexedInstrProfReader *ProfileReader;
+
+  /// Profile record of the function: a block of NumElisionCounters counters
+  /// for each of its NumProfiledSections critical sections.
+  GlobalVariable *ProfileNameVar = nullptr;
+  uint64_t ProfileHash = 0;
+  unsigned NumProfiledSections = 0;
+
+  bool findCriticalSection(CallInst *Lock, CriticalSection &CS);
+  void readProfile(MutableArrayRef<CriticalSection> Sections,
+                   SmallVectorImpl<bool> &Profitable);
+  bool applyProfile(CriticalSection &CS, ArrayRef<uint64_t> Counts);
+  void count(IRBuilder<> &Builder, const CriticalSection &CS,
+             ElisionCounter Counter, Value *Step = nullptr);
+  void countAbort(IRBuilder<> &Builder, const CriticalSection &CS,
+                  Value *Status);
+  void elide(CriticalSection &CS);
+
+public:
+  LockElision(Function &F, const DominatorTree &DT,
+              const TransactionalFootprintInfo &TFI,
+              OptimizationRemarkEmitter &ORE, const RetryPolicy &Policy,
+              bool InstrumentAborts, IndexedInstrProfReader *ProfileReader)
+      : F(F), DT(DT), TFI(TFI), ORE(ORE), DefaultPolicy(Policy),
+        InstrumentAborts(InstrumentAborts), ProfileReader(ProfileReader) {}
+
+  bool run();
+};
+
+} // end anonymous namespace
+
+/// Read an unsigned integer function attribute, letting an explicitly given
+/// command-line option take precedence.
+static unsigned getPolicyParam(const Function &F, const cl::opt<unsigned> &Opt,
+                               StringRef Name) {
+  unsigned Val = Opt;
+  if (Opt.getNumOccurrences() == 0 && F.hasFnAttribute(Name))
+    F.getFnAttribute(Name).getValueAsString().getAsInteger(0, Val);
+  return Val;
+}
+
+static RetryPolicy getRetryPolicy(const Function &F) {
+  RetryPolicy Policy;
+  Policy.MaxRetries = getPolicyParam(F, Retries, "lock-elision-retries");
+  Policy.InitialBackoff = getPolicyParam(F, Backoff, "lock-elision-backoff");
+  Policy.MaxBackoff =
+      std::max(Policy.InitialBackoff,
+               getPolicyParam(F, MaxBackoff, "lock-elision-max-backoff"));
+  return Policy;
+}
+
+/// If \p I is a call to the function \p Name, return the mutex it operates on.
+static Value *getMutexOperand(const Instruction &I, StringRef Name) {
+  const auto *CI = dyn_cast<CallInst>(&I);
+  if (!CI)
+    return nullptr;
+  const Function *Callee = CI->getCalledFunction();
+  if (!Callee || Callee->getName() != Name || CI->getNumArgOperands() != 1 ||
+      !CI->getArgOperand(0)->getType()->isPointerTy())
+    return nullptr;
+  return CI->getArgOperand(0)->stripPointerCasts();
+}
+
+/// Walk every path from \p Lock to the unlock of the same mutex and record the
+/// unlocks in \p CS. Fail if some path leaves the function, re-enters the
+/// lock, may unwind, or if the section is too large to fit in a transaction.
+bool LockElision::findCriticalSection(CallInst *Lock, CriticalSection &CS) {
+  Value *Mutex = getMutexOperand(*Lock, "pthread_mutex_lock");
+  BasicBlock *LockBB = Lock->getParent();
+  unsigned Size = 0;
+
+  CS.Lock = Lock;
+  SmallVector<BasicBlock *, 8> Worklist;
+  SmallPtrSet<BasicBlock *, 8> Visited;
+
+  auto ScanFrom = [&](BasicBlock *BB, BasicBlock::iterator It) {
+    for (Instruction &I : make_range(It, BB->end())) {
+      if (getMutexOperand(I, "pthread_mutex_unlock") == Mutex) {
+        auto *Unlock = cast<CallInst>(&I);
+        if (!DT.dominates(Lock, Unlock))
+          return false;
+        CS.Unlocks.push_back(Unlock);
+        return true;
+      }
+      if (getMutexOperand(I, "pthread_mutex_lock") == Mutex || I.mayThrow() ||
+          ++Size > MaxCriticalSectionSize)
+        return false;
+    }
+    // Leaving the function with the lock held would leave the transaction
+    // open.
+    if (succ_empty(BB))
+      return false;
+    for (BasicBlock *Succ : successors(BB)) {
+      if (Succ == LockBB)
+        return false;
+      if (Visited.insert(Succ).second)
+        Worklist.push_back(Succ);
+    }
+    return true;
+  };
+
+  if (!ScanFrom(LockBB, std::next(Lock->getIterator())))
+    return false;
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (!ScanFrom(BB, BB->begin()))
+      return false;
+  }
+  return !CS.Unlocks.empty();
+}
+
+/// Name of the profile record holding the counters of the critical sections
+/// of \p F.
+static std::string getElisionProfileName(const Function &F) {
+  return getPGOFuncName(F) + ".lock-elision";
+}
+
+/// Read the counters of \p Sections from the profile, and clear the entries
+/// of \p Profitable for the sections that should not be elided.
+void LockElision::readProfile(MutableArrayRef<CriticalSection> Sections,
+                              SmallVectorImpl<bool> &Profitable) {
+  Expected<InstrProfRecord> Result = ProfileReader->getInstrProfRecord(
+      getElisionProfileName(F), ProfileHash);
+  if (Error E = Result.takeError()) {
+    handleAllErrors(std::move(E), [&](const InstrProfError &IPE) {
+      // Functions that were never executed have no record.
+      if (IPE.get() == instrprof_error::unknown_function)
+        return;
+      std::string Msg = IPE.message() + std::string(" ") + F.getName().str();
+      F.getContext().diagnose(DiagnosticInfoPGOProfile(
+          F.getParent()->getName().data(), Msg, DS_Warning));
+    });
+    return;
+  }
+
+  ArrayRef<uint64_t> Counts = Result->Counts;
+  for (CriticalSection &CS : Sections)
+    Profitable[CS.Index] = applyProfile(
+        CS, Counts.slice(CS.Index * NumElisionCounters, NumElisionCounters));
+}
+
+/// Tune the retry policy of \p CS to the causes of the aborts recorded in
+/// \p Counts. Return false if the section commits too rarely to be elided.
+bool LockElision::applyProfile(CriticalSection &CS,
+                               ArrayRef<uint64_t> Counts) {
+  uint64_t Commits = Counts[CommitCount];
+  uint64_t Executions = Commits + Counts[FallbackCount];
+  uint64_t Aborts = 0;
+  for (unsigned C = BusyAbortCount; C != NumElisionCounters; ++C)
+    Aborts += Counts[C];
+  if (Executions < ProfileMinExecutions)
+    return true;
+
+  if (Commits * 100 < Executions * MinCommitPercent) {
+    ++NumUnprofitable;
+    ORE.emit([&]() {
+      return OptimizationRemarkMissed(DEBUG_TYPE, "Unprofitable", CS.Lock)
+             << "critical section not elided: only "
+             << ore::NV("Commits", Commits) << " of "
+             << ore::NV("Executions", Executions)
+             << " profiled executions committed";
+    });
+    return false;
+  }
+
+  // Capacity aborts and explicit aborts other than for a busy lock happen
+  // again when the transaction is retried.
+  RetryPolicy &Policy = CS.Policy;
+  uint64_t Persistent =
+      Counts[CapacityAbortCount] + Counts[ExplicitAbortCount];
+  if (Policy.MaxRetries && Persistent * 2 > Aborts) {
+    Policy.MaxRetries = 0;
+    ++NumProfileTuned;
+    ORE.emit([&]() {
+      return OptimizationRemarkAnalysis(DEBUG_TYPE, "ProfileTuned", CS.Lock)
+             << "not retrying aborted transactions: "
+             << ore::NV("PersistentAborts", Persistent) << " of "
+             << ore::NV("Aborts", Aborts)
+             << " profiled aborts would happen again";
+    });
+    return true;
+  }
+
+  // When the lock is mostly found busy, give its holder more time to release
+  // it before retrying.
+  if (Policy.MaxRetries && Policy.InitialBackoff &&
+      Policy.InitialBackoff < Policy.MaxBackoff &&
+      Counts[BusyAbortCount] * 2 > Aborts) {
+    Policy.InitialBackoff = std::min(Policy.InitialBackoff * 4,
+                                     Policy.MaxBackoff);
+    ++NumProfileTuned;
+    ORE.emit([&]() {
+      return OptimizationRemarkAnalysis(DEBUG_TYPE, "ProfileTuned", CS.Lock)
+             << "backing off for "
+             << ore::NV("InitialBackoff", Policy.InitialBackoff)
+             << " iterations before retrying: "
+             << ore::NV("BusyAborts", Counts[BusyAbortCount]) << " of "
+             << ore::NV("Aborts", Aborts)
+             << " profiled aborts found the lock busy";
+    });
+  }
+  return true;
+}
+
+/// Increment the profile counter \p Counter of \p CS, by \p Step if given.
+void LockElision::count(IRBuilder<> &Builder, const CriticalSection &CS,
+                        ElisionCounter Counter, Value *Step) {
+  Module *M = F.getParent();
+  SmallVector<Value *, 5> Args = {
+      ConstantExpr::getBitCast(ProfileNameVar, Builder.getInt8PtrTy()),
+      Builder.getInt64(ProfileHash),
+      Builder.getInt32(NumProfiledSections * NumElisionCounters),
+      Builder.getInt32(CS.Index * NumElisionCounters + Counter)};
+  if (!Step) {
+    Builder.CreateCall(
+        Intrinsic::getDeclaration(M, Intrinsic::instrprof_increment), Args);
+    return;
+  }
+  Args.push_back(Builder.CreateZExt(Step, Builder.getInt64Ty()));
+  Builder.CreateCall(
+      Intrinsic::getDeclaration(M, Intrinsic::instrprof_increment_step), Args);
+}
+
+/// Count an abort of \p CS in the counter of its cause, as given by the abort
+/// \p Status.
+void LockElision::countAbort(IRBuilder<> &Builder, const CriticalSection &CS,
+                             Value *Status) {
+  auto HasBits = [&](unsigned Mask, unsigned Bits) {
+    return Builder.CreateICmpEQ(Builder.CreateAnd(Status, Mask),
+                                Builder.getInt32(Bits));
+  };
+  const unsigned CauseMask = Intrinsic::HTMAbortExplicit |
+                             Intrinsic::HTMAbortConflict |
+                             Intrinsic::HTMAbortCapacity;
+  Value *IsBusy = HasBits(LockBusyStatusMask, LockBusyStatus);
+  // The operands are created one at a time, so that the order of the
+  // instructions does not depend on the order the arguments are evaluated in.
+  Value *HasExplicit =
+      HasBits(Intrinsic::HTMAbortExplicit, Intrinsic::HTMAbortExplicit);
+  Value *NotBusy = Builder.CreateNot(IsBusy);
+  Value *IsExplicit = Builder.CreateAnd(HasExplicit, NotBusy);
+  count(Builder, CS, BusyAbortCount, IsBusy);
+  count(Builder, CS, ExplicitAbortCount, IsExplicit);
+  count(Builder, CS, ConflictAbortCount,
+        HasBits(Intrinsic::HTMAbortExplicit | Intrinsic::HTMAbortConflict,
+                Intrinsic::HTMAbortConflict));
+  count(Builder, CS, CapacityAbortCount,
+        HasBits(CauseMask, Intrinsic::HTMAbortCapacity));
+  count(Builder, CS, OtherAbortCount, HasBits(CauseMask, 0));
+}
+
+/// Emit one iteration of a spin-wait: a pause hint on X86, and elsewhere an
+/// empty volatile asm that keeps the backoff loop from being deleted.
+static void emitPause(IRBuilder<> &Builder) {
+  Module *M = Builder.GetInsertBlock()->getModule();
+  Triple::ArchType Arch = Triple(M->getTargetTriple()).getArch();
+  if (Arch == Triple::x86 || Arch == Triple::x86_64) {
+    Builder.CreateCall(
+        Intrinsic::getDeclaration(M, Intrinsic::x86_sse2_pause));
+    return;
+  }
+  Builder.CreateCall(InlineAsm::get(
+      FunctionType::get(Builder.getVoidTy(), false), "", "", true));
+}
+
+void LockElision::elide(CriticalSection &CS) {
+  CallInst *Lock = CS.Lock;
+  const RetryPolicy &Policy = CS.Policy;
+  Module *M = F.getParent();
+  LLVMContext &Ctx = F.getContext();
+  MDNode *LikelyStarted = MDBuilder(Ctx).createBranchWeights(1000, 1);
+
+  BasicBlock *Head = Lock->getParent();
+  BasicBlock *Begin = Head;
+  if (Policy.MaxRetries)
+    Begin = SplitBlock(Head, Lock);
+
+  IRBuilder<> Builder(Lock);
+  PHINode *Attempt = nullptr, *Delay = nullptr;
+  if (Policy.MaxRetries) {
+    Begin->setName("elide.begin");
+    Attempt = Builder.CreatePHI(Builder.getInt32Ty(), 2, "elide.attempt");
+    Attempt->addIncoming(Builder.getInt32(0), Head);
+    if (Policy.InitialBackoff) {
+      Delay = Builder.CreatePHI(Builder.getInt32Ty(), 2, "elide.delay");
+      Delay->addIncoming(Builder.getInt32(Policy.InitialBackoff), Head);
+    }
+  }
+  Value *Status = Builder.CreateCall(
+      Intrinsic::getDeclaration(M, Intrinsic::htm_begin), {}, "elide.status");
+  Value *Started = Builder.CreateICmpEQ(
+      Status, Builder.getInt32(Intrinsic::HTMStarted), "elide.started");
+
+  // Run the critical section inside the transaction when it started, and take
+  // the real lock otherwise.
+  TerminatorInst *CheckTerm, *AbortTerm;
+  SplitBlockAndInsertIfThenElse(Started, Lock, &CheckTerm, &AbortTerm,
+                                LikelyStarted);
+  BasicBlock *Check = CheckTerm->getParent();
+  BasicBlock *Fallback = AbortTerm->getParent();
+  BasicBlock *Cont = Lock->getParent();
+  Check->setName("elide.check");
+  Cont->setName("elide.cont");
+
+  if (ProfileNameVar) {
+    Builder.SetInsertPoint(AbortTerm);
+    countAbort(Builder, CS, Status);
+  }
+
+  if (Policy.MaxRetries) {
+    // Retry while attempts remain and the abort status says that retrying
+    // is worthwhile: either the hardware set the retry bit, or we aborted
+    // ourselves because the lock was busy and its holder will release it.
+    BasicBlock *Abort = Fallback;
+    Abort->setName("elide.abort");
+    Fallback = BasicBlock::Create(Ctx, "", &F, Cont);
+    Builder.SetInsertPoint(AbortTerm);
+    Value *More = Builder.CreateICmpULT(
+        Attempt, Builder.getInt32(Policy.MaxRetries), "elide.more");
+    Value *MayRetry = Builder.CreateICmpNE(
+        Builder.CreateAnd(Status, Intrinsic::HTMAbortRetry),
+        Builder.getInt32(0), "elide.mayretry");
+    Value *WasBusy = Builder.CreateICmpEQ(
+        Builder.CreateAnd(Status, LockBusyStatusMask),
+        Builder.getInt32(LockBusyStatus), "elide.wasbusy");
+    Value *Retry = Builder.CreateAnd(
+        More, Builder.CreateOr(MayRetry, WasBusy), "elide.retry");
+    Value *NextAttempt = Builder.CreateAdd(Attempt, Builder.getInt32(1),
+                                           "elide.attempt.next");
+
+    // RetryBB is where we go to retry, Latch the block jumping back to Begin.
+    BasicBlock *RetryBB = Begin, *Latch = Abort;
+    if (Policy.InitialBackoff) {
+      // Spin for Delay iterations, doubling Delay up to MaxBackoff for the
+      // next retry.
+      Value *Doubled = Builder.CreateShl(Delay, 1);
+      Value *NextDelay = Builder.CreateSelect(
+          Builder.CreateICmpULT(Doubled, Builder.getInt32(Policy.MaxBackoff)),
+          Doubled, Builder.getInt32(Policy.MaxBackoff), "elide.delay.next");
+
+      RetryBB = BasicBlock::Create(Ctx, "elide.backoff", &F, Fallback);
+      Builder.SetInsertPoint(RetryBB);
+      PHINode *Spin = Builder.CreatePHI(Builder.getInt32Ty(), 2, "elide.spin");
+      Spin->addIncoming(Builder.getInt32(0), Abort);
+      emitPause(Builder);
+      Value *NextSpin =
+          Builder.CreateAdd(Spin, Builder.getInt32(1), "elide.spin.next");
+      Spin->addIncoming(NextSpin, RetryBB);
+      Builder.CreateCondBr(Builder.CreateICmpULT(NextSpin, Delay), RetryBB,
+                           Begin);
+      Delay->addIncoming(NextDelay, RetryBB);
+      Latch = RetryBB;
+    }
+    Attempt->addIncoming(NextAttempt, Latch);
+
+    Builder.SetInsertPoint(AbortTerm);
+    Builder.CreateCondBr(Retry, RetryBB, Fallback);
+    AbortTerm->eraseFromParent();
+    AbortTerm = BranchInst::Create(Cont, Fallback);
+  }
+  Fallback->setName("elide.fallback");
+  Lock->moveBefore(AbortTerm);
+  if (ProfileNameVar) {
+    Builder.SetInsertPoint(Lock);
+    count(Builder, CS, FallbackCount);
+  }
+
+  // Inside the transaction, read the lock word so that a thread that takes
+  // the lock for real aborts us, and abort right away if it is already held.
+  Builder.SetInsertPoint(CheckTerm);
+  Value *Mutex = Lock->getArgOperand(0);
+  Type *LockWordPtrTy = Builder.getInt32Ty()->getPointerTo(
+      Mutex->getType()->getPointerAddressSpace());
+  Value *LockWord = Builder.CreateLoad(
+      Builder.CreateBitCast(Mutex, LockWordPtrTy), "elide.lockword");
+  Value *Free = Builder.CreateICmpEQ(LockWord, Builder.getInt32(0),
+                                     "elide.free");
+  BasicBlock *Busy = BasicBlock::Create(Ctx, "elide.busy", &F, Fallback);
+  Builder.CreateCondBr(Free, Cont, Busy, LikelyStarted);
+  CheckTerm->eraseFromParent();
+
+  // llvm.htm.abort never returns when executed inside a transaction, but take
+  // the lock anyway should we ever get here.
+  Builder.SetInsertPoint(Busy);
+  Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::htm_abort),
+                     Builder.getInt8(LockBusyAbortCode));
+  Builder.CreateBr(Fallback);
+
+  // The transactional path always succeeds in "taking" the lock.
+  if (!Lock->use_empty()) {
+    PHINode *PN = PHINode::Create(Lock->getType(), 2, "elide.lock.ret",
+                                  &Cont->front());
+    Lock->replaceAllUsesWith(PN);
+    PN->addIncoming(ConstantInt::get(Lock->getType(), 0), Check);
+    PN->addIncoming(Lock, Fallback);
+  }
+
+  // Commit the transaction instead of unlocking when the lock was elided. The
+  // section may call code that takes the lock word for real, which the commit
+  // would leave held, so read it again first, as glibc does, and abort if it
+  // is no longer free.
+  for (CallInst *Unlock : CS.Unlocks) {
+    TerminatorInst *ReleaseTerm, *UnlockTerm;
+    SplitBlockAndInsertIfThenElse(Started, Unlock, &ReleaseTerm, &UnlockTerm,
+                                  LikelyStarted);
+    BasicBlock *Release = ReleaseTerm->getParent();
+    BasicBlock *UnlockBB = UnlockTerm->getParent();
+    BasicBlock *End = Unlock->getParent();
+    Release->setName("elide.release");
+    UnlockBB->setName("elide.unlock");
+    End->setName("elide.end");
+    Unlock->moveBefore(UnlockTerm);
+
+    BasicBlock *Commit = BasicBlock::Create(Ctx, "elide.commit", &F, UnlockBB);
+    BasicBlock *Taken = BasicBlock::Create(Ctx, "elide.taken", &F, UnlockBB);
+    Builder.SetInsertPoint(ReleaseTerm);
+    Value *UnlockWord = Builder.CreateLoad(
+        Builder.CreateBitCast(Unlock->getArgOperand(0), LockWordPtrTy),
+        "elide.lockword");
+    Builder.CreateCondBr(
+        Builder.CreateICmpEQ(UnlockWord, Builder.getInt32(0), "elide.free"),
+        Commit, Taken, LikelyStarted);
+    ReleaseTerm->eraseFromParent();
+
+    Builder.SetInsertPoint(Commit);
+    Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::htm_commit));
+    if (ProfileNameVar)
+      count(Builder, CS, CommitCount);
+    Builder.CreateBr(End);
+
+    // As above, llvm.htm.abort does not return inside a transaction.
+    Builder.SetInsertPoint(Taken);
+    Builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::htm_abort),
+                       Builder.getInt8(LockTakenAbortCode));
+    Builder.CreateBr(UnlockBB);
+
+    if (!Unlock->use_empty()) {
+      PHINode *PN = PHINode::Create(Unlock->getType(), 2, "elide.unlock.ret",
+                                    &End->front());
+      Unlock->replaceAllUsesWith(PN);
+      PN->addIncoming(ConstantInt::get(Unlock->getType(), 0), Commit);
+      PN->addIncoming(Unlock, UnlockBB);
+    }
+  }
+}
+
+bool LockElision::run() {
+  // Collect all critical sections up front: elision only adds control flow
+  // around the lock and unlock calls and never invalidates another section.
+  SmallVector<CriticalSection, 4> Sections;
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB) {
+      if (!getMutexOperand(I, "pthread_mutex_lock"))
+        continue;
+      ++NumCriticalSections;
+      CriticalSection CS;
+      if (!findCriticalSection(cast<CallInst>(&I), CS)) {
+        LLVM_DEBUG(dbgs() << "LockElision: cannot elide " << I << "\n");
+        ORE.emit([&]() {
+          return OptimizationRemarkMissed(DEBUG_TYPE, "NotElided", &I)
+                 << "critical section not elided: it is too large, may "
+                    "unwind, or is not closed by a matching unlock";
+        });
+        continue;
+      }
+      SmallVector<const Instruction *, 2> Ends(CS.Unlocks.begin(),
+                                                CS.Unlocks.end());
+      TransactionalFootprint FP = TFI.getFootprint(CS.Lock, Ends);
+      if (TFI.isCertainToAbort(FP)) {
+        LLVM_DEBUG(dbgs() << "LockElision: " << I << " always aborts\n");
+        ++NumCertainToAbort;
+        ORE.emit([&]() {
+          OptimizationRemarkMissed R(DEBUG_TYPE, "CertainToAbort", &I);
+          R << "critical section not elided: ";
+          if (FP.AlwaysAborts)
+            return R << "it always executes an instruction aborting the "
+                        "transaction";
+          return R << "it touches " << ore::NV("ReadLines", FP.ReadLines)
+                   << " cache lines for reading and "
+                   << ore::NV("WrittenLines", FP.WrittenLines)
+                   << " for writing, exceeding the transactional capacity";
+        });
+        continue;
+      }
+      CS.Index = Sections.size();
+      CS.Policy = DefaultPolicy;
+      Sections.push_back(std::move(CS));
+    }
+  if (Sections.empty())
+    return false;
+
+  // The sections are numbered in the same order when instrumenting and when
+  // using the profile, and the hash checks that there are as many of them.
+  NumProfiledSections = Sections.size();
+  ProfileHash = (uint64_t(NumElisionCounters) << 32) | NumProfiledSections;
+  SmallVector<bool, 4> Profitable(Sections.size(), true);
+  if (ProfileReader)
+    readProfile(Sections, Profitable);
+  if (InstrumentAborts)
+    ProfileNameVar = createPGOFuncNameVar(F, getElisionProfileName(F));
+
+  bool Changed = false;
+  for (CriticalSection &CS : Sections) {
+    if (!Profitable[CS.Index])
+      continue;
+    ORE.emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "Elided", CS.Lock)
+             << "elided critical section into a hardware transaction";
+    });
+    elide(CS);
+    ++NumElided;
+    Changed = true;
+  }
+  return Changed;
+}
+
+static bool canElideLocks(const Function &F, const TargetTransformInfo &TTI) {
+  // The transactional path inspects the lock word of pthread_mutex_t, which
+  // we only know how to do for glibc.
+  return TTI.hasHardwareTransactionalMemory() &&
+         Triple(F.getParent()->getTargetTriple()).isOSGlibc();
+}
+
+/// Open the indexed profile \p FileName, diagnosing failures in \p Ctx.
+static std::unique_ptr<IndexedInstrProfReader>
+loadElisionProfile(LLVMContext &Ctx, StringRef FileName) {
+  auto ReaderOrErr = IndexedInstrProfReader::create(FileName);
+  if (Error E = ReaderOrErr.takeError()) {
+    handleAllErrors(std::move(E), [&](const ErrorInfoBase &EI) {
+      Ctx.diagnose(DiagnosticInfoPGOProfile(FileName.data(), EI.message()));
+    });
+    return nullptr;
+  }
+  if (!(*ReaderOrErr)->isIRLevelProfile()) {
+    Ctx.diagnose(DiagnosticInfoPGOProfile(
+        FileName.data(), "Not an IR level instrumentation profile"));
+    return nullptr;
+  }
+  return std::move(*ReaderOrErr);
+}
+
+// Pass manager boilerplate below here.
+
+namespace {
+struct LockElisionLegacyPass : public FunctionPass {
+  static char ID;
+  LockElisionLegacyPass(bool InstrumentAborts = false,
+                        std::string ProfileFileName = "")
+      : FunctionPass(ID), InstrumentAborts(InstrumentAborts),
+        ProfileFileName(std::move(ProfileFileName)) {
+    if (ClInstrumentAborts)
+      this->InstrumentAborts = true;
+    if (!ClProfileFile.empty())
+      this->ProfileFileName = ClProfileFile;
+    initializeLockElisionLegacyPassPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool doInitialization(Module &M) override {
+    if (!ProfileFileName.empty())
+      ProfileReader = loadElisionProfile(M.getContext(), ProfileFileName);
+    return false;
+  }
+
+  bool doFinalization(Module &M) override {
+    ProfileReader.reset();
+    return false;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<OptimizationRemarkEmitterWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addRequired<TransactionalFootprintWrapperPass>();
+    AU.addPreserved<GlobalsAAWrapperPass>();
+  }
+
+  bool runOnFunction(Function &F) override {
+    if (skipFunction(F))
+      return false;
+    auto &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+    if (!canElideLocks(F, TTI))
+      return false;
+    auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    auto &TFI =
+        getAnalysis<TransactionalFootprintWrapperPass>().getFootprintInfo();
+    auto &ORE = getAnalysis<OptimizationRemarkEmitterWrapperPass>().getORE();
+    return LockElision(F, DT, TFI, ORE, getRetryPolicy(F), InstrumentAborts,
+                       ProfileReader.get())
+        .run();
+  }
+
+private:
+  bool InstrumentAborts;
+  std::string ProfileFileName;
+  std::unique_ptr<IndexedInstrProfReader> ProfileReader;
+};
+}
+
+char LockElisionLegacyPass::ID = 0;
+INITIALIZE_PASS_BEGIN(LockElisionLegacyPass, "lock-elision",
+                      "Elide pthread mutex critical sections", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(OptimizationRemarkEmitterWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TransactionalFootprintWrapperPass)
+INITIALIZE_PASS_END(LockElisionLegacyPass, "lock-elision",
+                    "Elide pthread mutex critical sections", false, false)
+
+FunctionPass *llvm::createLockElisionPass(bool InstrumentAborts,
+                                          std::string ProfileFileName) {
+  return new LockElisionLegacyPass(InstrumentAborts,
+                                   std::move(ProfileFileName));
+}
+
+LockElisionPass::LockElisionPass(bool InstrumentAborts,
+                                 std::string ProfileFileName)
+    : InstrumentAborts(InstrumentAborts || ClInstrumentAborts),
+      ProfileFileName(std::move(ProfileFileName)) {
+  if (!ClProfileFile.empty())
+    this->ProfileFileName = ClProfileFile;
+}
+
+PreservedAnalyses LockElisionPass::run(Function &F,
+                                       FunctionAnalysisManager &FAM) {
+  auto &TTI = FAM.getResult<TargetIRAnalysis>(F);
+  if (!canElideLocks(F, TTI))
+    return PreservedAnalyses::all();
+  if (!ProfileLoaded && !ProfileFileName.empty())
+    ProfileReader = loadElisionProfile(F.getContext(), ProfileFileName);
+  ProfileLoaded = true;
+
+  auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+  auto &TFI = FAM.getResult<TransactionalFootprintAnalysis>(F);
+  auto &ORE = FAM.getResult<OptimizationRemarkEmitterAnalysis>(F);
+  if (!LockElision(F, DT, TFI, ORE, getRetryPolicy(F), InstrumentAborts,
+                   ProfileReader.get())
+           .run())
+    return PreservedAnalyses::all();
+  PreservedAnalyses PA;
+  PA.preserve<GlobalsAA>();
+  return PA;
+}
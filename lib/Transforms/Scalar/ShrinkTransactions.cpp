@@ -0,0 +1,368 @@
+//===- ShrinkTransactions.cpp - Move code out of transactions -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Hardware memory transactions abort more often the longer they run and the
+// more memory they touch. This pass moves work that does not need the
+// isolation of a transaction out of it:
+//
+//  - Instructions that only depend on values available before the start of
+//    the transaction and that are safe to speculate are hoisted above it,
+//    LICM-style. This covers pure computations and loads of thread-private
+//    memory (allocas that do not escape) that are not written inside the
+//    transaction, as told by MemorySSA.
+//
+//  - Instructions without side effects whose results are only used once the
+//    transaction committed are sunk below the commit, Sink-style.
+//
+// A transaction started by llvm.htm.begin (or llvm.x86.xbegin) is made of the
+// code reachable from it on the paths where it started (as told by the
+// branches comparing its result with -1), up to the commit or abort ending
+// it. This is the shape generated by the lock elision pass, where the
+// critical section also runs under the lock when the transaction aborts;
+// moving code out of it shortens the critical section on both paths.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Scalar/ShrinkTransactions.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CaptureTracking.h"
+#include "llvm/Analysis/GlobalsModRef.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/TransactionalFootprint.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PatternMatch.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Scalar.h"
+using namespace llvm;
+using namespace llvm::PatternMatch;
+
+#define DEBUG_TYPE "shrink-transactions"
+
+STATISTIC(NumHoisted, "Number of instructions hoisted out of transactions");
+STATISTIC(NumSunk, "Number of instructions sunk out of transactions");
+
+/// If \p BB ends with a branch on whether the transaction started by
+/// \p TxBegin runs, return the successor where it does.
+static BasicBlock *getStartedSuccessor(BasicBlock *BB, Value *TxBegin) {
+  auto *BI = dyn_cast<BranchInst>(BB->getTerminator());
+  ICmpInst::Predicate Pred;
+  if (!BI || !BI->isConditional() ||
+      !match(BI->getCondition(),
+             m_ICmp(Pred, m_Specific(TxBegin), m_AllOnes())) ||
+      !ICmpInst::isEquality(Pred))
+    return nullptr;
+  return BI->getSuccessor(Pred == ICmpInst::ICMP_EQ ? 0 : 1);
+}
+
+namespace {
+
+class TransactionShrinker {
+  DominatorTree &DT;
+  LoopInfo &LI;
+  MemorySSA &MSSA;
+  const DataLayout &DL;
+
+  /// The transaction being shrunk.
+  Instruction *TxBegin = nullptr;
+
+  /// The blocks of the transaction, mapped to the commit or abort ending it
+  /// in the block, or to null if the whole block belongs to it.
+  DenseMap<BasicBlock *, Instruction *> Region;
+
+  /// Allocas known to be (not) captured.
+  DenseMap<const Value *, bool> IsPrivate;
+
+  bool computeRegion();
+  bool isInRegion(Instruction *I) const;
+  bool isPrivateUnclobberedLoad(LoadInst *L);
+  bool hoist(Instruction &I);
+  bool sink(Instruction &I);
+
+public:
+  TransactionShrinker(DominatorTree &DT, LoopInfo &LI, MemorySSA &MSSA,
+                      const DataLayout &DL)
+      : DT(DT), LI(LI), MSSA(MSSA), DL(DL) {}
+
+  bool run(Instruction *TxBegin, ArrayRef<BasicBlock *> RPO);
+};
+
+} // end anonymous namespace
+
+/// Collect the blocks run by the transaction of TxBegin. Fail if we cannot
+/// tell where it runs, or if it contains another transaction.
+bool TransactionShrinker::computeRegion() {
+  Region.clear();
+  BasicBlock *Start = getStartedSuccessor(TxBegin->getParent(), TxBegin);
+  if (!Start)
+    return false;
+
+  SmallVector<BasicBlock *, 8> Worklist;
+  Worklist.push_back(Start);
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (Region.count(BB))
+      continue;
+    Instruction *End = nullptr;
+    for (Instruction &I : *BB) {
+      if (isTransactionBegin(I))
+        return false;
+      if (isTransactionCommit(I) || isTransactionAbort(I)) {
+        End = &I;
+        break;
+      }
+    }
+    Region[BB] = End;
+    if (End)
+      continue;
+    if (BasicBlock *Succ = getStartedSuccessor(BB, TxBegin))
+      Worklist.push_back(Succ);
+    else
+      for (BasicBlock *Succ : successors(BB))
+        Worklist.push_back(Succ);
+  }
+  return true;
+}
+
+bool TransactionShrinker::isInRegion(Instruction *I) const {
+  auto It = Region.find(I->getParent());
+  if (It == Region.end())
+    return false;
+  Instruction *End = It->second;
+  return !End || I == End || DT.dominates(I, End);
+}
+
+/// Return true if \p L reads memory that no other thread can access and that
+/// is not written inside the transaction, so that it can be read before the
+/// transaction starts.
+bool TransactionShrinker::isPrivateUnclobberedLoad(LoadInst *L) {
+  if (!L->isUnordered())
+    return false;
+  const Value *Obj = GetUnderlyingObject(L->getPointerOperand(), DL);
+  if (!isa<AllocaInst>(Obj))
+    return false;
+  auto Inserted = IsPrivate.insert({Obj, false});
+  if (Inserted.second)
+    Inserted.first->second = !PointerMayBeCaptured(
+        Obj, /*ReturnCaptures=*/true, /*StoreCaptures=*/true);
+  if (!Inserted.first->second)
+    return false;
+
+  MemoryAccess *Clobber = MSSA.getWalker()->getClobberingMemoryAccess(L);
+  if (MSSA.isLiveOnEntryDef(Clobber))
+    return true;
+  // The region starts after the block of TxBegin, whose instructions below it
+  // run in the transaction too.
+  if (auto *Def = dyn_cast<MemoryUseOrDef>(Clobber)) {
+    Instruction *DefI = Def->getMemoryInst();
+    if (DefI->getParent() == TxBegin->getParent())
+      return !DT.dominates(TxBegin, DefI);
+    return !isInRegion(DefI);
+  }
+  return !Region.count(Clobber->getBlock());
+}
+
+/// Move \p I above the start of the transaction if it only depends on values available there
+/// and can be executed whether or not the transaction starts.
+bool TransactionShrinker::hoist(Instruction &I) {
+  if (isa<PHINode>(I) || I.isTerminator() || I.isEHPad() ||
+      isa<DbgInfoIntrinsic>(I) || isa<AllocaInst>(I))
+    return false;
+  if (!DT.dominates(TxBegin, &I) || !isSafeToSpeculativelyExecute(&I))
+    return false;
+  for (Value *Op : I.operands())
+    if (auto *OpI = dyn_cast<Instruction>(Op))
+      if (!DT.dominates(OpI, TxBegin))
+        return false;
+  if (auto *L = dyn_cast<LoadInst>(&I)) {
+    if (!isPrivateUnclobberedLoad(L))
+      return false;
+  } else if (I.mayReadOrWriteMemory()) {
+    return false;
+  }
+
+  LLVM_DEBUG(dbgs() << "ShrinkTransactions: hoisting " << I << "\n");
+  I.moveBefore(TxBegin);
+  ++NumHoisted;
+  return true;
+}
+
+/// Move \p I below the end of the transaction if all its uses are there.
+bool TransactionShrinker::sink(Instruction &I) {
+  if (isa<PHINode>(I) || I.isTerminator() || I.isEHPad() ||
+      isa<DbgInfoIntrinsic>(I) || isa<AllocaInst>(I) || I.use_empty() ||
+      I.mayReadOrWriteMemory() || I.mayHaveSideEffects())
+    return false;
+
+  // Find the block dominating all uses. PHI nodes use their operand at the
+  // end of the incoming block.
+  BasicBlock *Target = nullptr;
+  for (Use &U : I.uses()) {
+    auto *UseInst = cast<Instruction>(U.getUser());
+    BasicBlock *UseBB = UseInst->getParent();
+    if (auto *PN = dyn_cast<PHINode>(UseInst))
+      UseBB = PN->getIncomingBlock(U);
+    else if (isInRegion(UseInst))
+      return false;
+    Target = Target ? DT.findNearestCommonDominator(Target, UseBB) : UseBB;
+  }
+
+  // Sink right after the commit when the uses follow it in the same block.
+  Instruction *InsertPt;
+  auto It = Region.find(Target);
+  if (It == Region.end()) {
+    BasicBlock::iterator FirstPt = Target->getFirstInsertionPt();
+    if (FirstPt == Target->end())
+      return false;
+    InsertPt = &*FirstPt;
+  } else if (It->second && isTransactionCommit(*It->second)) {
+    InsertPt = It->second->getNextNode();
+  } else {
+    return false;
+  }
+
+  // Do not sink into a loop the instruction is not part of.
+  Loop *L = LI.getLoopFor(Target);
+  if (L && !L->contains(I.getParent()))
+    return false;
+
+  LLVM_DEBUG(dbgs() << "ShrinkTransactions: sinking " << I << "\n");
+  I.moveBefore(InsertPt);
+  ++NumSunk;
+  return true;
+}
+
+bool TransactionShrinker::run(Instruction *Begin, ArrayRef<BasicBlock *> RPO) {
+  TxBegin = Begin;
+  if (!computeRegion())
+    return false;
+
+  // Hoist in dominance order so that the operands of an instruction are
+  // hoisted before it, and sink in the reverse order.
+  bool Changed = false;
+  for (BasicBlock *BB : RPO) {
+    auto It = Region.find(BB);
+    if (It == Region.end())
+      continue;
+    BasicBlock::iterator End =
+        It->second ? It->second->getIterator() : BB->end();
+    for (Instruction &I : make_early_inc_range(make_range(BB->begin(), End)))
+      Changed |= hoist(I);
+  }
+  for (BasicBlock *BB : reverse(RPO)) {
+    auto It = Region.find(BB);
+    if (It == Region.end())
+      continue;
+    BasicBlock::iterator End =
+        It->second ? It->second->getIterator() : BB->end();
+    SmallVector<Instruction *, 16> Insts;
+    for (Instruction &I : make_range(BB->begin(), End))
+      Insts.push_back(&I);
+    for (Instruction *I : reverse(Insts))
+      Changed |= sink(*I);
+  }
+  return Changed;
+}
+
+static bool shrinkTransactions(Function &F, DominatorTree &DT, LoopInfo &LI,
+                               MemorySSA &MSSA) {
+  SmallVector<Instruction *, 4> Begins;
+  for (Instruction &I : instructions(F))
+    if (isTransactionBegin(I))
+      Begins.push_back(&I);
+  if (Begins.empty())
+    return false;
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  SmallVector<BasicBlock *, 16> RPO(RPOT.begin(), RPOT.end());
+  TransactionShrinker Shrinker(DT, LI, MSSA, F.getParent()->getDataLayout());
+  bool Changed = false;
+  for (Instruction *TxBegin : Begins)
+    Changed |= Shrinker.run(TxBegin, RPO);
+  return Changed;
+}
+
+/// Return true if the module of \p F uses transactions at all, which saves
+/// computing MemorySSA for the vast majority of functions.
+static bool mayHaveTransactions(const Function &F) {
+  for (Intrinsic::ID ID : {Intrinsic::htm_begin, Intrinsic::x86_xbegin}) {
+    const Function *Begin =
+        F.getParent()->getFunction(Intrinsic::getName(ID));
+    if (Begin && !Begin->use_empty())
+      return true;
+  }
+  return false;
+}
+
+PreservedAnalyses ShrinkTransactionsPass::run(Function &F,
+                                              FunctionAnalysisManager &AM) {
+  if (!mayHaveTransactions(F))
+    return PreservedAnalyses::all();
+  auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+  auto &LI = AM.getResult<LoopAnalysis>(F);
+  auto &MSSA = AM.getResult<MemorySSAAnalysis>(F).getMSSA();
+  if (!shrinkTransactions(F, DT, LI, MSSA))
+    return PreservedAnalyses::all();
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  PA.preserve<GlobalsAA>();
+  return PA;
+}
+
+namespace {
+struct ShrinkTransactionsLegacyPass : public FunctionPass {
+  static char ID;
+  ShrinkTransactionsLegacyPass() : FunctionPass(ID) {
+    initializeShrinkTransactionsLegacyPassPass(
+        *PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override {
+    if (skipFunction(F) || !mayHaveTransactions(F))
+      return false;
+    auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    auto &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    auto &MSSA = getAnalysis<MemorySSAWrapperPass>().getMSSA();
+    return shrinkTransactions(F, DT, LI, MSSA);
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<MemorySSAWrapperPass>();
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addPreserved<LoopInfoWrapperPass>();
+    AU.addPreserved<GlobalsAAWrapperPass>();
+  }
+};
+} // end anonymous namespace
+
+char ShrinkTransactionsLegacyPass::ID = 0;
+INITIALIZE_PASS_BEGIN(ShrinkTransactionsLegacyPass, "shrink-transactions",
+                      "Move code out of hardware transactions", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MemorySSAWrapperPass)
+INITIALIZE_PASS_END(ShrinkTransactionsLegacyPass, "shrink-transactions",
+                    "Move code out of hardware transactions", false, false)
+
+FunctionPass *llvm::createShrinkTransactionsPass() {
+  return new ShrinkTransactionsLegacyPass();
+}
@@ -0,0 +1,71 @@
+; Check that the alias results cached by aa-eval are read back within its run,
+; when it queries the stores after the pointers, and that they do not change.
+; The cache does not outlive the batch of queries of a run, so the second
+; aa-eval starts from an empty cache.
+; REQUIRES: asserts
+; RUN: opt -aa-pipeline=basic-aa -passes='aa-eval,aa-eval' -evaluate-aa-metadata \
+; RUN:   -print-all-alias-modref-info -disable-output %s 2>&1 | FileCheck %s
+; RUN: opt -aa-pipeline=basic-aa -passes='aa-eval,aa-eval' -evaluate-aa-metadata \
+; RUN:   -print-all-alias-modref-info -disable-output %s 2> %t.ref
+; RUN: opt -aa-pipeline=basic-aa -passes='aa-eval,aa-eval' -evaluate-aa-metadata \
+; RUN:   -aa-cache-results -print-all-alias-modref-info -disable-output %s \
+; RUN:   2> %t.cached
+; RUN: diff %t.ref %t.cached
+; RUN: opt -aa-pipeline=basic-aa -passes='aa-eval,aa-eval' -evaluate-aa-metadata \
+; RUN:   -aa-cache-results -stats -disable-output %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=STATS
+
+; instcombine changes the IR between the runs, which must not see stale
+; results.
+; RUN: opt -aa-pipeline=basic-aa -passes='aa-eval,instcombine,aa-eval' \
+; RUN:   -print-all-alias-modref-info -disable-output %s 2> %t.ic.ref
+; RUN: opt -aa-pipeline=basic-aa -passes='aa-eval,instcombine,aa-eval' \
+; RUN:   -aa-cache-results -print-all-alias-modref-info -disable-output %s \
+; RUN:   2> %t.ic.cached
+; RUN: diff %t.ic.ref %t.ic.cached
+
+; Neither must the passes of the optimization pipeline, which preserve the
+; alias analyses while they change the IR.
+; RUN: opt -aa-pipeline=default -passes='default<O3>' -S \
+; RUN:   %S/../../Transforms/GVN/condprop.ll > %t.o3.ref
+; RUN: opt -aa-pipeline=default -passes='default<O3>' -aa-cache-results -S \
+; RUN:   %S/../../Transforms/GVN/condprop.ll > %t.o3.cached
+; RUN: diff %t.o3.ref %t.o3.cached
+
+; STATS: 4 aa - Number of alias results read from the cache
+; STATS-NEXT: 40 aa - Number of alias queries looked up in the cache
+
+; BasicAA queries the aggregation again for the incoming values of the phis,
+; assuming that the phis do not alias. Those results are not cached.
+define void @phis(i32* noalias %a, i32* noalias %b, i1 %c) {
+; CHECK-LABEL: Function: phis:
+; CHECK: NoAlias: i32* %a, i32* %b
+; CHECK: NoAlias: i32* %p, i32* %q
+entry:
+  br label %loop
+
+loop:
+  %p = phi i32* [ %a, %entry ], [ %p.next, %loop ]
+  %q = phi i32* [ %b, %entry ], [ %q.next, %loop ]
+  %p.next = getelementptr i32, i32* %p, i64 1
+  %q.next = getelementptr i32, i32* %q, i64 1
+  store i32 0, i32* %p
+  store i32 1, i32* %q
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; instcombine folds away %zero.
+define void @fold(i32* %a) {
+; CHECK-LABEL: Function: fold:
+; CHECK: MustAlias: i32* %a, i32* %zero
+; CHECK: NoAlias: i32* %one, i32* %zero
+entry:
+  %zero = getelementptr i32, i32* %a, i64 0
+  %one = getelementptr i32, i32* %a, i64 1
+  store i32 0, i32* %zero
+  store i32 1, i32* %one
+  ret void
+}
@@ -0,0 +1,141 @@
+; RUN: opt < %s -analyze -tx-footprint -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+; RUN: opt < %s -passes='print<tx-footprint>' -disable-output -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm 2>&1 | FileCheck %s
+; RUN: opt < %s -analyze -tx-footprint -tx-max-written-lines=32 -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s --check-prefix=SMALL
+
+declare i32 @llvm.x86.xbegin()
+declare void @llvm.x86.xend()
+declare void @llvm.x86.xabort(i8)
+declare i64 @write(i32, i8*, i64)
+declare void @unknown()
+
+; Accesses of the same lines are merged, and only the path where the
+; transaction started is part of the region.
+define void @scalar(i32* %p, i32* %q) {
+; CHECK-LABEL: Transactional footprint for function: scalar
+; CHECK-NEXT:    Region at: %status = call i32 @llvm.x86.xbegin()
+; CHECK-NEXT:      read lines: 1, written lines: 2
+; CHECK-NOT:       certain to abort
+entry:
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %fallback
+
+tx:
+  %v = load i32, i32* %p, align 4
+  %p1 = getelementptr inbounds i32, i32* %p, i64 1
+  store i32 %v, i32* %p1, align 4
+  %q16 = getelementptr inbounds i32, i32* %q, i64 16
+  store i32 %v, i32* %q16, align 4
+  call void @llvm.x86.xend()
+  br label %exit
+
+fallback:
+  call void @unknown()
+  br label %exit
+
+exit:
+  ret void
+}
+
+; Recurrences are widened by the trip count of their loop: 1024 i32 are 64
+; cache lines.
+define void @loop(i32* %a) {
+; CHECK-LABEL: Transactional footprint for function: loop
+; CHECK-NEXT:    Region at: %status = call i32 @llvm.x86.xbegin()
+; CHECK-NEXT:      read lines: 64, written lines: 64
+; CHECK-NOT:       certain to abort
+;
+; SMALL-LABEL: Transactional footprint for function: loop
+; SMALL:             certain to abort
+entry:
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %loop, label %exit
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  %v = load i32, i32* %p, align 4
+  %inc = add i32 %v, 1
+  store i32 %inc, i32* %p, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %cond = icmp ult i64 %i.next, 1024
+  br i1 %cond, label %loop, label %commit
+
+commit:
+  call void @llvm.x86.xend()
+  br label %exit
+
+exit:
+  ret void
+}
+
+; Calls to unknown functions make the line counts a lower bound.
+define void @call(i32* %p) {
+; CHECK-LABEL: Transactional footprint for function: call
+; CHECK-NEXT:    Region at: %status = call i32 @llvm.x86.xbegin()
+; CHECK-NEXT:      read lines: 0, written lines: 1 (lower bound)
+; CHECK-NOT:       certain to abort
+entry:
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp ne i32 %status, -1
+  br i1 %started, label %exit, label %tx
+
+tx:
+  store i32 0, i32* %p, align 4
+  call void @unknown()
+  call void @llvm.x86.xend()
+  br label %exit
+
+exit:
+  ret void
+}
+
+; System calls abort any transaction.
+define void @syscall(i8* %buf) {
+; CHECK-LABEL: Transactional footprint for function: syscall
+; CHECK-NEXT:    Region at: %status = call i32 @llvm.x86.xbegin()
+; CHECK-NEXT:      read lines: 0, written lines: 0
+; CHECK-NEXT:      aborts at: %n = call i64 @write(i32 1, i8* %buf, i64 1)
+; CHECK-NEXT:      certain to abort
+entry:
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %exit
+
+tx:
+  %n = call i64 @write(i32 1, i8* %buf, i64 1)
+  call void @llvm.x86.xend()
+  br label %exit
+
+exit:
+  ret void
+}
+
+; An abort on some paths only does not doom the transaction.
+define void @conditional_abort(i32* %p, i1 %c) {
+; CHECK-LABEL: Transactional footprint for function: conditional_abort
+; CHECK-NEXT:    Region at: %status = call i32 @llvm.x86.xbegin()
+; CHECK-NEXT:      read lines: 0, written lines: 1
+; CHECK-NEXT:      aborts at: call void @llvm.x86.xabort(i8 1)
+; CHECK-NOT:       certain to abort
+entry:
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %exit
+
+tx:
+  br i1 %c, label %abort, label %work
+
+abort:
+  call void @llvm.x86.xabort(i8 1)
+  br label %work
+
+work:
+  store i32 0, i32* %p, align 4
+  call void @llvm.x86.xend()
+  br label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,54 @@
+; Test the lowering of the target-independent transaction intrinsics to HTM.
+;
+; RUN: llc -verify-machineinstrs -mcpu=pwr8 -mattr=+htm < %s | FileCheck %s
+; RUN: opt -S -mcpu=pwr8 -mattr=+htm -expand-htm-intrinsics < %s | FileCheck %s --check-prefix=IR
+target datalayout = "E-m:e-i64:64-n32:64"
+target triple = "powerpc64-unknown-linux-gnu"
+
+declare i32 @llvm.htm.begin()
+declare void @llvm.htm.commit()
+declare void @llvm.htm.abort(i8)
+
+; The abort status is built from TEXASRU when the transaction did not start.
+define i32 @test_begin() {
+; CHECK-LABEL: test_begin:
+; CHECK:       tbegin. 0
+; CHECK:       mfspr {{[0-9]+}}, 131
+;
+; IR-LABEL: @test_begin(
+; IR:         [[TBEGIN:%.*]] = call i32 @llvm.ppc.tbegin(i32 0)
+; IR-NEXT:    [[STARTED:%.*]] = icmp ne i32 [[TBEGIN]], 0
+; IR-NEXT:    [[TEXASR:%.*]] = call i64 @llvm.ppc.get.texasru()
+; IR-NEXT:    [[TEXASRU:%.*]] = trunc i64 [[TEXASR]] to i32
+; IR:         lshr i32 [[TEXASRU]], 25
+; IR:         and i32 [[TEXASRU]], 1
+; IR:         and i32 [[TEXASRU]], 16777216
+; IR:         and i32 [[TEXASRU]], 1998848
+; IR:         and i32 [[TEXASRU]], 2097152
+; IR:         [[STATUS:%.*]] = select i1 [[STARTED]], i32 -1, i32 {{%.*}}
+; IR-NEXT:    ret i32 [[STATUS]]
+  %status = call i32 @llvm.htm.begin()
+  ret i32 %status
+}
+
+define void @test_commit() {
+; CHECK-LABEL: test_commit:
+; CHECK:       tend. 0
+;
+; IR-LABEL: @test_commit(
+; IR-NEXT:    call i32 @llvm.ppc.tend(i32 0)
+  call void @llvm.htm.commit()
+  ret void
+}
+
+; The code is passed with the failure persistent bit set.
+define void @test_abort() {
+; CHECK-LABEL: test_abort:
+; CHECK:       li [[CODE:[0-9]+]], 255
+; CHECK:       tabort. [[CODE]]
+;
+; IR-LABEL: @test_abort(
+; IR-NEXT:    call i32 @llvm.ppc.tabort(i32 255)
+  call void @llvm.htm.abort(i8 127)
+  ret void
+}
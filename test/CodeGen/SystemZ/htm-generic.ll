@@ -0,0 +1,66 @@
+; Test the lowering of the target-independent transaction intrinsics to
+; transactional execution.
+;
+; RUN: llc < %s -mtriple=s390x-linux-gnu -mcpu=zEC12 | FileCheck %s
+; RUN: opt < %s -S -mtriple=s390x-linux-gnu -mcpu=zEC12 -expand-htm-intrinsics | FileCheck %s --check-prefix=IR
+; RUN: opt < %s -S -mtriple=s390x-linux-gnu -mcpu=z10 -expand-htm-intrinsics | FileCheck %s --check-prefix=NOTX
+
+declare i32 @llvm.htm.begin()
+declare void @llvm.htm.commit()
+declare void @llvm.htm.abort(i8)
+
+; The abort status is built from the condition code and the transaction
+; diagnostic block, which is only read after an abort.
+define i32 @test_begin() {
+; CHECK-LABEL: test_begin:
+; CHECK:       tbegin {{[0-9]+}}(%r15), 65292
+;
+; IR-LABEL: @test_begin(
+; IR-NEXT:    [[TDB:%.*]] = alloca [256 x i8], align 8
+; IR-NEXT:    [[TDBPTR:%.*]] = getelementptr [256 x i8], [256 x i8]* [[TDB]], i32 0, i32 0
+; IR-NEXT:    [[CC:%.*]] = call i32 @llvm.s390.tbegin(i8* [[TDBPTR]], i32 65292)
+; IR-NEXT:    [[ABORTED:%.*]] = icmp ne i32 [[CC]], 0
+; IR-NEXT:    br i1 [[ABORTED]], label %tbegin.abort, label %tbegin.end, !prof
+; IR:       tbegin.abort:
+; IR-NEXT:    [[TACPTR:%.*]] = getelementptr [256 x i8], [256 x i8]* [[TDB]], i32 0, i32 8
+; IR-NEXT:    [[TACPTR64:%.*]] = bitcast i8* [[TACPTR]] to i64*
+; IR-NEXT:    [[TAC:%.*]] = load i64, i64* [[TACPTR64]], align 8
+; IR:         icmp uge i64 [[TAC]], 256
+; IR:         icmp eq i32 [[CC]], 2
+; IR:         select i1 {{%.*}}, i32 8, i32 0
+; IR-NEXT:    [[ABORTSTATUS:%.*]] = or i32
+; IR-NEXT:    br label %tbegin.end
+; IR:       tbegin.end:
+; IR-NEXT:    [[STATUS:%.*]] = phi i32 [ -1, {{%.*}} ], [ [[ABORTSTATUS]], %tbegin.abort ]
+; IR-NEXT:    ret i32 [[STATUS]]
+;
+; Transactions never start without the facility.
+; NOTX-LABEL: @test_begin(
+; NOTX-NEXT:    ret i32 0
+  %status = call i32 @llvm.htm.begin()
+  ret i32 %status
+}
+
+define void @test_commit() {
+; CHECK-LABEL: test_commit:
+; CHECK:       tend
+;
+; IR-LABEL: @test_commit(
+; IR-NEXT:    call i32 @llvm.s390.tend()
+;
+; NOTX-LABEL: @test_commit(
+; NOTX-NEXT:    ret void
+  call void @llvm.htm.commit()
+  ret void
+}
+
+; Codes are offset by 256 and made persistent.
+define void @test_abort() {
+; CHECK-LABEL: test_abort:
+; CHECK:       tabort 511
+;
+; IR-LABEL: @test_abort(
+; IR-NEXT:    call void @llvm.s390.tabort(i64 511)
+  call void @llvm.htm.abort(i8 127)
+  ret void
+}
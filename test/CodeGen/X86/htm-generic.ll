@@ -0,0 +1,51 @@
+; Test the lowering of the target-independent transaction intrinsics to RTM.
+;
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -mattr=+rtm | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -mattr=-rtm | FileCheck %s --check-prefix=NORTM
+; RUN: opt < %s -S -mtriple=x86_64-unknown-unknown -mattr=+rtm -expand-htm-intrinsics | FileCheck %s --check-prefix=IR
+
+declare i32 @llvm.htm.begin()
+declare void @llvm.htm.commit()
+declare void @llvm.htm.abort(i8)
+
+define i32 @test_begin() {
+; CHECK-LABEL: test_begin:
+; CHECK:       xbegin
+; CHECK:       movl $-1, %eax
+;
+; NORTM-LABEL: test_begin:
+; NORTM-NOT:   xbegin
+; NORTM:       xorl %eax, %eax
+;
+; IR-LABEL: @test_begin(
+; IR-NEXT:    [[STATUS:%.*]] = call i32 @llvm.x86.xbegin()
+; IR-NEXT:    ret i32 [[STATUS]]
+  %status = call i32 @llvm.htm.begin()
+  ret i32 %status
+}
+
+define void @test_commit() {
+; CHECK-LABEL: test_commit:
+; CHECK:       xend
+;
+; NORTM-LABEL: test_commit:
+; NORTM-NOT:   xend
+;
+; IR-LABEL: @test_commit(
+; IR-NEXT:    call void @llvm.x86.xend()
+  call void @llvm.htm.commit()
+  ret void
+}
+
+define void @test_abort() {
+; CHECK-LABEL: test_abort:
+; CHECK:       xabort $127
+;
+; NORTM-LABEL: test_abort:
+; NORTM-NOT:   xabort
+;
+; IR-LABEL: @test_abort(
+; IR-NEXT:    call void @llvm.x86.xabort(i8 127)
+  call void @llvm.htm.abort(i8 127)
+  ret void
+}
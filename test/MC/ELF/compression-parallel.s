@@ -0,0 +1,22 @@
+// REQUIRES: zlib
+// Sections of more than a megabyte are deflated in chunks on several threads,
+// which must still produce a zlib stream that readers can uncompress.
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zlib -triple x86_64-pc-linux-gnu < %s -o %t
+// RUN: llvm-readobj -sections %t | FileCheck --check-prefix=FLAGS %s
+// RUN: llvm-dwarfdump -debug-str %t | FileCheck --check-prefix=STR %s
+// RUN: llvm-mc -filetype=obj -compress-debug-sections=zlib-gnu -triple x86_64-pc-linux-gnu < %s -o %t.gnu
+// RUN: llvm-dwarfdump -debug-str %t.gnu | FileCheck --check-prefix=STR %s
+
+// FLAGS:      Name: .debug_str
+// FLAGS-NEXT: Type: SHT_PROGBITS
+// FLAGS-NEXT: Flags [
+// FLAGS-NEXT:   SHF_COMPRESSED
+
+// STR:      0x00000000: "perfectly compressable data sample ****************************"
+// STR:      0x001387c0: "perfectly compressable data sample ****************************"
+// STR-NOT:  0x
+
+	.section        .debug_str,"MS",@progbits,1
+	.rept 20000
+        .asciz  "perfectly compressable data sample ****************************"
+	.endr
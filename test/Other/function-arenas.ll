@@ -0,0 +1,49 @@
+; Check that allocating the bodies of the functions from their arena does not
+; change the output of the optimizer, both from assembly and from bitcode.
+; RUN: opt -function-arenas -O2 -S < %s | FileCheck %s
+; RUN: opt -function-arenas -passes='default<O2>' -S < %s | FileCheck %s
+; RUN: opt < %s -o - | opt -function-arenas -O2 -S | FileCheck %s
+
+; The switch grows its hung-off operands, and the inlined callee is deleted
+; while its cloned instructions are alive.
+
+define internal i32 @callee(i32 %x) {
+entry:
+  switch i32 %x, label %default [
+    i32 0, label %zero
+    i32 1, label %one
+    i32 2, label %two
+    i32 3, label %three
+  ]
+zero:
+  br label %exit
+one:
+  br label %exit
+two:
+  br label %exit
+three:
+  br label %exit
+default:
+  br label %exit
+exit:
+  %r = phi i32 [ 10, %zero ], [ 20, %one ], [ 30, %two ], [ 40, %three ], [ %x, %default ]
+  ret i32 %r
+}
+
+; CHECK-NOT: @callee
+; CHECK-LABEL: define i32 @caller(
+; CHECK: ret i32
+define i32 @caller(i32 %x) {
+entry:
+  %r = call i32 @callee(i32 %x)
+  ret i32 %r
+}
+
+; CHECK-LABEL: define i32 @folded(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: ret i32 30
+define i32 @folded() {
+entry:
+  %r = call i32 @callee(i32 2)
+  ret i32 %r
+}
@@ -0,0 +1,75 @@
+; Check that the functions optimized by an earlier run are loaded from the
+; cache, and that the output does not change.
+; REQUIRES: asserts
+; RUN: rm -rf %t.cache
+; RUN: opt -passes=instcombine %s -S -o %t.ref.ll
+; RUN: opt -passes=instcombine -incremental-cache=%t.cache -stats %s -S \
+; RUN:   -o %t.1.ll 2>&1 | FileCheck %s --check-prefix=FIRST
+; RUN: diff %t.ref.ll %t.1.ll
+; RUN: ls %t.cache | count 4
+; RUN: opt -passes=instcombine -incremental-cache=%t.cache -stats %s -S \
+; RUN:   -o %t.2.ll 2>&1 | FileCheck %s --check-prefix=SECOND
+; RUN: diff %t.ref.ll %t.2.ll
+
+; Changing @callee invalidates its entry and the one of @caller.
+; RUN: sed -e 's/xor i32 %x, 0/xor i32 %x, 5/' %s > %t.changed.ll
+; RUN: opt -passes=instcombine %t.changed.ll -S -o %t.changed.ref.ll
+; RUN: opt -passes=instcombine -incremental-cache=%t.cache -stats \
+; RUN:   %t.changed.ll -S -o %t.3.ll 2>&1 | FileCheck %s --check-prefix=CHANGED
+; RUN: diff %t.changed.ref.ll %t.3.ll
+
+; FIRST-NOT: loaded from the incremental cache
+; FIRST: 4 incremental-cache - Number of functions stored in the incremental cache
+; SECOND: 4 incremental-cache - Number of functions loaded from the incremental cache
+; SECOND-NOT: stored in the incremental cache
+; CHANGED-DAG: 2 incremental-cache - Number of functions loaded from the incremental cache
+; CHANGED-DAG: 2 incremental-cache - Number of functions stored in the incremental cache
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@hello = private constant [7 x i8] c"hello\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+; The call is turned into a call to a new declaration of @puts, with a new
+; string.
+define void @greet() {
+  %call = call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @hello, i64 0, i64 0))
+  ret void
+}
+
+define i32 @callee(i32 %x) {
+  %a = xor i32 %x, 0
+  %b = mul i32 %a, 4
+  ret i32 %b
+}
+
+define i32 @caller(i32 %x) {
+  %r = call i32 @callee(i32 %x)
+  %s = add i32 %r, 0
+  ret i32 %s
+}
+
+define i32 @range(i32* %p) {
+  %v = load i32, i32* %p, !range !0
+  %c = icmp ugt i32 %v, 10
+  %r = select i1 %c, i32 1, i32 %v
+  ret i32 %r
+}
+
+; Distinct metadata is not cached.
+define void @loop(i32 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %next = add i32 %i, 1
+  %c = icmp slt i32 %next, %n
+  br i1 %c, label %loop, label %exit, !llvm.loop !1
+exit:
+  ret void
+}
+
+!0 = !{i32 0, i32 5}
+!1 = distinct !{!1}
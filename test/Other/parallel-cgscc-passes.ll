@@ -0,0 +1,117 @@
+; Check that walking the call graph on several threads does not change the
+; output.
+; RUN: opt -passes='cgscc(inline,function-attrs)' %s -S -o %t.ref.ll
+; RUN: opt -passes='cgscc(inline,function-attrs)' -cgscc-pass-threads=4 %s -S \
+; RUN:   -o %t.ll
+; RUN: diff %t.ref.ll %t.ll
+; RUN: opt -passes='default<O2>' %s -S -o %t.O2.ref.ll
+; RUN: opt -passes='default<O2>' -cgscc-pass-threads=4 %s -S -o %t.O2.ll
+; RUN: diff %t.O2.ref.ll %t.O2.ll
+; RUN: opt -passes='default<O2>' -cgscc-pass-threads=4 \
+; RUN:   -function-pass-threads=4 %s -S -o %t.O2.both.ll
+; RUN: diff %t.O2.ref.ll %t.O2.both.ll
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@hello = private constant [7 x i8] c"hello\0A\00"
+@bye = private constant [5 x i8] c"bye\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+; The calls are turned into calls to a new declaration of @puts.
+define void @greet() {
+  %call = call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @hello, i64 0, i64 0))
+  ret void
+}
+
+define void @leave() {
+  %call = call i32 (i8*, ...) @printf(i8* getelementptr ([5 x i8], [5 x i8]* @bye, i64 0, i64 0))
+  ret void
+}
+
+; Inlined into its only caller, then deleted.
+define internal i32 @scale(i32 %x) {
+  %a = xor i32 %x, 0
+  %b = mul i32 %a, 4
+  ret i32 %b
+}
+
+define i32 @scaled_sum(i32* %p, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %idx = sext i32 %i to i64
+  %gep = getelementptr inbounds i32, i32* %p, i64 %idx
+  %v = load i32, i32* %gep
+  %s = call i32 @scale(i32 %v)
+  %acc.next = add i32 %acc, %s
+  %i.next = add nsw i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret i32 %acc.next
+}
+
+define i32 @inc(i32 %x) {
+  %r = add i32 %x, 1
+  ret i32 %r
+}
+
+define i32 @dec(i32 %x) {
+  %r = sub i32 %x, 1
+  ret i32 %r
+}
+
+define i32 @twice(i32 %x) {
+  %a = call i32 @inc(i32 %x)
+  %b = call i32 @inc(i32 %a)
+  ret i32 %b
+}
+
+define i32 @back(i32 %x) {
+  %a = call i32 @dec(i32 %x)
+  %b = call i32 @inc(i32 %a)
+  ret i32 %b
+}
+
+; Two functions calling each other.
+define i32 @even(i32 %n) {
+  %z = icmp eq i32 %n, 0
+  br i1 %z, label %yes, label %rec
+
+yes:
+  ret i32 1
+
+rec:
+  %m = call i32 @dec(i32 %n)
+  %r = call i32 @odd(i32 %m)
+  ret i32 %r
+}
+
+define i32 @odd(i32 %n) {
+  %z = icmp eq i32 %n, 0
+  br i1 %z, label %no, label %rec
+
+no:
+  ret i32 0
+
+rec:
+  %m = call i32 @dec(i32 %n)
+  %r = call i32 @even(i32 %m)
+  ret i32 %r
+}
+
+define i32 @main(i32* %p, i32 %n) {
+  call void @greet()
+  %a = call i32 @scaled_sum(i32* %p, i32 %n)
+  %b = call i32 @twice(i32 %a)
+  %c = call i32 @back(i32 %b)
+  %d = call i32 @even(i32 %c)
+  call void @leave()
+  ret i32 %d
+}
@@ -0,0 +1,53 @@
+; Check that running the function pipelines on several threads does not change
+; the output.
+; RUN: opt -passes=instcombine %s -S -o %t.ref.ll
+; RUN: opt -passes=instcombine -function-pass-threads=4 %s -S -o %t.ll
+; RUN: diff %t.ref.ll %t.ll
+; RUN: opt -passes='default<O2>' %s -S -o %t.O2.ref.ll
+; RUN: opt -passes='default<O2>' -function-pass-threads=4 %s -S -o %t.O2.ll
+; RUN: diff %t.O2.ref.ll %t.O2.ll
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@hello = private constant [7 x i8] c"hello\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+; The call is turned into a call to a new declaration of @puts.
+define void @greet() {
+  %call = call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @hello, i64 0, i64 0))
+  ret void
+}
+
+define i32 @mul(i32 %x) {
+  %a = xor i32 %x, 0
+  %b = mul i32 %a, 4
+  ret i32 %b
+}
+
+define i32 @sum(i32* %p, i32 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %t, %loop ]
+  %idx = sext i32 %i to i64
+  %gep = getelementptr i32, i32* %p, i64 %idx
+  %v = load i32, i32* %gep
+  %t = add i32 %s, %v
+  %next = add i32 %i, 1
+  %c = icmp slt i32 %next, %n
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %t
+}
+
+define i32 @range(i32* %p) {
+  %v = load i32, i32* %p, !range !0
+  %c = icmp ugt i32 %v, 10
+  %r = select i1 %c, i32 1, i32 %v
+  ret i32 %r
+}
+
+!0 = !{i32 0, i32 5}
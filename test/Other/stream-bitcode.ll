@@ -0,0 +1,61 @@
+; Check that streaming the functions out of a function pipeline gives the same
+; module as writing it at the end. The use-list order is not preserved when
+; streaming, so -preserve-bc-uselistorder, which is on by default, is ignored.
+; RUN: opt -passes=instcombine %s -o - | llvm-dis -o %t.ref.ll
+; RUN: opt -passes=instcombine -stream-bitcode %s -o - | llvm-dis -o %t.ll
+; RUN: diff %t.ref.ll %t.ll
+; RUN: FileCheck %s < %t.ll
+
+; Too few IDs are reserved for the declaration and the string created by
+; instcombine.
+; RUN: not opt -passes=instcombine -stream-bitcode \
+; RUN:   -stream-bitcode-reserved-ids=1 %s -o /dev/null 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=RESERVED
+; RESERVED: Too many module-level values were created while streaming bitcode
+
+; RUN: not opt -passes=instcombine -stream-bitcode %s -S 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=OUTPUT
+; OUTPUT: -stream-bitcode requires plain bitcode output
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@hello = private constant [7 x i8] c"hello\0A\00"
+@table = constant [1 x i8*] [i8* blockaddress(@indirect, %target)]
+
+; CHECK: @str = private unnamed_addr constant [6 x i8] c"hello\00"
+
+declare i32 @printf(i8*, ...)
+
+; CHECK-LABEL: define i32 @range(
+; CHECK-NEXT: %v = load i32, i32* %p, align 4, !range !0
+; CHECK-NEXT: ret i32 %v
+define i32 @range(i32* %p) {
+  %v = load i32, i32* %p, !range !0
+  %c = icmp ugt i32 %v, 10
+  %r = select i1 %c, i32 1, i32 %v
+  ret i32 %r
+}
+
+; The call is turned into a call to a new declaration of @puts. The writer is
+; created once @range is done, so @puts and @str are created while streaming.
+; CHECK-LABEL: define void @greet(
+; CHECK-NEXT: %puts = call i32 @puts(i8* getelementptr inbounds ([6 x i8], [6 x i8]* @str, i64 0, i64 0))
+define void @greet() {
+  %call = call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @hello, i64 0, i64 0))
+  ret void
+}
+
+; The address of a block is taken, so the function is written at the end.
+; CHECK-LABEL: define i32 @indirect(
+; CHECK: indirectbr i8* %addr, [label %target]
+define i32 @indirect(i8* %addr) {
+entry:
+  indirectbr i8* %addr, [label %target]
+target:
+  ret i32 1
+}
+
+; CHECK: declare i32 @puts(i8* nocapture readonly)
+
+!0 = !{i32 0, i32 5}
@@ -17,6 +17,17 @@
 ; TIME-LEGACY-DAG:   Module Verifier
 ; TIME-LEGACY-DAG:   Target Library Information
 ; TIME: Total{{$}}
+;
+; RUN: opt < %s -disable-output -instcombine -time-passes -track-memory -sort-timers=mem 2>&1 | FileCheck %s --check-prefix=MEM
+; MEM: Pass execution timing report
+; MEM: ---Mem---{{.*}}--- Name ---
+;
+; RUN: opt < %s -disable-output -instcombine -time-passes -time-passes-per-function 2>&1 | FileCheck %s --check-prefix=FUNC
+; FUNC: Pass execution timing report
+; FUNC: Function execution timing report
+; FUNC-DAG: foo{{$}}
+; FUNC-DAG: bar_with_loops{{$}}
+; FUNC: Total{{$}}
 
 define i32 @foo() {
   %res = add i32 5, 4
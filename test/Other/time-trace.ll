@@ -0,0 +1,38 @@
+; RUN: opt < %s -instcombine -time-trace -time-trace-granularity=0 \
+; RUN:   -time-trace-file=%t.json -disable-output
+; RUN: FileCheck --check-prefix=LEGACY --input-file=%t.json %s
+; RUN: opt < %s -passes=instcombine -time-trace -time-trace-granularity=0 \
+; RUN:   -time-trace-file=%t.newpm.json -disable-output
+; RUN: FileCheck --check-prefix=NEWPM --input-file=%t.newpm.json %s
+
+; Every pass is recorded with the function it runs on, nested in the pass
+; managers, and followed by the total time of every pass. The legacy pass
+; manager runs the analyses instcombine requires, and the verifier, as passes.
+
+; LEGACY: "traceEvents": [
+; LEGACY: "name": "Optimization Remark Emitter"
+; LEGACY: "detail": "foo"
+; LEGACY-NEXT: },
+; LEGACY-NEXT: "dur":
+; LEGACY-NEXT: "name": "Combine redundant instructions"
+; LEGACY: "name": "Module Verifier"
+; LEGACY: "detail": "foo"
+; LEGACY-NEXT: },
+; LEGACY-NEXT: "dur":
+; LEGACY-NEXT: "name": "OptFunction"
+; LEGACY: "name": "Function Pass Manager"
+; LEGACY: "name": "Total Combine redundant instructions"
+; LEGACY: "name": "process_name"
+
+; NEWPM: "traceEvents": [
+; NEWPM: "detail": "foo"
+; NEWPM-NEXT: },
+; NEWPM-NEXT: "dur":
+; NEWPM-NEXT: "name": "InstCombinePass"
+; NEWPM: "name": "ModuleToFunctionPassAdaptor<{{.*}}>"
+; NEWPM: "name": "Total InstCombinePass"
+
+define i32 @foo(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
@@ -0,0 +1,53 @@
+; Check that with -instcombine-incremental, a second run of instcombine only
+; visits the instructions that changed since the first one, and that the
+; result does not change.
+; REQUIRES: asserts
+; RUN: opt -passes='instcombine,instcombine' -instcombine-incremental -stats \
+; RUN:   -S %s 2>&1 | FileCheck %s --check-prefixes=CHECK,STATS
+; RUN: opt -passes='instcombine,simplify-cfg,instcombine' \
+; RUN:   -instcombine-incremental -stats -S %s 2>&1 \
+; RUN:   | FileCheck %s --check-prefixes=CHECK,CFG-STATS
+; RUN: opt -passes='instcombine,instcombine' -S %s -o %t.ref.ll
+; RUN: opt -passes='instcombine,instcombine' -instcombine-incremental -S %s \
+; RUN:   -o %t.ll
+; RUN: diff %t.ref.ll %t.ll
+; RUN: opt -instcombine -instcombine-incremental -S %s | FileCheck %s
+
+define i32 @chain(i32 %x, i32 %y) {
+; CHECK-LABEL: @chain(
+; CHECK-NEXT:    [[A:%.*]] = add i32 [[X:%.*]], [[Y:%.*]]
+; CHECK-NEXT:    [[B:%.*]] = mul i32 [[A]], [[Y]]
+; CHECK-NEXT:    [[C:%.*]] = xor i32 [[B]], [[X]]
+; CHECK-NEXT:    ret i32 [[C]]
+;
+  %a = add i32 %x, %y
+  %b = mul i32 %a, %y
+  %c = xor i32 %b, %x
+  %d = sub i32 %c, 0
+  ret i32 %d
+}
+
+define i32 @merge(i32 %x, i32 %y) {
+; CHECK-LABEL: @merge(
+; CHECK:         [[A:%.*]] = shl i32 [[X:%.*]], 2
+; CHECK-NEXT:    [[B:%.*]] = or i32 [[A]], [[Y:%.*]]
+; CHECK-NEXT:    ret i32 [[B]]
+;
+entry:
+  %a = mul i32 %x, 4
+  br label %next
+
+next:
+  %b = or i32 %a, %y
+  ret i32 %b
+}
+
+; The statistics are printed after the module.
+; The first run folds the sub of @chain and sinks the shl of @merge, then
+; iterates again, which visits none of the 8 instructions left. The second run
+; visits none of them either.
+; STATS: 16 instcombine - Number of unchanged insts not visited again
+
+; simplify-cfg merges the blocks of @merge, which moves its instructions, so
+; the second run visits them again.
+; CFG-STATS: 12 instcombine - Number of unchanged insts not visited again
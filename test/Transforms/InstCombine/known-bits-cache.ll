@@ -0,0 +1,62 @@
+; RUN: opt < %s -instcombine -S | FileCheck %s
+; RUN: opt < %s -passes=instcombine -verify-known-bits-cache -S | FileCheck %s
+
+; The high bits of %o8 are only known by looking further than the search
+; depth of ValueTracking, but the known bits of the ors are cached as they are
+; visited in order.
+
+define i32 @or_chain(i32* %p) {
+; CHECK-LABEL: @or_chain(
+; CHECK:         ret i32 0
+;
+  %p1 = getelementptr i32, i32* %p, i64 1
+  %p2 = getelementptr i32, i32* %p, i64 2
+  %p3 = getelementptr i32, i32* %p, i64 3
+  %p4 = getelementptr i32, i32* %p, i64 4
+  %p5 = getelementptr i32, i32* %p, i64 5
+  %p6 = getelementptr i32, i32* %p, i64 6
+  %p7 = getelementptr i32, i32* %p, i64 7
+  %p8 = getelementptr i32, i32* %p, i64 8
+  %l0 = load i32, i32* %p, !range !0
+  %l1 = load i32, i32* %p1, !range !0
+  %l2 = load i32, i32* %p2, !range !0
+  %l3 = load i32, i32* %p3, !range !0
+  %l4 = load i32, i32* %p4, !range !0
+  %l5 = load i32, i32* %p5, !range !0
+  %l6 = load i32, i32* %p6, !range !0
+  %l7 = load i32, i32* %p7, !range !0
+  %l8 = load i32, i32* %p8, !range !0
+  %o1 = or i32 %l0, %l1
+  %o2 = or i32 %o1, %l2
+  %o3 = or i32 %o2, %l3
+  %o4 = or i32 %o3, %l4
+  %o5 = or i32 %o4, %l5
+  %o6 = or i32 %o5, %l6
+  %o7 = or i32 %o6, %l7
+  %o8 = or i32 %o7, %l8
+  %r = and i32 %o8, 16
+  ret i32 %r
+}
+
+; The known bits of %a come from the assumption, which does not hold at %before,
+; so they must not be reused there.
+
+declare void @llvm.assume(i1)
+declare void @use(i32)
+
+define i32 @assume_context(i32 %x) {
+; CHECK-LABEL: @assume_context(
+; CHECK:         [[BEFORE:%.*]] = and i32 [[A:%.*]], 16
+; CHECK-NEXT:    call void @use(i32 [[BEFORE]])
+; CHECK:         ret i32 0
+;
+  %a = add i32 %x, 1
+  %before = and i32 %a, 16
+  call void @use(i32 %before)
+  %c = icmp ult i32 %a, 16
+  call void @llvm.assume(i1 %c)
+  %after = and i32 %a, 16
+  ret i32 %after
+}
+
+!0 = !{i32 0, i32 16}
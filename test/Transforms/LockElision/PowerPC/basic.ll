@@ -0,0 +1,29 @@
+; RUN: opt < %s -lock-elision -S -mtriple=powerpc64le-unknown-linux-gnu -mcpu=pwr8 | FileCheck %s
+; RUN: opt < %s -lock-elision -S -mtriple=powerpc64le-unknown-linux-gnu -mcpu=pwr8 -mattr=-htm | FileCheck %s --check-prefix=NOHTM
+
+%union.pthread_mutex_t = type { [40 x i8] }
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) nounwind
+
+; Sections are elided with the target-independent intrinsics, and the backoff
+; loop spins on an empty asm.
+define void @elide(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @elide(
+; CHECK:       elide.begin:
+; CHECK:         [[STATUS:%.*]] = call i32 @llvm.htm.begin()
+; CHECK:       elide.backoff:
+; CHECK:         call void asm sideeffect "", ""()
+; CHECK:       elide.busy:
+; CHECK-NEXT:    call void @llvm.htm.abort(i8 127)
+; CHECK:       elide.commit:
+; CHECK-NEXT:    call void @llvm.htm.commit()
+;
+; NOHTM-LABEL: @elide(
+; NOHTM-NOT:     llvm.htm.begin
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
@@ -0,0 +1,208 @@
+; RUN: opt < %s -lock-elision -lock-elision-retries=0 -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+; RUN: opt < %s -passes=lock-elision -lock-elision-retries=0 -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+; RUN: opt < %s -lock-elision -S -mtriple=x86_64-unknown-linux-gnu | FileCheck %s --check-prefix=NORTM
+; RUN: opt < %s -lock-elision -S -mtriple=x86_64-apple-macosx -mattr=+rtm | FileCheck %s --check-prefix=NORTM
+
+%union.pthread_mutex_t = type { %struct.__pthread_mutex_s }
+%struct.__pthread_mutex_s = type { i32, i32, i32, i32, i32, i16, i16, %struct.__pthread_internal_list }
+%struct.__pthread_internal_list = type { %struct.__pthread_internal_list*, %struct.__pthread_internal_list* }
+
+@lock = global %union.pthread_mutex_t zeroinitializer, align 8
+@counter = global i32 0, align 4
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_trylock(%union.pthread_mutex_t*) nounwind
+declare void @may_unwind()
+declare void @relock(%union.pthread_mutex_t*) nounwind
+
+; NORTM-NOT: llvm.htm.begin
+
+define void @increment() {
+; CHECK-LABEL: @increment(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    [[STATUS:%.*]] = call i32 @llvm.htm.begin()
+; CHECK-NEXT:    [[STARTED:%.*]] = icmp eq i32 [[STATUS]], -1
+; CHECK-NEXT:    br i1 [[STARTED]], label %elide.check, label %elide.fallback
+; CHECK:       elide.check:
+; CHECK-NEXT:    [[WORD:%.*]] = load i32, i32* getelementptr inbounds (%union.pthread_mutex_t, %union.pthread_mutex_t* @lock, i32 0, i32 0, i32 0)
+; CHECK-NEXT:    [[FREE:%.*]] = icmp eq i32 [[WORD]], 0
+; CHECK-NEXT:    br i1 [[FREE]], label %elide.cont, label %elide.busy
+; CHECK:       elide.busy:
+; CHECK-NEXT:    call void @llvm.htm.abort(i8 127)
+; CHECK-NEXT:    br label %elide.fallback
+; CHECK:       elide.fallback:
+; CHECK-NEXT:    call i32 @pthread_mutex_lock(%union.pthread_mutex_t* @lock)
+; CHECK-NEXT:    br label %elide.cont
+; CHECK:       elide.cont:
+; CHECK-NEXT:    load i32, i32* @counter
+; CHECK-NEXT:    add nsw i32
+; CHECK-NEXT:    store i32
+; CHECK-NEXT:    br i1 [[STARTED]], label %elide.release, label %elide.unlock
+; CHECK:       elide.release:
+; CHECK-NEXT:    [[WORD2:%.*]] = load i32, i32* getelementptr inbounds (%union.pthread_mutex_t, %union.pthread_mutex_t* @lock, i32 0, i32 0, i32 0)
+; CHECK-NEXT:    [[FREE2:%.*]] = icmp eq i32 [[WORD2]], 0
+; CHECK-NEXT:    br i1 [[FREE2]], label %elide.commit, label %elide.taken
+; CHECK:       elide.commit:
+; CHECK-NEXT:    call void @llvm.htm.commit()
+; CHECK-NEXT:    br label %elide.end
+; CHECK:       elide.taken:
+; CHECK-NEXT:    call void @llvm.htm.abort(i8 126)
+; CHECK-NEXT:    br label %elide.unlock
+; CHECK:       elide.unlock:
+; CHECK-NEXT:    call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* @lock)
+; CHECK-NEXT:    br label %elide.end
+; CHECK:       elide.end:
+; CHECK-NEXT:    ret void
+;
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* @lock)
+  %1 = load i32, i32* @counter, align 4
+  %inc = add nsw i32 %1, 1
+  store i32 %inc, i32* @counter, align 4
+  %2 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* @lock)
+  ret void
+}
+
+define i32 @early_exit(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @early_exit(
+; CHECK:         [[STATUS:%.*]] = call i32 @llvm.htm.begin()
+; CHECK-NEXT:    [[STARTED:%.*]] = icmp eq i32 [[STATUS]], -1
+; CHECK:         [[R:%.*]] = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+; CHECK:         [[LOCKRET:%.*]] = phi i32 [ 0, %{{.*}} ], [ [[R]], %{{.*}} ]
+; CHECK:         br i1 [[STARTED]], label %[[RELEASE1:.*]], label %[[UNLOCK1:.*]],
+; CHECK:       [[RELEASE1]]:
+; CHECK:         br i1 %{{.*}}, label %[[COMMIT1:.*]], label %{{.*}},
+; CHECK:       [[COMMIT1]]:
+; CHECK-NEXT:    call void @llvm.htm.commit()
+; CHECK:       [[UNLOCK1]]:
+; CHECK-NEXT:    call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+; CHECK:         ret i32 [[LOCKRET]]
+; CHECK:         br i1 [[STARTED]], label %[[RELEASE2:.*]], label %[[UNLOCK2:.*]],
+; CHECK:       [[RELEASE2]]:
+; CHECK:         br i1 %{{.*}}, label %[[COMMIT2:.*]], label %{{.*}},
+; CHECK:       [[COMMIT2]]:
+; CHECK-NEXT:    call void @llvm.htm.commit()
+; CHECK:       [[UNLOCK2]]:
+; CHECK-NEXT:    [[U2:%.*]] = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+; CHECK:         [[UNLOCKRET:%.*]] = phi i32 [ 0, %[[COMMIT2]] ], [ [[U2]], %[[UNLOCK2]] ]
+; CHECK-NEXT:    ret i32 [[UNLOCKRET]]
+;
+entry:
+  %r = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  %v = load i32, i32* %p, align 4
+  %cmp = icmp eq i32 %v, 0
+  br i1 %cmp, label %empty, label %take
+
+empty:
+  %u1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret i32 %r
+
+take:
+  %dec = add i32 %v, -1
+  store i32 %dec, i32* %p, align 4
+  %u2 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret i32 %u2
+}
+
+define void @missing_unlock(%union.pthread_mutex_t* %m, i1 %c) {
+; CHECK-LABEL: @missing_unlock(
+; CHECK-NOT:     llvm.htm.begin
+; CHECK:         ret void
+;
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  br i1 %c, label %unlock, label %exit
+
+unlock:
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  br label %exit
+
+exit:
+  ret void
+}
+
+define void @lock_in_loop(%union.pthread_mutex_t* %m, i1 %c) {
+; CHECK-LABEL: @lock_in_loop(
+; CHECK-NOT:     llvm.htm.begin
+; CHECK:         ret void
+;
+entry:
+  br label %loop
+
+loop:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+define void @unwinding(%union.pthread_mutex_t* %m) {
+; CHECK-LABEL: @unwinding(
+; CHECK-NOT:     llvm.htm.begin
+; CHECK:         ret void
+;
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  call void @may_unwind()
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; A callee may unlock and relock the mutex inside the transaction, which takes
+; the lock word for real: the lock word is read again before committing, and
+; the transaction aborts if it is no longer free.
+define void @relocking_callee(%union.pthread_mutex_t* %m) {
+; CHECK-LABEL: @relocking_callee(
+; CHECK:         [[STARTED:%.*]] = icmp eq i32 %{{.*}}, -1
+; CHECK:       elide.cont:
+; CHECK-NEXT:    call void @relock(%union.pthread_mutex_t* %m)
+; CHECK-NEXT:    br i1 [[STARTED]], label %elide.release, label %elide.unlock
+; CHECK:       elide.release:
+; CHECK-NEXT:    [[WORDPTR:%.*]] = bitcast %union.pthread_mutex_t* %m to i32*
+; CHECK-NEXT:    [[WORD:%.*]] = load i32, i32* [[WORDPTR]]
+; CHECK-NEXT:    [[FREE:%.*]] = icmp eq i32 [[WORD]], 0
+; CHECK-NEXT:    br i1 [[FREE]], label %elide.commit, label %elide.taken
+; CHECK:       elide.commit:
+; CHECK-NEXT:    call void @llvm.htm.commit()
+; CHECK-NEXT:    br label %elide.end
+; CHECK:       elide.taken:
+; CHECK-NEXT:    call void @llvm.htm.abort(i8 126)
+; CHECK-NEXT:    br label %elide.unlock
+; CHECK:       elide.unlock:
+; CHECK-NEXT:    call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+;
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  call void @relock(%union.pthread_mutex_t* %m)
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; Likewise, a trylock of the elided mutex succeeds inside the transaction, as
+; the lock word is free.
+define i32 @trylock(%union.pthread_mutex_t* %m) {
+; CHECK-LABEL: @trylock(
+; CHECK:         [[STARTED:%.*]] = icmp eq i32 %{{.*}}, -1
+; CHECK:       elide.cont:
+; CHECK-NEXT:    [[TRY:%.*]] = call i32 @pthread_mutex_trylock(%union.pthread_mutex_t* %m)
+; CHECK-NEXT:    br i1 [[STARTED]], label %elide.release, label %elide.unlock
+; CHECK:       elide.release:
+; CHECK-NEXT:    [[WORDPTR:%.*]] = bitcast %union.pthread_mutex_t* %m to i32*
+; CHECK-NEXT:    [[WORD:%.*]] = load i32, i32* [[WORDPTR]]
+; CHECK-NEXT:    [[FREE:%.*]] = icmp eq i32 [[WORD]], 0
+; CHECK-NEXT:    br i1 [[FREE]], label %elide.commit, label %elide.taken
+; CHECK:       elide.taken:
+; CHECK-NEXT:    call void @llvm.htm.abort(i8 126)
+; CHECK-NEXT:    br label %elide.unlock
+; CHECK:       elide.end:
+; CHECK-NEXT:    ret i32 [[TRY]]
+;
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  %try = call i32 @pthread_mutex_trylock(%union.pthread_mutex_t* %m)
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret i32 %try
+}
@@ -0,0 +1,50 @@
+; RUN: opt < %s -lock-elision -lock-elision-retries=0 -pass-remarks-missed=lock-elision -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm 2>%t | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t
+; RUN: opt < %s -passes=lock-elision -lock-elision-retries=0 -tx-max-written-lines=1024 -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s --check-prefix=LARGE
+
+; Critical sections that cannot commit as a transaction are not elided.
+
+%union.pthread_mutex_t = type { [40 x i8] }
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) nounwind
+declare i64 @write(i32, i8*, i64) nounwind
+
+; REMARK: remark: <unknown>:0:0: critical section not elided: it always executes an instruction aborting the transaction
+define void @syscall(%union.pthread_mutex_t* %m, i8* %buf) {
+; CHECK-LABEL: @syscall(
+; CHECK-NOT:     llvm.htm.begin
+; CHECK:         ret void
+;
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  %n = call i64 @write(i32 1, i8* %buf, i64 1)
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; Writing 64K exceeds the 32K L1 data cache tracking the write set.
+; REMARK: remark: <unknown>:0:0: critical section not elided: it touches 0 cache lines for reading and 1024 for writing, exceeding the transactional capacity
+define void @clear(%union.pthread_mutex_t* %m, i32* %a) {
+; CHECK-LABEL: @clear(
+; CHECK-NOT:     llvm.htm.begin
+; CHECK:         ret void
+;
+; LARGE-LABEL: @clear(
+; LARGE:         llvm.htm.begin
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %a, i64 %i
+  store i32 0, i32* %p, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %cond = icmp ult i64 %i.next, 16384
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
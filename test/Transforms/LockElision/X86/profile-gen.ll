@@ -0,0 +1,55 @@
+; RUN: opt < %s -lock-elision -lock-elision-retries=0 -lock-elision-profile-gen -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+; RUN: opt < %s -passes=lock-elision -lock-elision-retries=0 -lock-elision-profile-gen -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+; RUN: opt < %s -lock-elision -lock-elision-profile-gen -instrprof -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s --check-prefix=LOWER
+
+%union.pthread_mutex_t = type { [40 x i8] }
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) nounwind
+
+; The counters of each elided section are a commit count, a fallback count and
+; an abort count per abort cause, in a profile record of their own.
+; CHECK: @__profn_increment.lock_elision = private constant [22 x i8] c"increment.lock-elision"
+; LOWER: @__profc_increment.lock_elision = private global [7 x i64] zeroinitializer, section "__llvm_prf_cnts"
+
+define void @increment(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @increment(
+; CHECK:       elide.fallback:
+; CHECK-NEXT:    [[BUSYBITS:%.*]] = and i32 [[STATUS:%.*]], 2130706433
+; CHECK-NEXT:    [[BUSY:%.*]] = icmp eq i32 [[BUSYBITS]], 2130706433
+; CHECK-NEXT:    [[EXPLICITBIT:%.*]] = and i32 [[STATUS]], 1
+; CHECK-NEXT:    [[HASEXPLICIT:%.*]] = icmp eq i32 [[EXPLICITBIT]], 1
+; CHECK-NEXT:    [[NOTBUSY:%.*]] = xor i1 [[BUSY]], true
+; CHECK-NEXT:    [[EXPLICIT:%.*]] = and i1 [[HASEXPLICIT]], [[NOTBUSY]]
+; CHECK-NEXT:    [[STEP:%.*]] = zext i1 [[BUSY]] to i64
+; CHECK-NEXT:    call void @llvm.instrprof.increment.step(i8* getelementptr inbounds ([22 x i8], [22 x i8]* @__profn_increment.lock_elision, i32 0, i32 0), i64 30064771073, i32 7, i32 2, i64 [[STEP]])
+; CHECK-NEXT:    [[STEP:%.*]] = zext i1 [[EXPLICIT]] to i64
+; CHECK-NEXT:    call void @llvm.instrprof.increment.step({{.*}}, i64 30064771073, i32 7, i32 3, i64 [[STEP]])
+; CHECK-NEXT:    [[CONFLICTBITS:%.*]] = and i32 [[STATUS]], 5
+; CHECK-NEXT:    [[CONFLICT:%.*]] = icmp eq i32 [[CONFLICTBITS]], 4
+; CHECK-NEXT:    [[STEP:%.*]] = zext i1 [[CONFLICT]] to i64
+; CHECK-NEXT:    call void @llvm.instrprof.increment.step({{.*}}, i64 30064771073, i32 7, i32 4, i64 [[STEP]])
+; CHECK-NEXT:    [[CAUSEBITS:%.*]] = and i32 [[STATUS]], 13
+; CHECK-NEXT:    [[CAPACITY:%.*]] = icmp eq i32 [[CAUSEBITS]], 8
+; CHECK-NEXT:    [[STEP:%.*]] = zext i1 [[CAPACITY]] to i64
+; CHECK-NEXT:    call void @llvm.instrprof.increment.step({{.*}}, i64 30064771073, i32 7, i32 5, i64 [[STEP]])
+; CHECK-NEXT:    [[CAUSEBITS:%.*]] = and i32 [[STATUS]], 13
+; CHECK-NEXT:    [[OTHER:%.*]] = icmp eq i32 [[CAUSEBITS]], 0
+; CHECK-NEXT:    [[STEP:%.*]] = zext i1 [[OTHER]] to i64
+; CHECK-NEXT:    call void @llvm.instrprof.increment.step({{.*}}, i64 30064771073, i32 7, i32 6, i64 [[STEP]])
+; CHECK-NEXT:    call void @llvm.instrprof.increment({{.*}}, i64 30064771073, i32 7, i32 1)
+; CHECK-NEXT:    call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+; CHECK:       elide.commit:
+; CHECK-NEXT:    call void @llvm.htm.commit()
+; CHECK-NEXT:    call void @llvm.instrprof.increment({{.*}}, i64 30064771073, i32 7, i32 0)
+; CHECK-NEXT:    br label %elide.end
+;
+; LOWER-LABEL: @increment(
+; LOWER-NOT:     @llvm.instrprof.increment
+; LOWER:         ret void
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
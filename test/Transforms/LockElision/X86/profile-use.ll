@@ -0,0 +1,74 @@
+; RUN: llvm-profdata merge %S/Inputs/profile-use.proftext -o %t.profdata
+; RUN: opt < %s -lock-elision -lock-elision-profile-use=%t.profdata -pass-remarks-missed=lock-elision -pass-remarks-analysis=lock-elision -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm 2>%t.remarks | FileCheck %s
+; RUN: FileCheck %s --check-prefix=REMARK < %t.remarks
+; RUN: opt < %s -passes=lock-elision -lock-elision-profile-use=%t.profdata -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+
+%union.pthread_mutex_t = type { [40 x i8] }
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) nounwind
+
+; REMARK: remark: <unknown>:0:0: critical section not elided: only 10 of 100 profiled executions committed
+define void @rarely_commits(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @rarely_commits(
+; CHECK-NOT:     llvm.htm.begin
+; CHECK:         ret void
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; REMARK: remark: <unknown>:0:0: not retrying aborted transactions: 40 of 50 profiled aborts would happen again
+define void @capacity_aborts(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @capacity_aborts(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    call i32 @llvm.htm.begin()
+; CHECK-NOT:     elide.backoff
+; CHECK:         ret void
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; REMARK: remark: <unknown>:0:0: backing off for 64 iterations before retrying: 300 of 400 profiled aborts found the lock busy
+define void @busy_lock(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @busy_lock(
+; CHECK:       elide.begin:
+; CHECK-NEXT:    phi i32 [ 0, %entry ]
+; CHECK-NEXT:    phi i32 [ 64, %entry ]
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; Too few executions to trust the profile, and no profile at all, keep the
+; default policy.
+define void @few_executions(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @few_executions(
+; CHECK:       elide.begin:
+; CHECK-NEXT:    phi i32 [ 0, %entry ]
+; CHECK-NEXT:    phi i32 [ 16, %entry ]
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+define void @no_profile(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @no_profile(
+; CHECK:       elide.begin:
+; CHECK-NEXT:    phi i32 [ 0, %entry ]
+; CHECK-NEXT:    phi i32 [ 16, %entry ]
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
@@ -0,0 +1,89 @@
+; RUN: opt < %s -lock-elision -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s
+; RUN: opt < %s -lock-elision -lock-elision-retries=5 -lock-elision-backoff=4 -lock-elision-max-backoff=64 -S -mtriple=x86_64-unknown-linux-gnu -mattr=+rtm | FileCheck %s --check-prefix=OPT
+
+%union.pthread_mutex_t = type { [40 x i8] }
+
+declare i32 @pthread_mutex_lock(%union.pthread_mutex_t*) nounwind
+declare i32 @pthread_mutex_unlock(%union.pthread_mutex_t*) nounwind
+
+; The default policy retries up to three times, pausing 16, 32 and 64 times.
+define void @default_policy(%union.pthread_mutex_t* %m, i32* %p) {
+; CHECK-LABEL: @default_policy(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    br label %elide.begin
+; CHECK:       elide.begin:
+; CHECK-NEXT:    [[ATTEMPT:%.*]] = phi i32 [ 0, %entry ], [ [[NEXTATTEMPT:%.*]], %elide.backoff ]
+; CHECK-NEXT:    [[DELAY:%.*]] = phi i32 [ 16, %entry ], [ [[NEXTDELAY:%.*]], %elide.backoff ]
+; CHECK-NEXT:    [[STATUS:%.*]] = call i32 @llvm.htm.begin()
+; CHECK-NEXT:    [[STARTED:%.*]] = icmp eq i32 [[STATUS]], -1
+; CHECK-NEXT:    br i1 [[STARTED]], label %elide.check, label %elide.abort
+; CHECK:       elide.abort:
+; CHECK-NEXT:    [[MORE:%.*]] = icmp ult i32 [[ATTEMPT]], 3
+; CHECK-NEXT:    [[RETRYBIT:%.*]] = and i32 [[STATUS]], 2
+; CHECK-NEXT:    [[MAYRETRY:%.*]] = icmp ne i32 [[RETRYBIT]], 0
+; CHECK-NEXT:    [[CODE:%.*]] = and i32 [[STATUS]], 2130706433
+; CHECK-NEXT:    [[WASBUSY:%.*]] = icmp eq i32 [[CODE]], 2130706433
+; CHECK-NEXT:    [[RETRYABLE:%.*]] = or i1 [[MAYRETRY]], [[WASBUSY]]
+; CHECK-NEXT:    [[RETRY:%.*]] = and i1 [[MORE]], [[RETRYABLE]]
+; CHECK-NEXT:    [[NEXTATTEMPT]] = add i32 [[ATTEMPT]], 1
+; CHECK-NEXT:    [[DOUBLED:%.*]] = shl i32 [[DELAY]], 1
+; CHECK-NEXT:    [[CAPPED:%.*]] = icmp ult i32 [[DOUBLED]], 1024
+; CHECK-NEXT:    [[NEXTDELAY]] = select i1 [[CAPPED]], i32 [[DOUBLED]], i32 1024
+; CHECK-NEXT:    br i1 [[RETRY]], label %elide.backoff, label %elide.fallback
+; CHECK:       elide.backoff:
+; CHECK-NEXT:    [[SPIN:%.*]] = phi i32 [ 0, %elide.abort ], [ [[NEXTSPIN:%.*]], %elide.backoff ]
+; CHECK-NEXT:    call void @llvm.x86.sse2.pause()
+; CHECK-NEXT:    [[NEXTSPIN]] = add i32 [[SPIN]], 1
+; CHECK-NEXT:    [[SPINNING:%.*]] = icmp ult i32 [[NEXTSPIN]], [[DELAY]]
+; CHECK-NEXT:    br i1 [[SPINNING]], label %elide.backoff, label %elide.begin
+; CHECK:       elide.fallback:
+; CHECK-NEXT:    call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+; CHECK-NEXT:    br label %elide.cont
+; CHECK:       elide.cont:
+; CHECK:         br i1 [[STARTED]], label %elide.release, label %elide.unlock
+;
+; OPT-LABEL: @default_policy(
+; OPT:         phi i32 [ 4, %entry ]
+; OPT:         icmp ult i32 %{{.*}}, 5
+; OPT:         icmp ult i32 %{{.*}}, 64
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+; Function attributes select the policy unless overridden on the command line.
+define void @no_retry(%union.pthread_mutex_t* %m, i32* %p) "lock-elision-retries"="0" {
+; CHECK-LABEL: @no_retry(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    [[STATUS:%.*]] = call i32 @llvm.htm.begin()
+; CHECK-NEXT:    [[STARTED:%.*]] = icmp eq i32 [[STATUS]], -1
+; CHECK-NEXT:    br i1 [[STARTED]], label %elide.check, label %elide.fallback
+;
+; OPT-LABEL: @no_retry(
+; OPT:         icmp ult i32 %{{.*}}, 5
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
+
+define void @no_backoff(%union.pthread_mutex_t* %m, i32* %p) "lock-elision-retries"="8" "lock-elision-backoff"="0" {
+; CHECK-LABEL: @no_backoff(
+; CHECK:       elide.begin:
+; CHECK-NEXT:    [[ATTEMPT:%.*]] = phi i32 [ 0, %entry ], [ [[NEXTATTEMPT:%.*]], %elide.abort ]
+; CHECK-NEXT:    call i32 @llvm.htm.begin()
+; CHECK:       elide.abort:
+; CHECK-NEXT:    icmp ult i32 [[ATTEMPT]], 8
+; CHECK:         [[NEXTATTEMPT]] = add i32 [[ATTEMPT]], 1
+; CHECK-NEXT:    br i1 %{{.*}}, label %elide.begin, label %elide.fallback
+; CHECK-NOT:   elide.backoff
+; CHECK:         ret void
+entry:
+  %0 = call i32 @pthread_mutex_lock(%union.pthread_mutex_t* %m)
+  store i32 1, i32* %p, align 4
+  %1 = call i32 @pthread_mutex_unlock(%union.pthread_mutex_t* %m)
+  ret void
+}
@@ -0,0 +1,180 @@
+; RUN: opt < %s -shrink-transactions -S | FileCheck %s
+; RUN: opt < %s -passes=shrink-transactions -S | FileCheck %s
+
+declare i32 @llvm.x86.xbegin()
+declare void @llvm.x86.xend()
+declare void @llvm.x86.xabort(i8)
+declare void @escape(i32*)
+
+; Pure computations on values available before the transaction and loads of
+; thread-private memory are hoisted, and computations only used after the
+; commit are sunk.
+define i32 @hoist_and_sink(i32* %shared, i32 %a, i32 %b) {
+; CHECK-LABEL: @hoist_and_sink(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    [[PRIVATE:%.*]] = alloca i32
+; CHECK-NEXT:    store i32 %a, i32* [[PRIVATE]]
+; CHECK-NEXT:    [[MUL:%.*]] = mul i32 %a, %b
+; CHECK-NEXT:    [[DIV:%.*]] = sdiv i32 %a, 3
+; CHECK-NEXT:    [[P:%.*]] = load i32, i32* [[PRIVATE]]
+; CHECK-NEXT:    [[STATUS:%.*]] = call i32 @llvm.x86.xbegin()
+; CHECK-NEXT:    [[STARTED:%.*]] = icmp eq i32 [[STATUS]], -1
+; CHECK-NEXT:    br i1 [[STARTED]], label %tx, label %fallback
+; CHECK:       tx:
+; CHECK-NEXT:    [[REM:%.*]] = urem i32 %a, %b
+; CHECK-NEXT:    [[V:%.*]] = load i32, i32* %shared
+; CHECK-NEXT:    [[SUM:%.*]] = add i32 [[V]], [[MUL]]
+; CHECK-NEXT:    [[SUM2:%.*]] = add i32 [[SUM]], [[REM]]
+; CHECK-NEXT:    store i32 [[SUM2]], i32* %shared
+; CHECK-NEXT:    call void @llvm.x86.xend()
+; CHECK-NEXT:    [[SCALED:%.*]] = mul i32 [[V]], [[P]]
+; CHECK-NEXT:    [[RES:%.*]] = add i32 [[SCALED]], [[DIV]]
+; CHECK-NEXT:    ret i32 [[RES]]
+;
+entry:
+  %private = alloca i32
+  store i32 %a, i32* %private
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %fallback
+
+tx:
+  %mul = mul i32 %a, %b
+  %div = sdiv i32 %a, 3
+  %rem = urem i32 %a, %b
+  %p = load i32, i32* %private
+  %v = load i32, i32* %shared
+  %sum = add i32 %v, %mul
+  %sum2 = add i32 %sum, %rem
+  store i32 %sum2, i32* %shared
+  %scaled = mul i32 %v, %p
+  %res = add i32 %scaled, %div
+  call void @llvm.x86.xend()
+  ret i32 %res
+
+fallback:
+  ret i32 -1
+}
+
+; Private memory written inside the transaction, and memory that may be
+; shared with other threads, must be read inside it.
+define i32 @not_private(i32* %shared, i32 %a) {
+; CHECK-LABEL: @not_private(
+; CHECK:         call i32 @llvm.x86.xbegin()
+; CHECK:       tx:
+; CHECK-NEXT:    store i32 %a, i32* %written
+; CHECK-NEXT:    load i32, i32* %written
+; CHECK-NEXT:    load i32, i32* %escaped
+; CHECK:         call void @llvm.x86.xend()
+;
+entry:
+  %written = alloca i32
+  %escaped = alloca i32
+  call void @escape(i32* %escaped)
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp ne i32 %status, -1
+  br i1 %started, label %fallback, label %tx
+
+tx:
+  store i32 %a, i32* %written
+  %w = load i32, i32* %written
+  %e = load i32, i32* %escaped
+  %sum = add i32 %w, %e
+  store i32 %sum, i32* %shared
+  call void @llvm.x86.xend()
+  ret i32 0
+
+fallback:
+  ret i32 -1
+}
+
+; A store right after the start of the transaction, in the same block, is
+; inside it too.
+define i32 @clobber_in_begin_block(i32* %shared, i32 %a) {
+; CHECK-LABEL: @clobber_in_begin_block(
+; CHECK:         call i32 @llvm.htm.begin()
+; CHECK-NEXT:    store i32 %a, i32* %private
+; CHECK:       tx:
+; CHECK-NEXT:    load i32, i32* %private
+; CHECK:         call void @llvm.htm.commit()
+;
+entry:
+  %private = alloca i32
+  store i32 0, i32* %private
+  %status = call i32 @llvm.htm.begin()
+  store i32 %a, i32* %private
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %fallback
+
+tx:
+  %p = load i32, i32* %private
+  store i32 %p, i32* %shared
+  call void @llvm.htm.commit()
+  ret i32 0
+
+fallback:
+  ret i32 -1
+}
+
+; Instructions used on the path where the transaction did not start are
+; not part of the transaction, and sinking stops at loops.
+define i32 @no_sink_into_loop(i32* %shared, i32 %n) {
+; CHECK-LABEL: @no_sink_into_loop(
+; CHECK:       tx:
+; CHECK-NEXT:    [[V:%.*]] = load i32, i32* %shared
+; CHECK-NEXT:    [[INC:%.*]] = add i32 [[V]], 1
+; CHECK-NEXT:    call void @llvm.x86.xend()
+; CHECK-NEXT:    br label %loop
+;
+entry:
+  %status = call i32 @llvm.x86.xbegin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %fallback
+
+tx:
+  %v = load i32, i32* %shared
+  %inc = add i32 %v, 1
+  call void @llvm.x86.xend()
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %tx ], [ %i.next, %loop ]
+  %i.next = add i32 %i, %inc
+  %cond = icmp slt i32 %i.next, %n
+  br i1 %cond, label %loop, label %exit
+
+exit:
+  ret i32 %i.next
+
+fallback:
+  %not.started = add i32 %n, 1
+  ret i32 %not.started
+}
+
+declare i32 @llvm.htm.begin()
+declare void @llvm.htm.commit()
+
+; Transactions created with the target-independent intrinsics.
+define i32 @htm(i32* %shared, i32 %a) {
+; CHECK-LABEL: @htm(
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    [[MUL:%.*]] = mul i32 %a, %a
+; CHECK-NEXT:    [[STATUS:%.*]] = call i32 @llvm.htm.begin()
+; CHECK:       tx:
+; CHECK-NEXT:    store i32 [[MUL]], i32* %shared
+; CHECK-NEXT:    call void @llvm.htm.commit()
+;
+entry:
+  %status = call i32 @llvm.htm.begin()
+  %started = icmp eq i32 %status, -1
+  br i1 %started, label %tx, label %fallback
+
+tx:
+  %mul = mul i32 %a, %a
+  store i32 %mul, i32* %shared
+  call void @llvm.htm.commit()
+  ret i32 0
+
+fallback:
+  ret i32 -1
+}
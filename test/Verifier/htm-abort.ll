@@ -0,0 +1,9 @@
+; RUN: not opt -verify < %s 2>&1 | FileCheck %s
+
+declare void @llvm.htm.abort(i8)
+
+define void @abort(i8 %code) {
+; CHECK: llvm.htm.abort parameter #1 must be a constant integer
+  call void @llvm.htm.abort(i8 %code)
+  ret void
+}
@@ -79,22 +79,24 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/TargetRegistry.h"
-#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/WithColor.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/thread.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include <algorithm>
 #include <cassert>
 #include <cinttypes>
 #include <climits>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <system_error>
 #include <tuple>
@@ -2638,10 +2640,12 @@ bool DwarfLinker::link(const DebugMap &Map) {
     }
     EmitLambda();
   } else {
-    ThreadPool pool(2);
-    pool.async(AnalyzeAll);
-    pool.async(CloneAll);
-    pool.wait();
+    // Analysis and cloning wait for each other, so they must run at the same
+    // time: run the cloning on its own thread rather than in a ThreadPool,
+    // whose tasks can be held back by the concurrency limit of the process.
+    llvm::thread CloneThread(CloneAll);
+    AnalyzeAll();
+    CloneThread.join();
   }
 
   return Options.NoOutput ? true : Streamer->finish(Map);
@@ -47,6 +47,7 @@
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/WithColor.h"
 #include "llvm/Target/TargetMachine.h"
@@ -148,6 +149,20 @@ static cl::opt<std::string>
                     cl::desc("YAML output filename for pass remarks"),
                     cl::value_desc("filename"));
 
+static cl::opt<bool> TimeTrace("time-trace",
+                               cl::desc("Record a time trace of the passes"));
+
+static cl::opt<unsigned> TimeTraceGranularity(
+    "time-trace-granularity",
+    cl::desc(
+        "Minimum time granularity (in microseconds) traced by time profiler"),
+    cl::init(500), cl::Hidden);
+
+static cl::opt<std::string>
+    TimeTraceFile("time-trace-file",
+                  cl::desc("Specify time trace file destination"),
+                  cl::value_desc("filename"));
+
 namespace {
 static ManagedStatic<std::vector<std::string>> RunPassNames;
 
@@ -338,6 +353,9 @@ int main(int argc, char **argv) {
         llvm::make_unique<yaml::Output>(YamlFile->os()));
   }
 
+  if (TimeTrace)
+    timeTraceProfilerInitialize(TimeTraceGranularity, argv[0]);
+
   if (InputLanguage != "" && InputLanguage != "ir" &&
       InputLanguage != "mir") {
     WithColor::error(errs(), argv[0])
@@ -351,6 +369,17 @@ int main(int argc, char **argv) {
     if (int RetVal = compileModule(argv, Context))
       return RetVal;
 
+  if (TimeTrace) {
+    StringRef TraceName =
+        OutputFilename.empty() || OutputFilename == "-" ? InputFilename
+                                                        : OutputFilename;
+    if (Error E = timeTraceProfilerWrite(TimeTraceFile, TraceName)) {
+      WithColor::error(errs(), argv[0]) << toString(std::move(E)) << '\n';
+      return 1;
+    }
+    timeTraceProfilerCleanup();
+  }
+
   if (YamlFile)
     YamlFile->keep();
   return 0;
@@ -594,7 +623,10 @@ static int compileModule(char **argv, LLVMContext &Context) {
       Buffer.clear();
     }
 
-    PM.run(*M);
+    {
+      TimeTraceScope TimeScope("CodeGen", M->getModuleIdentifier());
+      PM.run(*M);
+    }
 
     auto HasError =
         ((const LLCDiagnosticHandler *)(Context.getDiagHandlerPtr()))->HasError;
@@ -116,15 +116,23 @@ int main(int argc, char **argv) {
   LLVMContext Context;
   cl::ParseCommandLineOptions(argc, argv, "llvm extractor\n");
 
-  // Use lazy loading, since we only care about selected global values.
+  // Use lazy loading, since we only care about selected global values. The
+  // metadata used by a function is loaded along with the function.
   SMDiagnostic Err;
-  std::unique_ptr<Module> M = getLazyIRFileModule(InputFilename, Err, Context);
+  std::unique_ptr<Module> M = getLazyIRFileModule(
+      InputFilename, Err, Context, /*ShouldLazyLoadMetadata=*/true);
 
   if (!M.get()) {
     Err.print(argv[0], errs());
     return 1;
   }
 
+  // Use *argv instead of argv[0] to work around a wrong GCC warning.
+  ExitOnError ExitOnErr(std::string(*argv) + ": error reading input: ");
+
+  // Load the module-level metadata before any global is deleted.
+  ExitOnErr(M->materializeMetadata());
+
   // Use SetVector to avoid duplicates.
   SetVector<GlobalValue *> GVs;
 
@@ -255,9 +263,6 @@ int main(int argc, char **argv) {
     BBs.push_back(&*Res);
   }
 
-  // Use *argv instead of argv[0] to work around a wrong GCC warning.
-  ExitOnError ExitOnErr(std::string(*argv) + ": error reading input: ");
-
   if (Recursive) {
     std::vector<llvm::Function *> Workqueue;
     for (GlobalValue *GV : GVs) {
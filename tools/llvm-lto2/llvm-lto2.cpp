@@ -116,6 +116,11 @@ static cl::opt<bool>
 static cl::opt<std::string>
     StatsFile("stats-file", cl::desc("Filename to write statistics to"));
 
+static cl::opt<bool> BorrowBitcodeNames(
+    "borrow-bitcode-names", cl::init(false), cl::Hidden,
+    cl::desc("Keep the names of the globals in the input buffers rather than "
+             "copying them"));
+
 static void check(Error E, std::string Msg) {
   if (!E)
     return;
@@ -245,6 +250,7 @@ static int run(int argc, char **argv) {
   Conf.OverrideTriple = OverrideTriple;
   Conf.DefaultTriple = DefaultTriple;
   Conf.StatsFile = StatsFile;
+  Conf.BorrowBitcodeNames = BorrowBitcodeNames;
 
   ThinBackend Backend;
   if (ThinLTODistributedIndexes)
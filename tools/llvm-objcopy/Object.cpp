@@ -164,7 +164,9 @@ void ELFSectionWriter<ELFT>::visit(const CompressedSection &Sec) {
     Buf += sizeof(DecompressedSize);
   } else {
     Elf_Chdr_Impl<ELFT> Chdr;
-    Chdr.ch_type = ELF::ELFCOMPRESS_ZLIB;
+    Chdr.ch_type = Sec.CompressionType == DebugCompressionType::Zstd
+                       ? ELF::ELFCOMPRESS_ZSTD
+                       : ELF::ELFCOMPRESS_ZLIB;
     Chdr.ch_size = Sec.DecompressedSize;
     Chdr.ch_addralign = Sec.DecompressedAlign;
     memcpy(Buf, &Chdr, sizeof(Chdr));
@@ -179,17 +181,24 @@ CompressedSection::CompressedSection(const SectionBase &Sec,
     : SectionBase(Sec), CompressionType(CompressionType),
       DecompressedSize(Sec.OriginalData.size()), DecompressedAlign(Sec.Align) {
 
-  if (!zlib::isAvailable()) {
-    CompressionType = DebugCompressionType::None;
-    return;
+  StringRef Data(reinterpret_cast<const char *>(OriginalData.data()),
+                 OriginalData.size());
+  if (CompressionType == DebugCompressionType::Zstd) {
+    if (!zstd::isAvailable()) {
+      CompressionType = DebugCompressionType::None;
+      return;
+    }
+    if (Error E = zstd::compress(Data, CompressedData))
+      reportError(Name, std::move(E));
+  } else {
+    if (!zlib::isAvailable()) {
+      CompressionType = DebugCompressionType::None;
+      return;
+    }
+    if (Error E = zlib::compressParallel(Data, CompressedData))
+      reportError(Name, std::move(E));
   }
 
-  if (Error E = zlib::compress(
-          StringRef(reinterpret_cast<const char *>(OriginalData.data()),
-                    OriginalData.size()),
-          CompressedData))
-    reportError(Name, std::move(E));
-
   size_t ChdrSize;
   if (CompressionType == DebugCompressionType::GNU) {
     Name = ".z" + Sec.Name.substr(1);
@@ -928,12 +928,17 @@ static DriverConfig parseObjcopyOptions(ArrayRef<const char *> ArgsArr) {
               InputArgs.getLastArgValue(OBJCOPY_compress_debug_sections_eq))
               .Case("zlib-gnu", DebugCompressionType::GNU)
               .Case("zlib", DebugCompressionType::Z)
+              .Case("zstd", DebugCompressionType::Zstd)
               .Default(DebugCompressionType::None);
       if (Config.CompressionType == DebugCompressionType::None)
         error("Invalid or unsupported --compress-debug-sections format: " +
               InputArgs.getLastArgValue(OBJCOPY_compress_debug_sections_eq));
-      if (!zlib::isAvailable())
-        error("LLVM was not compiled with LLVM_ENABLE_ZLIB: can not compress.");
+    }
+    if (Config.CompressionType == DebugCompressionType::Zstd) {
+      if (!zstd::isAvailable())
+        error("LLVM was not compiled with LLVM_ENABLE_ZSTD: can not compress.");
+    } else if (!zlib::isAvailable()) {
+      error("LLVM was not compiled with LLVM_ENABLE_ZLIB: can not compress.");
     }
   }
 
@@ -0,0 +1,482 @@
+//===- IncrementalCache.cpp - Cache of optimized function bodies ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// This file implements the cache behind -incremental-cache.
+///
+//===----------------------------------------------------------------------===//
+
+#include "IncrementalCache.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "incremental-cache"
+
+STATISTIC(NumLoaded, "Number of functions loaded from the incremental cache");
+STATISTIC(NumStored, "Number of functions stored in the incremental cache");
+
+namespace {
+
+/// Collects the globals a function refers to, and checks that a cache entry
+/// can carry its references: the globals must have a name to be found by, and
+/// the metadata must be uniqued tuples, which are the same in the module the
+/// entry is loaded into.
+class ReferenceCollector {
+  SmallPtrSet<const Constant *, 16> VisitedConstants;
+  SmallPtrSet<const Metadata *, 16> VisitedMetadata;
+
+public:
+  SetVector<GlobalValue *> Globals;
+
+  bool collect(Function &F);
+  bool collect(Constant *C);
+
+private:
+  bool collect(Value *V);
+  bool collect(Metadata *MD);
+};
+
+} // end anonymous namespace
+
+bool ReferenceCollector::collect(Function &F) {
+  if (!F.hasName() || F.hasPrefixData() || F.hasPrologueData())
+    return false;
+  if (F.hasPersonalityFn() && !collect(F.getPersonalityFn()))
+    return false;
+
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  F.getAllMetadata(MDs);
+  for (const auto &MD : MDs)
+    if (!collect(MD.second))
+      return false;
+
+  for (BasicBlock &BB : F) {
+    if (BB.hasAddressTaken())
+      return false;
+    for (Instruction &I : BB) {
+      for (Value *Op : I.operands())
+        if (!collect(Op))
+          return false;
+      I.getAllMetadata(MDs);
+      for (const auto &MD : MDs)
+        if (!collect(MD.second))
+          return false;
+    }
+  }
+  return true;
+}
+
+bool ReferenceCollector::collect(Constant *C) {
+  if (!VisitedConstants.insert(C).second)
+    return true;
+  if (isa<BlockAddress>(C))
+    return false;
+  if (auto *GV = dyn_cast<GlobalValue>(C)) {
+    Globals.insert(GV);
+    return GV->hasName();
+  }
+  for (Use &Op : C->operands())
+    if (!collect(cast<Constant>(Op)))
+      return false;
+  return true;
+}
+
+bool ReferenceCollector::collect(Value *V) {
+  if (auto *C = dyn_cast<Constant>(V))
+    return collect(C);
+  if (auto *MAV = dyn_cast<MetadataAsValue>(V))
+    return collect(MAV->getMetadata());
+  return true;
+}
+
+bool ReferenceCollector::collect(Metadata *MD) {
+  if (!MD || !VisitedMetadata.insert(MD).second)
+    return true;
+  if (isa<MDString>(MD) || isa<LocalAsMetadata>(MD))
+    return true;
+  if (auto *CAM = dyn_cast<ConstantAsMetadata>(MD))
+    return collect(CAM->getValue());
+  auto *N = dyn_cast<MDTuple>(MD);
+  if (!N || N->isDistinct())
+    return false;
+  for (const MDOperand &Op : N->operands())
+    if (!collect(Op.get()))
+      return false;
+  return true;
+}
+
+static void addString(SHA1 &Hasher, StringRef S) {
+  uint8_t Data[8];
+  support::endian::write64le(Data, S.size());
+  Hasher.update(Data);
+  Hasher.update(S);
+}
+
+static void addUint64(SHA1 &Hasher, uint64_t V) {
+  uint8_t Data[8];
+  support::endian::write64le(Data, V);
+  Hasher.update(Data);
+}
+
+Expected<std::unique_ptr<IncrementalCache>>
+IncrementalCache::create(StringRef Dir, Module &M, StringRef Pipeline,
+                         StringRef AAPipeline, TargetMachine *TM) {
+  if (std::error_code EC = sys::fs::create_directories(Dir))
+    return errorCodeToError(EC);
+
+  std::unique_ptr<IncrementalCache> Cache(new IncrementalCache(Dir));
+  Cache->computeKeys(M, Pipeline, AAPipeline, TM);
+  return std::move(Cache);
+}
+
+void IncrementalCache::computeKeys(Module &M, StringRef Pipeline,
+                                   StringRef AAPipeline, TargetMachine *TM) {
+  for (GlobalValue &GV : M.global_values())
+    InputGlobals.insert(&GV);
+
+  // The command-line options of the passes are not covered.
+  SHA1 Hasher;
+  addString(Hasher, LLVM_VERSION_STRING);
+  addString(Hasher, Pipeline);
+  addString(Hasher, AAPipeline);
+  addString(Hasher, M.getTargetTriple());
+  addString(Hasher, M.getDataLayoutStr());
+  addString(Hasher, TM ? TM->getTargetCPU() : "");
+  addString(Hasher, TM ? TM->getTargetFeatureString() : "");
+  std::string CommonHash = Hasher.result();
+
+  // Walk the calls bottom-up, so that the hash of a strongly connected
+  // component covers the functions it calls. Functions no external caller
+  // reaches are not visited, and are not cached.
+  DenseMap<const Function *, uint64_t> FunctionHashes;
+  DenseMap<const Function *, std::string> SCCHashes;
+  CallGraph CG(M);
+  for (scc_iterator<CallGraph *> SCCI = scc_begin(&CG); !SCCI.isAtEnd();
+       ++SCCI) {
+    SHA1 SCCHasher;
+    SmallVector<const Function *, 4> Functions;
+    for (CallGraphNode *Node : *SCCI) {
+      const Function *F = Node->getFunction();
+      if (!F || F->isDeclaration())
+        continue;
+      uint64_t Hash = StructuralHash(*F);
+      FunctionHashes[F] = Hash;
+      addUint64(SCCHasher, Hash);
+      Functions.push_back(F);
+    }
+    if (Functions.empty())
+      continue;
+
+    // The calls within the component have no hash yet.
+    for (CallGraphNode *Node : *SCCI)
+      for (const CallGraphNode::CallRecord &Call : *Node) {
+        auto Callee = SCCHashes.find(Call.second->getFunction());
+        if (Callee != SCCHashes.end())
+          SCCHasher.update(Callee->second);
+      }
+
+    std::string SCCHash = SCCHasher.result();
+    for (const Function *F : Functions)
+      SCCHashes[F] = SCCHash;
+  }
+
+  for (Function &F : M) {
+    auto SCCHash = SCCHashes.find(&F);
+    ReferenceCollector Collector;
+    if (SCCHash == SCCHashes.end() || !Collector.collect(F))
+      continue;
+    Hasher.init();
+    Hasher.update(CommonHash);
+    addUint64(Hasher, FunctionHashes[&F]);
+    Hasher.update(SCCHash->second);
+    Keys[&F] = toHex(Hasher.result());
+  }
+}
+
+bool IncrementalCache::load(Function &F) {
+  auto Key = Keys.find(&F);
+  if (Key == Keys.end())
+    return false;
+
+  SmallString<128> EntryPath;
+  sys::path::append(EntryPath, Dir, "llvmcache-" + Key->second);
+  int FD;
+  if (sys::fs::openFileForRead(Twine(EntryPath), FD, sys::fs::OF_UpdateAtime))
+    return false;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr =
+      MemoryBuffer::getOpenFile(FD, EntryPath,
+                                /*FileSize*/ -1,
+                                /*RequiresNullTerminator*/ false);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!MBOrErr)
+    return false;
+  MemoryBufferRef Buffer = (*MBOrErr)->getMemBufferRef();
+
+  Expected<StringMap<uint64_t>> HashesOrErr = getBitcodeFunctionHashes(Buffer);
+  if (!HashesOrErr) {
+    consumeError(HashesOrErr.takeError());
+    return false;
+  }
+  Expected<std::unique_ptr<Module>> EntryOrErr =
+      parseBitcodeFile(Buffer, F.getContext());
+  if (!EntryOrErr) {
+    consumeError(EntryOrErr.takeError());
+    return false;
+  }
+  std::unique_ptr<Module> Entry = std::move(*EntryOrErr);
+  Buffers.push_back(std::move(*MBOrErr));
+
+  // The reader upgrades the bodies written by other versions of LLVM, which
+  // changes their hash.
+  Function *Cached = Entry->getFunction(F.getName());
+  auto Hash = HashesOrErr->find(F.getName());
+  if (!Cached || Cached->isDeclaration() ||
+      Cached->getFunctionType() != F.getFunctionType() ||
+      Hash == HashesOrErr->end() || Hash->second != StructuralHash(*Cached))
+    return false;
+
+  // Check that the globals the entry refers to have the same type here before
+  // changing anything.
+  Module &M = *F.getParent();
+  for (GlobalValue &GV : Entry->global_values()) {
+    if (&GV == Cached)
+      continue;
+    if (!GV.isDeclaration()) {
+      if (!isa<GlobalVariable>(GV))
+        return false;
+      continue;
+    }
+    GlobalValue *Existing = M.getNamedValue(GV.getName());
+    if (Existing && Existing->getType() != GV.getType())
+      return false;
+  }
+
+  // Map the globals of the entry to the ones of the module, creating the
+  // declarations and the copied globals the pipeline created the first time.
+  ValueToValueMapTy VMap;
+  SmallVector<std::pair<GlobalVariable *, GlobalVariable *>, 4> Copies;
+  for (GlobalValue &GV : Entry->global_values()) {
+    if (&GV == Cached)
+      continue;
+    if (auto *GVar = dyn_cast<GlobalVariable>(&GV)) {
+      if (!GVar->isDeclaration()) {
+        auto *Copy = new GlobalVariable(
+            M, GVar->getValueType(), GVar->isConstant(), GVar->getLinkage(),
+            nullptr, GVar->getName(), nullptr, GVar->getThreadLocalMode(),
+            GVar->getAddressSpace());
+        Copy->copyAttributesFrom(GVar);
+        Copies.push_back({GVar, Copy});
+        VMap[GVar] = Copy;
+        continue;
+      }
+    }
+
+    GlobalValue *Existing = M.getNamedValue(GV.getName());
+    if (auto *Decl = dyn_cast<Function>(&GV)) {
+      if (!Existing) {
+        Existing = Function::Create(Decl->getFunctionType(),
+                                    GlobalValue::ExternalLinkage,
+                                    Decl->getAddressSpace(), Decl->getName(),
+                                    &M);
+        cast<Function>(Existing)->copyAttributesFrom(Decl);
+      } else if (auto *Callee = dyn_cast<Function>(Existing)) {
+        // The pipeline may have inferred attributes of a library function.
+        AttributeList Attrs = Decl->getAttributes();
+        if (Callee->isDeclaration())
+          for (unsigned Index = Attrs.index_begin(), End = Attrs.index_end();
+               Index != End; ++Index)
+            if (Attrs.hasAttributes(Index))
+              Callee->addAttributes(Index, AttrBuilder(Attrs, Index));
+      }
+    } else if (!Existing) {
+      auto *Decl = cast<GlobalVariable>(&GV);
+      auto *NewDecl = new GlobalVariable(
+          M, Decl->getValueType(), Decl->isConstant(),
+          GlobalValue::ExternalLinkage, nullptr, Decl->getName(), nullptr,
+          Decl->getThreadLocalMode(), Decl->getAddressSpace());
+      NewDecl->copyAttributesFrom(Decl);
+      Existing = NewDecl;
+    }
+    VMap[&GV] = Existing;
+  }
+  for (auto &Copy : Copies)
+    Copy.second->setInitializer(
+        cast<Constant>(MapValue(Copy.first->getInitializer(), VMap)));
+
+  // Move the body of the entry into F.
+  VMap[Cached] = &F;
+  for (auto Arg = F.arg_begin(), CachedArg = Cached->arg_begin();
+       Arg != F.arg_end(); ++Arg, ++CachedArg)
+    VMap[&*CachedArg] = &*Arg;
+
+  GlobalValue::LinkageTypes Linkage = F.getLinkage();
+  F.deleteBody();
+  F.setLinkage(Linkage);
+  F.setAttributes(Cached->getAttributes());
+  if (Cached->hasPersonalityFn())
+    F.setPersonalityFn(
+        cast<Constant>(MapValue(Cached->getPersonalityFn(), VMap)));
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  Cached->getAllMetadata(MDs);
+  for (const auto &MD : MDs)
+    F.addMetadata(MD.first, *MapMetadata(MD.second, VMap));
+
+  F.getBasicBlockList().splice(F.end(), Cached->getBasicBlockList());
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      RemapInstruction(&I, VMap, RF_IgnoreMissingLocals);
+
+  ++NumLoaded;
+  return true;
+}
+
+void IncrementalCache::store(Function &F) {
+  auto Key = Keys.find(&F);
+  if (Key == Keys.end())
+    return;
+
+  // The globals the pipeline created are copied, with the globals their
+  // initializers refer to, if they are local to the module. The declarations
+  // it created are declared like the input globals.
+  ReferenceCollector Collector;
+  if (!Collector.collect(F))
+    return;
+  for (unsigned Idx = 0; Idx != Collector.Globals.size(); ++Idx) {
+    GlobalValue *GV = Collector.Globals[Idx];
+    if (InputGlobals.count(GV) || GV->isDeclaration())
+      continue;
+    auto *GVar = dyn_cast<GlobalVariable>(GV);
+    if (!GVar || !GVar->hasLocalLinkage() || !GVar->hasInitializer() ||
+        !Collector.collect(GVar->getInitializer()))
+      return;
+  }
+
+  Module &M = *F.getParent();
+  Module Entry(F.getName(), F.getContext());
+  Entry.setDataLayout(M.getDataLayout());
+  Entry.setTargetTriple(M.getTargetTriple());
+
+  // Create the globals in the order of the module, so that the ones that are
+  // copied are created in the same order when the entry is loaded.
+  ValueToValueMapTy VMap;
+  Function *Cached =
+      Function::Create(F.getFunctionType(), F.getLinkage(),
+                       F.getAddressSpace(), F.getName(), &Entry);
+  VMap[&F] = Cached;
+  SmallVector<std::pair<GlobalVariable *, GlobalVariable *>, 4> Copies;
+  for (GlobalValue &GV : M.global_values()) {
+    if (&GV == &F || !Collector.Globals.count(&GV))
+      continue;
+    if (!InputGlobals.count(&GV) && !GV.isDeclaration()) {
+      auto *GVar = cast<GlobalVariable>(&GV);
+      auto *Copy = new GlobalVariable(
+          Entry, GVar->getValueType(), GVar->isConstant(), GVar->getLinkage(),
+          nullptr, GVar->getName(), nullptr, GVar->getThreadLocalMode(),
+          GVar->getAddressSpace());
+      Copy->copyAttributesFrom(GVar);
+      Copies.push_back({GVar, Copy});
+      VMap[GVar] = Copy;
+      continue;
+    }
+
+    // Aliases are declared as functions or variables of their type.
+    GlobalValue *Decl;
+    if (auto *FTy = dyn_cast<FunctionType>(GV.getValueType())) {
+      Function *DeclF =
+          Function::Create(FTy, GlobalValue::ExternalLinkage,
+                           GV.getAddressSpace(), GV.getName(), &Entry);
+      if (auto *Callee = dyn_cast<Function>(&GV)) {
+        DeclF->setAttributes(Callee->getAttributes());
+        DeclF->setCallingConv(Callee->getCallingConv());
+      }
+      Decl = DeclF;
+    } else {
+      auto *GVar = dyn_cast<GlobalVariable>(&GV);
+      Decl = new GlobalVariable(Entry, GV.getValueType(),
+                                GVar && GVar->isConstant(),
+                                GlobalValue::ExternalLinkage, nullptr,
+                                GV.getName(), nullptr,
+                                GV.getThreadLocalMode(), GV.getAddressSpace());
+    }
+    VMap[&GV] = Decl;
+  }
+  for (auto &Copy : Copies)
+    Copy.second->setInitializer(
+        cast<Constant>(MapValue(Copy.first->getInitializer(), VMap)));
+
+  auto CachedArg = Cached->arg_begin();
+  for (Argument &Arg : F.args()) {
+    CachedArg->setName(Arg.getName());
+    VMap[&Arg] = &*CachedArg++;
+  }
+  SmallVector<ReturnInst *, 4> Returns;
+  CloneFunctionInto(Cached, &F, VMap, /*ModuleLevelChanges=*/true, Returns);
+
+  // Write to a temporary file to avoid racing with other processes.
+  SmallString<128> TempPath;
+  sys::path::append(TempPath, Dir, "Opt-%%%%%%.tmp.bc");
+  Expected<sys::fs::TempFile> Temp = sys::fs::TempFile::create(
+      TempPath, sys::fs::owner_read | sys::fs::owner_write);
+  if (!Temp)
+    report_fatal_error(Twine("Failed to create a temporary file in ") + Dir +
+                       ": " + toString(Temp.takeError()));
+  {
+    raw_fd_ostream OS(Temp->FD, /*shouldClose=*/false);
+    WriteBitcodeToFile(Entry, OS, /*ShouldPreserveUseListOrder=*/false,
+                       /*Index=*/nullptr, /*GenerateHash=*/false,
+                       /*ModHash=*/nullptr, /*GenerateFunctionHashes=*/true);
+  }
+
+  // Another process may have stored the same entry in the meantime.
+  SmallString<128> EntryPath;
+  sys::path::append(EntryPath, Dir, "llvmcache-" + Key->second);
+  Error E = Temp->keep(EntryPath);
+  E = handleErrors(std::move(E), [&](const ECError &E) -> Error {
+    std::error_code EC = E.convertToErrorCode();
+    if (EC != errc::permission_denied)
+      return errorCodeToError(EC);
+    return Temp->discard();
+  });
+  if (E)
+    report_fatal_error(Twine("Failed to rename temporary file ") +
+                       Temp->TmpName + " to " + EntryPath + ": " +
+                       toString(std::move(E)));
+  ++NumStored;
+}
+
+PreservedAnalyses IncrementalCachePass::run(Function &F,
+                                            FunctionAnalysisManager &FAM) {
+  if (Cache.load(F))
+    return PreservedAnalyses::none();
+  PreservedAnalyses PA = FPM.run(F, FAM);
+  Cache.store(F);
+  return PA;
+}
@@ -0,0 +1,95 @@
+//===- IncrementalCache.h - Cache of optimized function bodies --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+///
+/// The cache behind -incremental-cache, which keeps the bodies a function
+/// pipeline made out of the functions of a module, so that running opt again
+/// on a module where a few functions changed only optimizes those.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TOOLS_OPT_INCREMENTALCACHE_H
+#define LLVM_TOOLS_OPT_INCREMENTALCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class Function;
+class GlobalValue;
+class Module;
+class TargetMachine;
+
+/// A directory of optimized function bodies, keyed by what the pipeline sees
+/// of the function before it runs: its StructuralHash(), the hashes of the
+/// functions it calls, directly or not, the pipeline and the target.
+///
+/// An entry is a bitcode file with the optimized function, written with its
+/// structural hash, and declarations of the globals it refers to. The globals
+/// the pipeline created for it, like string constants, are copied instead.
+/// Functions with debug info or other distinct metadata, or whose blocks have
+/// their address taken, are not cached.
+///
+/// The entries are named like the ones of the ThinLTO cache, so pruneCache()
+/// applies to the directory.
+class IncrementalCache {
+public:
+  /// Create the cache in \p Dir for the functions of \p M, before it is
+  /// optimized by \p Pipeline.
+  static Expected<std::unique_ptr<IncrementalCache>>
+  create(StringRef Dir, Module &M, StringRef Pipeline, StringRef AAPipeline,
+         TargetMachine *TM);
+
+  /// Replace the body of \p F with the optimized one from the cache. Return
+  /// false if it is not in the cache.
+  bool load(Function &F);
+
+  /// Store the body of \p F, once the pipeline optimized it.
+  void store(Function &F);
+
+private:
+  IncrementalCache(StringRef Dir) : Dir(Dir) {}
+
+  void computeKeys(Module &M, StringRef Pipeline, StringRef AAPipeline,
+                   TargetMachine *TM);
+
+  std::string Dir;
+  /// The key of each function that can be cached, as a hexadecimal string.
+  DenseMap<const Function *, std::string> Keys;
+  /// The globals of the module before it is optimized.
+  SmallPtrSet<const GlobalValue *, 32> InputGlobals;
+  /// The entries loaded so far. The names of the values read from them may
+  /// point into them.
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+};
+
+/// Run a function pipeline on the functions missing from an IncrementalCache,
+/// and store them. The other functions are loaded from the cache.
+class IncrementalCachePass : public PassInfoMixin<IncrementalCachePass> {
+public:
+  IncrementalCachePass(IncrementalCache &Cache, FunctionPassManager FPM)
+      : Cache(Cache), FPM(std::move(FPM)) {}
+
+  PreservedAnalyses run(Function &F, FunctionAnalysisManager &FAM);
+
+private:
+  IncrementalCache &Cache;
+  FunctionPassManager FPM;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_TOOLS_OPT_INCREMENTALCACHE_H
@@ -14,11 +14,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "Debugify.h"
+#include "IncrementalCache.h"
 #include "NewPMDriver.h"
 #include "PassPrinters.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Bitcode/BitcodeWriterPass.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/IR/Dominators.h"
@@ -56,6 +58,24 @@ static cl::opt<std::string>
                         "pipeline for handling managed aliasing queries"),
                cl::Hidden);
 
+static cl::opt<bool> StreamBitcode(
+    "stream-bitcode", cl::Hidden,
+    cl::desc("Write each function to the output bitcode as soon as the "
+             "function pipeline given by -passes is done with it, and delete "
+             "its body. The use-list order is not preserved, as the later "
+             "functions still change the use-lists of the globals"));
+
+static cl::opt<std::string> IncrementalCacheDir(
+    "incremental-cache", cl::Hidden, cl::value_desc("dir"),
+    cl::desc("Reuse the bodies the function pipeline given by -passes made "
+             "out of the same functions in earlier runs, from the cache in "
+             "this directory, and store the other ones"));
+
+static cl::opt<unsigned> StreamBitcodeReservedIDs(
+    "stream-bitcode-reserved-ids", cl::Hidden, cl::init(4096),
+    cl::desc("Number of IDs reserved for the module-level values and for the "
+             "metadata created while streaming bitcode"));
+
 /// {{@ These options accept textual pipeline descriptions which will be
 /// inserted into default pipelines at the respective extension points
 static cl::opt<std::string> PeepholeEPPipeline(
@@ -275,7 +295,58 @@ bool llvm::runPassPipeline(StringRef Arg0, Module &M, TargetMachine *TM,
   if (EnableDebugify)
     MPM.addPass(NewPMDebugifyPass());
 
-  if (!PB.parsePassPipeline(MPM, PassPipeline, VerifyEachPass, DebugPM)) {
+  std::unique_ptr<StreamingBitcodeWriter> StreamWriter;
+  std::unique_ptr<IncrementalCache> Cache;
+  if (StreamBitcode || !IncrementalCacheDir.empty()) {
+    // -preserve-bc-uselistorder, which is on by default, is ignored: the
+    // streaming writer cannot know the final use-lists of the globals.
+    if (StreamBitcode &&
+        (OK != OK_OutputBitcode || EmitSummaryIndex || EmitModuleHash ||
+         EnableDebugify)) {
+      errs() << Arg0 << ": -stream-bitcode requires plain bitcode output.\n";
+      return false;
+    }
+    // The keys of the cache are computed before any pass runs.
+    if (!IncrementalCacheDir.empty() && EnableDebugify) {
+      errs() << Arg0 << ": -incremental-cache does not support debugify.\n";
+      return false;
+    }
+    FunctionPassManager FPM(DebugPM);
+    if (!PB.parsePassPipeline(FPM, PassPipeline, VerifyEachPass, DebugPM)) {
+      errs() << Arg0
+             << ": unable to parse function pass pipeline description.\n";
+      return false;
+    }
+    // Each function is final once the pipeline is done with it. The writer
+    // is created after the module was verified.
+    std::function<void(Function &)> Callback;
+    if (StreamBitcode)
+      Callback = [&](Function &F) {
+        if (VK > VK_NoVerifier && verifyFunction(F, &errs()))
+          report_fatal_error("Broken function found, compilation aborted!");
+        if (!StreamWriter)
+          StreamWriter = llvm::make_unique<StreamingBitcodeWriter>(
+              M, StreamBitcodeReservedIDs);
+        StreamWriter->writeFunction(F);
+      };
+    if (!IncrementalCacheDir.empty()) {
+      Expected<std::unique_ptr<IncrementalCache>> CacheOrErr =
+          IncrementalCache::create(IncrementalCacheDir, M, PassPipeline,
+                                   AAPipeline, TM);
+      if (!CacheOrErr) {
+        errs() << Arg0 << ": unable to create the incremental cache: "
+               << toString(CacheOrErr.takeError()) << "\n";
+        return false;
+      }
+      Cache = std::move(*CacheOrErr);
+      MPM.addPass(createModuleToFunctionPassAdaptor(
+          IncrementalCachePass(*Cache, std::move(FPM)), std::move(Callback)));
+    } else {
+      MPM.addPass(createModuleToFunctionPassAdaptor(std::move(FPM),
+                                                    std::move(Callback)));
+    }
+  } else if (!PB.parsePassPipeline(MPM, PassPipeline, VerifyEachPass,
+                                   DebugPM)) {
     errs() << Arg0 << ": unable to parse pass pipeline description.\n";
     return false;
   }
@@ -294,8 +365,11 @@ bool llvm::runPassPipeline(StringRef Arg0, Module &M, TargetMachine *TM,
         PrintModulePass(Out->os(), "", ShouldPreserveAssemblyUseListOrder));
     break;
   case OK_OutputBitcode:
-    MPM.addPass(BitcodeWriterPass(Out->os(), ShouldPreserveBitcodeUseListOrder,
-                                  EmitSummaryIndex, EmitModuleHash));
+    // The streamed bitcode is written once the pipeline is done.
+    if (!StreamBitcode)
+      MPM.addPass(BitcodeWriterPass(Out->os(),
+                                    ShouldPreserveBitcodeUseListOrder,
+                                    EmitSummaryIndex, EmitModuleHash));
     break;
   case OK_OutputThinLTOBitcode:
     MPM.addPass(ThinLTOBitcodeWriterPass(
@@ -309,6 +383,13 @@ bool llvm::runPassPipeline(StringRef Arg0, Module &M, TargetMachine *TM,
   // Now that we have all of the passes ready, run them.
   MPM.run(M, MAM);
 
+  if (StreamBitcode) {
+    if (!StreamWriter)
+      StreamWriter = llvm::make_unique<StreamingBitcodeWriter>(
+          M, StreamBitcodeReservedIDs);
+    StreamWriter->finish(Out->os());
+  }
+
   // Declare success.
   if (OK != OK_NoOutput) {
     Out->keep();
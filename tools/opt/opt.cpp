@@ -49,6 +49,7 @@
 #include "llvm/Support/SystemUtils.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Target/TargetMachine.h"
@@ -251,6 +252,17 @@ static cl::opt<bool> DiscardValueNames(
     cl::desc("Discard names from Value (other than GlobalValue)."),
     cl::init(false), cl::Hidden);
 
+static cl::opt<bool> UseFunctionArenas(
+    "function-arenas",
+    cl::desc("Allocate the instructions and basic blocks of every function "
+             "from an arena owned by the function."),
+    cl::init(false), cl::Hidden);
+
+static cl::opt<bool> MaterializeInParallel(
+    "materialize-in-parallel",
+    cl::desc("Parse the function bodies of bitcode input on several threads"),
+    cl::init(false), cl::Hidden);
+
 static cl::opt<bool> Coroutines(
   "enable-coroutines",
   cl::desc("Enable coroutine passes."),
@@ -271,6 +283,20 @@ static cl::opt<std::string>
                     cl::desc("YAML output filename for pass remarks"),
                     cl::value_desc("filename"));
 
+static cl::opt<bool> TimeTrace("time-trace",
+                               cl::desc("Record a time trace of the passes"));
+
+static cl::opt<unsigned> TimeTraceGranularity(
+    "time-trace-granularity",
+    cl::desc(
+        "Minimum time granularity (in microseconds) traced by time profiler"),
+    cl::init(500), cl::Hidden);
+
+static cl::opt<std::string>
+    TimeTraceFile("time-trace-file",
+                  cl::desc("Specify time trace file destination"),
+                  cl::value_desc("filename"));
+
 class OptCustomPassManager : public legacy::PassManager {
   DebugifyStatsMap DIStatsMap;
 
@@ -422,6 +448,20 @@ void initializePollyPasses(llvm::PassRegistry &Registry);
 //===----------------------------------------------------------------------===//
 // main for opt
 //
+/// Write the time trace next to the output, or the input when writing to the
+/// standard output. Return false on error.
+static bool writeTimeTrace(const char *Argv0) {
+  StringRef TraceName = OutputFilename.empty() || OutputFilename == "-"
+                            ? InputFilename
+                            : OutputFilename;
+  if (Error E = timeTraceProfilerWrite(TimeTraceFile, TraceName)) {
+    errs() << Argv0 << ": " << toString(std::move(E)) << '\n';
+    return false;
+  }
+  timeTraceProfilerCleanup();
+  return true;
+}
+
 int main(int argc, char **argv) {
   InitLLVM X(argc, argv);
 
@@ -468,6 +508,7 @@ int main(int argc, char **argv) {
   initializePostInlineEntryExitInstrumenterPass(Registry);
   initializeUnreachableBlockElimLegacyPassPass(Registry);
   initializeExpandReductionsPass(Registry);
+  initializeExpandHTMIntrinsicsPass(Registry);
   initializeWasmEHPreparePass(Registry);
   initializeWriteBitcodePassPass(Registry);
 
@@ -483,9 +524,15 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  if (TimeTrace)
+    timeTraceProfilerInitialize(TimeTraceGranularity, argv[0]);
+
   SMDiagnostic Err;
 
   Context.setDiscardValueNames(DiscardValueNames);
+  Context.setUseFunctionArenas(UseFunctionArenas);
+  if (MaterializeInParallel)
+    Context.setMaterializeBitcodeInParallel(true);
   if (!DisableDITypeMap)
     Context.enableDebugTypeODRUniquing();
 
@@ -611,13 +658,14 @@ int main(int argc, char **argv) {
     // The user has asked to use the new pass manager and provided a pipeline
     // string. Hand off the rest of the functionality to the new code for that
     // layer.
-    return runPassPipeline(argv[0], *M, TM.get(), Out.get(), ThinLinkOut.get(),
-                           OptRemarkFile.get(), PassPipeline, OK, VK,
-                           PreserveAssemblyUseListOrder,
-                           PreserveBitcodeUseListOrder, EmitSummaryIndex,
-                           EmitModuleHash, EnableDebugify)
-               ? 0
-               : 1;
+    bool Succeeded = runPassPipeline(
+        argv[0], *M, TM.get(), Out.get(), ThinLinkOut.get(),
+        OptRemarkFile.get(), PassPipeline, OK, VK, PreserveAssemblyUseListOrder,
+        PreserveBitcodeUseListOrder, EmitSummaryIndex, EmitModuleHash,
+        EnableDebugify);
+    if (TimeTrace && !writeTimeTrace(argv[0]))
+      return 1;
+    return Succeeded ? 0 : 1;
   }
 
   // Create a PassManager to hold and optimize the collection of passes we are
@@ -868,5 +916,8 @@ int main(int argc, char **argv) {
   if (ThinLinkOut)
     ThinLinkOut->keep();
 
+  if (TimeTrace && !writeTimeTrace(argv[0]))
+    return 1;
+
   return 0;
 }
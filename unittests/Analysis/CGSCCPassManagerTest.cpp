@@ -13,11 +13,15 @@
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/SourceMgr.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <string>
+#include <vector>
 
 using namespace llvm;
 
@@ -1271,4 +1275,90 @@ TEST_F(CGSCCPassManagerTest, TestAnalysisInvalidationCGSCCUpdate) {
   // and then over the whole module.
   EXPECT_EQ(6 + 3 + 6 + 3 + 6, IndirectFunctionAnalysisRuns);
 }
+
+TEST_F(CGSCCPassManagerTest, ParallelAdaptor) {
+  // A tree of calls with many more leaves than threads, so that the threads
+  // run at the same time: each of the 16 @m functions calls two @l functions,
+  // and @r calls all of the @m ones.
+  std::string IR;
+  for (int I = 0; I != 32; ++I)
+    IR += "define i32 @l" + std::to_string(I) + "(i32 %x) {\n"
+          "  %a = add i32 %x, " + std::to_string(I) + "\n"
+          "  ret i32 %a\n"
+          "}\n";
+  for (int I = 0; I != 16; ++I)
+    IR += "define i32 @m" + std::to_string(I) + "(i32 %x) {\n"
+          "  %a = call i32 @l" + std::to_string(2 * I) + "(i32 %x)\n"
+          "  %b = call i32 @l" + std::to_string(2 * I + 1) + "(i32 %a)\n"
+          "  ret i32 %b\n"
+          "}\n";
+  IR += "define i32 @r(i32 %x) {\n";
+  for (int I = 0; I != 16; ++I)
+    IR += "  %a" + std::to_string(I) + " = call i32 @m" + std::to_string(I) +
+          "(i32 %x)\n";
+  IR += "  ret i32 %a0\n"
+        "}\n";
+  SMDiagnostic Err;
+  M = parseAssemblyString(IR, Err, Context);
+  ASSERT_TRUE(M);
+
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+  MAM.registerPass([&] { return TargetLibraryAnalysis(); });
+  MAM.registerPass([&] { return LazyCallGraphAnalysis(); });
+  MAM.registerPass([&] { return FunctionAnalysisManagerModuleProxy(FAM); });
+  MAM.registerPass([&] { return CGSCCAnalysisManagerModuleProxy(CGAM); });
+  CGAM.registerPass([&] { return FunctionAnalysisManagerCGSCCProxy(); });
+  CGAM.registerPass([&] { return ModuleAnalysisManagerCGSCCProxy(MAM); });
+  FAM.registerPass([&] { return CGSCCAnalysisManagerFunctionProxy(CGAM); });
+  FAM.registerPass([&] { return ModuleAnalysisManagerFunctionProxy(MAM); });
+
+  // The SCC passes run under the call graph lock, one at a time.
+  std::vector<Function *> Visited;
+  std::atomic<int> FunctionPassRuns(0);
+  int Pipelines = 0;
+  auto BuildPipeline = [&] {
+    ++Pipelines;
+    CGSCCPassManager CGPM;
+    CGPM.addPass(LambdaSCCPass([&](LazyCallGraph::SCC &C,
+                                   CGSCCAnalysisManager &, LazyCallGraph &,
+                                   CGSCCUpdateResult &) {
+      for (LazyCallGraph::Node &N : C)
+        Visited.push_back(&N.getFunction());
+      return PreservedAnalyses::all();
+    }));
+    FunctionPassManager FPM;
+    FPM.addPass(LambdaFunctionPass([&](Function &F, FunctionAnalysisManager &) {
+      ++FunctionPassRuns;
+      // Add a declaration to the module, like the library call
+      // simplifications do.
+      F.getParent()->getOrInsertFunction(
+          "declared", FunctionType::get(Type::getVoidTy(Context), false));
+      return PreservedAnalyses::none();
+    }));
+    CGPM.addPass(createCGSCCToFunctionPassAdaptor(std::move(FPM)));
+    return CGPM;
+  };
+
+  ModulePassManager MPM;
+  MPM.addPass(ParallelModuleToPostOrderCGSCCPassAdaptor(BuildPipeline, 4));
+  EXPECT_EQ(4, Pipelines);
+  MPM.run(*M, MAM);
+
+  EXPECT_TRUE(Context.isThreadSafe());
+  EXPECT_EQ(49, FunctionPassRuns);
+  ASSERT_EQ(49u, Visited.size());
+
+  // Each function is visited once, after its callees.
+  DenseMap<Function *, unsigned> Positions;
+  for (unsigned I = 0, E = Visited.size(); I != E; ++I)
+    EXPECT_TRUE(Positions.insert({Visited[I], I}).second);
+  for (Function *F : Visited)
+    for (Instruction &I : instructions(*F))
+      if (auto *CI = dyn_cast<CallInst>(&I))
+        EXPECT_LT(Positions.lookup(CI->getCalledFunction()), Positions[F]);
+  ASSERT_TRUE(M->getFunction("declared"));
+  EXPECT_EQ(50u, M->size());
+}
 }
@@ -0,0 +1,135 @@
+//===- KnownBitsCacheTest.cpp - KnownBitsCache unit tests -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Analysis/KnownBitsCache.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/KnownBits.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class KnownBitsCacheTest : public testing::Test {
+protected:
+  void parseAssembly(const char *Assembly) {
+    SMDiagnostic Error;
+    M = parseAssemblyString(Assembly, Error, Context);
+    if (!M) {
+      Error.print("KnownBitsCacheTest", errs());
+      report_fatal_error("Could not parse the test module");
+    }
+    F = M->getFunction("test");
+    AC.reset(new AssumptionCache(*F));
+    KBC.reset(new KnownBitsCache(*AC));
+  }
+
+  Instruction *getInstruction(StringRef Name) {
+    for (Instruction &I : instructions(F))
+      if (I.getName() == Name)
+        return &I;
+    report_fatal_error("No instruction named " + Name);
+  }
+
+  KnownBits computeKnownBits(const Value *V, const Instruction *CxtI,
+                             KnownBitsCache *Cache) {
+    return llvm::computeKnownBits(V, M->getDataLayout(), /*Depth=*/0, AC.get(),
+                                  CxtI, /*DT=*/nullptr, /*ORE=*/nullptr,
+                                  /*UseInstrInfo=*/true, Cache);
+  }
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+  Function *F = nullptr;
+  std::unique_ptr<AssumptionCache> AC;
+  std::unique_ptr<KnownBitsCache> KBC;
+};
+
+} // end anonymous namespace
+
+// A chain of ors is longer than the search depth, but its known bits are
+// found when its values are queried in order.
+TEST_F(KnownBitsCacheTest, PastMaxDepth) {
+  parseAssembly("define i32 @test(i32 %x, i32 %y) {\n"
+                "  %a = and i32 %x, 15\n"
+                "  %b = and i32 %y, 15\n"
+                "  %o1 = or i32 %a, %b\n"
+                "  %o2 = or i32 %o1, %b\n"
+                "  %o3 = or i32 %o2, %b\n"
+                "  %o4 = or i32 %o3, %b\n"
+                "  %o5 = or i32 %o4, %b\n"
+                "  %o6 = or i32 %o5, %b\n"
+                "  %o7 = or i32 %o6, %b\n"
+                "  %o8 = or i32 %o7, %b\n"
+                "  ret i32 %o8\n"
+                "}\n");
+  Instruction *Last = getInstruction("o8");
+  EXPECT_EQ(0u, computeKnownBits(Last, Last, nullptr).countMinLeadingZeros());
+
+  for (Instruction &I : instructions(F))
+    if (I.getType()->isIntegerTy())
+      computeKnownBits(&I, &I, KBC.get());
+  EXPECT_EQ(28u,
+            computeKnownBits(Last, Last, KBC.get()).countMinLeadingZeros());
+  EXPECT_EQ(28u, ComputeNumSignBits(Last, M->getDataLayout(), /*Depth=*/0,
+                                    AC.get(), Last, /*DT=*/nullptr,
+                                    /*UseInstrInfo=*/true, KBC.get()));
+}
+
+// The known bits that come from an assumption are not cached, as they only
+// hold where the assumption does.
+TEST_F(KnownBitsCacheTest, Assumptions) {
+  parseAssembly("declare void @llvm.assume(i1)\n"
+                "declare void @g()\n"
+                "define i32 @test(i32 %x) {\n"
+                "  %a = add i32 %x, 1\n"
+                "  %before = add i32 %a, 0\n"
+                "  call void @g()\n"
+                "  %c = icmp ult i32 %a, 16\n"
+                "  call void @llvm.assume(i1 %c)\n"
+                "  %after = add i32 %a, 0\n"
+                "  ret i32 %after\n"
+                "}\n");
+  Instruction *A = getInstruction("a");
+  EXPECT_EQ(28u, computeKnownBits(A, getInstruction("after"), KBC.get())
+                     .countMinLeadingZeros());
+  EXPECT_EQ(0u, computeKnownBits(A, getInstruction("before"), KBC.get())
+                    .countMinLeadingZeros());
+}
+
+// Changing a value in place and forgetting it drops the results computed
+// from it.
+TEST_F(KnownBitsCacheTest, ForgetValue) {
+  parseAssembly("define i32 @test(i32 %x) {\n"
+                "  %a = and i32 %x, 15\n"
+                "  %b = shl i32 %a, 1\n"
+                "  %c = add nuw i32 %b, 1\n"
+                "  ret i32 %c\n"
+                "}\n");
+  Instruction *A = getInstruction("a");
+  Instruction *C = getInstruction("c");
+  EXPECT_EQ(27u, computeKnownBits(C, C, KBC.get()).countMinLeadingZeros());
+
+  A->setOperand(1, ConstantInt::get(A->getType(), 255));
+  KBC->forgetValue(A);
+  EXPECT_EQ(23u, computeKnownBits(C, C, KBC.get()).countMinLeadingZeros());
+
+  // Deleted values are dropped from the cache.
+  C->replaceAllUsesWith(A);
+  C->eraseFromParent();
+  EXPECT_EQ(24u, computeKnownBits(A, A, KBC.get()).countMinLeadingZeros());
+}
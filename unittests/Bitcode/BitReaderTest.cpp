@@ -12,8 +12,13 @@
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Error.h"
@@ -122,6 +127,294 @@ TEST(BitReaderTest, MaterializeFunctionsOutOfOrder) {
   EXPECT_FALSE(verifyModule(*M, &dbgs()));
 }
 
+// Tests that the names borrowed from the string table behave like copies.
+TEST(BitReaderTest, BorrowedNames) {
+  SmallString<1024> Mem;
+
+  LLVMContext Context;
+  Context.setBorrowBitcodeNames(true);
+  std::unique_ptr<Module> M = getLazyModuleFromAssembly(
+      Context, Mem, "@g = global i32 0\n"
+                    "@a = alias i32, i32* @g\n"
+                    "define void @f() {\n"
+                    "  store i32 1, i32* @a\n"
+                    "  call void @llvm.trap()\n"
+                    "  unreachable\n"
+                    "}\n"
+                    "declare void @llvm.trap()\n");
+  Function *F = M->getFunction("f");
+  GlobalVariable *G = M->getNamedGlobal("g");
+  ASSERT_TRUE(F && G && M->getNamedAlias("a"));
+  EXPECT_TRUE(F->hasBorrowedName());
+  EXPECT_TRUE(G->hasBorrowedName());
+  EXPECT_TRUE(M->getNamedAlias("a")->hasBorrowedName());
+  EXPECT_FALSE(M->getFunction("llvm.trap")->hasBorrowedName());
+  EXPECT_TRUE(G->getName().begin() >= Mem.begin() &&
+              G->getName().end() <= Mem.end());
+
+  // Renaming copies the name, and keeps names unique.
+  F->setName("g");
+  EXPECT_FALSE(F->hasBorrowedName());
+  EXPECT_EQ("g.1", F->getName());
+  EXPECT_EQ(G, M->getNamedValue("g"));
+  auto *G2 = new GlobalVariable(*M, Type::getInt32Ty(Context), false,
+                                GlobalValue::ExternalLinkage, nullptr, "a");
+  EXPECT_EQ("a.2", G2->getName());
+
+  // Moving a global out of the module and back keeps its name borrowed.
+  G->removeFromParent();
+  EXPECT_EQ("g", G->getName());
+  EXPECT_EQ(nullptr, M->getNamedValue("g"));
+  M->getGlobalList().push_back(G);
+  EXPECT_EQ(G, M->getNamedValue("g"));
+  EXPECT_TRUE(G->hasBorrowedName());
+
+  // Iterating over the symbol table copies the names.
+  unsigned NumNames = 0;
+  for (const auto &Entry : M->getValueSymbolTable()) {
+    EXPECT_EQ(Entry.getKey(), Entry.getValue()->getName());
+    ++NumNames;
+  }
+  EXPECT_EQ(5u, NumNames);
+  EXPECT_FALSE(G->hasBorrowedName());
+  EXPECT_EQ(G, M->getNamedValue("g"));
+
+  ASSERT_FALSE(M->materializeAll());
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+}
+
+// Tests that a function written before the rest of the module reads back like
+// the others, including the values and the metadata created in between.
+TEST(BitReaderTest, StreamingWriter) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M =
+      parseAssembly(Context, "@g = global i32 0\n"
+                             "define i32 @f(i32* %p) {\n"
+                             "  %v = load i32, i32* %p, !range !0\n"
+                             "  ret i32 %v\n"
+                             "}\n"
+                             "define i32 @h() {\n"
+                             "  %v = load i32, i32* @g, !range !0\n"
+                             "  ret i32 %v\n"
+                             "}\n"
+                             "!0 = !{i32 0, i32 10}\n");
+  StreamingBitcodeWriter Writer(*M, /*NumReservedIDs=*/16);
+
+  // Store to a new global, and narrow the range, before writing @f.
+  Type *I32 = Type::getInt32Ty(Context);
+  Function *F = M->getFunction("f");
+  auto *New = new GlobalVariable(*M, I32, false, GlobalValue::ExternalLinkage,
+                                 ConstantInt::get(I32, 7), "new");
+  auto *Load = cast<LoadInst>(&F->getEntryBlock().front());
+  new StoreInst(Load, New, F->getEntryBlock().getTerminator());
+  Load->setMetadata(LLVMContext::MD_range,
+                    MDBuilder(Context).createRange(APInt(32, 0), APInt(32, 5)));
+  EXPECT_TRUE(Writer.writeFunction(*F));
+  EXPECT_TRUE(F->empty());
+  EXPECT_TRUE(F->isMaterializable());
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+
+  // Declare a function after @f was written.
+  M->getOrInsertFunction("decl", I32);
+
+  SmallString<1024> Mem;
+  raw_svector_ostream OS(Mem);
+  Writer.finish(OS);
+
+  Expected<std::unique_ptr<Module>> ModuleOrErr =
+      parseBitcodeFile(MemoryBufferRef(Mem.str(), "test"), Context);
+  ASSERT_TRUE(!!ModuleOrErr) << toString(ModuleOrErr.takeError());
+  std::unique_ptr<Module> Read = std::move(ModuleOrErr.get());
+  EXPECT_FALSE(verifyModule(*Read, &dbgs()));
+
+  // Each function numbers its metadata on its own when printed, so the ranges
+  // are compared separately.
+  std::string Body;
+  raw_string_ostream BodyOS(Body);
+  Read->getFunction("f")->print(BodyOS);
+  Read->getFunction("h")->print(BodyOS);
+  EXPECT_EQ("\ndefine i32 @f(i32* %p) {\n"
+            "  %v = load i32, i32* %p, !range !0\n"
+            "  store i32 %v, i32* @new\n"
+            "  ret i32 %v\n"
+            "}\n"
+            "\ndefine i32 @h() {\n"
+            "  %v = load i32, i32* @g, !range !0\n"
+            "  ret i32 %v\n"
+            "}\n",
+            BodyOS.str());
+  auto getRange = [&](StringRef Name) {
+    return cast<LoadInst>(&Read->getFunction(Name)->getEntryBlock().front())
+        ->getMetadata(LLVMContext::MD_range);
+  };
+  EXPECT_EQ(MDBuilder(Context).createRange(APInt(32, 0), APInt(32, 5)),
+            getRange("f"));
+  EXPECT_EQ(MDBuilder(Context).createRange(APInt(32, 0), APInt(32, 10)),
+            getRange("h"));
+  EXPECT_EQ(ConstantInt::get(I32, 7),
+            Read->getNamedGlobal("new")->getInitializer());
+  ASSERT_TRUE(Read->getFunction("decl"));
+  EXPECT_TRUE(Read->getFunction("decl")->isDeclaration());
+}
+
+// Tests that parsing the function bodies on several threads reads the same
+// module as parsing them one at a time, including the use-list orders.
+TEST(BitReaderTest, MaterializeInParallel) {
+  const char *Assembly =
+      "@table = constant i8* blockaddress(@indirect, %bb)\n"
+      "@g = global i32 0\n"
+      "define i8* @before() {\n"
+      "  ret i8* blockaddress(@func, %bb)\n"
+      "}\n"
+      "define void @func() {\n"
+      "  unreachable\n"
+      "bb:\n"
+      "  unreachable\n"
+      "}\n"
+      "define void @indirect(i8* %addr) {\n"
+      "  indirectbr i8* %addr, [label %bb]\n"
+      "bb:\n"
+      "  ret void\n"
+      "}\n"
+      "define i32 @loop(i32 %n) {\n"
+      "entry:\n"
+      "  br label %body\n"
+      "body:\n"
+      "  %i = phi i32 [ 0, %entry ], [ %next, %body ]\n"
+      "  %next = add i32 %i, 1\n"
+      "  %v = load i32, i32* @g, !range !0\n"
+      "  store i32 %next, i32* @g\n"
+      "  %c = icmp slt i32 %next, %n\n"
+      "  br i1 %c, label %body, label %exit\n"
+      "exit:\n"
+      "  ret i32 %v\n"
+      "}\n"
+      "define i32 @caller(i32 %n) {\n"
+      "  %a = call i32 @loop(i32 %n), !range !0\n"
+      "  %b = call i32 @loop(i32 add (i32 ptrtoint (i32* @g to i32), i32 1))\n"
+      "  %s = add i32 %a, %b\n"
+      "  ret i32 %s\n"
+      "}\n"
+      "!0 = !{i32 0, i32 10}\n";
+
+  for (bool PreserveUseListOrder : {false, true}) {
+    SmallString<1024> Mem;
+    {
+      LLVMContext Context;
+      raw_svector_ostream OS(Mem);
+      WriteBitcodeToFile(*parseAssembly(Context, Assembly), OS,
+                         PreserveUseListOrder);
+    }
+
+    std::string Printed[2];
+    for (bool Parallel : {false, true}) {
+      LLVMContext Context;
+      Context.setMaterializeBitcodeInParallel(Parallel);
+      Expected<std::unique_ptr<Module>> ModuleOrErr =
+          parseBitcodeFile(MemoryBufferRef(Mem.str(), "test"), Context);
+      ASSERT_TRUE(!!ModuleOrErr) << toString(ModuleOrErr.takeError());
+      std::unique_ptr<Module> M = std::move(ModuleOrErr.get());
+      EXPECT_FALSE(verifyModule(*M, &dbgs()));
+      raw_string_ostream OS(Printed[Parallel]);
+      M->print(OS, nullptr, PreserveUseListOrder);
+    }
+    EXPECT_EQ(Printed[false], Printed[true]);
+  }
+}
+
+// Tests that the module-level metadata is only loaded once a function using it
+// is materialized.
+TEST(BitReaderTest, LazyLoadMetadata) {
+  // Enough nodes are shared by @g and @h to get an index of the metadata.
+  const unsigned NumShared = 30;
+  std::string Assembly = "define void @f() {\n"
+                         "  ret void, !md !0\n"
+                         "}\n"
+                         "define void @g() {\n";
+  for (unsigned I = 1; I <= NumShared; ++I)
+    Assembly += "  call void @f(), !md !" + std::to_string(I) + "\n";
+  Assembly += "  ret void, !md !0\n"
+              "}\n"
+              "define void @h() {\n";
+  for (unsigned I = 1; I <= NumShared; ++I)
+    Assembly += "  call void @f(), !md !" + std::to_string(I) + "\n";
+  Assembly += "  ret void\n"
+              "}\n"
+              "!0 = !{!\"f\"}\n";
+  for (unsigned I = 1; I <= NumShared; ++I)
+    Assembly += "!" + std::to_string(I) + " = !{!\"g" + std::to_string(I) +
+                "\"}\n";
+
+  // The nodes are parsed in another context, so that they are only found in
+  // the one that reads the bitcode once they are loaded.
+  SmallString<1024> Mem;
+  {
+    LLVMContext WriteContext;
+    writeModuleToBuffer(parseAssembly(WriteContext, Assembly.c_str()), Mem);
+  }
+  LLVMContext Context;
+  Expected<std::unique_ptr<Module>> ModuleOrErr =
+      getLazyBitcodeModule(MemoryBufferRef(Mem.str(), "test"), Context,
+                           /*ShouldLazyLoadMetadata=*/true);
+  ASSERT_TRUE(!!ModuleOrErr) << toString(ModuleOrErr.takeError());
+  std::unique_ptr<Module> M = std::move(ModuleOrErr.get());
+
+  auto IsLoaded = [&](StringRef Name) {
+    return MDTuple::getIfExists(Context, {MDString::get(Context, Name)});
+  };
+  EXPECT_FALSE(IsLoaded("f"));
+  EXPECT_FALSE(IsLoaded("g1"));
+
+  ASSERT_FALSE(M->getFunction("f")->materialize());
+  EXPECT_TRUE(IsLoaded("f"));
+  EXPECT_FALSE(IsLoaded("g1"));
+  EXPECT_FALSE(IsLoaded("g30"));
+
+  ASSERT_FALSE(M->getFunction("g")->materialize());
+  EXPECT_TRUE(IsLoaded("g1"));
+  EXPECT_TRUE(IsLoaded("g30"));
+
+  ASSERT_FALSE(M->materializeAll());
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+}
+
+TEST(BitReaderTest, FunctionHashes) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M =
+      parseAssembly(Context, "declare void @d()\n"
+                             "define i32 @f(i32 %x) {\n"
+                             "  %y = add i32 %x, 1\n"
+                             "  ret i32 %y\n"
+                             "}\n"
+                             "define void @g() {\n"
+                             "  call void @d()\n"
+                             "  ret void\n"
+                             "}\n");
+  SmallString<1024> Mem;
+  {
+    raw_svector_ostream OS(Mem);
+    WriteBitcodeToFile(*M, OS, /*ShouldPreserveUseListOrder=*/false,
+                       /*Index=*/nullptr, /*GenerateHash=*/false,
+                       /*ModHash=*/nullptr, /*GenerateFunctionHashes=*/true);
+  }
+  Expected<StringMap<uint64_t>> HashesOrErr =
+      getBitcodeFunctionHashes(MemoryBufferRef(Mem.str(), "test"));
+  ASSERT_TRUE(!!HashesOrErr) << toString(HashesOrErr.takeError());
+  StringMap<uint64_t> &Hashes = *HashesOrErr;
+
+  // Only the definitions get a hash.
+  EXPECT_EQ(2u, Hashes.size());
+  EXPECT_EQ(StructuralHash(*M->getFunction("f")), Hashes.lookup("f"));
+  EXPECT_EQ(StructuralHash(*M->getFunction("g")), Hashes.lookup("g"));
+
+  // Without the flag, the module has none.
+  SmallString<1024> Plain;
+  writeModuleToBuffer(std::move(M), Plain);
+  HashesOrErr = getBitcodeFunctionHashes(MemoryBufferRef(Plain.str(), "test"));
+  ASSERT_TRUE(!!HashesOrErr) << toString(HashesOrErr.takeError());
+  EXPECT_TRUE(HashesOrErr->empty());
+}
+
 TEST(BitReaderTest, MaterializeFunctionsForBlockAddr) { // PR11677
   SmallString<1024> Mem;
 
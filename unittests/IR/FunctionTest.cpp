@@ -8,7 +8,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueArena.h"
 #include "gtest/gtest.h"
 using namespace llvm;
 
@@ -130,4 +132,72 @@ TEST(FunctionTest, setSection) {
   EXPECT_TRUE(F->hasSection());
 }
 
+TEST(FunctionTest, ArenaAllocation) {
+  LLVMContext C;
+  Module M("test", C);
+  Type *I32 = Type::getInt32Ty(C);
+  FunctionType *FTy = FunctionType::get(I32, {I32}, false);
+
+  Function *NoArena =
+      Function::Create(FTy, GlobalValue::ExternalLinkage, "noarena", &M);
+  EXPECT_EQ(nullptr, NoArena->getArena());
+
+  C.setUseFunctionArenas(true);
+  Function *F1 = Function::Create(FTy, GlobalValue::ExternalLinkage, "f1", &M);
+  Function *F2 = Function::Create(FTy, GlobalValue::ExternalLinkage, "f2", &M);
+  ValueArena *Arena = F1->getArena();
+  ASSERT_NE(nullptr, Arena);
+  EXPECT_EQ(0u, Arena->getBytesAllocated());
+
+  Instruction *Moved;
+  {
+    ValueArenaScope Scope(Arena);
+    BasicBlock *BB = BasicBlock::Create(C, "entry", F1);
+    IRBuilder<> B(BB);
+    Moved = cast<Instruction>(B.CreateAdd(F1->arg_begin(), B.getInt32(1)));
+    // Grow the hung-off operands of a switch.
+    SwitchInst *SI = B.CreateSwitch(Moved, BB, 1);
+    for (unsigned I = 0; I != 8; ++I)
+      SI->addCase(B.getInt32(I), BB);
+  }
+  EXPECT_NE(0u, Arena->getBytesAllocated());
+
+  // Outside of the scope, the values come from the heap again.
+  BasicBlock *BB2 = BasicBlock::Create(C, "entry", F2);
+  ReturnInst::Create(C, F2->arg_begin(), BB2);
+
+  // Move an instruction out of the function and delete the function: the
+  // instruction stays alive.
+  Moved->removeFromParent();
+  Moved->setOperand(0, F2->arg_begin());
+  Moved->insertBefore(BB2->getTerminator());
+  F1->eraseFromParent();
+  BB2->getTerminator()->setOperand(0, Moved);
+  EXPECT_EQ(Moved, BB2->getTerminator()->getOperand(0));
+  EXPECT_EQ(F2->arg_begin(), Moved->getOperand(0));
+}
+
+TEST(FunctionTest, ArenaReuse) {
+  LLVMContext C;
+  C.setUseFunctionArenas(true);
+  Module M("test", C);
+  Type *I32 = Type::getInt32Ty(C);
+  FunctionType *FTy = FunctionType::get(I32, {I32}, false);
+  Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage, "f", &M);
+  ValueArena *Arena = F->getArena();
+
+  ValueArenaScope Scope(Arena);
+  BasicBlock *BB = BasicBlock::Create(C, "entry", F);
+  IRBuilder<> B(BB);
+  Value *Arg = F->arg_begin();
+  auto *Add = cast<Instruction>(B.CreateAdd(Arg, B.getInt32(1)));
+  size_t BytesAllocated = Arena->getBytesAllocated();
+
+  // The memory of a deleted instruction goes to the next one of its size.
+  Add->eraseFromParent();
+  auto *Sub = cast<Instruction>(B.CreateSub(Arg, B.getInt32(1)));
+  EXPECT_EQ(BytesAllocated, Arena->getBytesAllocated());
+  B.CreateRet(Sub);
+}
+
 } // end namespace
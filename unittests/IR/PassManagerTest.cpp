@@ -14,6 +14,8 @@
 #include "llvm/IR/Module.h"
 #include "llvm/Support/SourceMgr.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <string>
 
 using namespace llvm;
 
@@ -772,4 +774,93 @@ TEST_F(PassManagerTest, IndirectAnalysisInvalidation) {
   // three functions.
   EXPECT_EQ(3 * 4 * 3, FunctionCount);
 }
+
+class TestThreadSafeFunctionAnalysis
+    : public AnalysisInfoMixin<TestThreadSafeFunctionAnalysis> {
+public:
+  struct Result {
+    Result(int Count) : InstructionCount(Count) {}
+    int InstructionCount;
+  };
+
+  TestThreadSafeFunctionAnalysis(std::atomic<int> &Runs) : Runs(Runs) {}
+
+  Result run(Function &F, FunctionAnalysisManager &AM) {
+    ++Runs;
+    return Result(F.getInstructionCount());
+  }
+
+private:
+  friend AnalysisInfoMixin<TestThreadSafeFunctionAnalysis>;
+  static AnalysisKey Key;
+
+  std::atomic<int> &Runs;
+};
+
+AnalysisKey TestThreadSafeFunctionAnalysis::Key;
+
+TEST_F(PassManagerTest, ParallelAdaptor) {
+  // Many more functions than threads, so that the threads run at the same
+  // time.
+  std::string IR;
+  const int NumFunctions = 64;
+  for (int I = 0; I != NumFunctions; ++I)
+    IR += "define i32 @f" + std::to_string(I) + "(i32 %x) {\n"
+          "  %a = add i32 %x, " + std::to_string(I) + "\n"
+          "  ret i32 %a\n"
+          "}\n";
+  M = parseIR(Context, IR.c_str());
+  ASSERT_TRUE(M);
+
+  FunctionAnalysisManager FAM;
+  std::atomic<int> FunctionAnalysisRuns(0);
+  FAM.registerPass(
+      [&] { return TestThreadSafeFunctionAnalysis(FunctionAnalysisRuns); });
+
+  ModuleAnalysisManager MAM;
+  MAM.registerPass([&] { return FunctionAnalysisManagerModuleProxy(FAM); });
+  FAM.registerPass([&] { return ModuleAnalysisManagerFunctionProxy(MAM); });
+
+  std::atomic<int> PassRuns(0), InstrCount(0);
+  int Pipelines = 0;
+  auto BuildPipeline = [&](bool Invalidate) {
+    ++Pipelines;
+    FunctionPassManager FPM;
+    FPM.addPass(LambdaPass([&](Function &F, FunctionAnalysisManager &AM) {
+      ++PassRuns;
+      InstrCount += AM.getResult<TestThreadSafeFunctionAnalysis>(F)
+                        .InstructionCount;
+      // Add a declaration to the module, like the library call
+      // simplifications do.
+      F.getParent()->getOrInsertFunction(
+          "declared", FunctionType::get(Type::getVoidTy(Context), false));
+      return PreservedAnalyses::all();
+    }));
+    if (Invalidate)
+      FPM.addPass(LambdaPass([](Function &, FunctionAnalysisManager &) {
+        return PreservedAnalyses::none();
+      }));
+    return FPM;
+  };
+
+  // The second pipeline uses the cached analyses, then invalidates them.
+  ModulePassManager MPM;
+  MPM.addPass(ParallelModuleToFunctionPassAdaptor(
+      [&] { return BuildPipeline(false); }, 4));
+  MPM.addPass(ParallelModuleToFunctionPassAdaptor(
+      [&] { return BuildPipeline(true); }, 4));
+  MPM.addPass(ParallelModuleToFunctionPassAdaptor(
+      [&] { return BuildPipeline(false); }, 4));
+  EXPECT_EQ(12, Pipelines);
+  MPM.run(*M, MAM);
+
+  EXPECT_TRUE(Context.isThreadSafe());
+  EXPECT_EQ(3 * NumFunctions, PassRuns);
+  EXPECT_EQ(3 * 2 * NumFunctions, InstrCount);
+  EXPECT_EQ(2 * NumFunctions, FunctionAnalysisRuns);
+  Function *Declared = M->getFunction("declared");
+  ASSERT_TRUE(Declared);
+  EXPECT_TRUE(Declared->isDeclaration());
+  EXPECT_EQ(NumFunctions + 1u, M->size());
+}
 }
@@ -0,0 +1,124 @@
+//===- StructuralHashTest.cpp - StructuralHash unit tests -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/StructuralHash.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+std::unique_ptr<Module> parseIR(LLVMContext &C, const char *IR) {
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(IR, Err, C);
+  if (!M)
+    Err.print("StructuralHashTest", errs());
+  return M;
+}
+
+uint64_t hashOf(LLVMContext &C, const char *IR, StringRef Name = "f") {
+  std::unique_ptr<Module> M = parseIR(C, IR);
+  return StructuralHash(*M->getFunction(Name));
+}
+
+const char *Base = R"(
+  @g = constant i32 7
+  declare i32 @h(i32)
+  define i32 @f(i32 %x) {
+    %v = load i32, i32* @g, !range !0
+    %a = add nsw i32 %x, %v
+    %r = call i32 @h(i32 %a)
+    ret i32 %r
+  }
+  !0 = !{i32 0, i32 8}
+)";
+
+TEST(StructuralHashTest, SameAcrossContexts) {
+  LLVMContext C1, C2;
+  EXPECT_EQ(hashOf(C1, Base), hashOf(C2, Base));
+}
+
+TEST(StructuralHashTest, IgnoresValueNames) {
+  LLVMContext C1, C2;
+  const char *Renamed = R"(
+    @g = constant i32 7
+    declare i32 @h(i32)
+    define i32 @f(i32 %y) {
+      %w = load i32, i32* @g, !range !0
+      %b = add nsw i32 %y, %w
+      %s = call i32 @h(i32 %b)
+      ret i32 %s
+    }
+    !0 = !{i32 0, i32 8}
+  )";
+  EXPECT_EQ(hashOf(C1, Base), hashOf(C2, Renamed));
+}
+
+TEST(StructuralHashTest, DependsOnContents) {
+  LLVMContext C;
+  uint64_t H = hashOf(C, Base);
+
+  const char *OtherFlags = R"(
+    @g = constant i32 7
+    declare i32 @h(i32)
+    define i32 @f(i32 %x) {
+      %v = load i32, i32* @g, !range !0
+      %a = add nuw i32 %x, %v
+      %r = call i32 @h(i32 %a)
+      ret i32 %r
+    }
+    !0 = !{i32 0, i32 8}
+  )";
+  EXPECT_NE(H, hashOf(C, OtherFlags));
+
+  const char *OtherInitializer = R"(
+    @g = constant i32 6
+    declare i32 @h(i32)
+    define i32 @f(i32 %x) {
+      %v = load i32, i32* @g, !range !0
+      %a = add nsw i32 %x, %v
+      %r = call i32 @h(i32 %a)
+      ret i32 %r
+    }
+    !0 = !{i32 0, i32 8}
+  )";
+  EXPECT_NE(H, hashOf(C, OtherInitializer));
+
+  const char *OtherCallee = R"(
+    @g = constant i32 7
+    declare i32 @k(i32)
+    define i32 @f(i32 %x) {
+      %v = load i32, i32* @g, !range !0
+      %a = add nsw i32 %x, %v
+      %r = call i32 @k(i32 %a)
+      ret i32 %r
+    }
+    !0 = !{i32 0, i32 8}
+  )";
+  EXPECT_NE(H, hashOf(C, OtherCallee));
+
+  const char *OtherMetadata = R"(
+    @g = constant i32 7
+    declare i32 @h(i32)
+    define i32 @f(i32 %x) {
+      %v = load i32, i32* @g, !range !0
+      %a = add nsw i32 %x, %v
+      %r = call i32 @h(i32 %a)
+      ret i32 %r
+    }
+    !0 = !{i32 0, i32 4}
+  )";
+  EXPECT_NE(H, hashOf(C, OtherMetadata));
+}
+
+} // end anonymous namespace
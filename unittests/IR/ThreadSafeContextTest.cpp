@@ -0,0 +1,105 @@
+//===- ThreadSafeContextTest.cpp - Thread-safe LLVMContext tests ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IR/Verifier.h"
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+using namespace llvm;
+
+namespace {
+
+TEST(ThreadSafeContextTest, enableThreadSafety) {
+  LLVMContext Context;
+  EXPECT_FALSE(Context.isThreadSafe());
+  Context.enableThreadSafety();
+  EXPECT_TRUE(Context.isThreadSafe());
+}
+
+#if LLVM_ENABLE_THREADS
+// Build functions using the same types, constants, attributes and metadata on
+// several threads at once, each in its own module.
+TEST(ThreadSafeContextTest, BuildFunctions) {
+  LLVMContext Context;
+  Context.enableThreadSafety();
+
+  const unsigned NumThreads = 4;
+  const unsigned NumFunctions = 50;
+  std::vector<std::unique_ptr<Module>> Modules;
+  for (unsigned T = 0; T != NumThreads; ++T)
+    Modules.push_back(
+        llvm::make_unique<Module>("m" + std::to_string(T), Context));
+
+  auto Build = [&](Module &M) {
+    MDBuilder MDB(Context);
+    for (unsigned I = 0; I != NumFunctions; ++I) {
+      Type *I64 = Type::getInt64Ty(Context);
+      StructType *Pair = StructType::get(I64, I64);
+      FunctionType *FTy =
+          FunctionType::get(I64, {I64, PointerType::getUnqual(Pair)}, false);
+      Function *F = Function::Create(FTy, GlobalValue::ExternalLinkage,
+                                     "f" + std::to_string(I), &M);
+      F->addFnAttr(Attribute::NoUnwind);
+      BasicBlock *BB = BasicBlock::Create(Context, "entry", F);
+      IRBuilder<> B(BB);
+      Value *Arg = F->arg_begin();
+      WeakTrackingVH Handle(Arg);
+      Value *Sum = B.CreateAdd(Arg, ConstantInt::get(I64, I % 7), "sum");
+      Value *Ptr = B.CreateStructGEP(Pair, F->arg_begin() + 1, 1);
+      LoadInst *Field = B.CreateLoad(Ptr);
+      Field->setMetadata(LLVMContext::MD_range,
+                         MDB.createRange(APInt(64, 0), APInt(64, I + 1)));
+      B.CreateRet(B.CreateMul(Sum, Field, "mul"));
+      EXPECT_EQ(Arg, Handle);
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  for (auto &M : Modules)
+    Threads.emplace_back(Build, std::ref(*M));
+  for (auto &T : Threads)
+    T.join();
+
+  for (auto &M : Modules)
+    EXPECT_FALSE(verifyModule(*M, &errs()));
+
+  // The threads got the same uniqued objects.
+  Function *F0 = Modules[0]->getFunction("f3");
+  for (auto &M : Modules) {
+    Function *F = M->getFunction("f3");
+    EXPECT_EQ(F0->getFunctionType(), F->getFunctionType());
+    EXPECT_EQ(F0->getAttributes(), F->getAttributes());
+    auto *Mul0 = cast<Instruction>(F0->getEntryBlock().getTerminator()
+                                       ->getOperand(0));
+    auto *Mul = cast<Instruction>(F->getEntryBlock().getTerminator()
+                                      ->getOperand(0));
+    auto *Load0 = cast<Instruction>(Mul0->getOperand(1));
+    auto *Load = cast<Instruction>(Mul->getOperand(1));
+    EXPECT_EQ(Load0->getMetadata(LLVMContext::MD_range),
+              Load->getMetadata(LLVMContext::MD_range));
+  }
+
+  // Every thread added its uses to the shared constants.
+  ConstantInt *Three = ConstantInt::get(Type::getInt64Ty(Context), 3);
+  unsigned NumUses = 0;
+  for (unsigned I = 0; I != NumFunctions; ++I)
+    NumUses += I % 7 == 3;
+  EXPECT_EQ(NumThreads * NumUses, Three->getNumUses());
+}
+#endif
+
+} // end anonymous namespace
@@ -44,6 +44,68 @@ TEST(ValueTest, UsedInBasicBlock) {
   EXPECT_TRUE(F->arg_begin()->isUsedInBasicBlock(&F->front()));
 }
 
+TEST(ValueTest, UseCounts) {
+  LLVMContext C;
+
+  const char *ModuleString =
+      "@g = global i32 0\n"
+      "@h = global i32 0\n"
+      "define void @f(i32 %x, i32 %y) {\n"
+      "  %x1 = add i32 %x, 1\n"
+      "  %x2 = add i32 %x, %x\n"
+      "  %p = getelementptr i32, i32* @g, i64 1\n"
+      "  store i32 %x1, i32* @g\n"
+      "  store i32 %x2, i32* getelementptr (i32, i32* @g, i64 2)\n"
+      "  store i32 %x, i32* @g\n"
+      "  ret void\n"
+      "}\n";
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(ModuleString, Err, C);
+  ASSERT_TRUE(M);
+
+  Function *F = M->getFunction("f");
+  Argument *X = F->arg_begin(), *Y = std::next(F->arg_begin());
+  GlobalVariable *G = M->getNamedGlobal("g"), *H = M->getNamedGlobal("h");
+  auto Walk = [](Value *V) {
+    return (unsigned)std::distance(V->use_begin(), V->use_end());
+  };
+
+  EXPECT_TRUE(X->hasUseCount());
+  EXPECT_TRUE(G->hasUseCount());
+  EXPECT_FALSE(F->front().front().hasUseCount());
+  EXPECT_EQ(4u, X->getNumUses());
+  EXPECT_TRUE(X->hasNUses(4));
+  EXPECT_TRUE(X->hasNUsesOrMore(3));
+  EXPECT_FALSE(X->hasNUsesOrMore(5));
+  EXPECT_TRUE(Y->use_empty());
+  EXPECT_TRUE(Y->hasNUses(0));
+  EXPECT_EQ(4u, G->getNumUses());
+  EXPECT_EQ(Walk(G), G->getNumUses());
+
+  // Replacing the uses keeps them in the same order as setting them one at a
+  // time would, and rewrites the constant expression using @g.
+  SmallVector<User *, 4> XUsers(X->user_begin(), X->user_end());
+  std::reverse(XUsers.begin(), XUsers.end());
+  X->replaceAllUsesWith(Y);
+  EXPECT_EQ(0u, X->getNumUses());
+  EXPECT_EQ(4u, Y->getNumUses());
+  EXPECT_TRUE(std::equal(XUsers.begin(), XUsers.end(), Y->user_begin()));
+
+  G->replaceAllUsesWith(H);
+  EXPECT_TRUE(G->use_empty());
+  EXPECT_EQ(0u, G->getNumUses());
+  EXPECT_EQ(4u, H->getNumUses());
+  EXPECT_EQ(Walk(H), H->getNumUses());
+
+  // Deleting the users updates the counts.
+  while (F->front().size() > 1)
+    F->front().back().getPrevNode()->eraseFromParent();
+  EXPECT_EQ(0u, Y->getNumUses());
+  H->removeDeadConstantUsers();
+  EXPECT_TRUE(H->hasNUses(0));
+  EXPECT_EQ(Walk(H), H->getNumUses());
+}
+
 TEST(GlobalTest, CreateAddressSpace) {
   LLVMContext Ctx;
   std::unique_ptr<Module> M(new Module("TestModule", Ctx));
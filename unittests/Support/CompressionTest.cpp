@@ -16,6 +16,7 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Config/config.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -72,6 +73,172 @@ TEST(CompressionTest, ZlibCRC32) {
       zlib::crc32(StringRef("The quick brown fox jumps over the lazy dog")));
 }
 
+TEST(CompressionTest, ZlibStream) {
+  // Write more than a chunk, in pieces, to exercise the streaming.
+  std::string Input;
+  for (unsigned I = 0; I < 20000; ++I)
+    Input += "line " + std::to_string(I) + "\n";
+
+  SmallString<32> Compressed;
+  Error E = zlib::compressStream(
+      [&](raw_ostream &OS) {
+        for (size_t I = 0; I < Input.size(); I += 7)
+          OS << StringRef(Input).substr(I, 7);
+      },
+      Compressed);
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+
+  // The result is a regular zlib stream.
+  SmallString<32> Uncompressed;
+  E = zlib::uncompress(Compressed, Uncompressed, Input.size());
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+  EXPECT_EQ(Input, Uncompressed);
+
+  std::string Streamed;
+  unsigned Chunks = 0;
+  E = zlib::uncompressStream(Compressed, [&](StringRef Chunk) {
+    Streamed += Chunk;
+    ++Chunks;
+    return Error::success();
+  });
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+  EXPECT_EQ(Input, Streamed);
+  EXPECT_GT(Chunks, 1U);
+
+  // Truncated input is an error.
+  E = zlib::uncompressStream(Compressed.str().drop_back(10),
+                             [](StringRef) { return Error::success(); });
+  EXPECT_EQ("zlib error: Z_BUF_ERROR", llvm::toString(std::move(E)));
+}
+
+TEST(CompressionTest, ZlibParallel) {
+  // Several chunks, the last one partial.
+  std::string Input;
+  for (unsigned I = 0; Input.size() < 1000000; ++I)
+    Input += "line " + std::to_string(I * I % 7919) + "\n";
+
+  for (int Level : {zlib::NoCompression, zlib::BestSpeedCompression,
+                    zlib::DefaultCompression, zlib::BestSizeCompression}) {
+    SmallString<32> Compressed;
+    Error E = zlib::compressParallel(Input, Compressed, Level);
+    EXPECT_FALSE(E);
+    consumeError(std::move(E));
+
+    // The result is a regular zlib stream, with a valid checksum.
+    SmallString<32> Uncompressed;
+    E = zlib::uncompress(Compressed, Uncompressed, Input.size());
+    EXPECT_FALSE(E);
+    consumeError(std::move(E));
+    EXPECT_EQ(Input, Uncompressed);
+
+    // The chunks compress about as well as a single stream.
+    SmallString<32> Serial;
+    E = zlib::compress(Input, Serial, Level);
+    EXPECT_FALSE(E);
+    consumeError(std::move(E));
+    EXPECT_LT(Compressed.size(), Serial.size() + Serial.size() / 20 + 64);
+  }
+
+  // A corrupted checksum is detected.
+  SmallString<32> Compressed;
+  Error E = zlib::compressParallel(Input, Compressed);
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+  Compressed.back() ^= 1;
+  SmallString<32> Uncompressed;
+  E = zlib::uncompress(Compressed, Uncompressed, Input.size());
+  EXPECT_EQ("zlib error: Z_DATA_ERROR", llvm::toString(std::move(E)));
+}
+
+#endif
+
+#if LLVM_ENABLE_ZSTD == 1 && HAVE_LIBZSTD
+
+void TestZstdCompression(StringRef Input, int Level) {
+  SmallString<32> Compressed;
+  SmallString<32> Uncompressed;
+
+  Error E = zstd::compress(Input, Compressed, Level);
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+
+  // Check that uncompressed buffer is the same as original.
+  E = zstd::uncompress(Compressed, Uncompressed, Input.size());
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+
+  EXPECT_EQ(Input, Uncompressed);
+  if (Input.size() > 0) {
+    // Uncompression fails if expected length is too short.
+    E = zstd::uncompress(Compressed, Uncompressed, Input.size() - 1);
+    EXPECT_EQ("zstd error: Destination buffer is too small",
+              llvm::toString(std::move(E)));
+  }
+}
+
+TEST(CompressionTest, Zstd) {
+  TestZstdCompression("", zstd::DefaultCompression);
+
+  TestZstdCompression("hello, world!", zstd::BestSizeCompression);
+  TestZstdCompression("hello, world!", zstd::BestSpeedCompression);
+  TestZstdCompression("hello, world!", zstd::DefaultCompression);
+
+  const size_t kSize = 1024;
+  char BinaryData[kSize];
+  for (size_t i = 0; i < kSize; ++i) {
+    BinaryData[i] = i & 255;
+  }
+  StringRef BinaryDataStr(BinaryData, kSize);
+
+  TestZstdCompression(BinaryDataStr, zstd::BestSizeCompression);
+  TestZstdCompression(BinaryDataStr, zstd::BestSpeedCompression);
+  TestZstdCompression(BinaryDataStr, zstd::DefaultCompression);
+}
+
+TEST(CompressionTest, ZstdStream) {
+  // Write more than a chunk, in pieces, to exercise the streaming.
+  std::string Input;
+  for (unsigned I = 0; I < 20000; ++I)
+    Input += "line " + std::to_string(I) + "\n";
+
+  SmallString<32> Compressed;
+  Error E = zstd::compressStream(
+      [&](raw_ostream &OS) {
+        for (size_t I = 0; I < Input.size(); I += 7)
+          OS << StringRef(Input).substr(I, 7);
+      },
+      Compressed);
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+
+  // The result is a regular zstd frame.
+  SmallString<32> Uncompressed;
+  E = zstd::uncompress(Compressed, Uncompressed, Input.size());
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+  EXPECT_EQ(Input, Uncompressed);
+
+  std::string Streamed;
+  unsigned Chunks = 0;
+  E = zstd::uncompressStream(Compressed, [&](StringRef Chunk) {
+    Streamed += Chunk;
+    ++Chunks;
+    return Error::success();
+  });
+  EXPECT_FALSE(E);
+  consumeError(std::move(E));
+  EXPECT_EQ(Input, Streamed);
+  EXPECT_GT(Chunks, 1U);
+
+  // Truncated input is an error.
+  E = zstd::uncompressStream(Compressed.str().drop_back(10),
+                             [](StringRef) { return Error::success(); });
+  EXPECT_EQ("zstd error: Src size is incorrect", llvm::toString(std::move(E)));
+}
+
 #endif
 
 }
@@ -12,11 +12,15 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Support/ConcurrencyLimit.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/TargetSelect.h"
 
 #include "gtest/gtest.h"
 
+#include <chrono>
+#include <thread>
+
 using namespace llvm;
 
 // Fixture for the unittests, allowing to *temporarily* disable the unittests
@@ -164,3 +168,85 @@ TEST_F(ThreadPoolTest, PoolDestruction) {
   }
   ASSERT_EQ(5, checked_in);
 }
+
+TEST_F(ThreadPoolTest, NestedTasks) {
+  CHECK_UNSUPPORTED();
+  // Tasks submitted from a task go to the deque of its thread, where the
+  // other threads can steal them.
+  std::atomic_int checked_in{0};
+  ThreadPool Pool;
+  for (size_t i = 0; i < 5; ++i) {
+    Pool.async([&Pool, &checked_in] {
+      for (size_t j = 0; j < 5; ++j)
+        Pool.async([&checked_in] { ++checked_in; });
+      ++checked_in;
+    });
+  }
+  Pool.wait();
+  ASSERT_EQ(30, checked_in);
+}
+
+TEST_F(ThreadPoolTest, WaitForNestedTask) {
+  CHECK_UNSUPPORTED();
+  // A task waiting for a task queued behind it on the only thread of the
+  // pool runs it instead of deadlocking.
+  std::atomic_int checked_in{0};
+  ThreadPool Pool(1);
+  Pool.async([&Pool, &checked_in] {
+    auto Future = Pool.async([&checked_in] { ++checked_in; });
+    Pool.wait(Future);
+    ASSERT_EQ(1, checked_in);
+    ++checked_in;
+  });
+  Pool.wait();
+  ASSERT_EQ(2, checked_in);
+}
+
+TEST_F(ThreadPoolTest, ConcurrencyLimit) {
+  CHECK_UNSUPPORTED();
+  // The threads of all the pools share the concurrency limit of the process.
+  unsigned OldLimit = parallel::getMaxConcurrency();
+  parallel::setMaxConcurrency(2);
+  std::atomic_int Running{0};
+  std::atomic_int MaxRunning{0};
+  auto Task = [&Running, &MaxRunning] {
+    int Now = ++Running;
+    int Max = MaxRunning;
+    while (Now > Max && !MaxRunning.compare_exchange_weak(Max, Now))
+      ;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    --Running;
+  };
+  {
+    ThreadPool Pool1(4), Pool2(4);
+    for (size_t i = 0; i < 16; ++i) {
+      Pool1.async(Task);
+      Pool2.async(Task);
+    }
+    Pool1.wait();
+    Pool2.wait();
+  }
+  parallel::setMaxConcurrency(OldLimit);
+  ASSERT_LE(MaxRunning, 2);
+}
+
+TEST_F(ThreadPoolTest, WaitFromOtherPool) {
+  CHECK_UNSUPPORTED();
+  // A task waiting for another pool gives its token to the threads of that
+  // pool.
+  unsigned OldLimit = parallel::getMaxConcurrency();
+  parallel::setMaxConcurrency(1);
+  std::atomic_int checked_in{0};
+  {
+    ThreadPool Outer(1);
+    Outer.async([&checked_in] {
+      ThreadPool Inner(1);
+      Inner.async([&checked_in] { ++checked_in; });
+      Inner.wait();
+      ++checked_in;
+    });
+    Outer.wait();
+  }
+  parallel::setMaxConcurrency(OldLimit);
+  ASSERT_EQ(2, checked_in);
+}
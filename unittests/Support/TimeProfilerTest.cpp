@@ -0,0 +1,98 @@
+//===- TimeProfilerTest.cpp - Unit tests for the time trace profiler ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+
+using namespace llvm;
+
+namespace {
+
+/// Write the trace and return its events.
+json::Array writeTrace() {
+  std::string Buffer;
+  raw_string_ostream OS(Buffer);
+  timeTraceProfilerWrite(OS);
+  Expected<json::Value> Trace = json::parse(OS.str());
+  EXPECT_TRUE(bool(Trace));
+  if (!Trace)
+    return json::Array();
+  return std::move(*Trace->getAsObject()->getArray("traceEvents"));
+}
+
+const json::Object *findEvent(const json::Array &Events, StringRef Name) {
+  for (const json::Value &Event : Events)
+    if (Event.getAsObject()->getString("name") == Name)
+      return Event.getAsObject();
+  return nullptr;
+}
+
+TEST(TimeProfiler, Disabled) {
+  EXPECT_FALSE(timeTraceProfilerEnabled());
+  TimeTraceScope Scope("Ignored", []() -> std::string {
+    ADD_FAILURE() << "The detail is computed when the profiler is disabled";
+    return "";
+  });
+}
+
+TEST(TimeProfiler, NestedSections) {
+  timeTraceProfilerInitialize(0, "TimeProfilerTest");
+  EXPECT_TRUE(timeTraceProfilerEnabled());
+  {
+    TimeTraceScope Outer("Outer", StringRef("outer detail"));
+    for (int I = 0; I < 3; ++I)
+      TimeTraceScope Inner("Inner", [] { return std::string("inner"); });
+  }
+  json::Array Events = writeTrace();
+  timeTraceProfilerCleanup();
+
+  const json::Object *Outer = findEvent(Events, "Outer");
+  const json::Object *Inner = findEvent(Events, "Inner");
+  ASSERT_TRUE(Outer && Inner);
+  EXPECT_EQ(Outer->getString("ph"), StringRef("X"));
+  EXPECT_EQ(Outer->getObject("args")->getString("detail"),
+            StringRef("outer detail"));
+  EXPECT_EQ(Inner->getObject("args")->getString("detail"), StringRef("inner"));
+  EXPECT_EQ(Outer->getInteger("tid"), Inner->getInteger("tid"));
+  EXPECT_LE(*Outer->getInteger("ts"), *Inner->getInteger("ts"));
+  EXPECT_LE(*Inner->getInteger("ts") + *Inner->getInteger("dur"),
+            *Outer->getInteger("ts") + *Outer->getInteger("dur"));
+
+  const json::Object *InnerTotal = findEvent(Events, "Total Inner");
+  ASSERT_TRUE(InnerTotal);
+  EXPECT_EQ(*InnerTotal->getObject("args")->getInteger("count"), 3);
+  const json::Object *Process = findEvent(Events, "process_name");
+  ASSERT_TRUE(Process);
+  EXPECT_EQ(Process->getObject("args")->getString("name"),
+            StringRef("TimeProfilerTest"));
+}
+
+#if LLVM_ENABLE_THREADS
+TEST(TimeProfiler, Threads) {
+  timeTraceProfilerInitialize(0, "TimeProfilerTest");
+  std::thread WorkerThread([] { TimeTraceScope Scope("Worker"); });
+  WorkerThread.join();
+  { TimeTraceScope Scope("Main"); }
+  json::Array Events = writeTrace();
+  timeTraceProfilerCleanup();
+
+  const json::Object *Worker = findEvent(Events, "Worker");
+  const json::Object *Main = findEvent(Events, "Main");
+  ASSERT_TRUE(Worker && Main);
+  EXPECT_NE(Worker->getInteger("tid"), Main->getInteger("tid"));
+}
+#endif
+
+} // end anonymous namespace